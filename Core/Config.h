@@ -112,6 +112,8 @@ struct Config {
 	int iLockedCPUSpeed;
 	bool bAutoSaveSymbolMap;
 	bool bCacheFullIsoInRam;
+	bool bSharedDiskCache;
+	bool bMapLocalISOs;
 	int iRemoteISOPort;
 	std::string sLastRemoteISOServer;
 	int iLastRemoteISOPort;
@@ -144,6 +146,8 @@ struct Config {
 	bool bSoftwareRendering;
 	bool bHardwareTransform; // only used in the GLES backend
 	bool bSoftwareSkinning;  // may speed up some games
+	bool bGeThread;  // runs display lists on their own thread
+	bool bDisplayListCache;  // replays pre-decoded stretches of display lists that run again
 	bool bVendorBugChecksEnabled;
 
 	int iRenderingMode; // 0 = non-buffered rendering 1 = buffered rendering
@@ -186,6 +190,7 @@ struct Config {
 	int iTexScalingLevel; // 0 = auto, 1 = off, 2 = 2x, ..., 5 = 5x
 	int iTexScalingType; // 0 = xBRZ, 1 = Hybrid
 	bool bTexDeposterize;
+	bool bTexScalingAsync;
 	bool bTexHardwareScaling;
 	int iFpsLimit1;
 	int iFpsLimit2;
@@ -88,60 +88,85 @@ size_t CachingFileLoader::ReadAt(s64 absolutePos, size_t bytes, void *data, Flag
 			size_t bytesFromCache = ReadFromCache(absolutePos + readSize, bytes - readSize, (u8 *)data + readSize);
 			readSize += bytesFromCache;
 			if (bytesFromCache == 0) {
-				// We can't read any more.
+				// Another thread evicted it already, so just read the rest directly.
+				readSize += backend_->ReadAt(absolutePos + readSize, bytes - readSize, (u8 *)data + readSize, flags);
 				break;
 			}
 		}
 
-		StartReadAhead(absolutePos + readSize);
+		if (bytes != 0 && prefetcher_->NoteRead(absolutePos >> BLOCK_SHIFT, (absolutePos + bytes - 1) >> BLOCK_SHIFT)) {
+			StartReadAhead();
+		}
 	}
 
 	return readSize;
 }
 
+void CachingFileLoader::HintExtent(s64 absolutePos, s64 bytes) {
+	Prepare();
+	if (filesize_ > 0 && bytes > 0 && prefetcher_->NoteExtent(absolutePos >> BLOCK_SHIFT, (absolutePos + bytes - 1) >> BLOCK_SHIFT)) {
+		StartReadAhead();
+	}
+}
+
 void CachingFileLoader::InitCache() {
-	cacheSize_ = 0;
-	oldestGeneration_ = 0;
-	generation_ = 0;
+	numBlocks_ = (filesize_ + BLOCK_SIZE - 1) >> BLOCK_SHIFT;
+	blocks_.reset(new BlockInfo[numBlocks_]);
+	slots_.reserve(std::min((s64)MAX_BLOCKS_CACHED, numBlocks_));
+	clockHand_ = 0;
+	prefetcher_.reset(new FilePrefetcher(FilePrefetcher::TraceFilename(Path()), numBlocks_, [this](s64 block) {
+		return blocks_[block].ptr.load() != nullptr;
+	}));
 }
 
 void CachingFileLoader::ShutdownCache() {
 	// TODO: Maybe add some hint that deletion is coming soon?
 	// We can't delete while the thread is running, so have to wait.
 	// This should only happen from the menu.
+	aheadCancel_ = true;
 	while (aheadThreadRunning_) {
 		sleep_ms(1);
 	}
 	if (aheadThread_.joinable())
 		aheadThread_.join();
 
-	std::lock_guard<std::recursive_mutex> guard(blocksMutex_);
-	for (auto block : blocks_) {
-		delete [] block.second.ptr;
+	std::lock_guard<std::mutex> guard(blocksMutex_);
+	for (auto &slot : slots_) {
+		delete [] slot.ptr;
 	}
-	blocks_.clear();
-	cacheSize_ = 0;
+	slots_.clear();
+	blocks_.reset();
+	prefetcher_.reset();
 }
 
 size_t CachingFileLoader::ReadFromCache(s64 pos, size_t bytes, void *data) {
+	if (bytes == 0) {
+		return 0;
+	}
 	s64 cacheStartPos = pos >> BLOCK_SHIFT;
-	s64 cacheEndPos = (pos + bytes - 1) >> BLOCK_SHIFT;
-	// TODO: Smarter.
+	s64 cacheEndPos = std::min((s64)((pos + bytes - 1) >> BLOCK_SHIFT), numBlocks_ - 1);
 	size_t readSize = 0;
 	size_t offset = (size_t)(pos - (cacheStartPos << BLOCK_SHIFT));
 	u8 *p = (u8 *)data;
 
-	std::lock_guard<std::recursive_mutex> guard(blocksMutex_);
 	for (s64 i = cacheStartPos; i <= cacheEndPos; ++i) {
-		auto block = blocks_.find(i);
-		if (block == blocks_.end()) {
+		BlockInfo &block = blocks_[i];
+		// Pin before looking at the pointer, so an eviction either sees us or we see null.
+		block.readers++;
+		const u8 *ptr = block.ptr.load();
+		if (!ptr) {
+			block.readers--;
 			return readSize;
 		}
-		block->second.generation = generation_;
 
 		size_t toRead = std::min(bytes - readSize, (size_t)BLOCK_SIZE - offset);
-		memcpy(p + readSize, block->second.ptr + offset, toRead);
+		memcpy(p + readSize, ptr + offset, toRead);
+		block.readers--;
 		readSize += toRead;
+		// Avoid dirtying the cache line when it's already marked.
+		if (!block.used.load(std::memory_order_relaxed)) {
+			block.used.store(true, std::memory_order_relaxed);
+		}
 
 		// Don't need an offset after the first read.
 		offset = 0;
@@ -149,15 +174,13 @@ size_t CachingFileLoader::ReadFromCache(s64 pos, size_t bytes, void *data) {
 	return readSize;
 }
 
-void CachingFileLoader::SaveIntoCache(s64 pos, size_t bytes, Flags flags, bool readingAhead) {
+bool CachingFileLoader::SaveIntoCache(s64 pos, size_t bytes, Flags flags, bool readingAhead) {
 	s64 cacheStartPos = pos >> BLOCK_SHIFT;
-	s64 cacheEndPos = (pos + bytes - 1) >> BLOCK_SHIFT;
+	s64 cacheEndPos = std::min((s64)((pos + bytes - 1) >> BLOCK_SHIFT), numBlocks_ - 1);
 
-	std::lock_guard<std::recursive_mutex> guard(blocksMutex_);
 	size_t blocksToRead = 0;
 	for (s64 i = cacheStartPos; i <= cacheEndPos; ++i) {
-		auto block = blocks_.find(i);
-		if (block != blocks_.end()) {
+		if (blocks_[i].ptr.load() != nullptr) {
 			break;
 		}
 		++blocksToRead;
@@ -166,122 +189,95 @@ void CachingFileLoader::SaveIntoCache(s64 pos, size_t bytes, Flags flags, bool r
 		}
 	}
 
-	if (!MakeCacheSpaceFor(blocksToRead, readingAhead) || blocksToRead == 0) {
-		return;
+	if (blocksToRead == 0) {
+		return true;
 	}
 
-	if (blocksToRead == 1) {
-		blocksMutex_.unlock();
-
-		u8 *buf = new u8[BLOCK_SIZE];
-		backend_->ReadAt(cacheStartPos << BLOCK_SHIFT, BLOCK_SIZE, buf, flags);
+	u8 *wholeRead = new u8[blocksToRead << BLOCK_SHIFT];
+	size_t readSize = backend_->ReadAt(cacheStartPos << BLOCK_SHIFT, blocksToRead << BLOCK_SHIFT, wholeRead, flags);
+	if (readSize < (blocksToRead << BLOCK_SHIFT)) {
+		memset(wholeRead + readSize, 0, (blocksToRead << BLOCK_SHIFT) - readSize);
+	}
 
-		blocksMutex_.lock();
-		// While blocksMutex_ was unlocked, another thread may have read.
-		// If so, free the one we just read.
-		if (blocks_.find(cacheStartPos) == blocks_.end()) {
-			blocks_[cacheStartPos] = BlockInfo(buf);
-		} else {
-			delete [] buf;
+	bool hadRoom = true;
+	std::lock_guard<std::mutex> guard(blocksMutex_);
+	for (size_t i = 0; i < blocksToRead; ++i) {
+		BlockInfo &block = blocks_[cacheStartPos + i];
+		if (block.ptr.load() != nullptr) {
+			// Written while we were busy, just skip it.  Keep the existing block.
+			continue;
 		}
-	} else {
-		blocksMutex_.unlock();
-
-		u8 *wholeRead = new u8[blocksToRead << BLOCK_SHIFT];
-		backend_->ReadAt(cacheStartPos << BLOCK_SHIFT, blocksToRead << BLOCK_SHIFT, wholeRead, flags);
-
-		blocksMutex_.lock();
-		for (size_t i = 0; i < blocksToRead; ++i) {
-			if (blocks_.find(cacheStartPos + i) != blocks_.end()) {
-				// Written while we were busy, just skip it.  Keep the existing block.
-				continue;
-			}
-			u8 *buf = new u8[BLOCK_SIZE];
-			memcpy(buf, wholeRead + (i << BLOCK_SHIFT), BLOCK_SIZE);
-			blocks_[cacheStartPos + i] = BlockInfo(buf);
+		u8 *buf = AllocateBlock(cacheStartPos + i, readingAhead);
+		if (!buf) {
+			hadRoom = false;
+			break;
 		}
-		delete[] wholeRead;
+		memcpy(buf, wholeRead + (i << BLOCK_SHIFT), BLOCK_SIZE);
+		// Blocks read ahead haven't been used yet, so they go first.
+		block.used = !readingAhead;
+		block.ptr.store(buf);
 	}
-
-	cacheSize_ += blocksToRead;
-	++generation_;
+	delete[] wholeRead;
+	return hadRoom;
 }
 
-bool CachingFileLoader::MakeCacheSpaceFor(size_t blocks, bool readingAhead) {
-	size_t goal = MAX_BLOCKS_CACHED - blocks;
-
-	if (readingAhead && cacheSize_ > goal) {
-		return false;
+u8 *CachingFileLoader::AllocateBlock(s64 block, bool readingAhead) {
+	if (slots_.size() < MAX_BLOCKS_CACHED) {
+		slots_.push_back(CacheSlot{ block, new u8[BLOCK_SIZE] });
+		return slots_.back().ptr;
 	}
 
-	std::lock_guard<std::recursive_mutex> guard(blocksMutex_);
-	while (cacheSize_ > goal) {
-		u64 minGeneration = generation_;
+	// Give each block a second chance if it was read since the hand last passed it.
+	// Reading ahead leaves those alone instead, so it can't push out blocks that were actually
+	// read, and gives up after one trip around.
+	for (size_t checked = 0; !readingAhead || checked < slots_.size(); ++checked) {
+		CacheSlot &slot = slots_[clockHand_];
+		clockHand_ = (clockHand_ + 1) % slots_.size();
 
-		// We increment the iterator inside because we delete things inside.
-		for (auto it = blocks_.begin(); it != blocks_.end(); ) {
-			// Check for the minimum seen generation.
-			// TODO: Do this smarter?
-			if (it->second.generation != 0 && it->second.generation < minGeneration) {
-				minGeneration = it->second.generation;
-			}
-
-			// 0 means it was never used yet or was the first read (e.g. block descriptor.)
-			if (it->second.generation == oldestGeneration_ || it->second.generation == 0) {
-				s64 pos = it->first;
-				delete it->second.ptr;
-				blocks_.erase(it);
-				--cacheSize_;
-
-				// Our iterator is invalid now.  Keep going?
-				if (cacheSize_ > goal) {
-					// This finds the one at that position.
-					it = blocks_.lower_bound(pos);
-				} else {
-					break;
-				}
-			} else {
-				++it;
-			}
+		BlockInfo &victim = blocks_[slot.block];
+		if (readingAhead ? victim.used.load() || victim.readers.load() != 0 : victim.used.exchange(false)) {
+			continue;
 		}
 
-		// If we didn't find any, update to the lowest we did find.
-		oldestGeneration_ = minGeneration;
+		victim.ptr.store(nullptr);
+		// Anyone who got the pointer before we cleared it is still copying.
+		while (victim.readers.load() != 0) {
+			std::this_thread::yield();
+		}
+		slot.block = block;
+		return slot.ptr;
 	}
-
-	return true;
+	return nullptr;
 }
 
-void CachingFileLoader::StartReadAhead(s64 pos) {
-	std::lock_guard<std::recursive_mutex> guard(blocksMutex_);
+void CachingFileLoader::StartReadAhead() {
 	if (aheadThreadRunning_) {
 		// Already going.
 		return;
 	}
-	if (cacheSize_ + BLOCK_READAHEAD > MAX_BLOCKS_CACHED) {
-		// Not enough space to readahead.
+
+	// Another thread might be starting it too.
+	std::unique_lock<std::mutex> guard(aheadMutex_, std::try_to_lock);
+	if (!guard.owns_lock() || aheadThreadRunning_) {
 		return;
 	}
 
 	aheadThreadRunning_ = true;
 	if (aheadThread_.joinable())
 		aheadThread_.join();
-	aheadThread_ = std::thread([this, pos] {
+	aheadThread_ = std::thread([this] {
 		setCurrentThreadName("FileLoaderReadAhead");
 
-		std::unique_lock<std::recursive_mutex> guard(blocksMutex_);
-		s64 cacheStartPos = pos >> BLOCK_SHIFT;
-		s64 cacheEndPos = cacheStartPos + BLOCK_READAHEAD - 1;
-
-		for (s64 i = cacheStartPos; i <= cacheEndPos; ++i) {
-			auto block = blocks_.find(i);
-			if (block == blocks_.end()) {
-				guard.unlock();
-				SaveIntoCache(i << BLOCK_SHIFT, BLOCK_SIZE * BLOCK_READAHEAD, Flags::NONE, true);
-				break;
+		bool hadRoom = true;
+		do {
+			s64 first;
+			size_t count;
+			while (!aheadCancel_ && hadRoom && prefetcher_->Next(MAX_BLOCKS_PER_READ, &first, &count)) {
+				// Stop when everything cached is in use, the next read will start us again.
+				hadRoom = SaveIntoCache(first << BLOCK_SHIFT, count << BLOCK_SHIFT, Flags::NONE, true);
 			}
-		}
-
-		aheadThreadRunning_ = false;
+			aheadThreadRunning_ = false;
+			// Something might've been queued after we ran out, but before we stopped running.
+		} while (!aheadCancel_ && hadRoom && prefetcher_->HasPending() && !aheadThreadRunning_.exchange(true));
 	});
 }
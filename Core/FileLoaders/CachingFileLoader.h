@@ -17,12 +17,15 @@
 
 #pragma once
 
-#include <map>
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 #include "Common/CommonTypes.h"
 #include "Core/Loaders.h"
+#include "Core/FileLoaders/FilePrefetcher.h"
 
 class CachingFileLoader : public ProxiedFileLoader {
 public:
@@ -38,45 +41,56 @@ class CachingFileLoader : public ProxiedFileLoader {
 		return ReadAt(absolutePos, bytes * count, data, flags) / bytes;
 	}
 	size_t ReadAt(s64 absolutePos, size_t bytes, void *data, Flags flags = Flags::NONE) override;
+	void HintExtent(s64 absolutePos, s64 bytes) override;
 
 private:
 	void Prepare();
 	void InitCache();
 	void ShutdownCache();
 	size_t ReadFromCache(s64 pos, size_t bytes, void *data);
-	// Guaranteed to read at least one block into the cache.
-	void SaveIntoCache(s64 pos, size_t bytes, Flags flags, bool readingAhead = false);
-	bool MakeCacheSpaceFor(size_t blocks, bool readingAhead);
-	void StartReadAhead(s64 pos);
+	// Guaranteed to read at least one block into the cache, unless reading ahead.
+	// Returns false if reading ahead found no room.
+	bool SaveIntoCache(s64 pos, size_t bytes, Flags flags, bool readingAhead = false);
+	// Returns a buffer for the block, evicting another if the cache is full.  blocksMutex_ must be held.
+	// Reading ahead only takes blocks nobody is using or has read lately, and may return null.
+	u8 *AllocateBlock(s64 block, bool readingAhead);
+	void StartReadAhead();
 
 	enum {
 		BLOCK_SIZE = 65536,
 		BLOCK_SHIFT = 16,
 		MAX_BLOCKS_PER_READ = 16,
 		MAX_BLOCKS_CACHED = 4096, // 256 MB
-		BLOCK_READAHEAD = 4,
 	};
 
 	s64 filesize_ = 0;
 	int exists_ = -1;
 	int isDirectory_ = -1;
-	u64 generation_;
-	u64 oldestGeneration_;
-	size_t cacheSize_;
 
+	// One entry for every block in the file, so reads can find blocks without locking.
 	struct BlockInfo {
+		std::atomic<u8 *> ptr{ nullptr };
+		// Readers pin the block while copying, eviction waits for them.
+		std::atomic<int> readers{ 0 };
+		// Set on read, cleared as the clock hand passes.
+		std::atomic<bool> used{ false };
+	};
+	// A cached block and its buffer, in the order the clock hand visits them.
+	struct CacheSlot {
+		s64 block;
 		u8 *ptr;
-		u64 generation;
-
-		BlockInfo() : ptr(nullptr), generation(0) {
-		}
-		BlockInfo(u8 *p) : ptr(p), generation(0) {
-		}
 	};
 
-	std::map<s64, BlockInfo> blocks_;
-	std::recursive_mutex blocksMutex_;
-	bool aheadThreadRunning_ = false;
+	std::unique_ptr<BlockInfo[]> blocks_;
+	s64 numBlocks_ = 0;
+	std::vector<CacheSlot> slots_;
+	size_t clockHand_ = 0;
+	// Only taken to add or evict blocks.
+	std::mutex blocksMutex_;
+	std::unique_ptr<FilePrefetcher> prefetcher_;
+	std::mutex aheadMutex_;
+	std::atomic<bool> aheadThreadRunning_{ false };
+	std::atomic<bool> aheadCancel_{ false };
 	std::thread aheadThread_;
 	std::once_flag preparedFlag_;
 };
@@ -0,0 +1,341 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+#include <cstring>
+
+#include "base/timeutil.h"
+#include "Common/FileUtil.h"
+#include "Common/Log.h"
+#include "Common/Swap.h"
+#include "Core/Config.h"
+#include "Core/System.h"
+#include "Core/FileLoaders/FilePrefetcher.h"
+
+static const char *BOOT_TRACE_MAGIC = "ppssppBT";
+static const u32 BOOT_TRACE_VERSION = 1;
+// Reads after this long aren't part of booting anymore.
+static const double BOOT_TRACE_SECONDS = 30.0;
+
+struct BootTraceHeader {
+	char magic[8];
+	u32_le version;
+	u32_le count;
+	s64_le numBlocks;
+};
+
+FilePrefetcher::FilePrefetcher(const std::string &traceFilename, s64 numBlocks, std::function<bool(s64)> isCached)
+	: numBlocks_(numBlocks), isCached_(isCached), traceFilename_(traceFilename) {
+	startTime_ = real_time_now();
+	for (Range &extent : extents_) {
+		extent = Range{ -1, -1 };
+	}
+	if (!traceFilename_.empty() && numBlocks_ > 0) {
+		recording_ = true;
+		traced_.resize((size_t)numBlocks_);
+		LoadTrace();
+	}
+}
+
+FilePrefetcher::~FilePrefetcher() {
+	if (!recorded_.empty()) {
+		SaveTrace();
+	}
+}
+
+std::string FilePrefetcher::TraceFilename(const std::string &path) {
+	std::string dir = g_Config.appCacheDirectory;
+	if (dir.empty()) {
+		if (g_Config.memStickDirectory.empty()) {
+			return "";
+		}
+		dir = GetSysDirectory(DIRECTORY_CACHE);
+	}
+
+	static const char *const invalidChars = "?*:/\\^|<>\"'";
+	std::string filename = path;
+	for (size_t i = 0; i < filename.size(); ++i) {
+		if (strchr(invalidChars, filename[i]) != nullptr) {
+			filename[i] = '_';
+		}
+	}
+	return dir + "/" + filename + ".ppbt";
+}
+
+bool FilePrefetcher::NoteRead(s64 firstBlock, s64 lastBlock) {
+	// Most reads are a sector or two from the same block as the last, which changes nothing.
+	if (firstBlock == lastBlock && lastNoted_.load(std::memory_order_relaxed) == firstBlock) {
+		return false;
+	}
+	lastNoted_.store(lastBlock, std::memory_order_relaxed);
+
+	std::lock_guard<std::mutex> guard(lock_);
+	if (recording_) {
+		RecordTrace(firstBlock, lastBlock);
+	}
+
+	Stream *hit = nullptr;
+	for (Stream &stream : streams_) {
+		if (stream.last < 0) {
+			continue;
+		}
+		const s64 delta = firstBlock - stream.last;
+		if (delta == 0 || delta == 1 || (stream.stride > 1 && delta == stream.stride)) {
+			hit = &stream;
+			break;
+		}
+	}
+
+	if (!hit) {
+		// A short jump forward from a stream might be the start of a strided pattern.
+		// Wait for the next read to confirm it before prefetching anything.
+		for (Stream &stream : streams_) {
+			const s64 delta = firstBlock - stream.last;
+			if (stream.last >= 0 && delta > 1 && delta <= MAX_STRIDE) {
+				stream.stride = delta;
+				stream.window = MIN_WINDOW / 2;
+				stream.prefetchedTo = lastBlock;
+				stream.last = lastBlock;
+				stream.lastUse = ++useCounter_;
+				return SkipCached();
+			}
+		}
+	}
+
+	if (!hit) {
+		// Start a new stream, in place of the one that went unused the longest.
+		// Random reads are common, so don't prefetch until the stream continues.
+		hit = std::min_element(std::begin(streams_), std::end(streams_), [](const Stream &a, const Stream &b) {
+			return a.lastUse < b.lastUse;
+		});
+		*hit = Stream();
+		hit->stride = 1;
+		hit->window = MIN_WINDOW / 2;
+		hit->last = lastBlock;
+		hit->prefetchedTo = lastBlock;
+		hit->lastUse = ++useCounter_;
+		return SkipCached();
+	} else if (lastBlock > hit->last) {
+		// Moved on to new blocks, so the stream is still going.  Look further ahead.
+		if (firstBlock == hit->last + 1) {
+			hit->stride = 1;
+		}
+		hit->window = std::min(hit->window * 2, (u32)MAX_WINDOW);
+	}
+
+	hit->last = std::max(hit->last, lastBlock);
+	hit->lastUse = ++useCounter_;
+
+	if (hit->stride <= 1) {
+		// Don't go past the end of the file being read, if we know where that is.
+		s64 end = std::min(lastBlock + hit->window, numBlocks_ - 1);
+		const s64 extentEnd = ExtentEnd(lastBlock);
+		if (extentEnd >= 0) {
+			end = std::min(end, extentEnd);
+		}
+		const s64 start = std::max(lastBlock + 1, hit->prefetchedTo + 1);
+		if (start <= end) {
+			Queue(start, end);
+			hit->prefetchedTo = end;
+		}
+	} else {
+		// Read the same amount at each of the next few strides.
+		const u32 strides = std::min(hit->window, (u32)MAX_STRIDES_AHEAD);
+		const s64 length = lastBlock - firstBlock;
+		for (u32 i = strides; i > 0; --i) {
+			const s64 start = firstBlock + hit->stride * i;
+			if (start > hit->prefetchedTo && start < numBlocks_) {
+				Queue(start, std::min(start + length, numBlocks_ - 1));
+			}
+		}
+		hit->prefetchedTo = std::max(hit->prefetchedTo, std::min(firstBlock + hit->stride * strides, numBlocks_ - 1));
+	}
+	return SkipCached();
+}
+
+bool FilePrefetcher::NoteExtent(s64 firstBlock, s64 lastBlock) {
+	if (firstBlock < 0 || firstBlock >= numBlocks_ || lastBlock < firstBlock) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> guard(lock_);
+	lastBlock = std::min(lastBlock, numBlocks_ - 1);
+	extents_[nextExtent_] = Range{ firstBlock, lastBlock };
+	nextExtent_ = (nextExtent_ + 1) % MAX_EXTENTS;
+
+	// The start is going to be read right away, the rest is up to the stream that follows.
+	Queue(firstBlock, std::min(lastBlock, firstBlock + MIN_WINDOW - 1));
+	return SkipCached();
+}
+
+s64 FilePrefetcher::ExtentEnd(s64 block) const {
+	// Files are small compared to the block size, so the first match is good enough.
+	for (const Range &extent : extents_) {
+		if (extent.first >= 0 && block >= extent.first && block <= extent.last) {
+			return extent.last;
+		}
+	}
+	return -1;
+}
+
+void FilePrefetcher::Queue(s64 first, s64 last) {
+	// Newer requests are more likely to be needed soon.
+	pending_.push_front(Range{ first, last });
+	if (pending_.size() > MAX_PENDING) {
+		pending_.pop_back();
+	}
+}
+
+bool FilePrefetcher::SkipCached() {
+	while (!pending_.empty()) {
+		Range &range = pending_.front();
+		while (range.first <= range.last && isCached_(range.first)) {
+			++range.first;
+		}
+		if (range.first <= range.last) {
+			return true;
+		}
+		pending_.pop_front();
+	}
+	while (replayNext_ < replay_.size() && (replay_[replayNext_] >= numBlocks_ || isCached_(replay_[replayNext_]))) {
+		++replayNext_;
+	}
+	return replayNext_ < replay_.size();
+}
+
+bool FilePrefetcher::Next(size_t maxBlocks, s64 *firstBlock, size_t *count) {
+	std::lock_guard<std::mutex> guard(lock_);
+	SkipCached();
+	if (!pending_.empty()) {
+		Range &range = pending_.front();
+		*firstBlock = range.first;
+		*count = 1;
+		while (*count < maxBlocks && range.first + (s64)*count <= range.last && !isCached_(range.first + *count)) {
+			++*count;
+		}
+		range.first += *count;
+		if (range.first > range.last) {
+			pending_.pop_front();
+		}
+		return true;
+	}
+
+	// Nothing more urgent, so continue with what was read while booting last time.
+	if (replayNext_ < replay_.size()) {
+		const s64 block = replay_[replayNext_++];
+		*firstBlock = block;
+		*count = 1;
+		while (*count < maxBlocks && replayNext_ < replay_.size() && replay_[replayNext_] == block + (s64)*count && !isCached_(block + *count)) {
+			++*count;
+			++replayNext_;
+		}
+		return true;
+	}
+	return false;
+}
+
+bool FilePrefetcher::HasPending() {
+	std::lock_guard<std::mutex> guard(lock_);
+	return SkipCached();
+}
+
+void FilePrefetcher::RecordTrace(s64 firstBlock, s64 lastBlock) {
+	if (real_time_now() - startTime_ > BOOT_TRACE_SECONDS) {
+		recording_ = false;
+		return;
+	}
+
+	for (s64 block = firstBlock; block <= lastBlock && block < numBlocks_; ++block) {
+		if (traced_[(size_t)block]) {
+			continue;
+		}
+		traced_[(size_t)block] = true;
+		recorded_.push_back((u32)block);
+		if (recorded_.size() >= BOOT_TRACE_MAX_BLOCKS) {
+			recording_ = false;
+			break;
+		}
+	}
+}
+
+void FilePrefetcher::LoadTrace() {
+	FILE *f = File::OpenCFile(traceFilename_, "rb");
+	if (!f) {
+		return;
+	}
+
+	BootTraceHeader header;
+	if (fread(&header, sizeof(header), 1, f) == 1 && !memcmp(header.magic, BOOT_TRACE_MAGIC, sizeof(header.magic)) && header.version == BOOT_TRACE_VERSION) {
+		// A different size means the file changed, so the trace is no good.
+		if (header.numBlocks == numBlocks_ && header.count <= BOOT_TRACE_MAX_BLOCKS) {
+			std::vector<u32_le> blocks(header.count);
+			if (fread(blocks.data(), sizeof(u32_le), blocks.size(), f) == blocks.size()) {
+				replay_.assign(blocks.begin(), blocks.end());
+				INFO_LOG(LOADER, "Prefetching %d blocks read during the last boot", (int)replay_.size());
+			}
+		}
+	}
+	fclose(f);
+}
+
+void FilePrefetcher::SaveTrace() {
+	// Only a session that got through booting saw the whole trace.  Shorter ones, like identifying
+	// the file or opening it a second time, just add what they read to the end of the last one.
+	std::vector<u32> trace;
+	const bool booted = real_time_now() - startTime_ >= BOOT_TRACE_SECONDS || recorded_.size() >= BOOT_TRACE_MAX_BLOCKS;
+	if (booted) {
+		trace = recorded_;
+	} else {
+		std::vector<bool> inTrace((size_t)numBlocks_);
+		for (u32 block : replay_) {
+			if (block < numBlocks_ && !inTrace[block]) {
+				inTrace[block] = true;
+				trace.push_back(block);
+			}
+		}
+		const size_t previousSize = trace.size();
+		for (u32 block : recorded_) {
+			if (trace.size() >= BOOT_TRACE_MAX_BLOCKS) {
+				break;
+			}
+			if (!inTrace[block]) {
+				trace.push_back(block);
+			}
+		}
+		if (trace.size() == previousSize && previousSize == replay_.size()) {
+			// Nothing new, leave it alone.
+			return;
+		}
+	}
+
+	FILE *f = File::OpenCFile(traceFilename_, "wb");
+	if (!f) {
+		WARN_LOG(LOADER, "Unable to save boot read trace to %s", traceFilename_.c_str());
+		return;
+	}
+
+	BootTraceHeader header;
+	memcpy(header.magic, BOOT_TRACE_MAGIC, sizeof(header.magic));
+	header.version = BOOT_TRACE_VERSION;
+	header.count = (u32)trace.size();
+	header.numBlocks = numBlocks_;
+	std::vector<u32_le> blocks(trace.begin(), trace.end());
+	if (fwrite(&header, sizeof(header), 1, f) != 1 || fwrite(blocks.data(), sizeof(u32_le), blocks.size(), f) != blocks.size()) {
+		WARN_LOG(LOADER, "Unable to save boot read trace to %s", traceFilename_.c_str());
+	}
+	fclose(f);
+}
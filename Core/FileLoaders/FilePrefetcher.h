@@ -0,0 +1,102 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+
+// Decides what the caching file loaders read ahead, in units of their cache blocks.
+// Sequential and strided streams of reads get a window that grows while they keep going, files
+// get their start read as they're opened, and the blocks read while the game booted last time
+// are read again at the next launch.
+class FilePrefetcher {
+public:
+	// An empty traceFilename disables recording and replaying the boot trace.
+	FilePrefetcher(const std::string &traceFilename, s64 numBlocks, std::function<bool(s64)> isCached);
+	~FilePrefetcher();
+
+	// Where the boot trace for a file is kept, or empty if there's no cache directory.
+	static std::string TraceFilename(const std::string &path);
+
+	// Called for every read that wasn't a prefetch, cached or not.  Both return whether there's
+	// anything to prefetch now.
+	bool NoteRead(s64 firstBlock, s64 lastBlock);
+	// Something is about to read this range, like a file being opened.
+	bool NoteExtent(s64 firstBlock, s64 lastBlock);
+
+	// Takes the next range to read, skipping blocks that are already cached.
+	bool Next(size_t maxBlocks, s64 *firstBlock, size_t *count);
+	// Whether there's anything left to read that isn't cached already.
+	bool HasPending();
+
+private:
+	struct Range {
+		s64 first;
+		s64 last;
+	};
+	struct Stream {
+		s64 last = -1;
+		// 1 for sequential, otherwise the distance between reads.
+		s64 stride = 0;
+		s64 prefetchedTo = -1;
+		u32 window = 0;
+		u64 lastUse = 0;
+	};
+
+	void Queue(s64 first, s64 last);
+	bool SkipCached();
+	s64 ExtentEnd(s64 block) const;
+	void RecordTrace(s64 firstBlock, s64 lastBlock);
+	void LoadTrace();
+	void SaveTrace();
+
+	enum {
+		MAX_STREAMS = 8,
+		MAX_EXTENTS = 16,
+		MAX_PENDING = 32,
+		MIN_WINDOW = 4,
+		MAX_WINDOW = 64,
+		MAX_STRIDE = 16,
+		MAX_STRIDES_AHEAD = 8,
+		BOOT_TRACE_MAX_BLOCKS = 2048,
+	};
+
+	std::mutex lock_;
+	std::atomic<s64> lastNoted_{ -1 };
+	s64 numBlocks_;
+	std::function<bool(s64)> isCached_;
+	u64 useCounter_ = 0;
+	Stream streams_[MAX_STREAMS];
+	Range extents_[MAX_EXTENTS];
+	int nextExtent_ = 0;
+	std::deque<Range> pending_;
+
+	std::string traceFilename_;
+	double startTime_;
+	bool recording_ = false;
+	std::vector<bool> traced_;
+	std::vector<u32> recorded_;
+	std::vector<u32> replay_;
+	size_t replayNext_ = 0;
+};
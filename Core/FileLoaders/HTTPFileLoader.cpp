@@ -16,8 +16,10 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include <algorithm>
+#include <thread>
 
 #include "base/stringutil.h"
+#include "thread/threadutil.h"
 #include "Common/Common.h"
 #include "Core/FileLoaders/HTTPFileLoader.h"
 
@@ -173,8 +175,9 @@ std::string HTTPFileLoader::Path() const {
 }
 
 size_t HTTPFileLoader::ReadAt(s64 absolutePos, size_t bytes, void *data, Flags flags) {
+	// A cancel only applies to the reads that were running, the segments of this one all share it.
+	cancelConnect_ = false;
 	Prepare();
-	std::lock_guard<std::mutex> guard(readAtMutex_);
 
 	s64 absoluteEnd = std::min(absolutePos + (s64)bytes, filesize_);
 	if (absolutePos >= filesize_ || bytes == 0) {
@@ -182,8 +185,53 @@ size_t HTTPFileLoader::ReadAt(s64 absolutePos, size_t bytes, void *data, Flags f
 		return 0;
 	}
 
-	Connect();
-	if (!connected_) {
+	// With a lot of latency, one request at a time can't keep the connection busy.
+	const size_t total = (size_t)(absoluteEnd - absolutePos);
+	const size_t segments = std::min((total + SEGMENT_SIZE - 1) / SEGMENT_SIZE, (size_t)MAX_SEGMENTS);
+	const size_t segmentSize = ((total + segments - 1) / segments + 2047) & ~(size_t)2047;
+	u8 *p = (u8 *)data;
+
+	std::vector<size_t> fetched(segments);
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < segments; ++i) {
+		threads.push_back(std::thread([&, i] {
+			setCurrentThreadName("HTTPFileLoader");
+			const size_t start = std::min(i * segmentSize, total);
+			fetched[i] = FetchRange(absolutePos + start, std::min(segmentSize, total - start), p + start);
+		}));
+	}
+	fetched[0] = FetchRange(absolutePos, std::min(segmentSize, total), p);
+	for (std::thread &thread : threads) {
+		thread.join();
+	}
+
+	// Only what was read up to the first failure counts.
+	size_t readBytes = 0;
+	for (size_t i = 0; i < segments; ++i) {
+		readBytes += fetched[i];
+		if (readBytes < std::min((i + 1) * segmentSize, total)) {
+			break;
+		}
+	}
+	return readBytes;
+}
+
+size_t HTTPFileLoader::FetchRange(s64 absolutePos, size_t bytes, void *data) {
+	if (bytes == 0) {
+		return 0;
+	}
+	const s64 absoluteEnd = absolutePos + (s64)bytes;
+
+	http::Client *client = TakeClient();
+	if (!client) {
+		return 0;
+	}
+
+	// The client always asks the server to close the connection after each request.
+	// Latency is important here, so reduce the timeout.
+	if (!client->Connect(3, 10.0, &cancelConnect_)) {
+		latestError_ = "Could not connect (refused to connect)";
+		ReturnClient(client);
 		return 0;
 	}
 
@@ -192,20 +240,22 @@ size_t HTTPFileLoader::ReadAt(s64 absolutePos, size_t bytes, void *data, Flags f
 	snprintf(requestHeaders, sizeof(requestHeaders),
 		"Range: bytes=%lld-%lld\r\n", absolutePos, absoluteEnd - 1);
 
-	int err = client_.SendRequest("GET", url_.Resource().c_str(), requestHeaders, nullptr);
+	int err = client->SendRequest("GET", url_.Resource().c_str(), requestHeaders, nullptr);
 	if (err < 0) {
 		latestError_ = "Invalid response reading data";
-		Disconnect();
+		client->Disconnect();
+		ReturnClient(client);
 		return 0;
 	}
 
 	Buffer readbuf;
 	std::vector<std::string> responseHeaders;
-	int code = client_.ReadResponseHeaders(&readbuf, responseHeaders);
+	int code = client->ReadResponseHeaders(&readbuf, responseHeaders);
 	if (code != 206) {
 		ERROR_LOG(LOADER, "HTTP server did not respond with range, received code=%03d", code);
 		latestError_ = "Invalid response reading data";
-		Disconnect();
+		client->Disconnect();
+		ReturnClient(client);
 		return 0;
 	}
 
@@ -232,14 +282,14 @@ size_t HTTPFileLoader::ReadAt(s64 absolutePos, size_t bytes, void *data, Flags f
 
 	// TODO: Would be nice to read directly.
 	Buffer output;
-	int res = client_.ReadResponseEntity(&readbuf, responseHeaders, &output);
+	int res = client->ReadResponseEntity(&readbuf, responseHeaders, &output);
 	if (res != 0) {
 		ERROR_LOG(LOADER, "Unable to read HTTP response entity: %d", res);
 		// Let's take anything we got anyway.  Not worse than returning nothing?
 	}
 
-	// TODO: Keepalive instead.
-	Disconnect();
+	client->Disconnect();
+	ReturnClient(client);
 
 	if (!supportedResponse) {
 		ERROR_LOG(LOADER, "HTTP server did not respond with the range we wanted.");
@@ -247,15 +297,37 @@ size_t HTTPFileLoader::ReadAt(s64 absolutePos, size_t bytes, void *data, Flags f
 		return 0;
 	}
 
-	size_t readBytes = output.size();
+	size_t readBytes = std::min(output.size(), bytes);
 	output.Take(readBytes, (char *)data);
-	filepos_ = absolutePos + readBytes;
 	return readBytes;
 }
 
+http::Client *HTTPFileLoader::TakeClient() {
+	std::lock_guard<std::mutex> guard(clientsLock_);
+	if (!freeClients_.empty()) {
+		http::Client *client = freeClients_.back();
+		freeClients_.pop_back();
+		return client;
+	}
+
+	std::unique_ptr<http::Client> client(new http::Client());
+	if (!client->Resolve(url_.Host().c_str(), url_.Port())) {
+		ERROR_LOG(LOADER, "HTTP request failed, unable to resolve: |%s| port %d", url_.Host().c_str(), url_.Port());
+		latestError_ = "Could not connect (name not resolved)";
+		return nullptr;
+	}
+	client->SetDataTimeout(20.0);
+	clients_.push_back(std::move(client));
+	return clients_.back().get();
+}
+
+void HTTPFileLoader::ReturnClient(http::Client *client) {
+	std::lock_guard<std::mutex> guard(clientsLock_);
+	freeClients_.push_back(client);
+}
+
 void HTTPFileLoader::Connect() {
 	if (!connected_) {
-		cancelConnect_ = false;
 		// Latency is important here, so reduce the timeout.
 		connected_ = client_.Connect(3, 10.0, &cancelConnect_);
 	}
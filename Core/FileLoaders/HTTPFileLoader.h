@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include <vector>
 
@@ -50,12 +52,15 @@ class HTTPFileLoader : public FileLoader {
 	}
 
 	std::string LatestError() const override {
-		return latestError_;
+		return latestError_.load();
 	}
 
 private:
 	void Prepare();
 	int SendHEAD(const Url &url, std::vector<std::string> &responseHeaders);
+	size_t FetchRange(s64 absolutePos, size_t bytes, void *data);
+	http::Client *TakeClient();
+	void ReturnClient(http::Client *client);
 
 	void Connect();
 
@@ -66,15 +71,25 @@ class HTTPFileLoader : public FileLoader {
 		connected_ = false;
 	}
 
+	enum {
+		// Reads larger than this are split up and fetched over several connections at once.
+		SEGMENT_SIZE = 256 * 1024,
+		MAX_SEGMENTS = 4,
+	};
+
 	s64 filesize_ = 0;
-	s64 filepos_ = 0;
 	Url url_;
+	// Only for the HEAD request, reads use the ones in clients_.
 	http::Client client_;
 	std::string filename_;
 	bool connected_ = false;
-	bool cancelConnect_ = false;
-	const char *latestError_ = "";
+	// Set from other threads, and polled by every segment's connect.  Cleared by each new read.
+	std::atomic<bool> cancelConnect_{ false };
+	std::atomic<const char *> latestError_{ "" };
 
 	std::once_flag preparedFlag_;
-	std::mutex readAtMutex_;
+	// Each already resolved, so they only need to connect.
+	std::mutex clientsLock_;
+	std::vector<std::unique_ptr<http::Client>> clients_;
+	std::vector<http::Client *> freeClients_;
 };
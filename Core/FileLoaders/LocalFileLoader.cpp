@@ -16,6 +16,7 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include <cstdio>
+#include <cstring>
 
 #include "ppsspp_config.h"
 #include "util/text/utf8.h"
@@ -27,9 +28,21 @@
 #include "Common/CommonWindows.h"
 #else
 #include <fcntl.h>
+#include <sys/mman.h>
 #endif
 
-LocalFileLoader::LocalFileLoader(const std::string &filename)
+// Mapping a large ISO takes most of a 32-bit address space.  Only where we can tell what kind of disk
+// a file is on: SD cards, USB sticks and network shares can vanish, and then touching the mapping crashes.
+#if PPSSPP_ARCH(64BIT) && ((PPSSPP_PLATFORM(WINDOWS) && !PPSSPP_PLATFORM(UWP)) || (PPSSPP_PLATFORM(LINUX) && !PPSSPP_PLATFORM(ANDROID)) || PPSSPP_PLATFORM(MAC))
+#define MAP_LOCAL_FILES 1
+#if PPSSPP_PLATFORM(LINUX)
+#include <sys/vfs.h>
+#elif PPSSPP_PLATFORM(MAC)
+#include <sys/mount.h>
+#endif
+#endif
+
+LocalFileLoader::LocalFileLoader(const std::string &filename, bool mapFile)
 	: filesize_(0), filename_(filename) {
 	if (filename.empty()) {
 		ERROR_LOG(FILESYS, "LocalFileLoader can't load empty filenames");
@@ -73,14 +86,93 @@ LocalFileLoader::LocalFileLoader(const std::string &filename)
 	filesize_ = end_offset.QuadPart;
 	SetFilePointerEx(handle_, zero, nullptr, FILE_BEGIN);
 #endif // _WIN32
+
+	if (mapFile) {
+		MapFile();
+	}
+}
+
+bool LocalFileLoader::IsOnFixedDisk() {
+#if !defined(MAP_LOCAL_FILES)
+	return false;
+#elif defined(_WIN32)
+	wchar_t volume[MAX_PATH];
+	if (!GetVolumePathNameW(ConvertUTF8ToWString(filename_).c_str(), volume, MAX_PATH)) {
+		return false;
+	}
+	return GetDriveTypeW(volume) == DRIVE_FIXED;
+#elif PPSSPP_PLATFORM(LINUX)
+	struct statfs fs;
+	if (fstatfs(fd_, &fs) != 0) {
+		return false;
+	}
+	// File systems that are normally on an internal disk.  FAT, exFAT and NTFS usually mean removable media.
+	switch ((u32)fs.f_type) {
+	case 0xEF53:     // ext2/3/4
+	case 0x58465342: // XFS
+	case 0x9123683E: // Btrfs
+	case 0xF2F52010: // F2FS
+	case 0x2FC12FC1: // ZFS
+		return true;
+	default:
+		return false;
+	}
+#else
+	struct statfs fs;
+	if (fstatfs(fd_, &fs) != 0 || (fs.f_flags & MNT_LOCAL) == 0) {
+		return false;
+	}
+	return strcmp(fs.f_fstypename, "apfs") == 0 || strcmp(fs.f_fstypename, "hfs") == 0;
+#endif
+}
+
+void LocalFileLoader::MapFile() {
+#ifdef MAP_LOCAL_FILES
+	if (filesize_ == 0 || filesize_ > (u64)SIZE_MAX) {
+		return;
+	}
+	if (!IsOnFixedDisk()) {
+		INFO_LOG(FILESYS, "Not mapping %s, it's not on a fixed disk", filename_.c_str());
+		return;
+	}
+#ifndef _WIN32
+	void *map = mmap(nullptr, (size_t)filesize_, PROT_READ, MAP_SHARED, fd_, 0);
+	if (map == MAP_FAILED) {
+		WARN_LOG(FILESYS, "Unable to map %s, reading it instead", filename_.c_str());
+		return;
+	}
+	map_ = (const u8 *)map;
+#else
+	mapping_ = CreateFileMapping(handle_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping_ == nullptr) {
+		WARN_LOG(FILESYS, "Unable to map %s, reading it instead", filename_.c_str());
+		return;
+	}
+	map_ = (const u8 *)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+	if (map_ == nullptr) {
+		WARN_LOG(FILESYS, "Unable to map %s, reading it instead", filename_.c_str());
+		CloseHandle(mapping_);
+		mapping_ = nullptr;
+	}
+#endif
+#endif
 }
 
 LocalFileLoader::~LocalFileLoader() {
 #ifndef _WIN32
+	if (map_) {
+		munmap((void *)map_, (size_t)filesize_);
+	}
 	if (fd_ != -1) {
 		close(fd_);
 	}
 #else
+	if (map_) {
+		UnmapViewOfFile(map_);
+	}
+	if (mapping_) {
+		CloseHandle(mapping_);
+	}
 	if (handle_ != INVALID_HANDLE_VALUE) {
 		CloseHandle(handle_);
 	}
@@ -116,7 +208,15 @@ std::string LocalFileLoader::Path() const {
 	return filename_;
 }
 
+const u8 *LocalFileLoader::GetPointer(s64 absolutePos, size_t bytes) {
+	if (!map_ || absolutePos < 0 || (u64)absolutePos > filesize_ || bytes > filesize_ - (u64)absolutePos) {
+		return nullptr;
+	}
+	return map_ + absolutePos;
+}
+
 size_t LocalFileLoader::ReadAt(s64 absolutePos, size_t bytes, size_t count, void *data, Flags flags) {
+	// Even with the file mapped, read it normally, so that an I/O error is just a short read.
 #if PPSSPP_PLATFORM(SWITCH)
 	// Toolchain has no fancy IO API.  We must lock.
 	std::lock_guard<std::mutex> guard(readLock_);
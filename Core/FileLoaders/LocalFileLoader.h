@@ -26,7 +26,8 @@ typedef void *HANDLE;
 
 class LocalFileLoader : public FileLoader {
 public:
-	LocalFileLoader(const std::string &filename);
+	// Mapping lets GetPointer work, but only happens if the file is on a fixed disk.
+	LocalFileLoader(const std::string &filename, bool mapFile = false);
 	virtual ~LocalFileLoader();
 
 	virtual bool Exists() override;
@@ -34,13 +35,21 @@ class LocalFileLoader : public FileLoader {
 	virtual s64 FileSize() override;
 	virtual std::string Path() const override;
 	virtual size_t ReadAt(s64 absolutePos, size_t bytes, size_t count, void *data, Flags flags = Flags::NONE) override;
+	virtual const u8 *GetPointer(s64 absolutePos, size_t bytes) override;
 
 private:
+	bool IsOnFixedDisk();
+	void MapFile();
+
 #ifndef _WIN32
 	int fd_;
 #else
 	HANDLE handle_;
+	HANDLE mapping_ = nullptr;
 #endif
+	// The whole file, if it was mapped.  Sectors can be copied straight from the page cache, which
+	// other processes with the same file open share.
+	const u8 *map_ = nullptr;
 	u64 filesize_;
 	std::string filename_;
 	std::mutex readLock_;
@@ -83,11 +83,21 @@ size_t RamCachingFileLoader::ReadAt(s64 absolutePos, size_t bytes, void *data, F
 			}
 		}
 
+		if (bytes != 0) {
+			prefetcher_->NoteRead(absolutePos >> BLOCK_SHIFT, (absolutePos + bytes - 1) >> BLOCK_SHIFT);
+		}
 		StartReadAhead(absolutePos + readSize);
 	}
 	return readSize;
 }
 
+void RamCachingFileLoader::HintExtent(s64 absolutePos, s64 bytes) {
+	if (cache_ != nullptr && bytes > 0) {
+		prefetcher_->NoteExtent(absolutePos >> BLOCK_SHIFT, (absolutePos + bytes - 1) >> BLOCK_SHIFT);
+		StartReadAhead(absolutePos);
+	}
+}
+
 void RamCachingFileLoader::InitCache() {
 	std::lock_guard<std::mutex> guard(blocksMutex_);
 	u32 blockCount = (u32)((filesize_ + BLOCK_SIZE - 1) >> BLOCK_SHIFT);
@@ -98,6 +108,9 @@ void RamCachingFileLoader::InitCache() {
 	}
 	aheadRemaining_ = blockCount;
 	blocks_.resize(blockCount);
+	prefetcher_.reset(new FilePrefetcher(FilePrefetcher::TraceFilename(Path()), blockCount, [this](s64 block) {
+		return IsCached(block);
+	}));
 }
 
 void RamCachingFileLoader::ShutdownCache() {
@@ -113,6 +126,7 @@ void RamCachingFileLoader::ShutdownCache() {
 
 	std::lock_guard<std::mutex> guard(blocksMutex_);
 	blocks_.clear();
+	prefetcher_.reset();
 	if (cache_ != nullptr) {
 		free(cache_);
 		cache_ = nullptr;
@@ -228,6 +242,14 @@ void RamCachingFileLoader::StartReadAhead(s64 pos) {
 		setCurrentThreadName("FileLoaderReadAhead");
 
 		while (aheadRemaining_ != 0 && !aheadCancel_) {
+			// Whatever the prefetcher expects to be read soon goes first.
+			s64 first;
+			size_t count;
+			if (prefetcher_->Next(MAX_BLOCKS_PER_READ, &first, &count)) {
+				SaveIntoCache(first << BLOCK_SHIFT, count << BLOCK_SHIFT, Flags::NONE);
+				continue;
+			}
+
 			// Where should we look?
 			const u32 cacheStartPos = NextAheadBlock();
 			if (cacheStartPos == 0xFFFFFFFF) {
@@ -251,6 +273,11 @@ void RamCachingFileLoader::StartReadAhead(s64 pos) {
 	});
 }
 
+bool RamCachingFileLoader::IsCached(s64 block) {
+	std::lock_guard<std::mutex> guard(blocksMutex_);
+	return blocks_[(size_t)block] != 0;
+}
+
 u32 RamCachingFileLoader::NextAheadBlock() {
 	std::lock_guard<std::mutex> guard(blocksMutex_);
 
@@ -17,12 +17,14 @@
 
 #pragma once
 
+#include <memory>
 #include <vector>
 #include <mutex>
 #include <thread>
 
 #include "Common/CommonTypes.h"
 #include "Core/Loaders.h"
+#include "Core/FileLoaders/FilePrefetcher.h"
 
 class RamCachingFileLoader : public ProxiedFileLoader {
 public:
@@ -38,6 +40,7 @@ class RamCachingFileLoader : public ProxiedFileLoader {
 		return ReadAt(absolutePos, bytes * count, data, flags) / bytes;
 	}
 	size_t ReadAt(s64 absolutePos, size_t bytes, void *data, Flags flags = Flags::NONE) override;
+	void HintExtent(s64 absolutePos, s64 bytes) override;
 
 	void Cancel() override;
 
@@ -48,6 +51,7 @@ class RamCachingFileLoader : public ProxiedFileLoader {
 	// Guaranteed to read at least one block into the cache.
 	void SaveIntoCache(s64 pos, size_t bytes, Flags flags);
 	void StartReadAhead(s64 pos);
+	bool IsCached(s64 block);
 	u32 NextAheadBlock();
 
 	enum {
@@ -64,6 +68,7 @@ class RamCachingFileLoader : public ProxiedFileLoader {
 
 	std::vector<u8> blocks_;
 	std::mutex blocksMutex_;
+	std::unique_ptr<FilePrefetcher> prefetcher_;
 	u32 aheadRemaining_;
 	s64 aheadPos_;
 	std::thread aheadThread_;
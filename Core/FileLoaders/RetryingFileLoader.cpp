@@ -15,6 +15,9 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
+
+#include "base/timeutil.h"
 #include "Core/FileLoaders/RetryingFileLoader.h"
 
 // Takes ownership of backend.
@@ -54,8 +57,16 @@ s64 RetryingFileLoader::FileSize() {
 size_t RetryingFileLoader::ReadAt(s64 absolutePos, size_t bytes, void *data, Flags flags) {
 	size_t readSize = backend_->ReadAt(absolutePos, bytes, data, flags);
 
+	// Reads past the end of the file are expected to come up short, don't wait on those.
+	size_t wanted = bytes;
+	s64 filesize = backend_->FileSize();
+	if (filesize > 0) {
+		wanted = (size_t)std::max((s64)0, std::min(filesize - absolutePos, (s64)bytes));
+	}
+
 	int retries = 0;
-	while (readSize < bytes && retries < MAX_RETRIES) {
+	while (readSize < wanted && retries < MAX_RETRIES) {
+		sleep_ms(RETRY_DELAY_MS << retries);
 		u8 *p = (u8 *)data;
 		readSize += backend_->ReadAt(absolutePos + readSize, bytes - readSize, p + readSize, flags);
 		++retries;
@@ -37,5 +37,7 @@ class RetryingFileLoader : public ProxiedFileLoader {
 private:
 	enum {
 		MAX_RETRIES = 3,
+		// Doubled after each retry, so a struggling server gets some time to recover.
+		RETRY_DELAY_MS = 50,
 	};
 };
@@ -0,0 +1,639 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "ppsspp_config.h"
+#include "file/file_util.h"
+#include "file/free.h"
+#include "Common/CommonWindows.h"
+#include "Common/FileUtil.h"
+#include "Common/Log.h"
+#include "Core/Config.h"
+#include "Core/System.h"
+#include "Core/FileLoaders/SharedCachingFileLoader.h"
+#include "ext/xxhash.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifndef _WIN32
+// Linux's open file description locks belong to the open file, not the process, so two stores in one
+// process still exclude each other.  Elsewhere the process owns the locks, see sharedStore_.
+#ifdef F_OFD_SETLK
+#define LOCK_SET F_OFD_SETLK
+#define LOCK_SET_WAIT F_OFD_SETLKW
+#else
+#define LOCK_SET F_SETLK
+#define LOCK_SET_WAIT F_SETLKW
+#endif
+#endif
+
+#if PPSSPP_PLATFORM(SWITCH)
+// Far from optimal, but I guess it works...
+#define fseeko fseek
+#define ftello ftell
+#endif
+
+static const char *STORE_MAGIC = "ppssppSB";
+static const char *MANIFEST_MAGIC = "ppssppSM";
+static const u64 HASH_SEED_HI = 0x9e3779b97f4a7c15ULL;
+static const u64 RECORD_CHECK_SEED = 0x5043444348454b31ULL;
+static const s64 SAFETY_FREE_DISK_SPACE = 768 * 1024 * 1024; // 768 MB
+
+SharedBlockStore *SharedCachingFileLoader::sharedStore_ = nullptr;
+int SharedCachingFileLoader::sharedStoreRefs_ = 0;
+std::mutex SharedCachingFileLoader::sharedStoreMutex_;
+
+static bool IsKnownHash(const SharedBlockHash &hash) {
+	return hash.lo != 0 || hash.hi != 0;
+}
+
+// Locks a single byte of the file, which is all the lock file is used for.
+// Locks held by a process go away when it exits, even if it crashes.
+static bool LockByte(FILE *f, u32 offset, bool exclusive, bool wait) {
+#ifdef _WIN32
+	HANDLE h = (HANDLE)_get_osfhandle(_fileno(f));
+	OVERLAPPED overlapped = {};
+	overlapped.Offset = offset;
+	DWORD flags = (exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0) | (wait ? 0 : LOCKFILE_FAIL_IMMEDIATELY);
+	return LockFileEx(h, flags, 0, 1, 0, &overlapped) != 0;
+#else
+	struct flock lock = {};
+	lock.l_type = exclusive ? F_WRLCK : F_RDLCK;
+	lock.l_whence = SEEK_SET;
+	lock.l_start = offset;
+	lock.l_len = 1;
+	int result;
+	do {
+		result = fcntl(fileno(f), wait ? LOCK_SET_WAIT : LOCK_SET, &lock);
+	} while (result != 0 && errno == EINTR);
+	return result == 0;
+#endif
+}
+
+static void UnlockByte(FILE *f, u32 offset) {
+#ifdef _WIN32
+	HANDLE h = (HANDLE)_get_osfhandle(_fileno(f));
+	OVERLAPPED overlapped = {};
+	overlapped.Offset = offset;
+	UnlockFileEx(h, 0, 1, 0, &overlapped);
+#else
+	struct flock lock = {};
+	lock.l_type = F_UNLCK;
+	lock.l_whence = SEEK_SET;
+	lock.l_start = offset;
+	lock.l_len = 1;
+	fcntl(fileno(f), LOCK_SET, &lock);
+#endif
+}
+
+// Turns an exclusive lock on the byte into a shared one, without a moment where it's not locked.
+static void DowngradeByte(FILE *f, u32 offset) {
+#ifdef _WIN32
+	// Windows keeps both locks on the range, and the first unlock drops the exclusive one.
+	LockByte(f, offset, false, false);
+	UnlockByte(f, offset);
+#else
+	// POSIX replaces the lock type in one step.
+	LockByte(f, offset, false, false);
+#endif
+}
+
+// Takes ownership of backend.
+SharedCachingFileLoader::SharedCachingFileLoader(FileLoader *backend)
+	: ProxiedFileLoader(backend) {
+}
+
+void SharedCachingFileLoader::Prepare() {
+	std::call_once(preparedFlag_, [this]() {
+		filesize_ = ProxiedFileLoader::FileSize();
+		if (filesize_ <= 0) {
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(sharedStoreMutex_);
+			if (!sharedStore_) {
+				sharedStore_ = new SharedBlockStore(CacheDirectory());
+			}
+			++sharedStoreRefs_;
+			store_ = sharedStore_;
+		}
+		if (store_->IsValid()) {
+			OpenManifest();
+		}
+	});
+}
+
+SharedCachingFileLoader::~SharedCachingFileLoader() {
+	if (manifest_) {
+		fclose(manifest_);
+	}
+	if (store_) {
+		std::lock_guard<std::mutex> guard(sharedStoreMutex_);
+		if (--sharedStoreRefs_ == 0) {
+			delete sharedStore_;
+			sharedStore_ = nullptr;
+		}
+	}
+}
+
+bool SharedCachingFileLoader::Exists() {
+	Prepare();
+	return ProxiedFileLoader::Exists();
+}
+
+bool SharedCachingFileLoader::ExistsFast() {
+	// Same as DiskCachingFileLoader, checking might be slow.
+	return true;
+}
+
+s64 SharedCachingFileLoader::FileSize() {
+	Prepare();
+	return filesize_;
+}
+
+size_t SharedCachingFileLoader::ReadAt(s64 absolutePos, size_t bytes, void *data, Flags flags) {
+	Prepare();
+
+	if (absolutePos >= filesize_) {
+		bytes = 0;
+	} else if (absolutePos + (s64)bytes >= filesize_) {
+		bytes = filesize_ - absolutePos;
+	}
+
+	if (!manifest_ || (flags & Flags::HINT_UNCACHED) != 0) {
+		return backend_->ReadAt(absolutePos, bytes, data, flags);
+	}
+
+	u8 *p = (u8 *)data;
+	std::vector<u8> buf(blockSize_);
+	size_t readSize = 0;
+	while (readSize < bytes) {
+		const s64 pos = absolutePos + readSize;
+		const u32 block = (u32)(pos / blockSize_);
+		const size_t offset = (size_t)(pos - (s64)block * blockSize_);
+
+		if (ReadCachedBlock(block, &buf[0])) {
+			const size_t toCopy = std::min(bytes - readSize, (size_t)blockSize_ - offset);
+			memcpy(p + readSize, &buf[offset], toCopy);
+			readSize += toCopy;
+			continue;
+		}
+
+		// Fetch the blocks after it too, up to the first one that's already cached.
+		const u32 lastBlock = (u32)((absolutePos + bytes - 1) / blockSize_);
+		u32 count = 1;
+		BlockHash hash;
+		while (count < MAX_BLOCKS_PER_READ && block + count <= lastBlock && !LookupHash(block + count, &hash)) {
+			++count;
+		}
+
+		buf.resize((size_t)count * blockSize_);
+		const size_t fetched = backend_->ReadAt((s64)block * blockSize_, buf.size(), &buf[0], flags);
+		for (u32 i = 0; i < count; ++i) {
+			const size_t start = (size_t)i * blockSize_;
+			const size_t size = BlockSize(block + i);
+			if (start + size > fetched) {
+				break;
+			}
+			hash = SharedBlockStore::HashBlock(&buf[start], size);
+			store_->AddBlock(hash, &buf[start], size);
+			SaveHash(block + i, hash);
+		}
+
+		if (fetched <= offset) {
+			break;
+		}
+		const size_t toCopy = std::min(bytes - readSize, fetched - offset);
+		memcpy(p + readSize, &buf[offset], toCopy);
+		readSize += toCopy;
+		if (fetched < std::min(buf.size(), (size_t)(filesize_ - (s64)block * blockSize_))) {
+			// The backend couldn't read it all, so don't keep trying.
+			break;
+		}
+	}
+
+	return readSize;
+}
+
+std::string SharedCachingFileLoader::CacheDirectory() {
+	std::string dir = g_Config.appCacheDirectory;
+	if (dir.empty()) {
+		dir = GetSysDirectory(DIRECTORY_CACHE);
+	}
+	return dir + "/shared";
+}
+
+std::string SharedCachingFileLoader::ManifestPath() {
+	static const char *const invalidChars = "?*:/\\^|<>\"'";
+	std::string filename = ProxiedFileLoader::Path();
+	for (size_t i = 0; i < filename.size(); ++i) {
+		if (strchr(invalidChars, filename[i]) != nullptr) {
+			filename[i] = '_';
+		}
+	}
+	return CacheDirectory() + "/" + filename + ".ppsm";
+}
+
+void SharedCachingFileLoader::OpenManifest() {
+	blockSize_ = store_->BlockSize();
+	const size_t count = (size_t)((filesize_ + blockSize_ - 1) / blockSize_);
+	const std::string path = ManifestPath();
+
+	// Another process might be creating the same manifest.
+	if (!store_->LockWrites()) {
+		return;
+	}
+
+	std::vector<u64_le> data(count * 2);
+	manifest_ = File::OpenCFile(path, "rb+");
+	bool valid = manifest_ != nullptr;
+	if (valid) {
+		ManifestHeader header;
+		if (fread(&header, sizeof(header), 1, manifest_) != 1) {
+			valid = false;
+		} else if (memcmp(header.magic, MANIFEST_MAGIC, sizeof(header.magic)) != 0 || header.version != MANIFEST_VERSION) {
+			valid = false;
+		} else if (header.blockSize != blockSize_ || header.filesize != filesize_) {
+			valid = false;
+		} else if (fread(&data[0], sizeof(u64_le), data.size(), manifest_) != data.size()) {
+			valid = false;
+		}
+	}
+
+	if (!valid) {
+		if (manifest_) {
+			INFO_LOG(LOADER, "Shared disk cache manifest did not match, recreating it");
+			fclose(manifest_);
+		}
+		std::fill(data.begin(), data.end(), 0);
+
+		ManifestHeader header;
+		memcpy(header.magic, MANIFEST_MAGIC, sizeof(header.magic));
+		header.version = MANIFEST_VERSION;
+		header.blockSize = blockSize_;
+		header.filesize = filesize_;
+		manifest_ = File::OpenCFile(path, "wb+");
+		if (!manifest_ || fwrite(&header, sizeof(header), 1, manifest_) != 1 || fwrite(&data[0], sizeof(u64_le), data.size(), manifest_) != data.size() || fflush(manifest_) != 0) {
+			ERROR_LOG(LOADER, "Could not create shared disk cache manifest for %s", ProxiedFileLoader::Path().c_str());
+			if (manifest_) {
+				fclose(manifest_);
+				manifest_ = nullptr;
+			}
+		}
+	}
+	store_->UnlockWrites();
+
+	if (manifest_) {
+		hashes_.resize(count);
+		for (size_t i = 0; i < count; ++i) {
+			hashes_[i].lo = data[i * 2];
+			hashes_[i].hi = data[i * 2 + 1];
+		}
+	}
+}
+
+bool SharedCachingFileLoader::LookupHash(u32 block, BlockHash *hash) {
+	std::lock_guard<std::mutex> guard(manifestLock_);
+	if (!IsKnownHash(hashes_[block])) {
+		// Another process might have read it since.
+		u64_le data[2];
+		if (fseeko(manifest_, (s64)sizeof(ManifestHeader) + (s64)block * sizeof(data), SEEK_SET) != 0 || fread(data, sizeof(data), 1, manifest_) != 1) {
+			return false;
+		}
+		hashes_[block].lo = data[0];
+		hashes_[block].hi = data[1];
+	}
+
+	*hash = hashes_[block];
+	return IsKnownHash(*hash);
+}
+
+void SharedCachingFileLoader::SaveHash(u32 block, const BlockHash &hash) {
+	std::lock_guard<std::mutex> guard(manifestLock_);
+	hashes_[block] = hash;
+
+	// Every process writes the same hash for the same block, so there's no need to lock.
+	u64_le data[2];
+	data[0] = hash.lo;
+	data[1] = hash.hi;
+	if (fseeko(manifest_, (s64)sizeof(ManifestHeader) + (s64)block * sizeof(data), SEEK_SET) != 0 || fwrite(data, sizeof(data), 1, manifest_) != 1 || fflush(manifest_) != 0) {
+		ERROR_LOG(LOADER, "Unable to write shared disk cache manifest entry.");
+	}
+}
+
+bool SharedCachingFileLoader::ReadCachedBlock(u32 block, u8 *dest) {
+	BlockHash hash;
+	if (!LookupHash(block, &hash)) {
+		return false;
+	}
+	return store_->ReadBlock(hash, dest) == BlockSize(block);
+}
+
+size_t SharedCachingFileLoader::BlockSize(u32 block) const {
+	return (size_t)std::min((s64)blockSize_, filesize_ - (s64)block * blockSize_);
+}
+
+SharedBlockStore::SharedBlockStore(const std::string &dir) : dir_(dir) {
+	if (!File::Exists(dir_)) {
+		File::CreateFullPath(dir_);
+	}
+
+	lockFile_ = File::OpenCFile(dir_ + "/blocks.lock", "ab+");
+	if (!lockFile_) {
+		ERROR_LOG(LOADER, "Could not open shared disk cache lock file, disabling it");
+		return;
+	}
+
+	// Only a process that has the store to itself may start it over.
+	const bool alone = LockByte(lockFile_, LOCK_IN_USE, true, false);
+	if (!alone && !LockByte(lockFile_, LOCK_IN_USE, false, true)) {
+		ERROR_LOG(LOADER, "Could not lock shared disk cache, disabling it");
+		fclose(lockFile_);
+		lockFile_ = nullptr;
+		return;
+	}
+	if (!LockWrites()) {
+		return;
+	}
+
+	const std::string path = dir_ + "/blocks.ppsb";
+	if (!OpenStore(path)) {
+		// If anyone else is using it, they might still be able to read it.
+		if (alone || !File::Exists(path)) {
+			CreateStore(path);
+		} else {
+			ERROR_LOG(LOADER, "Shared disk cache in use, but could not be read");
+		}
+	}
+	if (f_) {
+		Refresh();
+		maxRecords_ = DetermineMaxRecords();
+		if (alone && scanned_ >= MAX_RECORDS) {
+			Reset(path);
+		}
+		INFO_LOG(LOADER, "Opened shared disk cache with %d blocks", (int)records_.size());
+	}
+	UnlockWrites();
+
+	if (alone) {
+		// Let the others in.  Unlocking first would let another process in alone, and it might Reset().
+		DowngradeByte(lockFile_, LOCK_IN_USE);
+	}
+}
+
+SharedBlockStore::~SharedBlockStore() {
+	if (f_) {
+		fclose(f_);
+	}
+	if (lockFile_) {
+		UnlockByte(lockFile_, LOCK_IN_USE);
+		fclose(lockFile_);
+	}
+}
+
+SharedBlockHash SharedBlockStore::HashBlock(const u8 *data, size_t size) {
+	BlockHash hash;
+	hash.lo = XXH64(data, size, 0);
+	hash.hi = XXH64(data, size, HASH_SEED_HI);
+	// Zero means not known in the manifests.
+	if (!IsKnownHash(hash)) {
+		hash.lo = 1;
+	}
+	return hash;
+}
+
+size_t SharedBlockStore::ReadBlock(const BlockHash &hash, u8 *dest) {
+	std::lock_guard<std::mutex> guard(lock_);
+	if (!f_) {
+		return 0;
+	}
+
+	auto it = records_.find(hash);
+	if (it == records_.end()) {
+		// Another process might have added it.
+		Refresh();
+		it = records_.find(hash);
+		if (it == records_.end()) {
+			return 0;
+		}
+	}
+
+	RecordHeader header;
+	bool failed = false;
+	if (fseeko(f_, RecordOffset(it->second), SEEK_SET) != 0) {
+		failed = true;
+	} else if (fread(&header, sizeof(header), 1, f_) != 1 || header.size > blockSize_) {
+		failed = true;
+	} else if (fread(dest, header.size, 1, f_) != 1) {
+		failed = true;
+	}
+	if (failed) {
+		ERROR_LOG(LOADER, "Unable to read shared disk cache block.");
+		return 0;
+	}
+
+	if (!BlockHashEqual()(HashBlock(dest, header.size), hash)) {
+		ERROR_LOG(LOADER, "Shared disk cache block %d is corrupt.", (int)it->second);
+		return 0;
+	}
+	return header.size;
+}
+
+void SharedBlockStore::AddBlock(const BlockHash &hash, const u8 *data, size_t size) {
+	if (size == 0 || size > blockSize_ || !LockWrites()) {
+		return;
+	}
+	if (!f_) {
+		UnlockWrites();
+		return;
+	}
+
+	// Refreshing also makes sure it wasn't added by someone else in the meantime.
+	const s64 fileSize = Refresh();
+	const s64 stride = (s64)sizeof(RecordHeader) + blockSize_;
+	// Nobody's writing now, so a record that was started but isn't valid never will be.
+	const u32 record = std::max(scanned_, (u32)((fileSize - (s64)sizeof(StoreHeader) + stride - 1) / stride));
+	if (records_.find(hash) == records_.end() && record < maxRecords_) {
+		RecordHeader header;
+		header.hashLo = hash.lo;
+		header.hashHi = hash.hi;
+		header.size = (u32)size;
+		header.check = (u32)XXH64(&header, sizeof(header) - sizeof(header.check), RECORD_CHECK_SEED);
+
+		// Once the file grows past it, a record cut off by a crash would look whole, so wipe it first.
+		const RecordHeader blank{};
+		bool failed = false;
+		if (record > scanned_ && (fseeko(f_, RecordOffset(record - 1), SEEK_SET) != 0 || fwrite(&blank, sizeof(blank), 1, f_) != 1)) {
+			failed = true;
+		} else if (fseeko(f_, RecordOffset(record), SEEK_SET) != 0) {
+			failed = true;
+		} else if (fwrite(&header, sizeof(header), 1, f_) != 1 || fwrite(data, size, 1, f_) != 1) {
+			failed = true;
+		} else if (fflush(f_) != 0) {
+			failed = true;
+		}
+
+		if (failed) {
+			ERROR_LOG(LOADER, "Unable to write shared disk cache block.");
+		} else {
+			records_.emplace(hash, record);
+			scanned_ = record + 1;
+		}
+	}
+	UnlockWrites();
+}
+
+bool SharedBlockStore::LockWrites() {
+	lock_.lock();
+	// Threads share lockFile_ and so its lock, the mutex keeps the other threads out.
+	if (!lockFile_) {
+		lock_.unlock();
+		return false;
+	}
+	if (!LockByte(lockFile_, LOCK_WRITES, true, true)) {
+		ERROR_LOG(LOADER, "Unable to lock shared disk cache for writing.");
+		lock_.unlock();
+		return false;
+	}
+	return true;
+}
+
+void SharedBlockStore::UnlockWrites() {
+	UnlockByte(lockFile_, LOCK_WRITES);
+	lock_.unlock();
+}
+
+bool SharedBlockStore::OpenStore(const std::string &path) {
+	f_ = File::OpenCFile(path, "rb+");
+	if (!f_) {
+		return false;
+	}
+
+	StoreHeader header;
+	bool valid = true;
+	if (fread(&header, sizeof(header), 1, f_) != 1) {
+		valid = false;
+	} else if (memcmp(header.magic, STORE_MAGIC, sizeof(header.magic)) != 0 || header.version != STORE_VERSION) {
+		valid = false;
+	} else if (header.blockSize != DEFAULT_BLOCK_SIZE) {
+		valid = false;
+	}
+
+	if (!valid) {
+		ERROR_LOG(LOADER, "Shared disk cache header did not match");
+		fclose(f_);
+		f_ = nullptr;
+	}
+	return valid;
+}
+
+bool SharedBlockStore::CreateStore(const std::string &path) {
+	f_ = File::OpenCFile(path, "wb+");
+	if (!f_) {
+		ERROR_LOG(LOADER, "Could not create shared disk cache file");
+		return false;
+	}
+
+	StoreHeader header;
+	memcpy(header.magic, STORE_MAGIC, sizeof(header.magic));
+	header.version = STORE_VERSION;
+	header.blockSize = DEFAULT_BLOCK_SIZE;
+	blockSize_ = DEFAULT_BLOCK_SIZE;
+	if (fwrite(&header, sizeof(header), 1, f_) != 1 || fflush(f_) != 0) {
+		ERROR_LOG(LOADER, "Could not create shared disk cache file");
+		fclose(f_);
+		f_ = nullptr;
+		return false;
+	}
+
+	INFO_LOG(LOADER, "Created new shared disk cache in %s", dir_.c_str());
+	return true;
+}
+
+void SharedBlockStore::Reset(const std::string &path) {
+	INFO_LOG(LOADER, "Shared disk cache is full, starting over");
+	fclose(f_);
+	f_ = nullptr;
+	records_.clear();
+	scanned_ = 0;
+
+	// The manifests would only point at blocks that are gone.
+	std::vector<FileInfo> files;
+	getFilesInDir(dir_.c_str(), &files, "ppsm:");
+	for (const FileInfo &file : files) {
+		File::Delete(file.fullName);
+	}
+
+	if (CreateStore(path)) {
+		maxRecords_ = DetermineMaxRecords();
+	}
+}
+
+s64 SharedBlockStore::Refresh() {
+	if (fseeko(f_, 0, SEEK_END) != 0) {
+		return 0;
+	}
+	const s64 fileSize = ftello(f_);
+
+	while (RecordOffset(scanned_) + (s64)sizeof(RecordHeader) <= fileSize) {
+		RecordHeader header;
+		if (fseeko(f_, RecordOffset(scanned_), SEEK_SET) != 0 || fread(&header, sizeof(header), 1, f_) != 1) {
+			break;
+		}
+
+		const u32 check = (u32)XXH64(&header, sizeof(header) - sizeof(header.check), RECORD_CHECK_SEED);
+		const s64 end = RecordOffset(scanned_) + (s64)sizeof(RecordHeader) + header.size;
+		if (header.check == check && header.size != 0 && header.size <= blockSize_ && end <= fileSize) {
+			BlockHash hash;
+			hash.lo = header.hashLo;
+			hash.hi = header.hashHi;
+			// With two of the same, either will do.
+			records_.emplace(hash, scanned_);
+		} else if (RecordOffset(scanned_ + 1) >= fileSize) {
+			// Might still be being written.  Look again next time.
+			break;
+		}
+		++scanned_;
+	}
+	return fileSize;
+}
+
+s64 SharedBlockStore::RecordOffset(u32 record) const {
+	return (s64)sizeof(StoreHeader) + (s64)record * ((s64)sizeof(RecordHeader) + blockSize_);
+}
+
+u32 SharedBlockStore::DetermineMaxRecords() {
+	uint64_t freeBytes = 0;
+	if (!free_disk_space(dir_, freeBytes)) {
+		// We can't know for sure how much is free, so we have to assume none.
+		freeBytes = 0;
+	}
+
+	// We want to leave them some room for other stuff.
+	const u64 availBytes = freeBytes > (u64)SAFETY_FREE_DISK_SPACE ? freeBytes - SAFETY_FREE_DISK_SPACE : 0;
+	const u64 freeRecords = availBytes / ((u64)sizeof(RecordHeader) + blockSize_);
+	return (u32)std::min((u64)MAX_RECORDS, scanned_ + freeRecords);
+}
@@ -0,0 +1,193 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/Swap.h"
+#include "Core/Loaders.h"
+
+class SharedBlockStore;
+
+struct SharedBlockHash {
+	u64 lo;
+	u64 hi;
+};
+
+// Like DiskCachingFileLoader, but the blocks go into one store shared by every image and every
+// PPSSPP process using the same cache directory.  Blocks are stored once per content, so
+// different dumps of the same game only take space for the blocks that differ.
+class SharedCachingFileLoader : public ProxiedFileLoader {
+public:
+	SharedCachingFileLoader(FileLoader *backend);
+	~SharedCachingFileLoader() override;
+
+	bool Exists() override;
+	bool ExistsFast() override;
+	s64 FileSize() override;
+
+	size_t ReadAt(s64 absolutePos, size_t bytes, size_t count, void *data, Flags flags = Flags::NONE) override {
+		return ReadAt(absolutePos, bytes * count, data, flags) / bytes;
+	}
+	size_t ReadAt(s64 absolutePos, size_t bytes, void *data, Flags flags = Flags::NONE) override;
+
+	// Where the store and the manifests are kept.
+	static std::string CacheDirectory();
+
+private:
+	typedef SharedBlockHash BlockHash;
+
+	void Prepare();
+	void OpenManifest();
+	std::string ManifestPath();
+	bool LookupHash(u32 block, BlockHash *hash);
+	void SaveHash(u32 block, const BlockHash &hash);
+	bool ReadCachedBlock(u32 block, u8 *dest);
+	size_t BlockSize(u32 block) const;
+
+	// File format:
+	// 64 magic
+	// 32 version
+	// 32 blockSize
+	// 64 filesize
+	// hashes[filesize / blockSize], 128 each, zero if not known yet
+
+	enum {
+		MANIFEST_VERSION = 1,
+		MAX_BLOCKS_PER_READ = 16,
+	};
+
+	struct ManifestHeader {
+		char magic[8];
+		u32_le version;
+		u32_le blockSize;
+		s64_le filesize;
+	};
+
+	std::once_flag preparedFlag_;
+	s64 filesize_ = 0;
+	u32 blockSize_ = 0;
+	SharedBlockStore *store_ = nullptr;
+
+	// Which block of the store each block of the file is, by hash.
+	std::mutex manifestLock_;
+	FILE *manifest_ = nullptr;
+	std::vector<BlockHash> hashes_;
+
+	// The store is opened once per process.  Where fcntl() locks are per process (anything but Linux),
+	// a second store in the same process would be granted the locks the first one holds, so only one
+	// can exist.  Loaders in a process share it, and its own mutexes order them.
+	static SharedBlockStore *sharedStore_;
+	static int sharedStoreRefs_;
+	static std::mutex sharedStoreMutex_;
+};
+
+// An append only file of blocks, found by the hash of their contents.  Any number of processes
+// can read and append to it at once.  Appends take a lock on a separate lock file, so that records
+// always start at a multiple of the record size, even if a process crashed halfway through one.
+class SharedBlockStore {
+public:
+	typedef SharedBlockHash BlockHash;
+
+	SharedBlockStore(const std::string &dir);
+	~SharedBlockStore();
+
+	bool IsValid() const {
+		return f_ != nullptr;
+	}
+	u32 BlockSize() const {
+		return blockSize_;
+	}
+
+	static BlockHash HashBlock(const u8 *data, size_t size);
+
+	// Returns the size of the block, or 0 if it's not in the store.  The data is checked against the hash.
+	size_t ReadBlock(const BlockHash &hash, u8 *dest);
+	void AddBlock(const BlockHash &hash, const u8 *data, size_t size);
+
+	// Held while appending blocks and creating manifests, across all processes.
+	bool LockWrites();
+	void UnlockWrites();
+
+private:
+	struct BlockHashHasher {
+		size_t operator()(const BlockHash &hash) const {
+			return (size_t)hash.lo;
+		}
+	};
+	struct BlockHashEqual {
+		bool operator()(const BlockHash &a, const BlockHash &b) const {
+			return a.lo == b.lo && a.hi == b.hi;
+		}
+	};
+
+	bool OpenStore(const std::string &path);
+	bool CreateStore(const std::string &path);
+	void Reset(const std::string &path);
+	// Looks for records added since the last time, and returns the size of the file.
+	s64 Refresh();
+	s64 RecordOffset(u32 record) const;
+	u32 DetermineMaxRecords();
+
+	// File format:
+	// 64 magic
+	// 32 version
+	// 32 blockSize
+	// records, each sizeof(RecordHeader) + blockSize apart
+	//   128 hash of the data
+	//   32 size, up to blockSize
+	//   32 check of the fields above, so half written records are skipped
+	//   data[size]
+
+	enum {
+		STORE_VERSION = 1,
+		DEFAULT_BLOCK_SIZE = 65536,
+		// Just under 2 GB, so 32-bit file offsets are enough.
+		MAX_RECORDS = 32000,
+		// Byte offsets in the lock file.
+		LOCK_WRITES = 0,
+		LOCK_IN_USE = 1,
+	};
+
+	struct StoreHeader {
+		char magic[8];
+		u32_le version;
+		u32_le blockSize;
+	};
+	struct RecordHeader {
+		u64_le hashLo;
+		u64_le hashHi;
+		u32_le size;
+		u32_le check;
+	};
+
+	std::mutex lock_;
+	std::string dir_;
+	FILE *f_ = nullptr;
+	FILE *lockFile_ = nullptr;
+	u32 blockSize_ = DEFAULT_BLOCK_SIZE;
+	u32 maxRecords_ = 0;
+	// How many record slots have been looked at.
+	u32 scanned_ = 0;
+	std::unordered_map<BlockHash, u32, BlockHashHasher, BlockHashEqual> records_;
+};
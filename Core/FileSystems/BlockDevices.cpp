@@ -18,9 +18,16 @@
 #include <cstdio>
 #include <cstring>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <snappy-c.h>
 #include "i18n/i18n.h"
+#include "thread/threadutil.h"
 #include "Common/FileUtil.h"
 #include "Common/Swap.h"
+#include "Common/ThreadPools.h"
 #include "Core/Loaders.h"
 #include "Core/Host.h"
 #include "Core/FileSystems/BlockDevices.h"
@@ -40,7 +47,7 @@ BlockDevice *constructBlockDevice(FileLoader *fileLoader) {
 		return nullptr;
 	char buffer[4]{};
 	size_t size = fileLoader->ReadAt(0, 1, 4, buffer);
-	if (size == 4 && !memcmp(buffer, "CISO", 4))
+	if (size == 4 && (!memcmp(buffer, "CISO", 4) || !memcmp(buffer, "ZCSO", 4)))
 		return new CISOFileBlockDevice(fileLoader);
 	else if (size == 4 && !memcmp(buffer, "\x00PBP", 4))
 		return new NPDRMDemoBlockDevice(fileLoader);
@@ -97,6 +104,14 @@ bool FileBlockDevice::ReadBlocks(u32 minBlock, int count, u8 *outPtr) {
 	return true;
 }
 
+void FileBlockDevice::HintBlocks(u32 minBlock, u32 count) {
+	fileLoader_->HintExtent((u64)minBlock * GetBlockSize(), (u64)count * GetBlockSize());
+}
+
+const u8 *FileBlockDevice::GetBlocksPointer(u32 minBlock, u32 count) {
+	return fileLoader_->GetPointer((u64)minBlock * GetBlockSize(), (size_t)count * GetBlockSize());
+}
+
 // .CSO format
 
 // compressed ISO(9660) header format
@@ -122,18 +137,150 @@ typedef struct ciso_header
 #endif
 } CISO_H;
 
+// ZCSO is the same idea with room to grow: a 64-bit index, a choice of codec, and an optional
+// preset dictionary for deflate.  Snappy frames decompress many times faster than deflate.
+typedef struct zcso_header
+{
+	unsigned char magic[4];         // +00 : 'Z','C','S','O'
+	u32_le header_size;             // +04 : header size (==0x30)
+	u64_le total_bytes;             // +08 : number of original data size
+	u32_le frame_size;              // +10 : number of original bytes per frame
+	unsigned char ver;              // +14 : version 01
+	unsigned char codec;            // +15 : ZCSOCodec
+	unsigned char rsv_16[2];        // +16 : reserved
+	u64_le index_offset;            // +18 : numFrames + 1 file offsets, top bit set for plain frames
+	u64_le dict_offset;             // +20 : deflate dictionary, if dict_size is not 0
+	u32_le dict_size;               // +28 : at most 32KB
+	u32_le rsv_2c;                  // +2C : reserved
+} ZCSO_H;
+
+static const u64 CSO_FRAME_PLAIN = 0x8000000000000000ULL;
+// Deflate can't look back any further than this.
+static const u32 ZCSO_MAX_DICT_SIZE = 32 * 1024;
+// Frames compressed together when writing a ZCSO.
+static const u32 ZCSO_COMPRESS_BATCH_FRAMES = 64;
+// Real CSOs align frames to a few bytes at most, anything past this is a broken header.
+static const u8 CSO_MAX_INDEX_SHIFT = 16;
+// Each frame gets decoded in one piece, and the cache keeps several.
+static const u32 CSO_MAX_FRAME_SIZE = 16 * 1024 * 1024;
+
 
 // TODO: Need much better error handling.
 
 static const u32 CSO_READ_BUFFER_SIZE = 256 * 1024;
+// Decoded frames are kept for partial and repeated reads.
+static const u32 CSO_FRAME_CACHE_SIZE = 2 * 1024 * 1024;
+// How much to decode ahead of sequential reads.
+static const u32 CSO_READAHEAD_SIZE = 512 * 1024;
+// Below this many frames, it's not worth waking the thread pool.
+static const u32 CSO_PARALLEL_MIN_FRAMES = 8;
+
+static bool InitInflate(z_stream *z) {
+	z->zalloc = Z_NULL;
+	z->zfree = Z_NULL;
+	z->opaque = Z_NULL;
+	if (inflateInit2(z, -15) != Z_OK) {
+		ERROR_LOG(LOADER, "Unable to initialize inflate: %s\n", (z->msg) ? z->msg : "?");
+		return false;
+	}
+	return true;
+}
+
+static bool InflateFrame(z_stream *z, u32 frame, const u8 *src, u32 srcSize, u8 *dest, u32 frameSize, const std::vector<u8> &dict) {
+	inflateReset(z);
+	if (!dict.empty())
+		inflateSetDictionary(z, dict.data(), (uInt)dict.size());
+	z->next_in = (Bytef *)src;
+	z->avail_in = srcSize;
+	z->next_out = dest;
+	z->avail_out = frameSize;
+
+	int status = inflate(z, Z_FINISH);
+	if (status != Z_STREAM_END) {
+		ERROR_LOG(LOADER, "Inflate frame %d: failed - %s[%d]\n", frame, (z->msg) ? z->msg : "error", status);
+		return false;
+	}
+	if (z->total_out != frameSize) {
+		ERROR_LOG(LOADER, "Inflate frame %d: block size error %d != %d\n", frame, (u32)z->total_out, frameSize);
+		return false;
+	}
+	return true;
+}
+
+// Counts a read someone is waiting on, for as long as it's running.
+struct DemandReadScope {
+	DemandReadScope(std::atomic<int> &count) : count_(count) {
+		count_++;
+	}
+	~DemandReadScope() {
+		count_--;
+	}
+	std::atomic<int> &count_;
+};
 
 CISOFileBlockDevice::CISOFileBlockDevice(FileLoader *fileLoader)
 	: fileLoader_(fileLoader)
 {
+	char magic[4]{};
+	fileLoader->ReadAt(0, 1, 4, magic);
+	const bool loaded = memcmp(magic, "ZCSO", 4) == 0 ? LoadZCSOHeader() : LoadCISOHeader();
+	if (!loaded) {
+		frameSize = 0x800;
+		totalBytes_ = 0;
+		numFrames = 0;
+		index = new u64[1]{};
+	}
+
+	// Determine the translation from block to frame.
+	blockShift = 0;
+	for (u32 i = frameSize; i > 0x800; i >>= 1)
+		++blockShift;
+	numBlocks = (u32)(totalBytes_ / GetBlockSize());
+	VERBOSE_LOG(LOADER, "CSO numBlocks=%i numFrames=%i", numBlocks, numFrames);
+
+	// We might read a bit of alignment too, so be prepared.
+	readBufferSize_ = std::max(CSO_READ_BUFFER_SIZE, frameSize + (1 << indexShift));
+	readBuffer = new u8[readBufferSize_];
+	zlibBuffer = new u8[frameSize + (1 << indexShift)];
+	zstream_ = new z_stream;
+	if (!InitInflate(zstream_)) {
+		delete zstream_;
+		zstream_ = nullptr;
+	}
+
+	frameCacheSlots_ = std::max(CSO_FRAME_CACHE_SIZE / frameSize, 4U);
+	frameCache_ = new u8[(size_t)frameCacheSlots_ * frameSize];
+	aheadFrames_ = std::max(CSO_READAHEAD_SIZE / frameSize, 1U);
+	lastFrameRead_ = numFrames;
+
+	// Double check that the CSO is not truncated.  In most cases, this will be the exact size.
+	u64 fileSize = fileLoader->FileSize();
+	u64 expectedFileSize = FramePos(numFrames);
+	if (expectedFileSize > fileSize) {
+		ERROR_LOG(LOADER, "Expected CSO to at least be %lld bytes, but file is %lld bytes", expectedFileSize, fileSize);
+		NotifyReadError();
+	}
+}
+
+static bool ValidFrameSize(u32 frameSize) {
+	if ((frameSize & (frameSize - 1)) != 0) {
+		ERROR_LOG(LOADER, "CSO block size %i unsupported, must be a power of two", frameSize);
+		return false;
+	} else if (frameSize < 0x800) {
+		ERROR_LOG(LOADER, "CSO block size %i unsupported, must be at least one sector", frameSize);
+		return false;
+	} else if (frameSize > CSO_MAX_FRAME_SIZE) {
+		ERROR_LOG(LOADER, "CSO block size %i unsupported, too large", frameSize);
+		return false;
+	}
+	return true;
+}
+
+bool CISOFileBlockDevice::LoadCISOHeader() {
 	// CISO format is fairly simple, but most tools do not write the header_size.
 
 	CISO_H hdr;
-	size_t readSize = fileLoader->ReadAt(0, sizeof(CISO_H), 1, &hdr);
+	size_t readSize = fileLoader_->ReadAt(0, sizeof(CISO_H), 1, &hdr);
 	if (readSize != 1 || memcmp(hdr.magic, "CISO", 4) != 0) {
 		WARN_LOG(LOADER, "Invalid CSO!");
 	}
@@ -142,75 +289,184 @@ CISOFileBlockDevice::CISOFileBlockDevice(FileLoader *fileLoader)
 	}
 
 	frameSize = hdr.block_size;
-	if ((frameSize & (frameSize - 1)) != 0)
-		ERROR_LOG(LOADER, "CSO block size %i unsupported, must be a power of two", frameSize);
-	else if (frameSize < 0x800)
-		ERROR_LOG(LOADER, "CSO block size %i unsupported, must be at least one sector", frameSize);
-
-	// Determine the translation from block to frame.
-	blockShift = 0;
-	for (u32 i = frameSize; i > 0x800; i >>= 1)
-		++blockShift;
+	if (!ValidFrameSize(frameSize)) {
+		NotifyReadError();
+		return false;
+	}
+	// The index gets shifted by this, and we allocate room for that much alignment after each frame.
+	if (hdr.align > CSO_MAX_INDEX_SHIFT) {
+		ERROR_LOG(LOADER, "CSO index alignment %d unsupported", hdr.align);
+		NotifyReadError();
+		return false;
+	}
 
 	indexShift = hdr.align;
-	const u64 totalSize = hdr.total_bytes;
-	numFrames = (u32)((totalSize + frameSize - 1) / frameSize);
-	numBlocks = (u32)(totalSize / GetBlockSize());
-	VERBOSE_LOG(LOADER, "CSO numBlocks=%i numFrames=%i align=%i", numBlocks, numFrames, indexShift);
-
-	// We might read a bit of alignment too, so be prepared.
-	if (frameSize + (1 << indexShift) < CSO_READ_BUFFER_SIZE)
-		readBuffer = new u8[CSO_READ_BUFFER_SIZE];
-	else
-		readBuffer = new u8[frameSize + (1 << indexShift)];
-	zlibBuffer = new u8[frameSize + (1 << indexShift)];
-	zlibBufferFrame = numFrames;
+	totalBytes_ = hdr.total_bytes;
+	numFrames = (u32)((totalBytes_ + frameSize - 1) / frameSize);
+	// CSO v2+ requires blocks be uncompressed if large enough to be.  High bit means other things.
+	plainIfFull_ = hdr.ver >= 2;
 
 	const u32 indexSize = numFrames + 1;
 	const size_t headerEnd = hdr.ver > 1 ? (size_t)hdr.header_size : sizeof(hdr);
 
-#if COMMON_LITTLE_ENDIAN
-	index = new u32[indexSize];
-	if (fileLoader->ReadAt(headerEnd, sizeof(u32), indexSize, index) != indexSize) {
-		NotifyReadError();
-		memset(index, 0, indexSize * sizeof(u32));
-	}
-#else
-	index = new u32[indexSize];
 	u32_le *indexTemp = new u32_le[indexSize];
-
-	if (fileLoader->ReadAt(headerEnd, sizeof(u32), indexSize, indexTemp) != indexSize) {
+	if (fileLoader_->ReadAt(headerEnd, sizeof(u32), indexSize, indexTemp) != indexSize) {
 		NotifyReadError();
 		memset(indexTemp, 0, indexSize * sizeof(u32_le));
 	}
 
-	for (u32 i = 0; i < indexSize; i++)
-		index[i] = indexTemp[i];
-
+	index = new u64[indexSize];
+	for (u32 i = 0; i < indexSize; i++) {
+		const u32 idx = indexTemp[i];
+		index[i] = ((u64)(idx & 0x7FFFFFFF) << indexShift) | ((idx & 0x80000000) != 0 ? CSO_FRAME_PLAIN : 0);
+	}
 	delete[] indexTemp;
-#endif
+	return true;
+}
 
-	ver_ = hdr.ver;
+bool CISOFileBlockDevice::LoadZCSOHeader() {
+	ZCSO_H hdr;
+	if (fileLoader_->ReadAt(0, sizeof(ZCSO_H), 1, &hdr) != 1 || hdr.ver != 1 || hdr.header_size < sizeof(ZCSO_H)) {
+		ERROR_LOG(LOADER, "Invalid ZCSO header");
+		NotifyReadError();
+		return false;
+	}
 
-	// Double check that the CSO is not truncated.  In most cases, this will be the exact size.
-	u64 fileSize = fileLoader->FileSize();
-	u64 lastIndexPos = index[indexSize - 1] & 0x7FFFFFFF;
-	u64 expectedFileSize = lastIndexPos << indexShift;
-	if (expectedFileSize > fileSize) {
-		ERROR_LOG(LOADER, "Expected CSO to at least be %lld bytes, but file is %lld bytes", expectedFileSize, fileSize);
+	frameSize = hdr.frame_size;
+	if (!ValidFrameSize(frameSize))
+		return false;
+	if (hdr.codec != (u8)ZCSOCodec::DEFLATE && hdr.codec != (u8)ZCSOCodec::SNAPPY) {
+		ERROR_LOG(LOADER, "ZCSO codec %d unsupported", hdr.codec);
 		NotifyReadError();
+		return false;
 	}
+	codec_ = (ZCSOCodec)hdr.codec;
+	indexShift = 0;
+	totalBytes_ = hdr.total_bytes;
+	numFrames = (u32)((totalBytes_ + frameSize - 1) / frameSize);
+
+	if (hdr.dict_size != 0) {
+		if (hdr.dict_size > ZCSO_MAX_DICT_SIZE || codec_ != ZCSOCodec::DEFLATE) {
+			ERROR_LOG(LOADER, "ZCSO dictionary invalid");
+			NotifyReadError();
+			return false;
+		}
+		dict_.resize(hdr.dict_size);
+		if (fileLoader_->ReadAt(hdr.dict_offset, 1, dict_.size(), dict_.data()) != dict_.size()) {
+			NotifyReadError();
+			return false;
+		}
+	}
+
+	const u32 indexSize = numFrames + 1;
+	u64_le *indexTemp = new u64_le[indexSize];
+	if (fileLoader_->ReadAt(hdr.index_offset, sizeof(u64), indexSize, indexTemp) != indexSize) {
+		NotifyReadError();
+		memset(indexTemp, 0, indexSize * sizeof(u64_le));
+	}
+	index = new u64[indexSize];
+	for (u32 i = 0; i < indexSize; i++)
+		index[i] = indexTemp[i];
+	delete[] indexTemp;
+	return true;
 }
 
 CISOFileBlockDevice::~CISOFileBlockDevice()
 {
+	{
+		std::lock_guard<std::mutex> guard(aheadLock_);
+		aheadExit_ = true;
+		aheadCond_.notify_one();
+	}
+	if (aheadThread_.joinable())
+		aheadThread_.join();
+
+	if (zstream_) {
+		inflateEnd(zstream_);
+		delete zstream_;
+	}
 	delete [] index;
 	delete [] readBuffer;
 	delete [] zlibBuffer;
+	delete [] frameCache_;
+	delete [] aheadBuffer_;
+}
+
+bool CISOFileBlockDevice::IsPlainFrame(u32 frame) const {
+	if (plainIfFull_) {
+		return FramePos(frame + 1) - FramePos(frame) >= frameSize;
+	}
+	return (index[frame] & CSO_FRAME_PLAIN) != 0;
+}
+
+bool CISOFileBlockDevice::DecompressFrame(z_stream *z, u32 frame, const u8 *src, u32 srcSize, u8 *dest) {
+	if (codec_ == ZCSOCodec::SNAPPY) {
+		size_t outSize = frameSize;
+		if (snappy_uncompress((const char *)src, srcSize, (char *)dest, &outSize) != SNAPPY_OK || outSize != frameSize) {
+			ERROR_LOG(LOADER, "Snappy frame %d: failed\n", frame);
+			return false;
+		}
+		return true;
+	}
+	return z && InflateFrame(z, frame, src, srcSize, dest, frameSize, dict_);
+}
+
+bool CISOFileBlockDevice::ReadCachedFrame(u32 frame, u32 offset, u32 size, u8 *outPtr) {
+	std::lock_guard<std::mutex> guard(frameCacheLock_);
+	auto it = frameCacheMap_.find(frame);
+	if (it == frameCacheMap_.end())
+		return false;
+	frameCacheLRU_.splice(frameCacheLRU_.begin(), frameCacheLRU_, it->second);
+	memcpy(outPtr, it->second->second + offset, size);
+	return true;
+}
+
+void CISOFileBlockDevice::CacheFrame(u32 frame, const u8 *data) {
+	std::lock_guard<std::mutex> guard(frameCacheLock_);
+	if (frameCacheMap_.find(frame) != frameCacheMap_.end())
+		return;
+
+	u8 *slot;
+	if (frameCacheLRU_.size() < frameCacheSlots_) {
+		slot = frameCache_ + frameCacheLRU_.size() * frameSize;
+	} else {
+		slot = frameCacheLRU_.back().second;
+		frameCacheMap_.erase(frameCacheLRU_.back().first);
+		frameCacheLRU_.pop_back();
+	}
+	memcpy(slot, data, frameSize);
+	frameCacheLRU_.emplace_front(frame, slot);
+	frameCacheMap_[frame] = frameCacheLRU_.begin();
+}
+
+bool CISOFileBlockDevice::ReadFrame(z_stream *z, u8 *scratch, u32 frame, const u8 *raw, u32 rawSize, u32 blockOffset, u32 blocks, u8 *outPtr) {
+	const u32 offset = blockOffset * GetBlockSize();
+	const u32 size = blocks * GetBlockSize();
+	if (IsPlainFrame(frame)) {
+		memcpy(outPtr, raw + offset, size);
+		return true;
+	}
+	if (ReadCachedFrame(frame, offset, size, outPtr))
+		return true;
+
+	// Whole frames are only part of a larger read, so they go straight to the output.
+	const bool whole = blocks == 1U << blockShift;
+	if (!DecompressFrame(z, frame, raw, rawSize, whole ? outPtr : scratch)) {
+		NotifyReadError();
+		memset(outPtr, 0, size);
+		return false;
+	}
+	if (!whole) {
+		memcpy(outPtr, scratch + offset, size);
+		// In case we end up reusing it in a single read later.
+		CacheFrame(frame, scratch);
+	}
+	return true;
 }
 
 bool CISOFileBlockDevice::ReadBlock(int blockNumber, u8 *outPtr, bool uncached)
 {
+	DemandReadScope demand(demandReads_);
 	FileLoader::Flags flags = uncached ? FileLoader::Flags::HINT_UNCACHED : FileLoader::Flags::NONE;
 	if ((u32)blockNumber >= numBlocks) {
 		memset(outPtr, 0, GetBlockSize());
@@ -218,73 +474,55 @@ bool CISOFileBlockDevice::ReadBlock(int blockNumber, u8 *outPtr, bool uncached)
 	}
 
 	const u32 frameNumber = blockNumber >> blockShift;
-	const u32 idx = index[frameNumber];
-	const u32 indexPos = idx & 0x7FFFFFFF;
-	const u32 nextIndexPos = index[frameNumber + 1] & 0x7FFFFFFF;
-	z_stream z;
-
-	const u64 compressedReadPos = (u64)indexPos << indexShift;
-	const u64 compressedReadEnd = (u64)nextIndexPos << indexShift;
-	const size_t compressedReadSize = (size_t)(compressedReadEnd - compressedReadPos);
+	const u64 compressedReadPos = FramePos(frameNumber);
+	const size_t compressedReadSize = (size_t)(FramePos(frameNumber + 1) - compressedReadPos);
 	const u32 compressedOffset = (blockNumber & ((1 << blockShift) - 1)) * GetBlockSize();
 
-	bool plain = (idx & 0x80000000) != 0;
-	if (ver_ >= 2) {
-		// CSO v2+ requires blocks be uncompressed if large enough to be.  High bit means other things.
-		plain = compressedReadSize >= frameSize;
-	}
-	if (plain) {
+	if (!uncached)
+		NoteFramesRead(frameNumber, frameNumber);
+
+	if (IsPlainFrame(frameNumber)) {
 		int readSize = (u32)fileLoader_->ReadAt(compressedReadPos + compressedOffset, 1, GetBlockSize(), outPtr, flags);
 		if (readSize < GetBlockSize())
 			memset(outPtr + readSize, 0, GetBlockSize() - readSize);
-	} else if (zlibBufferFrame == frameNumber) {
-		// We already have it.  Just apply the offset and copy.
-		memcpy(outPtr, zlibBuffer + compressedOffset, GetBlockSize());
+	} else if (!uncached && ReadCachedFrame(frameNumber, compressedOffset, GetBlockSize(), outPtr)) {
+		// We already have it.
 	} else {
-		const u32 readSize = (u32)fileLoader_->ReadAt(compressedReadPos, 1, compressedReadSize, readBuffer, flags);
-
-		z.zalloc = Z_NULL;
-		z.zfree = Z_NULL;
-		z.opaque = Z_NULL;
-		if (inflateInit2(&z, -15) != Z_OK) {
-			ERROR_LOG(LOADER, "GetBlockSize() ERROR: %s\n", (z.msg) ? z.msg : "?");
+		std::lock_guard<std::mutex> guard(readLock_);
+		if (compressedReadSize > readBufferSize_) {
+			ERROR_LOG(LOADER, "block %d: bad compressed frame size %d\n", blockNumber, (int)compressedReadSize);
 			NotifyReadError();
-			return false;
-		}
-		z.avail_in = readSize;
-		z.next_out = frameSize == (u32)GetBlockSize() ? outPtr : zlibBuffer;
-		z.avail_out = frameSize;
-		z.next_in = readBuffer;
-
-		int status = inflate(&z, Z_FINISH);
-		if (status != Z_STREAM_END) {
-			ERROR_LOG(LOADER, "block %d: inflate : %s[%d]\n", blockNumber, (z.msg) ? z.msg : "error", status);
-			NotifyReadError();
-			inflateEnd(&z);
 			memset(outPtr, 0, GetBlockSize());
 			return false;
 		}
-		if (z.total_out != frameSize) {
-			ERROR_LOG(LOADER, "block %d: block size error %d != %d\n", blockNumber, (u32)z.total_out, frameSize);
+		const u32 readSize = (u32)fileLoader_->ReadAt(compressedReadPos, 1, compressedReadSize, readBuffer, flags);
+		if (!DecompressFrame(zstream_, frameNumber, readBuffer, readSize, zlibBuffer)) {
 			NotifyReadError();
-			inflateEnd(&z);
 			memset(outPtr, 0, GetBlockSize());
 			return false;
 		}
-		inflateEnd(&z);
 
-		if (frameSize != (u32)GetBlockSize()) {
-			zlibBufferFrame = frameNumber;
-			memcpy(outPtr, zlibBuffer + compressedOffset, GetBlockSize());
-		}
+		memcpy(outPtr, zlibBuffer + compressedOffset, GetBlockSize());
+		if (!uncached)
+			CacheFrame(frameNumber, zlibBuffer);
 	}
 	return true;
 }
 
+void CISOFileBlockDevice::HintBlocks(u32 minBlock, u32 count) {
+	if (minBlock >= numBlocks || count == 0) {
+		return;
+	}
+	const u32 lastBlock = std::min(minBlock + count, numBlocks) - 1;
+	const u64 pos = FramePos(minBlock >> blockShift);
+	fileLoader_->HintExtent(pos, FramePos((lastBlock >> blockShift) + 1) - pos);
+}
+
 bool CISOFileBlockDevice::ReadBlocks(u32 minBlock, int count, u8 *outPtr) {
 	if (count == 1) {
 		return ReadBlock(minBlock, outPtr);
 	}
+	DemandReadScope demand(demandReads_);
 	if (minBlock >= numBlocks) {
 		memset(outPtr, 0, GetBlockSize() * count);
 		return false;
@@ -298,79 +536,285 @@ bool CISOFileBlockDevice::ReadBlocks(u32 minBlock, int count, u8 *outPtr) {
 
 	const u32 minFrameNumber = minBlock >> blockShift;
 	const u32 lastFrameNumber = lastBlock >> blockShift;
-	const u32 afterLastIndexPos = index[lastFrameNumber + 1] & 0x7FFFFFFF;
-	const u64 totalReadEnd = (u64)afterLastIndexPos << indexShift;
+	const u32 blocksPerFrame = 1 << blockShift;
+	NoteFramesRead(minFrameNumber, lastFrameNumber);
+
+	std::lock_guard<std::mutex> guard(readLock_);
+	std::atomic<bool> success(true);
+	u32 frame = minFrameNumber;
+	while (frame <= lastFrameNumber) {
+		// Read as many frames as fit in the buffer at once.
+		const u64 batchPos = FramePos(frame);
+		u32 batchEnd = frame + 1;
+		while (batchEnd <= lastFrameNumber && FramePos(batchEnd + 1) - batchPos <= readBufferSize_)
+			++batchEnd;
+		const size_t chunkSize = (size_t)(FramePos(batchEnd) - batchPos);
+		if (chunkSize > readBufferSize_) {
+			ERROR_LOG(LOADER, "Frame %d: bad compressed frame size %d\n", frame, (int)chunkSize);
+			NotifyReadError();
+			memset(outPtr, 0, (lastBlock + 1 - minBlock) * GetBlockSize());
+			return false;
+		}
+
+		const u32 readSize = (u32)fileLoader_->ReadAt(batchPos, 1, chunkSize, readBuffer);
+		if (readSize < chunkSize) {
+			memset(readBuffer + readSize, 0, chunkSize - readSize);
+		}
+
+		auto readFrames = [&](z_stream *z, u8 *scratch, u32 first, u32 end) {
+			for (u32 f = first; f < end; ++f) {
+				const u32 startBlock = std::max(f << blockShift, minBlock);
+				const u32 endBlock = std::min((f + 1) << blockShift, lastBlock + 1);
+				const u32 rawSize = (u32)(FramePos(f + 1) - FramePos(f));
+				u8 *dest = outPtr + (startBlock - minBlock) * GetBlockSize();
+				if (!ReadFrame(z, scratch, f, readBuffer + (FramePos(f) - batchPos), rawSize, startBlock & (blocksPerFrame - 1), endBlock - startBlock, dest))
+					success = false;
+			}
+		};
+
+		if (batchEnd - frame >= CSO_PARALLEL_MIN_FRAMES) {
+			GlobalThreadPool::Loop([&](int lower, int upper) {
+				z_stream z;
+				std::unique_ptr<u8[]> scratch(new u8[frameSize]);
+				const bool valid = InitInflate(&z);
+				readFrames(valid ? &z : nullptr, scratch.get(), lower, upper);
+				if (valid)
+					inflateEnd(&z);
+			}, frame, batchEnd);
+		} else {
+			readFrames(zstream_, zlibBuffer, frame, batchEnd);
+		}
+		frame = batchEnd;
+	}
+
+	return success;
+}
+
+void CISOFileBlockDevice::NoteFramesRead(u32 firstFrame, u32 lastFrame) {
+	std::lock_guard<std::mutex> guard(aheadLock_);
+	const bool sequential = firstFrame == lastFrameRead_ || firstFrame == lastFrameRead_ + 1;
+	lastFrameRead_ = lastFrame;
+	if (!sequential) {
+		// Seeked somewhere else, so whatever's still queued won't be needed.
+		aheadEnd_ = aheadNext_;
+		return;
+	}
+
+	// The frames just read don't need decoding ahead anymore.
+	aheadNext_ = std::max(aheadNext_, lastFrame + 1);
+	// Top it up once it's half used, rather than waking the thread for every frame.
+	if (aheadEnd_ >= lastFrame + 1 + aheadFrames_ / 2 || lastFrame + 1 >= numFrames)
+		return;
+	aheadEnd_ = std::min(lastFrame + 1 + aheadFrames_, numFrames);
+
+	if (!aheadThread_.joinable()) {
+		aheadBuffer_ = new u8[readBufferSize_];
+		aheadThread_ = std::thread(std::bind(&CISOFileBlockDevice::ReadAheadFunc, this));
+	}
+	aheadCond_.notify_one();
+}
+
+void CISOFileBlockDevice::ReadAheadFunc() {
+	setCurrentThreadName("CSOReadAhead");
+
+	std::unique_lock<std::mutex> guard(aheadLock_);
+	while (!aheadExit_) {
+		if (aheadNext_ >= aheadEnd_) {
+			aheadCond_.wait(guard);
+			continue;
+		}
+
+		const u32 first = aheadNext_;
+		const u64 batchPos = FramePos(first);
+		u32 end = first + 1;
+		while (end < aheadEnd_ && FramePos(end + 1) - batchPos <= readBufferSize_)
+			++end;
+		aheadNext_ = end;
+
+		guard.unlock();
+		const u32 stopped = ReadAheadFrames(first, end);
+		guard.lock();
+		if (stopped < end) {
+			// A read came in.  If the frames left are still just ahead of it, pick them up again once
+			// it's had a moment, otherwise the read moved on and they can go.
+			if (aheadNext_ == end && lastFrameRead_ < stopped && stopped <= lastFrameRead_ + aheadFrames_) {
+				aheadNext_ = stopped;
+				aheadEnd_ = std::max(aheadEnd_, end);
+			}
+			aheadCond_.wait_for(guard, std::chrono::milliseconds(1));
+		}
+	}
+}
+
+u32 CISOFileBlockDevice::ReadAheadFrames(u32 firstFrame, u32 endFrame) {
+	// Whatever the game is waiting for comes first, so this stops whenever a read is running.
+	if (demandReads_ > 0)
+		return firstFrame;
+	const u64 batchPos = FramePos(firstFrame);
+	const size_t chunkSize = (size_t)(FramePos(endFrame) - batchPos);
+	if (chunkSize > readBufferSize_)
+		return endFrame;
+	const size_t readSize = fileLoader_->ReadAt(batchPos, 1, chunkSize, aheadBuffer_);
+	if (readSize < chunkSize) {
+		// Let the actual read report the error.
+		return endFrame;
+	}
 
 	z_stream z;
-	z.zalloc = Z_NULL;
-	z.zfree = Z_NULL;
-	z.opaque = Z_NULL;
-	if (inflateInit2(&z, -15) != Z_OK) {
-		ERROR_LOG(LOADER, "Unable to initialize inflate: %s\n", (z.msg) ? z.msg : "?");
+	if (!InitInflate(&z))
+		return endFrame;
+	std::unique_ptr<u8[]> scratch(new u8[frameSize]);
+	u32 f = firstFrame;
+	for (; f < endFrame && demandReads_ == 0; ++f) {
+		if (IsPlainFrame(f))
+			continue;
+		{
+			std::lock_guard<std::mutex> guard(frameCacheLock_);
+			if (frameCacheMap_.find(f) != frameCacheMap_.end())
+				continue;
+		}
+		const u32 rawSize = (u32)(FramePos(f + 1) - FramePos(f));
+		if (DecompressFrame(&z, f, aheadBuffer_ + (FramePos(f) - batchPos), rawSize, scratch.get()))
+			CacheFrame(f, scratch.get());
+	}
+	inflateEnd(&z);
+	return f;
+}
+
+// Picks sectors spread evenly over the image, so that whatever the game repeats most (headers,
+// padding, common file structures) is likely to show up in it.  Blank sectors compress fine anyway.
+static std::vector<u8> SampleDictionary(BlockDevice *src) {
+	const u32 blockSize = src->GetBlockSize();
+	const u32 numBlocks = src->GetNumBlocks();
+	const u32 samples = ZCSO_MAX_DICT_SIZE / blockSize;
+
+	std::vector<u8> dict;
+	std::vector<u8> block(blockSize);
+	for (u32 i = 0; i < samples * 4 && dict.size() < ZCSO_MAX_DICT_SIZE && numBlocks != 0; ++i) {
+		const u32 blockNumber = (u32)((u64)numBlocks * i / (samples * 4));
+		if (!src->ReadBlock(blockNumber, block.data(), true))
+			continue;
+		if (std::all_of(block.begin(), block.end(), [](u8 c) { return c == 0; }))
+			continue;
+		dict.insert(dict.end(), block.begin(), block.end());
+	}
+	return dict;
+}
+
+bool CompressBlockDevice(BlockDevice *src, const std::string &filename, ZCSOCodec codec, u32 frameSize, bool useDictionary, std::string *error) {
+	if (!ValidFrameSize(frameSize)) {
+		*error = "Invalid frame size";
+		return false;
+	}
+	if (useDictionary && codec != ZCSOCodec::DEFLATE) {
+		*error = "Dictionaries are only supported with deflate";
 		return false;
 	}
 
-	u64 readBufferStart = 0;
-	u64 readBufferEnd = 0;
-	u32 block = minBlock;
-	const u32 blocksPerFrame = 1 << blockShift;
-	for (u32 frame = minFrameNumber; frame <= lastFrameNumber; ++frame) {
-		const u32 idx = index[frame];
-		const u32 indexPos = idx & 0x7FFFFFFF;
-		const u32 nextIndexPos = index[frame + 1] & 0x7FFFFFFF;
-
-		const u64 frameReadPos = (u64)indexPos << indexShift;
-		const u64 frameReadEnd = (u64)nextIndexPos << indexShift;
-		const u32 frameReadSize = (u32)(frameReadEnd - frameReadPos);
-		const u32 frameBlockOffset = block & ((1 << blockShift) - 1);
-		const u32 frameBlocks = std::min(lastBlock - block + 1, blocksPerFrame - frameBlockOffset);
-
-		if (frameReadEnd > readBufferEnd) {
-			const s64 maxNeeded = totalReadEnd - frameReadPos;
-			const size_t chunkSize = (size_t)std::min(maxNeeded, (s64)std::max(frameReadSize, CSO_READ_BUFFER_SIZE));
-
-			const u32 readSize = (u32)fileLoader_->ReadAt(frameReadPos, 1, chunkSize, readBuffer);
-			if (readSize < chunkSize) {
-				memset(readBuffer + readSize, 0, chunkSize - readSize);
-			}
+	const u32 blockSize = src->GetBlockSize();
+	const u32 blocksPerFrame = frameSize / blockSize;
+	const u32 numBlocks = src->GetNumBlocks();
+	const u64 totalBytes = (u64)numBlocks * blockSize;
+	const u32 numFrames = (u32)((totalBytes + frameSize - 1) / frameSize);
 
-			readBufferStart = frameReadPos;
-			readBufferEnd = frameReadPos + readSize;
+	std::vector<u8> dict;
+	if (useDictionary)
+		dict = SampleDictionary(src);
+
+	FILE *f = File::OpenCFile(filename, "wb");
+	if (!f) {
+		*error = "Could not open " + filename + " for writing";
+		return false;
+	}
+
+	ZCSO_H hdr{};
+	memcpy(hdr.magic, "ZCSO", 4);
+	hdr.header_size = sizeof(ZCSO_H);
+	hdr.total_bytes = totalBytes;
+	hdr.frame_size = frameSize;
+	hdr.ver = 1;
+	hdr.codec = (u8)codec;
+	hdr.dict_offset = dict.empty() ? 0 : sizeof(ZCSO_H);
+	hdr.dict_size = (u32)dict.size();
+
+	// The header gets written again once we know where the index is.
+	bool success = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+	if (!dict.empty())
+		success = success && fwrite(dict.data(), dict.size(), 1, f) == 1;
+
+	std::vector<u64_le> index;
+	index.reserve(numFrames + 1);
+	u64 pos = sizeof(ZCSO_H) + dict.size();
+
+	const size_t maxCompressed = std::max(snappy_max_compressed_length(frameSize), (size_t)compressBound(frameSize));
+	std::vector<u8> input((size_t)ZCSO_COMPRESS_BATCH_FRAMES * frameSize);
+	std::vector<u8> output((size_t)ZCSO_COMPRESS_BATCH_FRAMES * maxCompressed);
+	std::vector<size_t> outputSizes(ZCSO_COMPRESS_BATCH_FRAMES);
+
+	for (u32 frame = 0; frame < numFrames && success; frame += ZCSO_COMPRESS_BATCH_FRAMES) {
+		const u32 batchFrames = std::min(ZCSO_COMPRESS_BATCH_FRAMES, numFrames - frame);
+		const u32 firstBlock = frame * blocksPerFrame;
+		const u32 batchBlocks = std::min(batchFrames * blocksPerFrame, numBlocks - firstBlock);
+		// The last frame gets padded out with zeros.
+		memset(input.data(), 0, (size_t)batchFrames * frameSize);
+		if (!src->ReadBlocks(firstBlock, batchBlocks, input.data())) {
+			*error = "Failed to read blocks from the source image";
+			fclose(f);
+			return false;
 		}
 
-		u8 *rawBuffer = &readBuffer[frameReadPos - readBufferStart];
-		const int plain = idx & 0x80000000;
-		if (plain) {
-			memcpy(outPtr, rawBuffer + frameBlockOffset * GetBlockSize(), frameBlocks * GetBlockSize());
-		} else {
-			z.avail_in = frameReadSize;
-			z.next_out = frameBlocks == blocksPerFrame ? outPtr : zlibBuffer;
-			z.avail_out = frameSize;
-			z.next_in = rawBuffer;
-
-			int status = inflate(&z, Z_FINISH);
-			if (status != Z_STREAM_END) {
-				ERROR_LOG(LOADER, "Inflate frame %d: failed - %s[%d]\n", frame, (z.msg) ? z.msg : "error", status);
-				NotifyReadError();
-				memset(outPtr, 0, frameBlocks * GetBlockSize());
-			} else if (z.total_out != frameSize) {
-				ERROR_LOG(LOADER, "Inflate frame %d: block size error %d != %d\n", frame, (u32)z.total_out, frameSize);
-				NotifyReadError();
-				memset(outPtr, 0, frameBlocks * GetBlockSize());
-			} else if (frameBlocks != blocksPerFrame) {
-				memcpy(outPtr, zlibBuffer + frameBlockOffset * GetBlockSize(), frameBlocks * GetBlockSize());
-				// In case we end up reusing it in a single read later.
-				zlibBufferFrame = frame;
+		GlobalThreadPool::Loop([&](int lower, int upper) {
+			z_stream z{};
+			if (codec == ZCSOCodec::DEFLATE && deflateInit2(&z, 9, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+				// Store the frames plain.
+				for (int i = lower; i < upper; ++i)
+					outputSizes[i] = frameSize;
+				return;
 			}
 
-			inflateReset(&z);
-		}
+			for (int i = lower; i < upper; ++i) {
+				const u8 *in = &input[(size_t)i * frameSize];
+				u8 *out = &output[(size_t)i * maxCompressed];
+				size_t outSize = maxCompressed;
+				if (codec == ZCSOCodec::SNAPPY) {
+					if (snappy_compress((const char *)in, frameSize, (char *)out, &outSize) != SNAPPY_OK)
+						outSize = frameSize;
+				} else {
+					deflateReset(&z);
+					if (!dict.empty())
+						deflateSetDictionary(&z, dict.data(), (uInt)dict.size());
+					z.next_in = (Bytef *)in;
+					z.avail_in = frameSize;
+					z.next_out = out;
+					z.avail_out = (uInt)maxCompressed;
+					outSize = deflate(&z, Z_FINISH) == Z_STREAM_END ? (size_t)z.total_out : frameSize;
+				}
+				// Frames that don't shrink are stored as is.
+				outputSizes[i] = outSize;
+			}
 
-		block += frameBlocks;
-		outPtr += frameBlocks * GetBlockSize();
+			if (codec == ZCSOCodec::DEFLATE)
+				deflateEnd(&z);
+		}, 0, batchFrames);
+
+		for (u32 i = 0; i < batchFrames && success; ++i) {
+			const bool plain = outputSizes[i] >= frameSize;
+			const u8 *data = plain ? &input[(size_t)i * frameSize] : &output[(size_t)i * maxCompressed];
+			const size_t size = plain ? frameSize : outputSizes[i];
+			index.push_back(pos | (plain ? CSO_FRAME_PLAIN : 0));
+			success = fwrite(data, size, 1, f) == 1;
+			pos += size;
+		}
 	}
+	index.push_back(pos);
 
-	inflateEnd(&z);
+	hdr.index_offset = pos;
+	success = success && fwrite(index.data(), sizeof(u64_le), index.size(), f) == index.size();
+	success = success && fseek(f, 0, SEEK_SET) == 0 && fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+	if (fclose(f) != 0 || !success) {
+		*error = "Failed to write " + filename;
+		return false;
+	}
 	return true;
 }
 
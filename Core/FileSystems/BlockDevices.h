@@ -18,17 +18,26 @@
 #pragma once
 
 // Abstractions around read-only blockdevices, such as PSP UMD discs.
-// CISOFileBlockDevice implements compressed iso images, CISO format.
+// CISOFileBlockDevice implements compressed iso images, CISO and ZCSO formats.
 //
 // The ISOFileSystemReader reads from a BlockDevice, so it automatically works
 // with CISO images.
 
+#include <atomic>
+#include <condition_variable>
+#include <list>
 #include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "Common/CommonTypes.h"
 #include "Core/ELF/PBPReader.h"
 
 class FileLoader;
+struct z_stream_s;
 
 class BlockDevice {
 public:
@@ -45,6 +54,10 @@ class BlockDevice {
 	}
 	int GetBlockSize() const { return 2048;}  // forced, it cannot be changed by subclasses
 	virtual u32 GetNumBlocks() = 0;
+	// These blocks will probably be read soon, so the file loader can start on them.
+	virtual void HintBlocks(u32 minBlock, u32 count) {}
+	// Points straight at these blocks if they can be read in place, otherwise returns nullptr.
+	virtual const u8 *GetBlocksPointer(u32 minBlock, u32 count) { return nullptr; }
 
 	u32 CalculateCRC();
 	void NotifyReadError();
@@ -53,6 +66,13 @@ class BlockDevice {
 	bool reportedError_ = false;
 };
 
+// Per-frame codec in a ZCSO header.  Only codecs in ext/ are used: snappy is the fast one (LZ4's
+// speed class), deflate packs tighter.  Others like LZ4 or zstd can get new IDs later.
+enum class ZCSOCodec : u8 {
+	DEFLATE = 1,
+	SNAPPY = 2,
+};
+
 class CISOFileBlockDevice : public BlockDevice {
 public:
 	CISOFileBlockDevice(FileLoader *fileLoader);
@@ -60,19 +80,64 @@ class CISOFileBlockDevice : public BlockDevice {
 	bool ReadBlock(int blockNumber, u8 *outPtr, bool uncached = false) override;
 	bool ReadBlocks(u32 minBlock, int count, u8 *outPtr) override;
 	u32 GetNumBlocks() override { return numBlocks; }
+	void HintBlocks(u32 minBlock, u32 count) override;
 
 private:
+	bool LoadCISOHeader();
+	bool LoadZCSOHeader();
+	u64 FramePos(u32 frame) const {
+		return index[frame] & 0x7FFFFFFFFFFFFFFFULL;
+	}
+	bool IsPlainFrame(u32 frame) const;
+	bool DecompressFrame(z_stream_s *z, u32 frame, const u8 *src, u32 srcSize, u8 *dest);
+	// Decodes the part of a frame that was asked for, from the cache if it's there.
+	bool ReadFrame(z_stream_s *z, u8 *scratch, u32 frame, const u8 *raw, u32 rawSize, u32 blockOffset, u32 blocks, u8 *outPtr);
+	bool ReadCachedFrame(u32 frame, u32 offset, u32 size, u8 *outPtr);
+	void CacheFrame(u32 frame, const u8 *data);
+
+	// Once reads are sequential, frames after them get decoded ahead on their own thread, which
+	// skips ahead whenever a read is waiting.
+	void NoteFramesRead(u32 firstFrame, u32 lastFrame);
+	void ReadAheadFunc();
+	// Returns the frame it stopped at, if a read came in before the end.
+	u32 ReadAheadFrames(u32 firstFrame, u32 endFrame);
+
 	FileLoader *fileLoader_;
-	u32 *index;
+	// File offsets of each frame, the top bit marks plain frames.
+	u64 *index;
+	// Reads on several threads share these buffers and the stream, so they take readLock_.
+	std::mutex readLock_;
 	u8 *readBuffer;
+	u32 readBufferSize_;
 	u8 *zlibBuffer;
-	u32 zlibBufferFrame;
-	u8 indexShift;
+	z_stream_s *zstream_;
+	u8 indexShift = 0;
 	u8 blockShift;
 	u32 frameSize;
 	u32 numBlocks;
 	u32 numFrames;
-	int ver_;
+	u64 totalBytes_;
+	ZCSOCodec codec_ = ZCSOCodec::DEFLATE;
+	std::vector<u8> dict_;
+	bool plainIfFull_ = false;
+
+	// Decoded frames, most recently used first.
+	std::mutex frameCacheLock_;
+	std::list<std::pair<u32, u8 *>> frameCacheLRU_;
+	std::unordered_map<u32, std::list<std::pair<u32, u8 *>>::iterator> frameCacheMap_;
+	u8 *frameCache_;
+	u32 frameCacheSlots_;
+
+	std::mutex aheadLock_;
+	std::condition_variable aheadCond_;
+	std::thread aheadThread_;
+	u8 *aheadBuffer_ = nullptr;
+	u32 aheadFrames_;
+	u32 aheadNext_ = 0;
+	u32 aheadEnd_ = 0;
+	u32 lastFrameRead_;
+	bool aheadExit_ = false;
+	std::atomic<int> demandReads_{ 0 };
 };
 
 
@@ -83,6 +148,8 @@ class FileBlockDevice : public BlockDevice {
 	bool ReadBlock(int blockNumber, u8 *outPtr, bool uncached = false) override;
 	bool ReadBlocks(u32 minBlock, int count, u8 *outPtr) override;
 	u32 GetNumBlocks() override {return (u32)(filesize_ / GetBlockSize());}
+	void HintBlocks(u32 minBlock, u32 count) override;
+	const u8 *GetBlocksPointer(u32 minBlock, u32 count) override;
 
 private:
 	FileLoader *fileLoader_;
@@ -129,3 +196,5 @@ class NPDRMDemoBlockDevice : public BlockDevice {
 
 
 BlockDevice *constructBlockDevice(FileLoader *fileLoader);
+// Writes the contents of any block device out as a ZCSO image.  The dictionary only applies to deflate.
+bool CompressBlockDevice(BlockDevice *src, const std::string &filename, ZCSOCodec codec, u32 frameSize, bool useDictionary, std::string *error);
@@ -52,6 +52,8 @@ enum DevType {
 
 enum FileSystemFlags {
 	FILESYSTEM_SIMULATE_FAT32 = 1,
+	// ReadFile and WriteFile on different handles can run at the same time as each other and as other calls.
+	FILESYSTEM_CONCURRENT_IO = 2,
 };
 
 class IHandleAllocator {
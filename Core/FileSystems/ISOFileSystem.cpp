@@ -30,6 +30,22 @@
 
 const int sectorSize = 2048;
 
+// Entry names are identifiers, which are at most 255 bytes, so they always fit in a new block.
+static const size_t NAME_BLOCK_SIZE = 16384;
+static const size_t ENTRY_BLOCK_SIZE = 1024;
+
+// Path hashes are FNV-1a over "/" and each component in turn, so "A/B" hashes the same whether
+// it's done all at once or a component at a time.
+static const u64 PATH_HASH_ROOT = 0xcbf29ce484222325ULL;
+
+static u64 HashPathComponent(u64 hash, const char *name, size_t length) {
+	hash = (hash ^ '/') * 0x100000001b3ULL;
+	for (size_t i = 0; i < length; ++i) {
+		hash = (hash ^ (u8)name[i]) * 0x100000001b3ULL;
+	}
+	return hash;
+}
+
 bool parseLBN(std::string filename, u32 *sectorStart, u32 *readSize) {
 	// The format of this is: "/sce_lbn" "0x"? HEX* ANY* "_size" "0x"? HEX* ANY*
 	// That means that "/sce_lbn/_size1/" is perfectly valid.
@@ -178,13 +194,9 @@ ISOFileSystem::ISOFileSystem(IHandleAllocator *_hAlloc, BlockDevice *_blockDevic
 	entireISO.flags = 0;
 	entireISO.parent = NULL;
 
-	treeroot = new TreeEntry();
+	treeroot = AllocateEntries(1);
 	treeroot->isDirectory = true;
-	treeroot->startingPosition = 0;
-	treeroot->size = 0;
-	treeroot->flags = 0;
-	treeroot->parent = NULL;
-	treeroot->valid = false;
+	treeroot->pathHash = PATH_HASH_ROOT;
 
 	if (memcmp(desc.cd001, "CD001", 5)) {
 		ERROR_LOG(FILESYS, "ISO looks bogus, expected CD001 signature not present? Giving up...");
@@ -197,15 +209,28 @@ ISOFileSystem::ISOFileSystem(IHandleAllocator *_hAlloc, BlockDevice *_blockDevic
 
 ISOFileSystem::~ISOFileSystem() {
 	delete blockDevice;
-	delete treeroot;
 }
 
 void ISOFileSystem::ReadDirectory(TreeEntry *root) {
+	std::vector<TreeEntry> children;
+	// Whatever was read stays, even if the rest of the directory can't be.
+	auto addChildren = [&] {
+		root->children = AllocateEntries(children.size());
+		root->numChildren = (u32)children.size();
+		std::copy(children.begin(), children.end(), root->children);
+		for (u32 i = 0; i < root->numChildren; ++i) {
+			// If there's already an entry with this hash, it's a duplicate name or a collision.
+			// Either way, the first one stays, like when searching the children in order.
+			pathIndex_.emplace(root->children[i].pathHash, &root->children[i]);
+		}
+	};
+
 	for (u32 secnum = root->startsector, endsector = root->startsector + (root->dirsize + 2047) / 2048; secnum < endsector; ++secnum) {
 		u8 theSector[2048];
 		if (!blockDevice->ReadBlock(secnum, theSector)) {
 			blockDevice->NotifyReadError();
-			ERROR_LOG(FILESYS, "Error reading block for directory %s - skipping", root->name.c_str());
+			ERROR_LOG(FILESYS, "Error reading block for directory %s - skipping", root->name);
+			addChildren();
 			root->valid = true;  // Prevents re-reading
 			return;
 		}
@@ -223,6 +248,7 @@ void ISOFileSystem::ReadDirectory(TreeEntry *root) {
 			if (offset + IDENTIFIER_OFFSET + dir.identifierLength > 2048) {
 				blockDevice->NotifyReadError();
 				ERROR_LOG(FILESYS, "Directory entry crosses sectors, corrupt iso?");
+				addChildren();
 				return;
 			}
 
@@ -231,17 +257,22 @@ void ISOFileSystem::ReadDirectory(TreeEntry *root) {
 			bool isFile = (dir.flags & 2) ? false : true;
 			bool relative;
 
-			TreeEntry *entry = new TreeEntry();
+			children.push_back(TreeEntry());
+			TreeEntry *entry = &children.back();
 			if (dir.identifierLength == 1 && (dir.firstIdChar == '\x00' || dir.firstIdChar == '.')) {
 				entry->name = ".";
+				entry->nameLength = 1;
 				relative = true;
 			} else if (dir.identifierLength == 1 && dir.firstIdChar == '\x01') {
 				entry->name = "..";
+				entry->nameLength = 2;
 				relative = true;
 			} else {
-				entry->name = std::string((const char *)&dir.firstIdChar, dir.identifierLength);
+				entry->name = InternName((const char *)&dir.firstIdChar, dir.identifierLength);
+				entry->nameLength = dir.identifierLength;
 				relative = false;
 			}
+			entry->pathHash = HashPathComponent(root->pathHash, entry->name, entry->nameLength);
 
 			entry->size = dir.dataLength();
 			entry->startingPosition = dir.firstDataSector() * 2048;
@@ -252,7 +283,7 @@ void ISOFileSystem::ReadDirectory(TreeEntry *root) {
 			entry->dirsize = dir.dataLength();
 			entry->valid = isFile;  // Can pre-mark as valid if file, as we don't recurse into those.
 			// Let's not excessively spam the log - I commented this line out.
-			//DEBUG_LOG(FILESYS, "%s: %s %08x %08x %i", entry->isDirectory?"D":"F", entry->name.c_str(), dir.firstDataSectorLE, entry->startingPosition, entry->startingPosition);
+			//DEBUG_LOG(FILESYS, "%s: %s %08x %08x %i", entry->isDirectory?"D":"F", entry->name, dir.firstDataSectorLE, entry->startingPosition, entry->startingPosition);
 
 			if (entry->isDirectory && !relative) {
 				if (entry->startsector == root->startsector) {
@@ -260,12 +291,76 @@ void ISOFileSystem::ReadDirectory(TreeEntry *root) {
 					ERROR_LOG(FILESYS, "WARNING: Appear to have a recursive file system, breaking recursion. Probably corrupt ISO.");
 				}
 			}
-			root->children.push_back(entry);
 		}
 	}
+	addChildren();
 	root->valid = true;
 }
 
+ISOFileSystem::TreeEntry *ISOFileSystem::AllocateEntries(size_t count) {
+	if (entryBlocks_.empty() || entriesUsed_ + count > entryBlockSize_) {
+		entryBlockSize_ = std::max(ENTRY_BLOCK_SIZE, count);
+		entryBlocks_.push_back(std::unique_ptr<TreeEntry[]>(new TreeEntry[entryBlockSize_]));
+		entriesUsed_ = 0;
+	}
+
+	TreeEntry *entries = entryBlocks_.back().get() + entriesUsed_;
+	entriesUsed_ += count;
+	return entries;
+}
+
+const char *ISOFileSystem::InternName(const char *name, size_t length) {
+	if (names_.empty() || namesUsed_ + length + 1 > NAME_BLOCK_SIZE) {
+		names_.push_back(std::unique_ptr<char[]>(new char[NAME_BLOCK_SIZE]));
+		namesUsed_ = 0;
+	}
+
+	char *interned = names_.back().get() + namesUsed_;
+	memcpy(interned, name, length);
+	interned[length] = '\0';
+	namesUsed_ += length + 1;
+	return interned;
+}
+
+ISOFileSystem::TreeEntry *ISOFileSystem::FindChild(TreeEntry *dir, u64 pathHash, const char *name, size_t length) {
+	auto it = pathIndex_.find(pathHash);
+	if (it == pathIndex_.end()) {
+		// Every child of a directory that was read is in the index.
+		return nullptr;
+	}
+	TreeEntry *e = it->second;
+	if (e->parent == dir && e->nameLength == length && !memcmp(e->name, name, length)) {
+		return e;
+	}
+
+	// Some other path has the same hash, so search the slow way.
+	for (u32 i = 0; i < dir->numChildren; ++i) {
+		TreeEntry *child = &dir->children[i];
+		if (child->nameLength == length && !memcmp(child->name, name, length)) {
+			return child;
+		}
+	}
+	return nullptr;
+}
+
+bool ISOFileSystem::EntryMatchesPath(TreeEntry *e, const char *path, size_t length) {
+	// Compare the components from the end, up through the parents.
+	size_t end = length;
+	for (TreeEntry *cur = e; cur != treeroot; cur = cur->parent) {
+		if (!cur || cur->nameLength > end || memcmp(path + end - cur->nameLength, cur->name, cur->nameLength) != 0) {
+			return false;
+		}
+		end -= cur->nameLength;
+		if (cur->parent != treeroot) {
+			if (end == 0 || path[end - 1] != '/') {
+				return false;
+			}
+			--end;
+		}
+	}
+	return end == 0;
+}
+
 ISOFileSystem::TreeEntry *ISOFileSystem::GetFromPath(const std::string &path, bool catchError) {
 	const size_t pathLength = path.length();
 
@@ -287,35 +382,39 @@ ISOFileSystem::TreeEntry *ISOFileSystem::GetFromPath(const std::string &path, bo
 	if (pathLength <= pathIndex)
 		return treeroot;
 
+	// Paths that were opened before can be found all at once, without going through each directory.
+	const char *relativePath = path.c_str() + pathIndex;
+	size_t relativeLength = pathLength - pathIndex;
+	if (path[pathLength - 1] == '/')
+		--relativeLength;
+	auto indexed = pathIndex_.find(HashPathComponent(PATH_HASH_ROOT, relativePath, relativeLength));
+	if (indexed != pathIndex_.end() && EntryMatchesPath(indexed->second, relativePath, relativeLength)) {
+		TreeEntry *entry = indexed->second;
+		if (!entry->valid)
+			ReadDirectory(entry);
+		return entry;
+	}
+
 	TreeEntry *entry = treeroot;
+	u64 pathHash = PATH_HASH_ROOT;
 	while (true) {
 		if (!entry->valid) {
 			ReadDirectory(entry);
 		}
-		TreeEntry *nextEntry = nullptr;
-		std::string name = "";
-		if (pathLength > pathIndex) {
-			size_t nextSlashIndex = path.find_first_of('/', pathIndex);
-			if (nextSlashIndex == std::string::npos)
-				nextSlashIndex = pathLength;
-
-			const std::string firstPathComponent = path.substr(pathIndex, nextSlashIndex - pathIndex);
-			for (size_t i = 0; i < entry->children.size(); i++) {
-				const std::string &n = entry->children[i]->name;
-				if (firstPathComponent == n) {
-					//yay we got it
-					nextEntry = entry->children[i];
-					name = n;
-					break;
-				}
-			}
-		}
-		
+		size_t nextSlashIndex = path.find_first_of('/', pathIndex);
+		if (nextSlashIndex == std::string::npos)
+			nextSlashIndex = pathLength;
+
+		const char *component = path.c_str() + pathIndex;
+		const size_t componentLength = nextSlashIndex - pathIndex;
+		pathHash = HashPathComponent(pathHash, component, componentLength);
+		TreeEntry *nextEntry = FindChild(entry, pathHash, component, componentLength);
+
 		if (nextEntry) {
 			entry = nextEntry;
 			if (!entry->valid)
 				ReadDirectory(entry);
-			pathIndex += name.length();
+			pathIndex = nextSlashIndex;
 			if (pathIndex < pathLength && path[pathIndex] == '/')
 				++pathIndex;
 
@@ -364,7 +463,10 @@ int ISOFileSystem::OpenFile(std::string filename, FileAccess access, const char
 		// the param in sceIoLseek and sceIoRead is lba mode. we must mark it.
 		if (strncmp(devicename, "umd0:", 5)==0 || strncmp(devicename, "umd1:", 5)==0)
 			entry.isBlockSectorMode = true;
+		else
+			blockDevice->HintBlocks(sectorStart, (u32)(((u64)readSize + 2047) / 2048));
 
+		std::lock_guard<std::mutex> guard(entriesLock_);
 		entries[newHandle] = entry;
 		return newHandle;
 	}
@@ -377,15 +479,19 @@ int ISOFileSystem::OpenFile(std::string filename, FileAccess access, const char
 
 	if (entry.file == &entireISO)
 		entry.isBlockSectorMode = true;
+	else if (!entry.file->isDirectory)
+		blockDevice->HintBlocks(entry.file->startsector, (u32)((entry.file->size + 2047) / 2048));
 
 	entry.seekPos = 0;
 
 	u32 newHandle = hAlloc->GetNewHandle();
+	std::lock_guard<std::mutex> guard(entriesLock_);
 	entries[newHandle] = entry;
 	return newHandle;
 }
 
 void ISOFileSystem::CloseFile(u32 handle) {
+	std::lock_guard<std::mutex> guard(entriesLock_);
 	EntryMap::iterator iter = entries.find(handle);
 	if (iter != entries.end()) {
 		//CloseHandle((*iter).second.hFile);
@@ -474,18 +580,29 @@ size_t ISOFileSystem::ReadFile(u32 handle, u8 *pointer, s64 size)
 }
 
 size_t ISOFileSystem::ReadFile(u32 handle, u8 *pointer, s64 size, int &usec) {
-	EntryMap::iterator iter = entries.find(handle);
-	if (iter != entries.end()) {
+	EntryMap::iterator iter;
+	bool found;
+	{
+		std::lock_guard<std::mutex> guard(entriesLock_);
+		iter = entries.find(handle);
+		found = iter != entries.end();
+	}
+	if (found) {
 		OpenFileEntry &e = iter->second;
 
 		if (size < 0) {
-			ERROR_LOG_REPORT(FILESYS, "Invalid read for %lld bytes from umd %s", size, e.file ? e.file->name.c_str() : "device");
+			ERROR_LOG_REPORT(FILESYS, "Invalid read for %lld bytes from umd %s", size, e.file ? e.file->name : "device");
 			return 0;
 		}
 		
 		if (e.isBlockSectorMode) {
 			// Whole sectors! Shortcut to this simple code.
-			blockDevice->ReadBlocks(e.seekPos, (int)size, pointer);
+			const u8 *mapped = blockDevice->GetBlocksPointer(e.seekPos, (u32)size);
+			if (mapped) {
+				memcpy(pointer, mapped, (size_t)size * 2048);
+			} else {
+				blockDevice->ReadBlocks(e.seekPos, (int)size, pointer);
+			}
 			if (abs((int)lastReadBlock_ - (int)e.seekPos) > 100) {
 				// This is an estimate, sometimes it takes 1+ seconds, but it definitely takes time.
 				usec = 100000;
@@ -530,21 +647,30 @@ size_t ISOFileSystem::ReadFile(u32 handle, u8 *pointer, s64 size, int &usec) {
 		_dbg_assert_msg_(FILESYS, (middleSize & 2047) == 0, "Remaining size should be aligned");
 
 		const u8 *const start = pointer;
-		if (firstBlockSize > 0) {
-			blockDevice->ReadBlock(secNum++, theSector);
-			memcpy(pointer, theSector + firstBlockOffset, firstBlockSize);
-			pointer += firstBlockSize;
-		}
-		if (middleSize > 0) {
-			const u32 sectors = (u32)(middleSize / 2048);
-			blockDevice->ReadBlocks(secNum, sectors, pointer);
-			secNum += sectors;
-			pointer += middleSize;
-		}
-		if (lastBlockSize > 0) {
-			blockDevice->ReadBlock(secNum++, theSector);
-			memcpy(pointer, theSector, lastBlockSize);
-			pointer += lastBlockSize;
+		const u32 totalSectors = (u32)((firstBlockOffset + size + 2047) / 2048);
+		const u8 *mapped = size > 0 ? blockDevice->GetBlocksPointer(secNum, totalSectors) : nullptr;
+		if (mapped) {
+			// The ISO is mapped, so this can go straight from the page cache, partial sectors and all.
+			memcpy(pointer, mapped + firstBlockOffset, (size_t)size);
+			pointer += size;
+			secNum += totalSectors;
+		} else {
+			if (firstBlockSize > 0) {
+				blockDevice->ReadBlock(secNum++, theSector);
+				memcpy(pointer, theSector + firstBlockOffset, firstBlockSize);
+				pointer += firstBlockSize;
+			}
+			if (middleSize > 0) {
+				const u32 sectors = (u32)(middleSize / 2048);
+				blockDevice->ReadBlocks(secNum, sectors, pointer);
+				secNum += sectors;
+				pointer += middleSize;
+			}
+			if (lastBlockSize > 0) {
+				blockDevice->ReadBlock(secNum++, theSector);
+				memcpy(pointer, theSector, lastBlockSize);
+				pointer += lastBlockSize;
+			}
 		}
 
 		size_t totalBytes = pointer - start;
@@ -640,8 +766,8 @@ std::vector<PSPFileInfo> ISOFileSystem::GetDirListing(std::string path) {
 	const std::string dot(".");
 	const std::string dotdot("..");
 
-	for (size_t i = 0; i < entry->children.size(); i++) {
-		TreeEntry *e = entry->children[i];
+	for (u32 i = 0; i < entry->numChildren; i++) {
+		TreeEntry *e = &entry->children[i];
 
 		// do not include the relative entries in the list
 		if (e->name == dot || e->name == dotdot)
@@ -672,7 +798,7 @@ std::string ISOFileSystem::EntryFullPath(TreeEntry *e) {
 	TreeEntry *cur = e;
 	while (cur != NULL && cur != treeroot) {
 		// For the "/".
-		fullLen += 1 + cur->name.size();
+		fullLen += 1 + cur->nameLength;
 		cur = cur->parent;
 	}
 
@@ -681,21 +807,15 @@ std::string ISOFileSystem::EntryFullPath(TreeEntry *e) {
 
 	cur = e;
 	while (cur != NULL && cur != treeroot) {
-		path.replace(fullLen - cur->name.size(), cur->name.size(), cur->name);
-		path.replace(fullLen - cur->name.size() - 1, 1, "/");
-		fullLen -= 1 + cur->name.size();
+		path.replace(fullLen - cur->nameLength, cur->nameLength, cur->name, cur->nameLength);
+		path.replace(fullLen - cur->nameLength - 1, 1, "/");
+		fullLen -= 1 + cur->nameLength;
 		cur = cur->parent;
 	}
 
 	return path;
 }
 
-ISOFileSystem::TreeEntry::~TreeEntry() {
-	for (size_t i = 0; i < children.size(); ++i)
-		delete children[i];
-	children.clear();
-}
-
 void ISOFileSystem::DoState(PointerWrap &p) {
 	auto s = p.Section("ISOFileSystem", 1, 2);
 	if (!s)
@@ -748,9 +868,11 @@ void ISOFileSystem::DoState(PointerWrap &p) {
 		}
 	}
 
+	u32 lastReadBlock = lastReadBlock_;
 	if (s >= 2) {
-		p.Do(lastReadBlock_);
+		p.Do(lastReadBlock);
 	} else {
-		lastReadBlock_ = 0;
+		lastReadBlock = 0;
 	}
+	lastReadBlock_ = lastReadBlock;
 }
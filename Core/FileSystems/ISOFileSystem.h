@@ -17,8 +17,12 @@
 
 #pragma once
 
+#include <atomic>
 #include <map>
 #include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
 #include "FileSystem.h"
 
@@ -42,7 +46,7 @@ class ISOFileSystem : public IFileSystem {
 	bool     OwnsHandle(u32 handle) override;
 	int      Ioctl(u32 handle, u32 cmd, u32 indataPtr, u32 inlen, u32 outdataPtr, u32 outlen, int &usec) override;
 	int      DevType(u32 handle) override;
-	int      Flags() override { return 0; }
+	int      Flags() override { return FILESYSTEM_CONCURRENT_IO; }
 	u64      FreeSpace(const std::string &path) override { return 0; }
 
 	size_t WriteFile(u32 handle, const u8 *pointer, s64 size) override;
@@ -55,23 +59,27 @@ class ISOFileSystem : public IFileSystem {
 	bool RemoveFile(const std::string &filename) override { return false; }
 
 private:
+	// Directories are only read when something looks inside them, so booting a game with
+	// thousands of files only reads the few directories on the way to its files.
 	struct TreeEntry {
-		TreeEntry() : flags(0), valid(false) {}
-		~TreeEntry();
-
-		std::string name;
-		u32 flags;
-		u32 startingPosition;
-		s64 size;
-		bool isDirectory;
-
-		u32 startsector;
-		u32 dirsize;
-
-		TreeEntry *parent;
-
-		bool valid;
-		std::vector<TreeEntry *> children;
+		// Points into names_, or at a literal.  Always null terminated.
+		const char *name = "";
+		TreeEntry *parent = nullptr;
+		// Next to each other in entryBlocks_, once the directory is valid.
+		TreeEntry *children = nullptr;
+		// Of the full path, see HashPathComponent.
+		u64 pathHash = 0;
+		s64 size = 0;
+		u32 nameLength = 0;
+		u32 numChildren = 0;
+		u32 flags = 0;
+		u32 startingPosition = 0;
+
+		u32 startsector = 0;
+		u32 dirsize = 0;
+
+		bool isDirectory = false;
+		bool valid = false;
 	};
 
 	struct OpenFileEntry {
@@ -85,14 +93,31 @@ class ISOFileSystem : public IFileSystem {
 
 	typedef std::map<u32,OpenFileEntry> EntryMap;
 	EntryMap entries;
+	// Reads run on the IO workers, so adding and removing entries has to lock out their lookups.
+	std::mutex entriesLock_;
 	IHandleAllocator *hAlloc;
 	TreeEntry *treeroot;
 	BlockDevice *blockDevice;
-	u32 lastReadBlock_;
+	std::atomic<u32> lastReadBlock_{ 0 };
 
 	TreeEntry entireISO;
 
+	// Every entry read so far, by the hash of its full path.  A hash can only point to one entry,
+	// so on a collision, lookups fall back to searching the directory.
+	std::unordered_map<u64, TreeEntry *> pathIndex_;
+	// Entry names are packed into these instead of each having its own allocation.
+	std::vector<std::unique_ptr<char[]>> names_;
+	size_t namesUsed_ = 0;
+	// Same for the entries.  They're never freed until the ISO is, so pointers to them stay valid.
+	std::vector<std::unique_ptr<TreeEntry[]>> entryBlocks_;
+	size_t entriesUsed_ = 0;
+	size_t entryBlockSize_ = 0;
+
 	void ReadDirectory(TreeEntry *root);
+	TreeEntry *AllocateEntries(size_t count);
+	const char *InternName(const char *name, size_t length);
+	TreeEntry *FindChild(TreeEntry *dir, u64 pathHash, const char *name, size_t length);
+	bool EntryMatchesPath(TreeEntry *e, const char *path, size_t length);
 	TreeEntry *GetFromPath(const std::string &path, bool catchError = true);
 	std::string EntryFullPath(TreeEntry *e);
 };
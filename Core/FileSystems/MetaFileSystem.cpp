@@ -17,6 +17,7 @@
 
 #include <algorithm>
 #include <set>
+#include <thread>
 
 #include "Common/ChunkFile.h"
 #include "Common/StringUtils.h"
@@ -164,18 +165,46 @@ static bool RealPath(const std::string &currentDirectory, const std::string &inP
 	return true;
 }
 
+static std::string LowerCase(const std::string &str) {
+	std::string lower = str;
+	std::transform(lower.begin(), lower.end(), lower.begin(), [](char c) { return (char)tolower((u8)c); });
+	return lower;
+}
+
 IFileSystem *MetaFileSystem::GetHandleOwner(u32 handle)
 {
 	std::lock_guard<std::recursive_mutex> guard(lock);
+	auto known = handleOwners_.find(handle);
+	if (known != handleOwners_.end())
+		return known->second;
+
 	for (size_t i = 0; i < fileSystems.size(); i++)
 	{
-		if (fileSystems[i].system->OwnsHandle(handle))
+		if (fileSystems[i].system->OwnsHandle(handle)) {
+			handleOwners_[handle] = fileSystems[i].system;
 			return fileSystems[i].system; //got it!
+		}
 	}
 	//none found?
 	return 0;
 }
 
+void MetaFileSystem::RebuildMountIndex() {
+	mountIndex_.clear();
+	for (size_t i = 0; i < fileSystems.size(); i++) {
+		// The first one wins, like when searching in order.
+		mountIndex_.emplace(LowerCase(fileSystems[i].prefix), i);
+	}
+	handleOwners_.clear();
+}
+
+MetaFileSystem::MountPoint *MetaFileSystem::FindMount(const std::string &normalizedPrefix) {
+	auto it = mountIndex_.find(LowerCase(normalizedPrefix));
+	if (it == mountIndex_.end())
+		return nullptr;
+	return &fileSystems[it->second];
+}
+
 int MetaFileSystem::MapFilePath(const std::string &_inpath, std::string &outpath, MountPoint **system)
 {
 	int error = -1;
@@ -228,23 +257,17 @@ int MetaFileSystem::MapFilePath(const std::string &_inpath, std::string &outpath
 
 	if (RealPath(*currentDirectory, inpath, realpath))
 	{
-		std::string prefix = realpath;
+		// Prefixes always end with the colon, so they have to match all of it.
 		size_t prefixPos = realpath.find(':');
-		if (prefixPos != realpath.npos)
-			prefix = NormalizePrefix(realpath.substr(0, prefixPos + 1));
-
-		for (size_t i = 0; i < fileSystems.size(); i++)
+		MountPoint *mount = prefixPos != realpath.npos ? FindMount(NormalizePrefix(realpath.substr(0, prefixPos + 1))) : nullptr;
+		if (mount)
 		{
-			size_t prefLen = fileSystems[i].prefix.size();
-			if (strncasecmp(fileSystems[i].prefix.c_str(), prefix.c_str(), prefLen) == 0)
-			{
-				outpath = realpath.substr(prefixPos + 1);
-				*system = &(fileSystems[i]);
+			outpath = realpath.substr(prefixPos + 1);
+			*system = mount;
 
-				VERBOSE_LOG(FILESYS, "MapFilePath: mapped \"%s\" to prefix: \"%s\", path: \"%s\"", inpath.c_str(), fileSystems[i].prefix.c_str(), outpath.c_str());
+			VERBOSE_LOG(FILESYS, "MapFilePath: mapped \"%s\" to prefix: \"%s\", path: \"%s\"", inpath.c_str(), mount->prefix.c_str(), outpath.c_str());
 
-				return error == SCE_KERNEL_ERROR_NOCWD ? error : 0;
-			}
+			return error == SCE_KERNEL_ERROR_NOCWD ? error : 0;
 		}
 	}
 
@@ -276,18 +299,22 @@ void MetaFileSystem::Mount(std::string prefix, IFileSystem *system) {
 	x.prefix = prefix;
 	x.system = system;
 	fileSystems.push_back(x);
+	RebuildMountIndex();
 }
 
 void MetaFileSystem::Unmount(std::string prefix, IFileSystem *system) {
 	std::lock_guard<std::recursive_mutex> guard(lock);
+	WaitForUnlockedIO();
 	MountPoint x;
 	x.prefix = prefix;
 	x.system = system;
 	fileSystems.erase(std::remove(fileSystems.begin(), fileSystems.end(), x), fileSystems.end());
+	RebuildMountIndex();
 }
 
 void MetaFileSystem::Remount(std::string prefix, IFileSystem *newSystem) {
 	std::lock_guard<std::recursive_mutex> guard(lock);
+	WaitForUnlockedIO();
 	IFileSystem *oldSystem = nullptr;
 	for (auto &it : fileSystems) {
 		if (it.prefix == prefix) {
@@ -305,6 +332,7 @@ void MetaFileSystem::Remount(std::string prefix, IFileSystem *newSystem) {
 
 	if (delOldSystem)
 		delete oldSystem;
+	handleOwners_.clear();
 }
 
 IFileSystem *MetaFileSystem::GetSystemFromFilename(const std::string &filename) {
@@ -315,16 +343,24 @@ IFileSystem *MetaFileSystem::GetSystemFromFilename(const std::string &filename)
 }
 
 IFileSystem *MetaFileSystem::GetSystem(const std::string &prefix) {
-	for (auto it = fileSystems.begin(); it != fileSystems.end(); ++it) {
-		if (it->prefix == NormalizePrefix(prefix))
-			return it->system;
-	}
+	const std::string normalized = NormalizePrefix(prefix);
+	MountPoint *mount = FindMount(normalized);
+	if (mount && mount->prefix == normalized)
+		return mount->system;
 	return NULL;
 }
 
+void MetaFileSystem::WaitForUnlockedIO() {
+	// New ones need the lock to start, so this can't take long.
+	while (unlockedIO_ != 0) {
+		std::this_thread::yield();
+	}
+}
+
 void MetaFileSystem::Shutdown()
 {
 	std::lock_guard<std::recursive_mutex> guard(lock);
+	WaitForUnlockedIO();
 	current = 6;
 
 	// Ownership is a bit convoluted. Let's just delete everything once.
@@ -340,6 +376,7 @@ void MetaFileSystem::Shutdown()
 	}
 
 	fileSystems.clear();
+	RebuildMountIndex();
 	currentDir.clear();
 	startingDirectory = "";
 }
@@ -551,6 +588,7 @@ void MetaFileSystem::CloseFile(u32 handle)
 	IFileSystem *sys = GetHandleOwner(handle);
 	if (sys)
 		sys->CloseFile(handle);
+	handleOwners_.erase(handle);
 }
 
 size_t MetaFileSystem::ReadFile(u32 handle, u8 *pointer, s64 size)
@@ -575,22 +613,39 @@ size_t MetaFileSystem::WriteFile(u32 handle, const u8 *pointer, s64 size)
 
 size_t MetaFileSystem::ReadFile(u32 handle, u8 *pointer, s64 size, int &usec)
 {
-	std::lock_guard<std::recursive_mutex> guard(lock);
-	IFileSystem *sys = GetHandleOwner(handle);
-	if (sys)
-		return sys->ReadFile(handle, pointer, size, usec);
-	else
-		return 0;
+	IFileSystem *sys;
+	{
+		std::lock_guard<std::recursive_mutex> guard(lock);
+		sys = GetHandleOwner(handle);
+		if (!sys)
+			return 0;
+		if (!(sys->Flags() & FILESYSTEM_CONCURRENT_IO))
+			return sys->ReadFile(handle, pointer, size, usec);
+		unlockedIO_++;
+	}
+
+	// This is how the async IO workers read, so let them overlap when the file system can.
+	size_t result = sys->ReadFile(handle, pointer, size, usec);
+	unlockedIO_--;
+	return result;
 }
 
 size_t MetaFileSystem::WriteFile(u32 handle, const u8 *pointer, s64 size, int &usec)
 {
-	std::lock_guard<std::recursive_mutex> guard(lock);
-	IFileSystem *sys = GetHandleOwner(handle);
-	if (sys)
-		return sys->WriteFile(handle, pointer, size, usec);
-	else
-		return 0;
+	IFileSystem *sys;
+	{
+		std::lock_guard<std::recursive_mutex> guard(lock);
+		sys = GetHandleOwner(handle);
+		if (!sys)
+			return 0;
+		if (!(sys->Flags() & FILESYSTEM_CONCURRENT_IO))
+			return sys->WriteFile(handle, pointer, size, usec);
+		unlockedIO_++;
+	}
+
+	size_t result = sys->WriteFile(handle, pointer, size, usec);
+	unlockedIO_--;
+	return result;
 }
 
 size_t MetaFileSystem::SeekFile(u32 handle, s32 position, FileMove type)
@@ -663,5 +718,6 @@ void MetaFileSystem::DoState(PointerWrap &p)
 			fileSystems[i].system->DoState(p);
 		}
 	}
+	handleOwners_.clear();
 }
 
@@ -17,7 +17,9 @@
 
 #pragma once
 
+#include <atomic>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <mutex>
 
@@ -36,12 +38,23 @@ class MetaFileSystem : public IHandleAllocator, public IFileSystem {
 	};
 
 	std::vector<MountPoint> fileSystems;
+	// Lowercase prefix to the first mount in fileSystems with it.
+	std::unordered_map<std::string, size_t> mountIndex_;
+	// Which file system open handles belong to, filled in as they're used.
+	std::unordered_map<u32, IFileSystem *> handleOwners_;
+
+	void RebuildMountIndex();
+	MountPoint *FindMount(const std::string &normalizedPrefix);
 
 	typedef std::map<int, std::string> currentDir_t;
 	currentDir_t currentDir;
 
 	std::string startingDirectory;
 	std::recursive_mutex lock;  // must be recursive
+	// Reads and writes running without the lock, which have to finish before a file system goes away.
+	std::atomic<int> unlockedIO_{ 0 };
+
+	void WaitForUnlockedIO();
 
 public:
 	MetaFileSystem() {
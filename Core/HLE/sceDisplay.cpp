@@ -736,6 +736,7 @@ void hleEnterVblank(u64 userdata, int cyclesLate) {
 		DEBUG_LOG(SCEDISPLAY, "Setting latched framebuffer %08x (prev: %08x)", latchedFramebuf.topaddr, framebuf.topaddr);
 		framebuf = latchedFramebuf;
 		framebufIsLatched = false;
+		gpu->SyncThread();
 		gpu->SetDisplayFramebuffer(framebuf.topaddr, framebuf.stride, framebuf.fmt);
 		__DisplayFlip(cyclesLate);
 	} else if (!flippedThisFrame) {
@@ -931,6 +932,7 @@ static u32 sceDisplaySetMode(int displayMode, int displayWidth, int displayHeigh
 	}
 
 	if (!hasSetMode) {
+		gpu->SyncThread();
 		gpu->InitClear();
 		hasSetMode = true;
 	}
@@ -954,6 +956,7 @@ void __DisplaySetFramebuf(u32 topaddr, int linesize, int pixelFormat, int sync)
 		framebuf = fbstate;
 		// Also update latchedFramebuf for any sceDisplayGetFramebuf() after this.
 		latchedFramebuf = fbstate;
+		gpu->SyncThread();
 		gpu->SetDisplayFramebuffer(framebuf.topaddr, framebuf.stride, framebuf.fmt);
 		// IMMEDIATE means that the buffer is fine. We can just flip immediately.
 		// Doing it in non-buffered though creates problems (black screen) on occasion though
@@ -56,12 +56,14 @@ static ThreadSafeList<GeInterruptData> ge_pending_cb;
 static int geSyncEvent;
 static int geInterruptEvent;
 static int geCycleEvent;
+static int geThreadEvent;
 
 class GeIntrHandler : public IntrHandler {
 public:
 	GeIntrHandler() : IntrHandler(PSP_GE_INTR) {}
 
 	bool run(PendingInterrupt& pend) override {
+		gpu->SyncThread();
 		if (ge_pending_cb.empty()) {
 			ERROR_LOG_REPORT(SCEGE, "Unable to run GE interrupt: no pending interrupt");
 			return false;
@@ -144,6 +146,7 @@ class GeIntrHandler : public IntrHandler {
 	}
 
 	void handleResult(PendingInterrupt& pend) override {
+		gpu->SyncThread();
 		GeInterruptData intrdata = ge_pending_cb.front();
 		ge_pending_cb.pop_front();
 
@@ -193,6 +196,16 @@ static void __GeCheckCycles(u64 userdata, int cyclesLate) {
 	// Deprecated
 }
 
+static void __GeThreadEvents(u64 userdata, int cyclesLate) {
+	if (gpu)
+		gpu->FlushThreadEvents();
+}
+
+// Called from the GE thread, CoreTiming runs the event on the emu thread at its next advance.
+void __GeNotifyThreadEvents() {
+	CoreTiming::ScheduleEvent_Threadsafe_Immediate(geThreadEvent);
+}
+
 void __GeInit() {
 	memset(&ge_used_callbacks, 0, sizeof(ge_used_callbacks));
 	memset(&ge_callback_data, 0, sizeof(ge_callback_data));
@@ -202,6 +215,8 @@ void __GeInit() {
 	geSyncEvent = CoreTiming::RegisterEvent("GeSyncEvent", &__GeExecuteSync);
 	geInterruptEvent = CoreTiming::RegisterEvent("GeInterruptEvent", &__GeExecuteInterrupt);
 
+	geThreadEvent = CoreTiming::RegisterEvent("GeThreadEvent", &__GeThreadEvents);
+
 	// Deprecated
 	geCycleEvent = CoreTiming::RegisterEvent("GeCycleEvent", &__GeCheckCycles);
 
@@ -215,7 +230,7 @@ struct GeInterruptData_v1 {
 };
 
 void __GeDoState(PointerWrap &p) {
-	auto s = p.Section("sceGe", 1, 2);
+	auto s = p.Section("sceGe", 1, 3);
 	if (!s)
 		return;
 
@@ -241,6 +256,12 @@ void __GeDoState(PointerWrap &p) {
 	CoreTiming::RestoreRegisterEvent(geInterruptEvent, "GeInterruptEvent", &__GeExecuteInterrupt);
 	p.Do(geCycleEvent);
 	CoreTiming::RestoreRegisterEvent(geCycleEvent, "GeCycleEvent", &__GeCheckCycles);
+	if (s >= 3) {
+		p.Do(geThreadEvent);
+		CoreTiming::RestoreRegisterEvent(geThreadEvent, "GeThreadEvent", &__GeThreadEvents);
+	} else {
+		geThreadEvent = CoreTiming::RegisterEvent("GeThreadEvent", &__GeThreadEvents);
+	}
 
 	p.Do(listWaitingThreads);
 	p.Do(drawWaitingThreads);
@@ -529,6 +550,7 @@ static int sceGeGetMtx(int type, u32 matrixPtr) {
 	}
 
 	INFO_LOG(SCEGE, "sceGeGetMtx(%d, %08x)", type, matrixPtr);
+	gpu->SyncThread();
 	switch (type) {
 	case GE_MTX_BONE0:
 	case GE_MTX_BONE1:
@@ -563,6 +585,7 @@ static int sceGeGetMtx(int type, u32 matrixPtr) {
 
 static u32 sceGeGetCmd(int cmd) {
 	INFO_LOG(SCEGE, "sceGeGetCmd(%i)", cmd);
+	gpu->SyncThread();
 	if (cmd >= 0 && cmd < (int)ARRAY_SIZE(gstate.cmdmem)) {
 		return gstate.cmdmem[cmd];  // Does not mask away the high bits.
 	} else {
@@ -134,6 +134,8 @@ static std::thread ioManagerThread;
 // TODO: Is it better to just put all on the thread?
 // Let's try. (was 256)
 const int IO_THREAD_MIN_DATA_SIZE = 0;
+// Games often have several reads going at once, like streamed audio while loading a level.
+const int IO_WORKER_THREADS = 4;
 
 #define SCE_STM_FDIR 0x1000
 #define SCE_STM_FREG 0x2000
@@ -651,6 +653,7 @@ void __IoInit() {
 
 	ioManagerThreadEnabled = true;
 	ioManager.SetThreadEnabled(ioManagerThreadEnabled);
+	ioManager.StartWorkers(IO_WORKER_THREADS);
 	Core_ListenLifecycle(&__IoWakeManager);
 	ioManagerThread = std::thread(&__IoManagerThread);
 
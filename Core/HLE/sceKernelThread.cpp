@@ -46,6 +46,7 @@
 #include "Core/HLE/KernelThreadDebugInterface.h"
 #include "Core/HLE/KernelWaitHelpers.h"
 #include "Core/HLE/ThreadQueueList.h"
+#include "GPU/GPUInterface.h"
 
 typedef struct
 {
@@ -1142,6 +1143,8 @@ void __KernelIdle()
 	// Don't skip 0xDEADBEEF here, this is called directly bypassing CallSyscall().
 	// That means the hle flag would stick around until the next call.
 
+	// If the GE thread is still busy, its interrupts might be what everyone is waiting for.
+	gpu->SyncThread();
 	CoreTiming::Idle();
 	// We Advance within __KernelReSchedule(), so anything that has now happened after idle
 	// will be triggered properly upon reschedule.
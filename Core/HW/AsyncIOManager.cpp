@@ -18,6 +18,7 @@
 #include <condition_variable>
 #include <mutex>
 
+#include "thread/threadutil.h"
 #include "Common/ChunkFile.h"
 #include "Core/MIPS/MIPS.h"
 #include "Core/Reporting.h"
@@ -42,15 +43,81 @@ void AsyncIOManager::ScheduleOperation(AsyncIOEvent ev) {
 			ERROR_LOG_REPORT(SCEIO, "Scheduling operation for file %d while one is pending (type %d)", ev.handle, ev.type);
 		}
 	}
+
+	if (!workers_.empty()) {
+		std::lock_guard<std::mutex> guard(workLock_);
+		work_.push_back(ev);
+		workCount_++;
+		workWait_.notify_one();
+		return;
+	}
 	ScheduleEvent(ev);
 }
 
 void AsyncIOManager::Shutdown() {
+	StopWorkers();
+
 	std::lock_guard<std::mutex> guard(resultsLock_);
 	resultsPending_.clear();
 	results_.clear();
 }
 
+void AsyncIOManager::StartWorkers(int count) {
+	StopWorkers();
+	workersExit_ = false;
+	for (int i = 0; i < count; ++i) {
+		workers_.push_back(std::thread(&AsyncIOManager::WorkerFunc, this));
+	}
+}
+
+void AsyncIOManager::StopWorkers() {
+	{
+		std::lock_guard<std::mutex> guard(workLock_);
+		workersExit_ = true;
+		workWait_.notify_all();
+	}
+	for (std::thread &worker : workers_) {
+		worker.join();
+	}
+	workers_.clear();
+}
+
+void AsyncIOManager::WorkerFunc() {
+	setCurrentThreadName("IOWorker");
+
+	std::unique_lock<std::mutex> guard(workLock_);
+	while (true) {
+		workWait_.wait(guard, [&] { return workersExit_ || !work_.empty(); });
+		// Finish everything queued before exiting, someone is waiting on the results.
+		if (work_.empty()) {
+			break;
+		}
+
+		AsyncIOEvent ev = work_.front();
+		work_.pop_front();
+		guard.unlock();
+		ProcessEvent(ev);
+		guard.lock();
+
+		// The result is in by now, so waiters see either it or a busy worker.
+		if (--workCount_ == 0) {
+			workDone_.notify_all();
+		}
+	}
+}
+
+bool AsyncIOManager::WorkersBusy() {
+	std::lock_guard<std::mutex> guard(workLock_);
+	return workCount_ != 0;
+}
+
+void AsyncIOManager::SyncThread(bool force) {
+	IOThreadEventQueue::SyncThread(force);
+
+	std::unique_lock<std::mutex> guard(workLock_);
+	workDone_.wait(guard, [&] { return workCount_ == 0; });
+}
+
 bool AsyncIOManager::HasResult(u32 handle) {
 	std::lock_guard<std::mutex> guard(resultsLock_);
 	return results_.find(handle) != results_.end();
@@ -80,10 +147,17 @@ bool AsyncIOManager::ReadResult(u32 handle, AsyncIOResult &result) {
 	}
 }
 
+bool AsyncIOManager::StillRunning(u32 handle) {
+	if (!ThreadEnabled() || resultsPending_.find(handle) == resultsPending_.end()) {
+		return false;
+	}
+	return HasEvents() || WorkersBusy();
+}
+
 bool AsyncIOManager::WaitResult(u32 handle, AsyncIOResult &result) {
 	std::unique_lock<std::mutex> guard(resultsLock_);
 	ScheduleEvent(IO_EVENT_SYNC);
-	while (HasEvents() && ThreadEnabled() && resultsPending_.find(handle) != resultsPending_.end()) {
+	while (StillRunning(handle)) {
 		if (PopResult(handle, result)) {
 			return true;
 		}
@@ -97,7 +171,7 @@ u64 AsyncIOManager::ResultFinishTicks(u32 handle) {
 
 	std::unique_lock<std::mutex> guard(resultsLock_);
 	ScheduleEvent(IO_EVENT_SYNC);
-	while (HasEvents() && ThreadEnabled() && resultsPending_.find(handle) != resultsPending_.end()) {
+	while (StillRunning(handle)) {
 		if (ReadResult(handle, result)) {
 			return result.finishTicks;
 		}
@@ -15,9 +15,13 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <condition_variable>
+#include <deque>
 #include <map>
 #include <set>
 #include <mutex>
+#include <thread>
+#include <vector>
 
 #include "Core/ThreadEventQueue.h"
 
@@ -80,6 +84,11 @@ class AsyncIOManager : public IOThreadEventQueue {
 public:
 	void DoState(PointerWrap &p);
 
+	// Reads and writes on different handles then run at the same time, on this many threads.
+	void StartWorkers(int count);
+	// Also waits for the workers to finish what they're running.
+	void SyncThread(bool force = false);
+
 	bool HasOperation(u32 handle);
 	void ScheduleOperation(AsyncIOEvent ev);
 	void Shutdown();
@@ -97,13 +106,27 @@ class AsyncIOManager : public IOThreadEventQueue {
 private:
 	bool PopResult(u32 handle, AsyncIOResult &result);
 	bool ReadResult(u32 handle, AsyncIOResult &result);
+	bool StillRunning(u32 handle);
 	void Read(u32 handle, u8 *buf, size_t bytes, u32 invalidateAddr);
 	void Write(u32 handle, u8 *buf, size_t bytes);
 
 	void EventResult(u32 handle, AsyncIOResult result);
 
+	void StopWorkers();
+	void WorkerFunc();
+	bool WorkersBusy();
+
 	std::mutex resultsLock_;
 	std::condition_variable resultsWait_;
 	std::set<u32> resultsPending_;
 	std::map<u32, AsyncIOResult> results_;
+
+	std::vector<std::thread> workers_;
+	std::mutex workLock_;
+	std::condition_variable workWait_;
+	std::condition_variable workDone_;
+	std::deque<AsyncIOEvent> work_;
+	// Queued or running on a worker.
+	int workCount_ = 0;
+	bool workersExit_ = false;
 };
\ No newline at end of file
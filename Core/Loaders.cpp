@@ -22,11 +22,13 @@
 #include "file/file_util.h"
 #include "Common/FileUtil.h"
 
+#include "Core/Config.h"
 #include "Core/FileLoaders/CachingFileLoader.h"
 #include "Core/FileLoaders/DiskCachingFileLoader.h"
 #include "Core/FileLoaders/HTTPFileLoader.h"
 #include "Core/FileLoaders/LocalFileLoader.h"
 #include "Core/FileLoaders/RetryingFileLoader.h"
+#include "Core/FileLoaders/SharedCachingFileLoader.h"
 #include "Core/FileSystems/MetaFileSystem.h"
 #include "Core/PSPLoaders.h"
 #include "Core/MemMap.h"
@@ -42,15 +44,19 @@ void RegisterFileLoaderFactory(std::string prefix, std::unique_ptr<FileLoaderFac
 }
 
 FileLoader *ConstructFileLoader(const std::string &filename) {
-	if (filename.find("http://") == 0 || filename.find("https://") == 0)
-		return new CachingFileLoader(new DiskCachingFileLoader(new RetryingFileLoader(new HTTPFileLoader(filename))));
+	if (filename.find("http://") == 0 || filename.find("https://") == 0) {
+		FileLoader *remote = new RetryingFileLoader(new HTTPFileLoader(filename));
+		if (g_Config.bSharedDiskCache)
+			return new CachingFileLoader(new SharedCachingFileLoader(remote));
+		return new CachingFileLoader(new DiskCachingFileLoader(remote));
+	}
 
 	for (auto &iter : factories) {
 		if (startsWith(iter.first, filename)) {
 			return iter.second->ConstructFileLoader(filename);
 		}
 	}
-	return new LocalFileLoader(filename);
+	return new LocalFileLoader(filename, g_Config.bMapLocalISOs);
 }
 
 // TODO : improve, look in the file more
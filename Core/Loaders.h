@@ -89,6 +89,16 @@ class FileLoader {
 		return ReadAt(absolutePos, 1, bytes, data, flags);
 	}
 
+	// This range is likely to be read soon, for example because a file in it was opened.
+	virtual void HintExtent(s64 absolutePos, s64 bytes) {
+	}
+
+	// Returns a pointer to the data if this whole range can be read in place, like from a memory
+	// mapped file, otherwise nullptr.  It stays valid as long as the loader does.
+	virtual const u8 *GetPointer(s64 absolutePos, size_t bytes) {
+		return nullptr;
+	}
+
 	// Cancel any operations that might block, if possible.
 	virtual void Cancel() {
 	}
@@ -125,6 +135,9 @@ class ProxiedFileLoader : public FileLoader {
 	std::string Path() const override {
 		return backend_->Path();
 	}
+	void HintExtent(s64 absolutePos, s64 bytes) override {
+		backend_->HintExtent(absolutePos, bytes);
+	}
 	void Cancel() override {
 		backend_->Cancel();
 	}
@@ -494,6 +494,8 @@ void PSP_RunLoopUntil(u64 globalticks) {
 	}
 
 	mipsr4k.RunLoopUntil(globalticks);
+	// Nothing outside the emu loop expects the GE thread to be running.
+	gpu->SyncThread();
 	gpu->CleanupBeforeUI();
 }
 
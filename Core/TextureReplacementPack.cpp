@@ -0,0 +1,490 @@
+// Copyright (c) 2016- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include "ppsspp_config.h"
+
+#ifdef USING_QT_UI
+#include <QtGui/QImage>
+#else
+#include <libpng17/png.h>
+#endif
+
+#ifdef _WIN32
+#include "Common/CommonWindows.h"
+#include "util/text/utf8.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <tuple>
+#include <snappy-c.h>
+
+#include "Common/FileUtil.h"
+#include "Common/Log.h"
+#include "Core/TextureReplacementPack.h"
+
+static const char PACK_MAGIC[4] = { 'P', 'P', 'R', 'P' };
+static const u32 PACK_VERSION = 1;
+// How many entries after the requested one to load in the background.
+static const u32 PREFETCH_NEIGHBOURS = 16;
+static const size_t MAX_DECODED_BYTES = 64 * 1024 * 1024;
+// Larger than any texture a PSP game could be given, even scaled up.  Entries are decoded in one piece.
+static const u64 MAX_ENTRY_BYTES = 16384ULL * 16384ULL * 4;
+
+static bool EntryLess(const ReplacementPackEntry &e, u64 cachekey, u32 hash, u32 level) {
+	if (e.cachekey != cachekey)
+		return e.cachekey < cachekey;
+	if (e.hash != hash)
+		return e.hash < hash;
+	return e.level < level;
+}
+
+ReplacementPack::ReplacementPack() {
+}
+
+ReplacementPack::~ReplacementPack() {
+	Close();
+}
+
+bool ReplacementPack::Open(const std::string &filename) {
+	Close();
+	if (!MapFile(filename)) {
+		return false;
+	}
+
+	header_ = (const ReplacementPackHeader *)base_;
+	entries_ = (const ReplacementPackEntry *)(base_ + sizeof(ReplacementPackHeader));
+	bool valid = size_ >= sizeof(ReplacementPackHeader) && memcmp(header_->magic, PACK_MAGIC, sizeof(PACK_MAGIC)) == 0 && header_->version == PACK_VERSION;
+	if (valid) {
+		valid = sizeof(ReplacementPackHeader) + (u64)header_->entryCount * sizeof(ReplacementPackEntry) <= size_;
+	}
+	for (u32 i = 0; valid && i < header_->entryCount; ++i) {
+		// Written so that a huge offset can't wrap around.
+		const ReplacementPackEntry &entry = entries_[i];
+		valid = entry.offset <= size_ && entry.size <= size_ - entry.offset;
+		valid = valid && (u64)entry.w * entry.h * 4 <= MAX_ENTRY_BYTES;
+	}
+	if (!valid) {
+		ERROR_LOG(G3D, "Invalid texture replacement pack: %s", filename.c_str());
+		header_ = nullptr;
+		UnmapFile();
+		return false;
+	}
+
+	INFO_LOG(G3D, "Using texture replacement pack %s (%d entries)", filename.c_str(), (int)header_->entryCount);
+	return true;
+}
+
+void ReplacementPack::Close() {
+	if (loaderThread_.joinable()) {
+		{
+			std::lock_guard<std::mutex> guard(loaderLock_);
+			loaderExit_ = true;
+		}
+		loaderCond_.notify_one();
+		loaderThread_.join();
+	}
+	loaderExit_ = false;
+	loaderQueue_.clear();
+	decoded_.clear();
+	decodedOrder_.clear();
+	decodedBytes_ = 0;
+
+	header_ = nullptr;
+	entries_ = nullptr;
+	UnmapFile();
+}
+
+bool ReplacementPack::MapFile(const std::string &filename) {
+#if defined(_WIN32) && !PPSSPP_PLATFORM(UWP)
+	HANDLE file = CreateFileW(ConvertUTF8ToWString(filename).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	HANDLE mapping = nullptr;
+	if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart != 0) {
+		mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	}
+	void *view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (!view) {
+		if (mapping)
+			CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+	fileHandle_ = file;
+	mappingHandle_ = mapping;
+	base_ = (const u8 *)view;
+	size_ = (size_t)fileSize.QuadPart;
+	return true;
+#elif defined(_WIN32)
+	// No file mapping on UWP, just read it all.
+	FILE *fp = File::OpenCFile(filename, "rb");
+	if (!fp) {
+		return false;
+	}
+	fallbackData_.resize((size_t)File::GetFileSize(fp));
+	bool success = fread(fallbackData_.data(), 1, fallbackData_.size(), fp) == fallbackData_.size();
+	fclose(fp);
+	if (!success || fallbackData_.empty()) {
+		fallbackData_.clear();
+		return false;
+	}
+	base_ = fallbackData_.data();
+	size_ = fallbackData_.size();
+	return true;
+#else
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	void *view = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && st.st_size != 0) {
+		view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	}
+	if (view == MAP_FAILED) {
+		close(fd);
+		return false;
+	}
+	fd_ = fd;
+	base_ = (const u8 *)view;
+	size_ = (size_t)st.st_size;
+	return true;
+#endif
+}
+
+void ReplacementPack::UnmapFile() {
+#ifdef _WIN32
+	if (mappingHandle_) {
+		UnmapViewOfFile(base_);
+		CloseHandle((HANDLE)mappingHandle_);
+		CloseHandle((HANDLE)fileHandle_);
+		mappingHandle_ = nullptr;
+		fileHandle_ = nullptr;
+	}
+	fallbackData_.clear();
+#else
+	if (fd_ >= 0) {
+		munmap((void *)base_, size_);
+		close(fd_);
+		fd_ = -1;
+	}
+#endif
+	base_ = nullptr;
+	size_ = 0;
+}
+
+const ReplacementPackEntry *ReplacementPack::Find(u64 cachekey, u32 hash, u32 level, bool aliasOnly) const {
+	if (!header_) {
+		return nullptr;
+	}
+
+	const ReplacementPackEntry *end = entries_ + header_->entryCount;
+	const ReplacementPackEntry *it = std::lower_bound(entries_, end, 0, [&](const ReplacementPackEntry &e, int) {
+		return EntryLess(e, cachekey, hash, level);
+	});
+	if (it == end || it->cachekey != cachekey || it->hash != hash || it->level != level) {
+		return nullptr;
+	}
+	if (aliasOnly && (it->flags & PACK_ENTRY_ALIAS) == 0) {
+		return nullptr;
+	}
+	return it;
+}
+
+bool ReplacementPack::Decompress(const ReplacementPackEntry *entry, std::vector<u8> &out) const {
+	const size_t expected = (size_t)entry->w * entry->h * 4;
+	out.resize(expected);
+	const u8 *src = base_ + entry->offset;
+	if (entry->compression == (u8)ReplacementPackCompression::SNAPPY) {
+		size_t outSize = expected;
+		if (snappy_uncompress((const char *)src, entry->size, (char *)out.data(), &outSize) != SNAPPY_OK || outSize != expected) {
+			return false;
+		}
+		return true;
+	}
+	if (entry->compression != (u8)ReplacementPackCompression::NONE || entry->size != expected) {
+		return false;
+	}
+	memcpy(out.data(), src, expected);
+	return true;
+}
+
+bool ReplacementPack::Read(const ReplacementPackEntry *entry, void *out, int rowPitch) {
+	const int srcPitch = entry->w * 4;
+	const u8 *pixels = nullptr;
+	std::vector<u8> temp;
+
+	std::unique_lock<std::mutex> guard(loaderLock_);
+	auto decoded = decoded_.find((u32)(entry - entries_));
+	if (decoded != decoded_.end()) {
+		pixels = decoded->second.data();
+	} else if (entry->compression == (u8)ReplacementPackCompression::NONE && entry->size == (u64)srcPitch * entry->h) {
+		// Straight out of the mapping, no need to hold the lock.
+		guard.unlock();
+		pixels = base_ + entry->offset;
+	} else {
+		guard.unlock();
+		if (!Decompress(entry, temp)) {
+			ERROR_LOG(G3D, "Could not decompress texture replacement %016llx%08x_%d", (u64)entry->cachekey, (u32)entry->hash, (int)entry->level);
+			return false;
+		}
+		pixels = temp.data();
+	}
+
+	for (u32 y = 0; y < entry->h; ++y) {
+		memcpy((u8 *)out + rowPitch * y, pixels + srcPitch * y, srcPitch);
+	}
+	return true;
+}
+
+void ReplacementPack::Prefetch(const ReplacementPackEntry *entry) {
+	if (!header_) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> guard(loaderLock_);
+	const u32 first = (u32)(entry - entries_);
+	const u32 last = std::min(first + PREFETCH_NEIGHBOURS, (u32)header_->entryCount);
+	for (u32 i = first; i < last; ++i) {
+		if (!decoded_.count(i) && std::find(loaderQueue_.begin(), loaderQueue_.end(), i) == loaderQueue_.end()) {
+			loaderQueue_.push_back(i);
+		}
+	}
+	if (!loaderThread_.joinable()) {
+		loaderThread_ = std::thread([this] { LoaderThreadFunc(); });
+	}
+	loaderCond_.notify_one();
+}
+
+void ReplacementPack::LoaderThreadFunc() {
+	std::unique_lock<std::mutex> guard(loaderLock_);
+	while (!loaderExit_) {
+		if (loaderQueue_.empty()) {
+			loaderCond_.wait(guard);
+			continue;
+		}
+
+		const u32 index = loaderQueue_.front();
+		loaderQueue_.pop_front();
+		const ReplacementPackEntry *entry = &entries_[index];
+		if ((entry->flags & PACK_ENTRY_IGNORED) != 0 || decoded_.count(index)) {
+			continue;
+		}
+		guard.unlock();
+
+		std::vector<u8> pixels;
+		bool keep = false;
+		if (entry->compression == (u8)ReplacementPackCompression::NONE) {
+			// Just fault the pages in, Read() copies straight from the mapping.
+			volatile u8 sum = 0;
+			const u8 *src = base_ + entry->offset;
+			for (u32 i = 0; i < entry->size; i += 4096) {
+				sum += src[i];
+			}
+		} else {
+			keep = Decompress(entry, pixels);
+		}
+
+		guard.lock();
+		if (keep) {
+			decodedBytes_ += pixels.size();
+			decoded_[index] = std::move(pixels);
+			decodedOrder_.push_back(index);
+			while (decodedBytes_ > MAX_DECODED_BYTES && !decodedOrder_.empty()) {
+				auto oldest = decoded_.find(decodedOrder_.front());
+				decodedBytes_ -= oldest->second.size();
+				decoded_.erase(oldest);
+				decodedOrder_.pop_front();
+			}
+		}
+	}
+}
+
+static bool DecodePNG(const std::string &filename, std::vector<u8> &pixels, int &w, int &h, bool &alphaFull) {
+#ifdef USING_QT_UI
+	QImage image(filename.c_str(), "PNG");
+	if (image.isNull()) {
+		return false;
+	}
+	image = image.convertToFormat(QImage::Format_ARGB32);
+	w = image.width();
+	h = image.height();
+	pixels.resize(w * h * 4);
+	for (int y = 0; y < h; ++y) {
+		const QRgb *src = (const QRgb *)image.constScanLine(y);
+		u8 *outLine = &pixels[y * w * 4];
+		for (int x = 0; x < w; ++x) {
+			outLine[x * 4 + 0] = qRed(src[x]);
+			outLine[x * 4 + 1] = qGreen(src[x]);
+			outLine[x * 4 + 2] = qBlue(src[x]);
+			outLine[x * 4 + 3] = qAlpha(src[x]);
+		}
+	}
+#else
+	png_image png = {};
+	png.version = PNG_IMAGE_VERSION;
+	FILE *fp = File::OpenCFile(filename, "rb");
+	if (!fp) {
+		return false;
+	}
+	bool success = png_image_begin_read_from_stdio(&png, fp) != 0;
+	if (success) {
+		png.format = PNG_FORMAT_RGBA;
+		w = png.width;
+		h = png.height;
+		pixels.resize(w * h * 4);
+		success = png_image_finish_read(&png, nullptr, pixels.data(), w * 4, nullptr) != 0;
+	}
+	if (!success) {
+		ERROR_LOG(G3D, "Could not load texture replacement: %s - %s", filename.c_str(), png.message);
+	}
+	fclose(fp);
+	png_image_free(&png);
+	if (!success) {
+		return false;
+	}
+#endif
+
+	alphaFull = true;
+	for (size_t i = 3; i < pixels.size(); i += 4) {
+		if (pixels[i] != 0xFF) {
+			alphaFull = false;
+			break;
+		}
+	}
+	return true;
+}
+
+bool ReplacementPack::Build(const std::string &texturesDirectory, const std::string &filename, const std::vector<ReplacementPackSource> &sources, bool compress) {
+	// Sort by key and drop duplicates.  Aliases win, they're looked up first anyway.
+	std::map<std::tuple<u64, u32, u32>, const ReplacementPackSource *> sorted;
+	for (const ReplacementPackSource &source : sources) {
+		auto &slot = sorted[std::make_tuple(source.cachekey, source.hash, source.level)];
+		if (!slot || ((source.flags & PACK_ENTRY_ALIAS) != 0 && (slot->flags & PACK_ENTRY_ALIAS) == 0)) {
+			slot = &source;
+		}
+	}
+
+	FILE *fp = File::OpenCFile(filename, "wb");
+	if (!fp) {
+		ERROR_LOG(G3D, "Unable to create texture replacement pack: %s", filename.c_str());
+		return false;
+	}
+
+	ReplacementPackHeader header{};
+	memcpy(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+	header.version = PACK_VERSION;
+
+	std::vector<ReplacementPackEntry> entries;
+	entries.reserve(sorted.size());
+	u64 offset = sizeof(ReplacementPackHeader) + sorted.size() * sizeof(ReplacementPackEntry);
+	fseek(fp, (long)offset, SEEK_SET);
+
+	// Several keys can point to the same file, only store it once.
+	std::map<std::string, ReplacementPackEntry> written;
+	std::vector<u8> compressed;
+	bool success = true;
+	for (const auto &item : sorted) {
+		const ReplacementPackSource &source = *item.second;
+		ReplacementPackEntry entry{};
+		entry.cachekey = source.cachekey;
+		entry.hash = source.hash;
+		entry.level = source.level;
+		entry.flags = source.flags;
+
+		if (source.file.empty()) {
+			entry.flags |= PACK_ENTRY_IGNORED;
+			entry.offset = offset;
+			entries.push_back(entry);
+			continue;
+		}
+
+		auto prev = written.find(source.file);
+		if (prev != written.end()) {
+			entry.w = prev->second.w;
+			entry.h = prev->second.h;
+			entry.offset = prev->second.offset;
+			entry.size = prev->second.size;
+			entry.compression = prev->second.compression;
+			entry.flags |= prev->second.flags & PACK_ENTRY_ALPHA_FULL;
+			entries.push_back(entry);
+			continue;
+		}
+
+		std::vector<u8> pixels;
+		int w, h;
+		bool alphaFull;
+		if (!DecodePNG(texturesDirectory + source.file, pixels, w, h, alphaFull)) {
+			// Leave it out, same as a missing file.
+			continue;
+		}
+
+		entry.w = w;
+		entry.h = h;
+		entry.offset = offset;
+		if (alphaFull) {
+			entry.flags |= PACK_ENTRY_ALPHA_FULL;
+		}
+
+		const u8 *data = pixels.data();
+		size_t dataSize = pixels.size();
+		entry.compression = (u8)ReplacementPackCompression::NONE;
+		if (compress) {
+			size_t compressedSize = snappy_max_compressed_length(pixels.size());
+			compressed.resize(compressedSize);
+			if (snappy_compress((const char *)pixels.data(), pixels.size(), (char *)compressed.data(), &compressedSize) == SNAPPY_OK && compressedSize < pixels.size()) {
+				entry.compression = (u8)ReplacementPackCompression::SNAPPY;
+				data = compressed.data();
+				dataSize = compressedSize;
+			}
+		}
+		entry.size = (u32)dataSize;
+
+		if (fwrite(data, 1, dataSize, fp) != dataSize) {
+			success = false;
+			break;
+		}
+		offset += dataSize;
+		written[source.file] = entry;
+		entries.push_back(entry);
+	}
+
+	// Decode failures leave entries out, so the count is only known now.  Any unused index space is just padding.
+	header.entryCount = (u32)entries.size();
+	if (success) {
+		fseek(fp, 0, SEEK_SET);
+		success = fwrite(&header, sizeof(header), 1, fp) == 1;
+		success = success && (entries.empty() || fwrite(entries.data(), sizeof(ReplacementPackEntry), entries.size(), fp) == entries.size());
+	}
+	if (fclose(fp) != 0) {
+		success = false;
+	}
+	if (!success) {
+		ERROR_LOG(G3D, "Failed writing texture replacement pack: %s", filename.c_str());
+		File::Delete(filename);
+	}
+	return success;
+}
@@ -0,0 +1,128 @@
+// Copyright (c) 2016- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/Swap.h"
+
+// A texture pack with every PNG already decoded, in one memory mapped file.
+// This avoids opening lots of small files and decoding PNGs on the emu thread.
+//
+// Layout: ReplacementPackHeader, then entryCount ReplacementPackEntry sorted by key, then the pixel data.
+// Pixel data is tightly packed RGBA8888, optionally snappy compressed.
+
+enum class ReplacementPackCompression : u8 {
+	NONE = 0,
+	SNAPPY = 1,
+};
+
+enum {
+	// The entry came from [hashes] in textures.ini, rather than a file named after its hash.
+	PACK_ENTRY_ALIAS = 0x01,
+	// An empty filename in [hashes], meaning don't replace.
+	PACK_ENTRY_IGNORED = 0x02,
+	PACK_ENTRY_ALPHA_FULL = 0x04,
+};
+
+struct ReplacementPackHeader {
+	char magic[4];
+	u32_le version;
+	u32_le entryCount;
+	u32_le reserved;
+};
+
+struct ReplacementPackEntry {
+	u64_le cachekey;
+	u32_le hash;
+	u32_le level;
+	// Size of the image as stored, before any hashrange scaling.
+	u32_le w;
+	u32_le h;
+	u64_le offset;
+	u32_le size;
+	u8 flags;
+	u8 compression;
+	u16_le reserved;
+};
+
+// Used when building a pack.
+struct ReplacementPackSource {
+	u64 cachekey;
+	u32 hash;
+	u32 level;
+	u8 flags;
+	// Relative to the texture directory.  Several entries may share a file.
+	std::string file;
+};
+
+class ReplacementPack {
+public:
+	ReplacementPack();
+	~ReplacementPack();
+
+	bool Open(const std::string &filename);
+	void Close();
+	bool IsOpen() const {
+		return header_ != nullptr;
+	}
+
+	// With aliasOnly, only entries from [hashes] are considered.
+	const ReplacementPackEntry *Find(u64 cachekey, u32 hash, u32 level, bool aliasOnly) const;
+	bool Read(const ReplacementPackEntry *entry, void *out, int rowPitch);
+	// Loads the entry and the ones after it (nearby addresses and hashes) on the loader thread.
+	void Prefetch(const ReplacementPackEntry *entry);
+
+	static bool Build(const std::string &texturesDirectory, const std::string &filename, const std::vector<ReplacementPackSource> &sources, bool compress);
+
+private:
+	bool MapFile(const std::string &filename);
+	void UnmapFile();
+	void LoaderThreadFunc();
+	bool Decompress(const ReplacementPackEntry *entry, std::vector<u8> &out) const;
+
+	const u8 *base_ = nullptr;
+	size_t size_ = 0;
+	const ReplacementPackHeader *header_ = nullptr;
+	const ReplacementPackEntry *entries_ = nullptr;
+	// Only used where we can't map the file.
+	std::vector<u8> fallbackData_;
+#ifdef _WIN32
+	void *fileHandle_ = nullptr;
+	void *mappingHandle_ = nullptr;
+#else
+	int fd_ = -1;
+#endif
+
+	std::thread loaderThread_;
+	std::mutex loaderLock_;
+	std::condition_variable loaderCond_;
+	std::deque<u32> loaderQueue_;
+	bool loaderExit_ = false;
+	// Decompressed entries, by index.  Oldest dropped first when over the limit.
+	std::unordered_map<u32, std::vector<u8>> decoded_;
+	std::deque<u32> decodedOrder_;
+	size_t decodedBytes_ = 0;
+};
@@ -24,6 +24,7 @@
 #include <algorithm>
 #include "i18n/i18n.h"
 #include "ext/xxhash.h"
+#include "file/file_util.h"
 #include "file/ini_file.h"
 #include "Common/ColorConv.h"
 #include "Common/FileUtil.h"
@@ -36,6 +37,7 @@
 
 static const std::string INI_FILENAME = "textures.ini";
 static const std::string NEW_TEXTURE_DIR = "new/";
+static const std::string PACK_FILENAME = "textures.pack";
 static const int VERSION = 1;
 static const int MAX_MIP_LEVELS = 12;  // 12 should be plenty, 8 is the max mip levels supported by the PSP.
 
@@ -69,6 +71,13 @@ void TextureReplacer::NotifyConfigChanged() {
 	if (enabled_) {
 		enabled_ = LoadIni();
 	}
+
+	// Entries may point into the pack, so start over.
+	cache_.clear();
+	pack_.Close();
+	if (enabled_ && g_Config.bReplaceTextures && File::Exists(basePath_ + PACK_FILENAME)) {
+		pack_.Open(basePath_ + PACK_FILENAME);
+	}
 }
 
 bool TextureReplacer::LoadIni() {
@@ -306,6 +315,11 @@ ReplacedTexture &TextureReplacer::FindReplacement(u64 cachekey, u32 hash, int w,
 }
 
 void TextureReplacer::PopulateReplacement(ReplacedTexture *result, u64 cachekey, u32 hash, int w, int h) {
+	if (pack_.IsOpen()) {
+		PopulateReplacementFromPack(result, cachekey, hash, w, h);
+		return;
+	}
+
 	int newW = w;
 	int newH = h;
 	LookupHashRange(cachekey >> 32, newW, newH);
@@ -371,6 +385,62 @@ void TextureReplacer::PopulateReplacement(ReplacedTexture *result, u64 cachekey,
 	result->alphaStatus_ = ReplacedTextureAlpha::UNKNOWN;
 }
 
+void TextureReplacer::PopulateReplacementFromPack(ReplacedTexture *result, u64 cachekey, u32 hash, int w, int h) {
+	int newW = w;
+	int newH = h;
+	LookupHashRange(cachekey >> 32, newW, newH);
+
+	if (ignoreAddress_) {
+		cachekey = cachekey & 0xFFFFFFFFULL;
+	}
+
+	for (int i = 0; i < MAX_MIP_LEVELS; ++i) {
+		const ReplacementPackEntry *entry = LookupPackEntry(cachekey, hash, i);
+		if (!entry || (entry->flags & PACK_ENTRY_IGNORED) != 0) {
+			// Out of valid mip levels.  Bail out.
+			break;
+		}
+		if (i == 0) {
+			// Textures near this one are likely to be needed soon, get them ready.
+			pack_.Prefetch(entry);
+		}
+
+		ReplacedTextureLevel level;
+		level.fmt = ReplacedTextureFormat::F_8888;
+		level.packEntry = entry;
+		// We pad files that have been hashrange'd so they are the same texture size.
+		level.w = (entry->w * w) / newW;
+		level.h = (entry->h * h) / newH;
+
+		if (i != 0 && (level.w != (result->levels_[0].w >> i) || level.h != (result->levels_[0].h >> i))) {
+			WARN_LOG(G3D, "Replacement mipmap invalid: size=%dx%d, expected=%dx%d (level %d)", level.w, level.h, result->levels_[0].w >> i, result->levels_[0].h >> i, i);
+			break;
+		}
+		result->levels_.push_back(level);
+	}
+
+	result->pack_ = &pack_;
+	result->alphaStatus_ = ReplacedTextureAlpha::UNKNOWN;
+}
+
+const ReplacementPackEntry *TextureReplacer::LookupPackEntry(u64 cachekey, u32 hash, int level) {
+	// Same order as LookupHashFile(): [hashes] aliases, with the same fallbacks, then by name.
+	const ReplacementPackEntry *entry = pack_.Find(cachekey, hash, level, true);
+	if (!entry)
+		entry = pack_.Find(cachekey & 0xFFFFFFFFULL, 0, level, true);
+	if (!entry && !ignoreAddress_)
+		entry = pack_.Find(cachekey, 0, level, true);
+	if (!entry)
+		entry = pack_.Find(cachekey & 0xFFFFFFFFULL, hash, level, true);
+	if (!entry && !ignoreAddress_)
+		entry = pack_.Find(cachekey & ~0xFFFFFFFFULL, hash, level, true);
+	if (!entry)
+		entry = pack_.Find(0, hash, level, true);
+	if (!entry)
+		entry = pack_.Find(cachekey, hash, level, false);
+	return entry;
+}
+
 #ifndef USING_QT_UI
 static bool WriteTextureToPNG(png_imagep image, const std::string &filename, int convert_to_8bit, const void *buffer, png_int_32 row_stride, const void *colormap) {
 	FILE *fp = File::OpenCFile(filename, "wb");
@@ -594,6 +664,16 @@ void ReplacedTexture::Load(int level, void *out, int rowPitch) {
 
 	const ReplacedTextureLevel &info = levels_[level];
 
+	if (info.packEntry) {
+		if (pack_->Read(info.packEntry, out, rowPitch)) {
+			const bool alphaFull = (info.packEntry->flags & PACK_ENTRY_ALPHA_FULL) != 0;
+			if (level == 0 || !alphaFull) {
+				alphaStatus_ = alphaFull ? ReplacedTextureAlpha::FULL : ReplacedTextureAlpha::UNKNOWN;
+			}
+		}
+		return;
+	}
+
 #ifdef USING_QT_UI
 	QImage image(info.file.c_str(), "PNG");
 	if (image.isNull()) {
@@ -701,3 +781,45 @@ bool TextureReplacer::GenerateIni(const std::string &gameID, std::string *genera
 	}
 	return File::Exists(texturesDirectory + INI_FILENAME);
 }
+
+bool TextureReplacer::BuildPack(const std::string &texturesDirectory, bool compress) {
+	std::string dir = texturesDirectory;
+	if (!dir.empty() && dir.back() != '/') {
+		dir += "/";
+	}
+	if (!File::Exists(dir) || !File::IsDirectory(dir)) {
+		ERROR_LOG(G3D, "Texture directory not found: %s", dir.c_str());
+		return false;
+	}
+
+	std::vector<ReplacementPackSource> sources;
+	if (File::Exists(dir + INI_FILENAME)) {
+		IniFile ini;
+		ini.LoadFromVFS(dir + INI_FILENAME);
+		if (ini.HasSection("hashes")) {
+			auto hashes = ini.GetOrCreateSection("hashes")->ToMap();
+			for (const auto &item : hashes) {
+				ReplacementAliasKey key(0, 0, 0);
+				if (sscanf(item.first.c_str(), "%16llx%8x_%d", &key.cachekey, &key.hash, &key.level) >= 1) {
+					sources.push_back(ReplacementPackSource{ key.cachekey, key.hash, key.level, PACK_ENTRY_ALIAS, item.second });
+				}
+			}
+		}
+	}
+
+	// And anything named after its hash, which is what LookupHashFile() falls back to.
+	std::vector<FileInfo> files;
+	getFilesInDir(dir.c_str(), &files, "png:");
+	for (const FileInfo &file : files) {
+		ReplacementAliasKey key(0, 0, 0);
+		char ext[5] = {};
+		if (!file.isDirectory && sscanf(file.name.c_str(), "%16llx%8x_%d.%4s", &key.cachekey, &key.hash, &key.level, ext) == 4) {
+			sources.push_back(ReplacementPackSource{ key.cachekey, key.hash, key.level, 0, file.name });
+		} else if (!file.isDirectory && file.name.size() == 16 + 8 + 4 && sscanf(file.name.c_str(), "%16llx%8x", &key.cachekey, &key.hash) == 2) {
+			sources.push_back(ReplacementPackSource{ key.cachekey, key.hash, 0, 0, file.name });
+		}
+	}
+
+	NOTICE_LOG(G3D, "Building texture replacement pack from %d entries in %s", (int)sources.size(), dir.c_str());
+	return ReplacementPack::Build(dir, dir + PACK_FILENAME, sources, compress);
+}
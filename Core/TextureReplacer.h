@@ -23,6 +23,7 @@
 #include <vector>
 #include "Common/Common.h"
 #include "Common/MemoryUtil.h"
+#include "Core/TextureReplacementPack.h"
 #include "GPU/ge_constants.h"
 
 class IniFile;
@@ -59,6 +60,8 @@ struct ReplacedTextureLevel {
 	int h;
 	ReplacedTextureFormat fmt;
 	std::string file;
+	// Set instead of file when loading from a pack.
+	const ReplacementPackEntry *packEntry = nullptr;
 };
 
 struct ReplacementCacheKey {
@@ -155,6 +158,7 @@ struct ReplacedTexture {
 protected:
 	std::vector<ReplacedTextureLevel> levels_;
 	ReplacedTextureAlpha alphaStatus_;
+	ReplacementPack *pack_ = nullptr;
 
 	friend TextureReplacer;
 };
@@ -188,6 +192,8 @@ class TextureReplacer {
 	void NotifyTextureDecoded(const ReplacedTextureDecodeInfo &replacedInfo, const void *data, int pitch, int level, int w, int h);
 
 	static bool GenerateIni(const std::string &gameID, std::string *generatedFilename);
+	// Decodes all the PNGs in a texture directory into a single pack file, which is then used instead.
+	static bool BuildPack(const std::string &texturesDirectory, bool compress);
 
 protected:
 	bool LoadIni();
@@ -197,6 +203,8 @@ class TextureReplacer {
 	std::string LookupHashFile(u64 cachekey, u32 hash, int level);
 	std::string HashName(u64 cachekey, u32 hash, int level);
 	void PopulateReplacement(ReplacedTexture *result, u64 cachekey, u32 hash, int w, int h);
+	void PopulateReplacementFromPack(ReplacedTexture *result, u64 cachekey, u32 hash, int w, int h);
+	const ReplacementPackEntry *LookupPackEntry(u64 cachekey, u32 hash, int level);
 
 	SimpleBuf<u32> saveBuf;
 	bool enabled_ = false;
@@ -209,6 +217,7 @@ class TextureReplacer {
 	typedef std::pair<int, int> WidthHeightPair;
 	std::unordered_map<u64, WidthHeightPair> hashranges_;
 	std::unordered_map<ReplacementAliasKey, std::string> aliases_;
+	ReplacementPack pack_;
 
 	ReplacedTexture none_;
 	std::unordered_map<ReplacementCacheKey, ReplacedTexture> cache_;
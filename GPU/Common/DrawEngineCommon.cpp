@@ -17,9 +17,11 @@
 
 #include <algorithm>
 
+#include "base/timeutil.h"
 #include "profiler/profiler.h"
 #include "Common/ColorConv.h"
 #include "Core/Config.h"
+#include "Core/System.h"
 #include "GPU/Common/DrawEngineCommon.h"
 #include "GPU/Common/SplineCommon.h"
 #include "GPU/Common/VertexDecoderCommon.h"
@@ -506,6 +508,7 @@ bool DrawEngineCommon::ApplyShaderBlending() {
 
 void DrawEngineCommon::DecodeVertsStep(u8 *dest, int &i, int &decodedVerts) {
 	PROFILE_THIS_SCOPE("vertdec");
+	const double start = coreCollectDebugStats ? real_time_now() : 0.0;
 
 	const DeferredDrawCall &dc = drawCalls[i];
 
@@ -591,6 +594,10 @@ void DrawEngineCommon::DecodeVertsStep(u8 *dest, int &i, int &decodedVerts) {
 		indexGen.Advance(vertexCount);
 		i = lastMatch;
 	}
+
+	if (coreCollectDebugStats) {
+		gpuStats.msDecodingVertices += real_time_now() - start;
+	}
 }
 
 inline u32 ComputeMiniHashRange(const void *ptr, size_t sz) {
@@ -16,10 +16,22 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include <cstring>
+#include "ppsspp_config.h"
 #include "IndexGenerator.h"
 
 #include "Common/Common.h"
 
+#if defined(_M_SSE)
+#include <emmintrin.h>
+#endif
+#if PPSSPP_ARCH(ARM_NEON)
+#if defined(_MSC_VER) && PPSSPP_ARCH(ARM64)
+#include <arm64_neon.h>
+#else
+#include <arm_neon.h>
+#endif
+#endif
+
 // Points don't need indexing...
 const u8 IndexGenerator::indexedPrimitiveType[7] = {
 	GE_PRIM_POINTS,
@@ -31,6 +43,163 @@ const u8 IndexGenerator::indexedPrimitiveType[7] = {
 	GE_PRIM_RECTANGLES,
 };
 
+// Triangle patterns for 8 triangles at a time, as offsets from the first index, and what each
+// block of 8 triangles adds to them.  Indices wrap at 16 bits, same as the scalar code.
+alignas(16) static const u16 stripCW[24] = {
+	0, 1, 2, 1, 3, 2, 2, 3, 4, 3, 5, 4, 4, 5, 6, 5, 7, 6, 6, 7, 8, 7, 9, 8,
+};
+alignas(16) static const u16 stripCCW[24] = {
+	0, 2, 1, 1, 2, 3, 2, 4, 3, 3, 4, 5, 4, 6, 5, 5, 6, 7, 6, 8, 7, 7, 8, 9,
+};
+alignas(16) static const u16 stripStep[24] = {
+	8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
+};
+alignas(16) static const u16 fanCW[24] = {
+	0, 1, 2, 0, 2, 3, 0, 3, 4, 0, 4, 5, 0, 5, 6, 0, 6, 7, 0, 7, 8, 0, 8, 9,
+};
+alignas(16) static const u16 fanCCW[24] = {
+	0, 2, 1, 0, 3, 2, 0, 4, 3, 0, 5, 4, 0, 6, 5, 0, 7, 6, 0, 8, 7, 0, 9, 8,
+};
+alignas(16) static const u16 fanStep[24] = {
+	0, 8, 8, 0, 8, 8, 0, 8, 8, 0, 8, 8, 0, 8, 8, 0, 8, 8, 0, 8, 8, 0, 8, 8,
+};
+alignas(16) static const u16 listCCW[24] = {
+	0, 2, 1, 3, 5, 4, 6, 8, 7, 9, 11, 10, 12, 14, 13, 15, 17, 16, 18, 20, 19, 21, 23, 22,
+};
+alignas(16) static const u16 listStep[24] = {
+	24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24,
+};
+alignas(16) static const u16 sequential[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+
+// Writes start, start + 1, ... for count indices.
+static inline void GenerateSequential(u16 *outInds, u16 start, int count) {
+	int i = 0;
+#if defined(_M_SSE)
+	__m128i ind = _mm_add_epi16(_mm_set1_epi16(start), _mm_load_si128((const __m128i *)sequential));
+	const __m128i step = _mm_set1_epi16(8);
+	for (; i + 8 <= count; i += 8) {
+		_mm_storeu_si128((__m128i *)(outInds + i), ind);
+		ind = _mm_add_epi16(ind, step);
+	}
+#elif PPSSPP_ARCH(ARM_NEON)
+	uint16x8_t ind = vaddq_u16(vdupq_n_u16(start), vld1q_u16(sequential));
+	const uint16x8_t step = vdupq_n_u16(8);
+	for (; i + 8 <= count; i += 8) {
+		vst1q_u16(outInds + i, ind);
+		ind = vaddq_u16(ind, step);
+	}
+#endif
+	for (; i < count; i++)
+		outInds[i] = start + i;
+}
+
+// Writes whole blocks of 8 triangles from a pattern, and returns how many triangles that was.
+// The rest are left for the scalar loop.
+static inline int GeneratePattern(u16 *outInds, u16 start, int numTris, const u16 *pattern, const u16 *step) {
+	int i = 0;
+#if defined(_M_SSE)
+	const __m128i base = _mm_set1_epi16(start);
+	__m128i a = _mm_add_epi16(base, _mm_load_si128((const __m128i *)pattern));
+	__m128i b = _mm_add_epi16(base, _mm_load_si128((const __m128i *)(pattern + 8)));
+	__m128i c = _mm_add_epi16(base, _mm_load_si128((const __m128i *)(pattern + 16)));
+	const __m128i stepA = _mm_load_si128((const __m128i *)step);
+	const __m128i stepB = _mm_load_si128((const __m128i *)(step + 8));
+	const __m128i stepC = _mm_load_si128((const __m128i *)(step + 16));
+	for (; i + 8 <= numTris; i += 8) {
+		_mm_storeu_si128((__m128i *)outInds, a);
+		_mm_storeu_si128((__m128i *)(outInds + 8), b);
+		_mm_storeu_si128((__m128i *)(outInds + 16), c);
+		a = _mm_add_epi16(a, stepA);
+		b = _mm_add_epi16(b, stepB);
+		c = _mm_add_epi16(c, stepC);
+		outInds += 24;
+	}
+#elif PPSSPP_ARCH(ARM_NEON)
+	const uint16x8_t base = vdupq_n_u16(start);
+	uint16x8_t a = vaddq_u16(base, vld1q_u16(pattern));
+	uint16x8_t b = vaddq_u16(base, vld1q_u16(pattern + 8));
+	uint16x8_t c = vaddq_u16(base, vld1q_u16(pattern + 16));
+	const uint16x8_t stepA = vld1q_u16(step);
+	const uint16x8_t stepB = vld1q_u16(step + 8);
+	const uint16x8_t stepC = vld1q_u16(step + 16);
+	for (; i + 8 <= numTris; i += 8) {
+		vst1q_u16(outInds, a);
+		vst1q_u16(outInds + 8, b);
+		vst1q_u16(outInds + 16, c);
+		a = vaddq_u16(a, stepA);
+		b = vaddq_u16(b, stepB);
+		c = vaddq_u16(c, stepC);
+		outInds += 24;
+	}
+#endif
+	return i;
+}
+
+// Writes offset + inds[i] for count indices, wrapping to 16 bits.
+static inline void TranslateSequential(u16 *outInds, const u8 *inds, u16 offset, int count) {
+	int i = 0;
+#if defined(_M_SSE)
+	const __m128i off = _mm_set1_epi16(offset);
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 16 <= count; i += 16) {
+		const __m128i in = _mm_loadu_si128((const __m128i *)(inds + i));
+		_mm_storeu_si128((__m128i *)(outInds + i), _mm_add_epi16(off, _mm_unpacklo_epi8(in, zero)));
+		_mm_storeu_si128((__m128i *)(outInds + i + 8), _mm_add_epi16(off, _mm_unpackhi_epi8(in, zero)));
+	}
+#elif PPSSPP_ARCH(ARM_NEON)
+	const uint16x8_t off = vdupq_n_u16(offset);
+	for (; i + 16 <= count; i += 16) {
+		const uint8x16_t in = vld1q_u8(inds + i);
+		vst1q_u16(outInds + i, vaddw_u8(off, vget_low_u8(in)));
+		vst1q_u16(outInds + i + 8, vaddw_u8(off, vget_high_u8(in)));
+	}
+#endif
+	for (; i < count; i++)
+		outInds[i] = offset + inds[i];
+}
+
+static inline void TranslateSequential(u16 *outInds, const u16_le *inds, u16 offset, int count) {
+	int i = 0;
+#if defined(_M_SSE)
+	const __m128i off = _mm_set1_epi16(offset);
+	for (; i + 8 <= count; i += 8) {
+		const __m128i in = _mm_loadu_si128((const __m128i *)(inds + i));
+		_mm_storeu_si128((__m128i *)(outInds + i), _mm_add_epi16(off, in));
+	}
+#elif PPSSPP_ARCH(ARM_NEON)
+	const uint16x8_t off = vdupq_n_u16(offset);
+	for (; i + 8 <= count; i += 8) {
+		vst1q_u16(outInds + i, vaddq_u16(off, vld1q_u16((const u16 *)(inds + i))));
+	}
+#endif
+	for (; i < count; i++)
+		outInds[i] = offset + inds[i];
+}
+
+static inline void TranslateSequential(u16 *outInds, const u32_le *inds, u16 offset, int count) {
+	int i = 0;
+#if defined(_M_SSE)
+	const __m128i off = _mm_set1_epi16(offset);
+	for (; i + 8 <= count; i += 8) {
+		// Only the low 16 bits matter.  Sign extending them first makes the saturating pack exact.
+		__m128i lo = _mm_loadu_si128((const __m128i *)(inds + i));
+		__m128i hi = _mm_loadu_si128((const __m128i *)(inds + i + 4));
+		lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+		hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+		_mm_storeu_si128((__m128i *)(outInds + i), _mm_add_epi16(off, _mm_packs_epi32(lo, hi)));
+	}
+#elif PPSSPP_ARCH(ARM_NEON)
+	const uint16x8_t off = vdupq_n_u16(offset);
+	for (; i + 8 <= count; i += 8) {
+		const uint16x4_t lo = vmovn_u32(vld1q_u32((const u32 *)(inds + i)));
+		const uint16x4_t hi = vmovn_u32(vld1q_u32((const u32 *)(inds + i + 4)));
+		vst1q_u16(outInds + i, vaddq_u16(off, vcombine_u16(lo, hi)));
+	}
+#endif
+	for (; i < count; i++)
+		outInds[i] = offset + inds[i];
+}
+
 void IndexGenerator::Setup(u16 *inds) {
 	this->indsBase_ = inds;
 	Reset();
@@ -49,11 +218,10 @@ void IndexGenerator::AddPrim(int prim, int vertexCount, bool clockwise) {
 }
 
 void IndexGenerator::AddPoints(int numVerts) {
-	u16 *outInds = inds_;
-	const int startIndex = index_;
-	for (int i = 0; i < numVerts; i++)
-		*outInds++ = startIndex + i;
-	inds_ = outInds;
+	if (numVerts > 0) {
+		GenerateSequential(inds_, index_, numVerts);
+		inds_ += numVerts;
+	}
 	// ignore overflow verts
 	index_ += numVerts;
 	count_ += numVerts;
@@ -64,12 +232,21 @@ void IndexGenerator::AddPoints(int numVerts) {
 void IndexGenerator::AddList(int numVerts, bool clockwise) {
 	u16 *outInds = inds_;
 	const int startIndex = index_;
-	const int v1 = clockwise ? 1 : 2;
-	const int v2 = clockwise ? 2 : 1;
-	for (int i = 0; i < numVerts; i += 3) {
-		*outInds++ = startIndex + i;
-		*outInds++ = startIndex + i + v1;
-		*outInds++ = startIndex + i + v2;
+	// A partial triangle at the end still gets all three indices.
+	const int numTris = (numVerts + 2) / 3;
+	if (clockwise) {
+		if (numTris > 0) {
+			GenerateSequential(outInds, startIndex, numTris * 3);
+			outInds += numTris * 3;
+		}
+	} else {
+		const int done = GeneratePattern(outInds, startIndex, numTris, listCCW, listStep);
+		outInds += done * 3;
+		for (int i = done * 3; i < numVerts; i += 3) {
+			*outInds++ = startIndex + i;
+			*outInds++ = startIndex + i + 2;
+			*outInds++ = startIndex + i + 1;
+		}
 	}
 	inds_ = outInds;
 	// ignore overflow verts
@@ -88,7 +265,11 @@ void IndexGenerator::AddStrip(int numVerts, bool clockwise) {
 	const int numTris = numVerts - 2;
 	u16 *outInds = inds_;
 	int ibase = index_;
-	for (int i = 0; i < numTris; i++) {
+	// Blocks of 8 triangles keep the winding, so the rest just continues from there.
+	const int done = GeneratePattern(outInds, ibase, numTris, clockwise ? stripCW : stripCCW, stripStep);
+	outInds += done * 3;
+	ibase += done;
+	for (int i = done; i < numTris; i++) {
 		*outInds++ = ibase;
 		*outInds++ = ibase + wind;
 		wind ^= 3;  // toggle between 1 and 2
@@ -117,7 +298,9 @@ void IndexGenerator::AddFan(int numVerts, bool clockwise) {
 	const int startIndex = index_;
 	const int v1 = clockwise ? 1 : 2;
 	const int v2 = clockwise ? 2 : 1;
-	for (int i = 0; i < numTris; i++) {
+	const int done = GeneratePattern(outInds, startIndex, numTris, clockwise ? fanCW : fanCCW, fanStep);
+	outInds += done * 3;
+	for (int i = done; i < numTris; i++) {
 		*outInds++ = startIndex;
 		*outInds++ = startIndex + i + v1;
 		*outInds++ = startIndex + i + v2;
@@ -135,13 +318,12 @@ void IndexGenerator::AddFan(int numVerts, bool clockwise) {
 
 //Lines
 void IndexGenerator::AddLineList(int numVerts) {
-	u16 *outInds = inds_;
-	const int startIndex = index_;
-	for (int i = 0; i < numVerts; i += 2) {
-		*outInds++ = startIndex + i;
-		*outInds++ = startIndex + i + 1;
+	// A partial line at the end still gets both indices.
+	const int numInds = (numVerts + 1) & ~1;
+	if (numInds > 0) {
+		GenerateSequential(inds_, index_, numInds);
+		inds_ += numInds;
 	}
-	inds_ = outInds;
 	index_ += numVerts;
 	count_ += numVerts;
 	prim_ = GE_PRIM_LINES;
@@ -164,15 +346,12 @@ void IndexGenerator::AddLineStrip(int numVerts) {
 }
 
 void IndexGenerator::AddRectangles(int numVerts) {
-	u16 *outInds = inds_;
-	const int startIndex = index_;
 	//rectangles always need 2 vertices, disregard the last one if there's an odd number
 	numVerts = numVerts & ~1;
-	for (int i = 0; i < numVerts; i += 2) {
-		*outInds++ = startIndex + i;
-		*outInds++ = startIndex + i + 1;
+	if (numVerts > 0) {
+		GenerateSequential(inds_, index_, numVerts);
+		inds_ += numVerts;
 	}
-	inds_ = outInds;
 	index_ += numVerts;
 	count_ += numVerts;
 	prim_ = GE_PRIM_RECTANGLES;
@@ -182,10 +361,10 @@ void IndexGenerator::AddRectangles(int numVerts) {
 template <class ITypeLE, int flag>
 void IndexGenerator::TranslatePoints(int numInds, const ITypeLE *inds, int indexOffset) {
 	indexOffset = index_ - indexOffset;
-	u16 *outInds = inds_;
-	for (int i = 0; i < numInds; i++)
-		*outInds++ = indexOffset + inds[i];
-	inds_ = outInds;
+	if (numInds > 0) {
+		TranslateSequential(inds_, inds, indexOffset, numInds);
+		inds_ += numInds;
+	}
 	count_ += numInds;
 	prim_ = GE_PRIM_POINTS;
 	seenPrims_ |= (1 << GE_PRIM_POINTS) | flag;
@@ -194,13 +373,11 @@ void IndexGenerator::TranslatePoints(int numInds, const ITypeLE *inds, int index
 template <class ITypeLE, int flag>
 void IndexGenerator::TranslateLineList(int numInds, const ITypeLE *inds, int indexOffset) {
 	indexOffset = index_ - indexOffset;
-	u16 *outInds = inds_;
 	numInds = numInds & ~1;
-	for (int i = 0; i < numInds; i += 2) {
-		*outInds++ = indexOffset + inds[i];
-		*outInds++ = indexOffset + inds[i + 1];
+	if (numInds > 0) {
+		TranslateSequential(inds_, inds, indexOffset, numInds);
+		inds_ += numInds;
 	}
-	inds_ = outInds;
 	count_ += numInds;
 	prim_ = GE_PRIM_LINES;
 	seenPrims_ |= (1 << GE_PRIM_LINES) | flag;
@@ -230,6 +407,14 @@ void IndexGenerator::TranslateList(int numInds, const ITypeLE *inds, int indexOf
 		memcpy(inds_, inds, numInds * sizeof(ITypeLE));
 		inds_ += numInds;
 		count_ += numInds;
+	} else if (clockwise) {
+		int numTris = numInds / 3;  // Round to whole triangles
+		numInds = numTris * 3;
+		if (numInds > 0) {
+			TranslateSequential(inds_, inds, indexOffset, numInds);
+			inds_ += numInds;
+		}
+		count_ += numInds;
 	} else {
 		u16 *outInds = inds_;
 		int numTris = numInds / 3;  // Round to whole triangles
@@ -288,14 +473,12 @@ void IndexGenerator::TranslateFan(int numInds, const ITypeLE *inds, int indexOff
 template <class ITypeLE, int flag>
 inline void IndexGenerator::TranslateRectangles(int numInds, const ITypeLE *inds, int indexOffset) {
 	indexOffset = index_ - indexOffset;
-	u16 *outInds = inds_;
 	//rectangles always need 2 vertices, disregard the last one if there's an odd number
 	numInds = numInds & ~1;
-	for (int i = 0; i < numInds; i += 2) {
-		*outInds++ = indexOffset + inds[i];
-		*outInds++ = indexOffset + inds[i+1];
+	if (numInds > 0) {
+		TranslateSequential(inds_, inds, indexOffset, numInds);
+		inds_ += numInds;
 	}
-	inds_ = outInds;
 	count_ += numInds;
 	prim_ = GE_PRIM_RECTANGLES;
 	seenPrims_ |= (1 << GE_PRIM_RECTANGLES) | flag;
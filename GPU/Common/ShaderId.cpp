@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <string>
 #include <sstream>
 
@@ -11,6 +12,86 @@
 #include "GPU/Common/ShaderId.h"
 #include "GPU/Common/VertexDecoderCommon.h"
 
+// The registers each shader ID is computed from, masked down to the bits that it reads.  Plenty of
+// writes that dirty the shader state only touch other bits (the clear mode's channel enables, the
+// texture mode, the color write mask), and those don't need the IDs or pipelines looked up again.
+struct ShaderIDDependency {
+	GECommand cmd;
+	u32 mask;
+};
+
+static const ShaderIDDependency vertexShaderDeps[] = {
+	{ GE_CMD_CLEARMODE, 0x1 },
+	{ GE_CMD_VERTEXTYPE, GE_VTYPE_COL_MASK | GE_VTYPE_TC_MASK | GE_VTYPE_NRM_MASK },
+	{ GE_CMD_TEXTUREMAPENABLE, 0x1 },
+	{ GE_CMD_TEXMAPMODE, 0x303 },
+	{ GE_CMD_TEXSHADELS, 0x303 },
+	{ GE_CMD_SHADEMODE, 0x1 },
+	{ GE_CMD_FOGENABLE, 0x1 },
+	{ GE_CMD_LIGHTMODE, 0x1 },
+	{ GE_CMD_LIGHTINGENABLE, 0x1 },
+	{ GE_CMD_LIGHTENABLE0, 0x1 },
+	{ GE_CMD_LIGHTENABLE1, 0x1 },
+	{ GE_CMD_LIGHTENABLE2, 0x1 },
+	{ GE_CMD_LIGHTENABLE3, 0x1 },
+	{ GE_CMD_LIGHTTYPE0, 0x303 },
+	{ GE_CMD_LIGHTTYPE1, 0x303 },
+	{ GE_CMD_LIGHTTYPE2, 0x303 },
+	{ GE_CMD_LIGHTTYPE3, 0x303 },
+	{ GE_CMD_MATERIALUPDATE, 0x7 },
+	{ GE_CMD_REVERSENORMAL, 0x1 },
+	{ GE_CMD_PATCHFACING, 0x1 },
+};
+
+static const ShaderIDDependency fragmentShaderDeps[] = {
+	{ GE_CMD_CLEARMODE, 0x1 },
+	{ GE_CMD_VERTEXTYPE, GE_VTYPE_THROUGH_MASK },
+	{ GE_CMD_TEXTUREMAPENABLE, 0x1 },
+	{ GE_CMD_TEXMAPMODE, 0x3 },
+	{ GE_CMD_TEXFUNC, 0x10107 },
+	{ GE_CMD_TEXWRAP, 0x101 },
+	{ GE_CMD_SHADEMODE, 0x1 },
+	{ GE_CMD_FOGENABLE, 0x1 },
+	{ GE_CMD_LIGHTMODE, 0x1 },
+	{ GE_CMD_LIGHTINGENABLE, 0x1 },
+	{ GE_CMD_ALPHATESTENABLE, 0x1 },
+	{ GE_CMD_ALPHATEST, 0xFFFF07 },
+	{ GE_CMD_COLORTESTENABLE, 0x1 },
+	{ GE_CMD_COLORTEST, 0x3 },
+	{ GE_CMD_COLORREF, 0xFFFFFF },
+	{ GE_CMD_COLORTESTMASK, 0xFFFFFF },
+	{ GE_CMD_FRAMEBUFPIXFORMAT, 0x3 },
+	{ GE_CMD_ALPHABLENDENABLE, 0x1 },
+	{ GE_CMD_BLENDMODE, 0xFFFFFF },
+	{ GE_CMD_BLENDFIXEDA, 0xFFFFFF },
+	{ GE_CMD_BLENDFIXEDB, 0xFFFFFF },
+	{ GE_CMD_LOGICOPENABLE, 0x1 },
+	{ GE_CMD_LOGICOP, 0xF },
+	{ GE_CMD_STENCILTESTENABLE, 0x1 },
+	{ GE_CMD_STENCILTEST, 0xFF00 },
+	{ GE_CMD_STENCILOP, 0xFFFFFF },
+	{ GE_CMD_MASKALPHA, 0xFF },
+	{ GE_CMD_ZTESTENABLE, 0x1 },
+	{ GE_CMD_ZWRITEDISABLE, 0x1 },
+};
+
+template <size_t N>
+static u32 FindDependencyMask(const ShaderIDDependency (&deps)[N], u8 cmd) {
+	for (size_t i = 0; i < N; ++i) {
+		if (deps[i].cmd == cmd)
+			return deps[i].mask;
+	}
+	return 0;
+}
+
+u32 VertexShaderIDDependencyMask(u8 cmd) {
+	return FindDependencyMask(vertexShaderDeps, cmd);
+}
+
+u32 FragmentShaderIDDependencyMask(u8 cmd) {
+	return FindDependencyMask(fragmentShaderDeps, cmd);
+}
+
 std::string VertexShaderDesc(const VShaderID &id) {
 	std::stringstream desc;
 	desc << StringFromFormat("%08x:%08x ", id.d[1], id.d[0]);
@@ -319,3 +400,76 @@ void ComputeFragmentShaderID(FShaderID *id_out, const Draw::Bugs &bugs) {
 
 	*id_out = id;
 }
+
+#define HISTORY_HEADER_MAGIC 0x44495348
+#define HISTORY_VERSION 1
+struct ShaderIDHistoryHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t featureFlags;
+	uint32_t reserved;
+	int numVertexShaders;
+	int numFragmentShaders;
+};
+
+void ShaderIDHistory::Add(const VShaderID &id) {
+	if (std::find(vs_.begin(), vs_.end(), id) == vs_.end()) {
+		vs_.push_back(id);
+		dirty_ = true;
+	}
+}
+
+void ShaderIDHistory::Add(const FShaderID &id) {
+	if (std::find(fs_.begin(), fs_.end(), id) == fs_.end()) {
+		fs_.push_back(id);
+		dirty_ = true;
+	}
+}
+
+void ShaderIDHistory::Clear() {
+	vs_.clear();
+	fs_.clear();
+	dirty_ = false;
+}
+
+bool ShaderIDHistory::Load(FILE *f) {
+	Clear();
+
+	ShaderIDHistoryHeader header{};
+	if (fread(&header, sizeof(header), 1, f) != 1 || header.magic != HISTORY_HEADER_MAGIC)
+		return false;
+	if (header.version != HISTORY_VERSION || header.featureFlags != gstate_c.featureFlags)
+		return false;
+	// Sanity check the counts, in case of corruption.
+	if (header.numVertexShaders < 0 || header.numVertexShaders > 4096 || header.numFragmentShaders < 0 || header.numFragmentShaders > 4096)
+		return false;
+
+	vs_.resize(header.numVertexShaders);
+	fs_.resize(header.numFragmentShaders);
+	bool success = vs_.empty() || fread(&vs_[0], sizeof(VShaderID), vs_.size(), f) == vs_.size();
+	success = success && (fs_.empty() || fread(&fs_[0], sizeof(FShaderID), fs_.size(), f) == fs_.size());
+	for (const VShaderID &id : vs_) {
+		if (id.Bit(VS_BIT_IS_THROUGH) && id.Bit(VS_BIT_USE_HW_TRANSFORM))
+			success = false;
+	}
+	if (!success) {
+		ERROR_LOG(G3D, "Corrupt shader ID history, ignoring");
+		Clear();
+	}
+	return success;
+}
+
+bool ShaderIDHistory::Save(FILE *f) {
+	ShaderIDHistoryHeader header{};
+	header.magic = HISTORY_HEADER_MAGIC;
+	header.version = HISTORY_VERSION;
+	header.featureFlags = gstate_c.featureFlags;
+	header.numVertexShaders = (int)vs_.size();
+	header.numFragmentShaders = (int)fs_.size();
+	bool success = fwrite(&header, sizeof(header), 1, f) == 1;
+	success = success && (vs_.empty() || fwrite(&vs_[0], sizeof(VShaderID), vs_.size(), f) == vs_.size());
+	success = success && (fs_.empty() || fwrite(&fs_[0], sizeof(FShaderID), fs_.size(), f) == fs_.size());
+	if (success)
+		dirty_ = false;
+	return success;
+}
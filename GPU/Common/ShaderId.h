@@ -1,8 +1,10 @@
 #pragma once
 
 #include <string>
+#include <cstdio>
 #include <cstring>
 #include <cstdint>
+#include <vector>
 #include "base/basictypes.h"
 
 // TODO: There will be additional bits, indicating that groups of these will be
@@ -218,6 +220,40 @@ struct FShaderID : ShaderID {
 	}
 };
 
+// A few recently used shaders, checked before the shader manager's map. Comparing a handful of IDs
+// is cheaper than a map lookup, and draws tend to cycle between the same few shaders.
+template <class ID, class Shader>
+class ShaderLookaside {
+public:
+	Shader *Get(const ID &id) const {
+		for (int i = 0; i < SIZE; ++i) {
+			if (shaders_[i] && ids_[i] == id)
+				return shaders_[i];
+		}
+		return nullptr;
+	}
+
+	void Add(const ID &id, Shader *shader) {
+		ids_[next_] = id;
+		shaders_[next_] = shader;
+		next_ = (next_ + 1) % SIZE;
+	}
+
+	void Clear() {
+		for (int i = 0; i < SIZE; ++i) {
+			shaders_[i] = nullptr;
+		}
+		next_ = 0;
+	}
+
+private:
+	enum { SIZE = 4 };
+
+	ID ids_[SIZE];
+	Shader *shaders_[SIZE]{};
+	int next_ = 0;
+};
+
 namespace Draw {
 class Bugs;
 }
@@ -230,3 +266,31 @@ std::string VertexShaderDesc(const VShaderID &id);
 
 void ComputeFragmentShaderID(FShaderID *id, const Draw::Bugs &bugs);
 std::string FragmentShaderDesc(const FShaderID &id);
+
+// Bits of a register that the IDs above are computed from.  A write that doesn't change any of them
+// can't change the shaders, even if it's marked as dirtying them.
+u32 VertexShaderIDDependencyMask(u8 cmd);
+u32 FragmentShaderIDDependencyMask(u8 cmd);
+
+// The shader IDs a game has used, saved between runs so that a backend can generate and compile them
+// before the first draw that needs them.  The format is the same for every backend, but the IDs depend
+// on the supported features, so a file written with a different set is ignored.
+class ShaderIDHistory {
+public:
+	// Only called when a shader is created, so a linear search for duplicates is fine.
+	void Add(const VShaderID &id);
+	void Add(const FShaderID &id);
+	void Clear();
+
+	bool Load(FILE *f);
+	bool Save(FILE *f);
+
+	const std::vector<VShaderID> &VertexShaders() const { return vs_; }
+	const std::vector<FShaderID> &FragmentShaders() const { return fs_; }
+	bool IsDirty() const { return dirty_; }
+
+private:
+	std::vector<VShaderID> vs_;
+	std::vector<FShaderID> fs_;
+	bool dirty_ = false;
+};
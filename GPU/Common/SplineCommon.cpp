@@ -25,7 +25,9 @@
 #include "GPU/Common/GPUStateUtils.h"
 #include "GPU/Common/SplineCommon.h"
 #include "GPU/Common/DrawEngineCommon.h"
+#include "GPU/Common/TextureDecoder.h"  // for ReliableHash
 #include "GPU/ge_constants.h"
+#include "GPU/GPU.h"
 #include "GPU/GPUState.h"  // only needed for UVScale stuff
 
 bool CanUseHardwareTessellation(GEPatchPrimType prim) {
@@ -322,8 +324,65 @@ class Tessellator {
 
 		return Sample(u, weights);
 	}
+
+#ifdef _M_SSE
+	// Samples four points along V at once, one per lane.  weights[i] holds the weight of u[i] for each
+	// of the four points, and out gets one register per component.  Same order of operations as Sample().
+	template<int N>
+	void SampleV4(const __m128 weights[4], __m128 out[N]) const {
+		for (int c = 0; c < N; ++c) {
+			__m128 sum = _mm_mul_ps(_mm_set1_ps(u[0].AsArray()[c]), weights[0]);
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(u[1].AsArray()[c]), weights[1]));
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(u[2].AsArray()[c]), weights[2]));
+			out[c] = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(u[3].AsArray()[c]), weights[3]));
+		}
+	}
+#endif
 };
 
+#ifdef _M_SSE
+static inline void LoadWeights4(const Weight *w, __m128 basis[4], __m128 deriv[4]) {
+	basis[0] = _mm_loadu_ps(w[0].basis);
+	basis[1] = _mm_loadu_ps(w[1].basis);
+	basis[2] = _mm_loadu_ps(w[2].basis);
+	basis[3] = _mm_loadu_ps(w[3].basis);
+	_MM_TRANSPOSE4_PS(basis[0], basis[1], basis[2], basis[3]);
+	if (deriv) {
+		deriv[0] = _mm_loadu_ps(w[0].deriv);
+		deriv[1] = _mm_loadu_ps(w[1].deriv);
+		deriv[2] = _mm_loadu_ps(w[2].deriv);
+		deriv[3] = _mm_loadu_ps(w[3].deriv);
+		_MM_TRANSPOSE4_PS(deriv[0], deriv[1], deriv[2], deriv[3]);
+	}
+}
+
+// Cross(a, b).Normalized() for four vectors at once, using the same rsqrt estimate.
+static inline void CrossNormalize4(const __m128 a[3], const __m128 b[3], __m128 out[3]) {
+	const __m128 x = _mm_sub_ps(_mm_mul_ps(a[1], b[2]), _mm_mul_ps(a[2], b[1]));
+	const __m128 y = _mm_sub_ps(_mm_mul_ps(a[2], b[0]), _mm_mul_ps(a[0], b[2]));
+	const __m128 z = _mm_sub_ps(_mm_mul_ps(a[0], b[1]), _mm_mul_ps(a[1], b[0]));
+	const __m128 len2 = _mm_add_ps(_mm_mul_ps(z, z), _mm_add_ps(_mm_mul_ps(y, y), _mm_mul_ps(x, x)));
+	const __m128 scale = _mm_rsqrt_ps(len2);
+	out[0] = _mm_mul_ps(x, scale);
+	out[1] = _mm_mul_ps(y, scale);
+	out[2] = _mm_mul_ps(z, scale);
+}
+
+// Same as Vec4f::ToRGBA() for four colors, one component per register.
+static inline __m128i ColorsToRGBA4(const __m128 col[4]) {
+	const __m128 scale = _mm_set_ps1(255.0f);
+	const __m128i r = _mm_cvtps_epi32(_mm_mul_ps(col[0], scale));
+	const __m128i g = _mm_cvtps_epi32(_mm_mul_ps(col[1], scale));
+	const __m128i b = _mm_cvtps_epi32(_mm_mul_ps(col[2], scale));
+	const __m128i a = _mm_cvtps_epi32(_mm_mul_ps(col[3], scale));
+	const __m128i rb = _mm_packs_epi32(r, b);
+	const __m128i ga = _mm_packs_epi32(g, a);
+	const __m128i rg = _mm_unpacklo_epi16(rb, ga);
+	const __m128i ba = _mm_unpackhi_epi16(rb, ga);
+	return _mm_packus_epi16(_mm_unpacklo_epi32(rg, ba), _mm_unpackhi_epi32(rg, ba));
+}
+#endif
+
 ControlPoints::ControlPoints(const SimpleVertex *const *points, int size, SimpleBufferManager &managedBuf) {
 	pos = (Vec3f *)managedBuf.Allocate(sizeof(Vec3f) * size);
 	tex = (Vec2f *)managedBuf.Allocate(sizeof(Vec2f) * size);
@@ -374,7 +433,63 @@ class SubdivisionSurface {
 					if (sampleNrm)
 						tess_nrm.SampleU(wu.deriv);
 
-					for (int tile_v = start_v; tile_v <= surface.tess_v; ++tile_v) {
+					int tile_v = start_v;
+#ifdef _M_SSE
+					for (; tile_v + 3 <= surface.tess_v; tile_v += 4) {
+						const int index_v = surface.GetIndexV(patch_v, tile_v);
+						__m128 basis[4], deriv[4];
+						LoadWeights4(&weights.v[index_v], basis, sampleNrm ? deriv : nullptr);
+
+						alignas(16) float pos[3][4];
+						__m128 sampled[4];
+						tess_pos.SampleV4<3>(basis, sampled);
+						for (int c = 0; c < 3; ++c)
+							_mm_store_ps(pos[c], sampled[c]);
+
+						alignas(16) u32 col[4];
+						if (sampleCol) {
+							tess_col.SampleV4<4>(basis, sampled);
+							_mm_store_si128((__m128i *)col, ColorsToRGBA4(sampled));
+						}
+
+						alignas(16) float tex[2][4];
+						if (sampleTex) {
+							tess_tex.SampleV4<2>(basis, sampled);
+							_mm_store_ps(tex[0], sampled[0]);
+							_mm_store_ps(tex[1], sampled[1]);
+						}
+
+						alignas(16) float nrm[3][4];
+						if (sampleNrm) {
+							__m128 derivU[3], derivV[3];
+							tess_nrm.SampleV4<3>(basis, derivU);
+							tess_pos.SampleV4<3>(deriv, derivV);
+							CrossNormalize4(derivU, derivV, sampled);
+							for (int c = 0; c < 3; ++c)
+								_mm_store_ps(nrm[c], patchFacing ? _mm_mul_ps(sampled[c], _mm_set_ps1(-1.0f)) : sampled[c]);
+						}
+
+						for (int lane = 0; lane < 4; ++lane) {
+							SimpleVertex &vert = output.vertices[surface.GetIndex(index_u, index_v + lane, patch_u, patch_v)];
+							vert.pos = Vec3Packedf(pos[0][lane], pos[1][lane], pos[2][lane]);
+							vert.color_32 = sampleCol ? col[lane] : points.defcolor;
+							if (sampleTex) {
+								vert.uv[0] = tex[0][lane];
+								vert.uv[1] = tex[1][lane];
+							} else {
+								vert.uv[0] = patch_u + tile_u * inv_u;
+								vert.uv[1] = patch_v + (tile_v + lane) * inv_v;
+							}
+							if (sampleNrm) {
+								vert.nrm = Vec3Packedf(nrm[0][lane], nrm[1][lane], nrm[2][lane]);
+							} else {
+								vert.nrm.SetZero();
+								vert.nrm.z = 1.0f;
+							}
+						}
+					}
+#endif
+					for (; tile_v <= surface.tess_v; ++tile_v) {
 						const int index_v = surface.GetIndexV(patch_v, tile_v);
 						const Weight &wv = weights.v[index_v];
 
@@ -441,6 +556,132 @@ void SoftwareTessellation(OutputBuffers &output, const Surface &surface, u32 ori
 	SubdivisionSurface<Surface>::Tessellate(output, surface, points, weights, origVertType);
 }
 
+// Games tend to draw the same static patches every frame, so keep the tessellated vertices around
+// and skip tessellation when the control points and surface parameters are the same as last time.
+class TessellationCache {
+public:
+	struct Key {
+		ReliableHashType pointsHash;
+		u32 vertType;
+		int tess_u, tess_v;
+		int num_points_u, num_points_v;
+		int type_u, type_v;
+		int primType;
+		bool patchFacing;
+		bool sampleNrm;
+	};
+
+	~TessellationCache() {
+		Clear();
+	}
+
+	template<class Surface>
+	static void MakeKey(Key &key, ReliableHashType pointsHash, const Surface &surface, u32 origVertType) {
+		memset(&key, 0, sizeof(key));
+		key.pointsHash = pointsHash;
+		key.vertType = origVertType & (GE_VTYPE_NRM_MASK | GE_VTYPE_COL_MASK | GE_VTYPE_TC_MASK);
+		key.tess_u = surface.tess_u;
+		key.tess_v = surface.tess_v;
+		key.num_points_u = surface.num_points_u;
+		key.num_points_v = surface.num_points_v;
+		key.type_u = surface.type_u;
+		key.type_v = surface.type_v;
+		key.primType = surface.primType;
+		key.patchFacing = surface.patchFacing;
+		key.sampleNrm = (origVertType & GE_VTYPE_NRM_MASK) != 0 || gstate.isLightingEnabled();
+	}
+
+	bool Lookup(const Key &key, OutputBuffers &output) {
+		Decimate();
+		auto it = entries_.find(HashKey(key));
+		if (it == entries_.end() || memcmp(&it->second.key, &key, sizeof(key)) != 0)
+			return false;
+
+		Entry &entry = it->second;
+		entry.lastFrame = gpuStats.numFlips;
+		memcpy(output.vertices, entry.vertices.data(), entry.vertices.size() * sizeof(SimpleVertex));
+		memcpy(output.indices, entry.indices.data(), entry.indices.size() * sizeof(u16));
+		output.count = (int)entry.indices.size();
+		return true;
+	}
+
+	void Store(const Key &key, const OutputBuffers &output, int numVertices) {
+		const size_t size = numVertices * sizeof(SimpleVertex) + output.count * sizeof(u16);
+		if (totalSize_ + size > MAX_TOTAL_SIZE)
+			return;
+
+		Entry &entry = entries_[HashKey(key)];
+		totalSize_ -= entry.Size();
+		entry.key = key;
+		entry.vertices.assign(output.vertices, output.vertices + numVertices);
+		entry.indices.assign(output.indices, output.indices + output.count);
+		entry.lastFrame = gpuStats.numFlips;
+		totalSize_ += entry.Size();
+	}
+
+	void Clear() {
+		entries_.clear();
+		totalSize_ = 0;
+	}
+
+private:
+	enum {
+		MAX_TOTAL_SIZE = 8 * 1024 * 1024,
+		KILL_AGE = 120,
+		DECIMATION_INTERVAL = 17,
+	};
+
+	struct Entry {
+		Key key;
+		std::vector<SimpleVertex> vertices;
+		std::vector<u16> indices;
+		int lastFrame;
+
+		size_t Size() const {
+			return vertices.size() * sizeof(SimpleVertex) + indices.size() * sizeof(u16);
+		}
+	};
+
+	static ReliableHashType HashKey(const Key &key) {
+		return DoReliableHash(&key, sizeof(key), 0x6CB2A9E5);
+	}
+
+	void Decimate() {
+		if (gpuStats.numFlips - lastDecimation_ < DECIMATION_INTERVAL && gpuStats.numFlips >= lastDecimation_)
+			return;
+		lastDecimation_ = gpuStats.numFlips;
+
+		const int threshold = gpuStats.numFlips - KILL_AGE;
+		for (auto it = entries_.begin(); it != entries_.end(); ) {
+			if (it->second.lastFrame < threshold) {
+				totalSize_ -= it->second.Size();
+				it = entries_.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+
+	std::unordered_map<ReliableHashType, Entry> entries_;
+	size_t totalSize_ = 0;
+	int lastDecimation_ = 0;
+};
+
+static TessellationCache tessellationCache;
+
+template<class Surface>
+static void CachedSoftwareTessellation(OutputBuffers &output, const Surface &surface, u32 origVertType, ReliableHashType pointsHash,
+	const SimpleVertex *const *points, int num_points, SimpleBufferManager &managedBuf) {
+	TessellationCache::Key key;
+	TessellationCache::MakeKey(key, pointsHash, surface, origVertType);
+	if (tessellationCache.Lookup(key, output))
+		return;
+
+	ControlPoints cpoints(points, num_points, managedBuf);
+	SoftwareTessellation(output, surface, origVertType, cpoints);
+	tessellationCache.Store(key, output, surface.GetNumVertices());
+}
+
 template<class Surface>
 static void HardwareTessellation(OutputBuffers &output, const Surface &surface, u32 origVertType,
 	const SimpleVertex *const *points, TessellationDataTransfer *tessDataTransfer) {
@@ -487,6 +728,7 @@ using namespace Spline;
 void DrawEngineCommon::ClearSplineBezierWeights() {
 	Bezier3DWeight::weightsCache.Clear();
 	Spline3DWeight::weightsCache.Clear();
+	tessellationCache.Clear();
 }
 
 // Specialize to make instance (to avoid link error).
@@ -558,8 +800,11 @@ void DrawEngineCommon::SubmitCurve(const void *control_points, const void *indic
 	if (CanUseHardwareTessellation(surface.primType)) {
 		HardwareTessellation(output, surface, origVertType, points, tessDataTransfer);
 	} else {
-		ControlPoints cpoints(points, num_points, managedBuf);
-		SoftwareTessellation(output, surface, origVertType, cpoints);
+		// The simplified points already have bones, morph and UV scale applied, so they and the indices are all that matter.
+		ReliableHashType pointsHash = DoReliableHash(simplified_control_points + index_lower_bound, sizeof(SimpleVertex) * (index_upper_bound - index_lower_bound + 1), 0x3A2F94C1);
+		if (indices)
+			pointsHash += DoReliableHash(indices, IndexSize(origVertType) * num_points, 0x955FD1CA);
+		CachedSoftwareTessellation(output, surface, origVertType, pointsHash, points, num_points, managedBuf);
 	}
 
 	u32 vertTypeWithIndex16 = (vertType & ~GE_VTYPE_IDX_MASK) | GE_VTYPE_IDX_16BIT;
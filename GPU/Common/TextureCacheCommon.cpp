@@ -17,6 +17,7 @@
 
 #include <algorithm>
 #include "ppsspp_config.h"
+#include "base/timeutil.h"
 #include "profiler/profiler.h"
 #include "Common/ColorConv.h"
 #include "Common/MemoryUtil.h"
@@ -25,6 +26,7 @@
 #include "Core/System.h"
 #include "GPU/Common/FramebufferCommon.h"
 #include "GPU/Common/TextureCacheCommon.h"
+#include "GPU/Common/TextureScalerCommon.h"
 #include "GPU/Common/TextureDecoder.h"
 #include "GPU/Common/ShaderId.h"
 #include "GPU/Common/GPUStateUtils.h"
@@ -439,7 +441,7 @@ void TextureCacheCommon::SetTexture(bool force) {
 		}
 
 		if (match && (entry->status & TexCacheEntry::STATUS_TO_SCALE) && standardScaleFactor_ != 1 && texelsScaledThisFrame_ < TEXCACHE_MAX_TEXELS_SCALED) {
-			if ((entry->status & TexCacheEntry::STATUS_CHANGE_FREQUENT) == 0) {
+			if ((entry->status & TexCacheEntry::STATUS_CHANGE_FREQUENT) == 0 && AsyncScaleReady(*entry)) {
 				// INFO_LOG(G3D, "Reloading texture to do the scaling we skipped..");
 				match = false;
 				reason = "scaling";
@@ -976,10 +978,54 @@ void TextureCacheCommon::NotifyConfigChanged() {
 	}
 
 	standardScaleFactor_ = scaleFactor;
+	Scaler().ClearAsync();
 
 	replacer_.NotifyConfigChanged();
 }
 
+static TextureScalerCommon::AsyncKey AsyncScaleKey(const TexCacheEntry &entry) {
+	// The scaled result only depends on the content, not where it lives.
+	TextureScalerCommon::AsyncKey key;
+	key.hash = (u64)entry.cluthash << 32 | entry.fullhash;
+	key.dim = entry.dim;
+	key.format = entry.format;
+	return key;
+}
+
+bool TextureCacheCommon::AsyncScaleReady(const TexCacheEntry &entry) {
+	if (!g_Config.bTexScalingAsync || IsFakeMipmapChange()) {
+		return true;
+	}
+	return Scaler().IsAsyncReady(AsyncScaleKey(entry));
+}
+
+void TextureCacheCommon::QueueAsyncScale(const TexCacheEntry &entry, int level, const void *pixels, int pitch, u32 fmt, int w, int h) {
+	if (!g_Config.bTexScalingAsync || level != 0 || IsFakeMipmapChange()) {
+		return;
+	}
+	// Only queue textures we wanted to scale, but skipped.  Frequently changing ones aren't worth it.
+	if ((entry.status & TexCacheEntry::STATUS_TO_SCALE) == 0 || (entry.status & TexCacheEntry::STATUS_CHANGE_FREQUENT) != 0) {
+		return;
+	}
+
+	int scaleFactor = standardScaleFactor_;
+	if (lowMemoryMode_) {
+		scaleFactor = scaleFactor > 4 ? 4 : (scaleFactor > 2 ? 2 : 1);
+	}
+	if (scaleFactor > 1) {
+		Scaler().QueueAsync(AsyncScaleKey(entry), (const u32 *)pixels, pitch, fmt, w, h, scaleFactor);
+	}
+}
+
+void TextureCacheCommon::ScaleTexture(const TexCacheEntry &entry, int level, u32 *out, u32 *src, u32 &dstFmt, int &w, int &h, int scaleFactor) {
+	if (g_Config.bTexScalingAsync && level == 0 && !IsFakeMipmapChange()) {
+		if (Scaler().CopyAsyncResult(AsyncScaleKey(entry), out, dstFmt, w, h, scaleFactor)) {
+			return;
+		}
+	}
+	Scaler().ScaleAlways(out, src, dstFmt, w, h, scaleFactor);
+}
+
 void TextureCacheCommon::NotifyVideoUpload(u32 addr, int size, int width, GEBufferFormat fmt) {
 	addr &= 0x3FFFFFFF;
 	videos_[addr] = gpuStats.numFlips;
@@ -1201,6 +1247,7 @@ void TextureCacheCommon::DecodeTextureLevel(u8 *out, int outPitch, GETextureForm
 	int w = gstate.getTextureWidth(level);
 	int h = gstate.getTextureHeight(level);
 	const u8 *texptr = Memory::GetPointer(texaddr);
+	const double start = coreCollectDebugStats ? real_time_now() : 0.0;
 
 	switch (format) {
 	case GE_TFMT_CLUT4:
@@ -1208,40 +1255,36 @@ void TextureCacheCommon::DecodeTextureLevel(u8 *out, int outPitch, GETextureForm
 		const bool mipmapShareClut = gstate.isClutSharedForMipmaps();
 		const int clutSharingOffset = mipmapShareClut ? 0 : level * 16;
 
-		if (swizzled) {
-			tmpTexBuf32_.resize(bufw * ((h + 7) & ~7));
-			UnswizzleFromMem(tmpTexBuf32_.data(), bufw / 2, texptr, bufw, h, 0);
-			texptr = (u8 *)tmpTexBuf32_.data();
-		}
-
 		switch (clutformat) {
 		case GE_CMODE_16BIT_BGR5650:
 		case GE_CMODE_16BIT_ABGR5551:
 		case GE_CMODE_16BIT_ABGR4444:
 		{
 			if (clutAlphaLinear_ && mipmapShareClut && !expandTo32bit) {
+				const u16 color = clutAlphaLinearColor_;
 				// Here, reverseColors means the CLUT is already reversed.
 				if (reverseColors) {
-					for (int y = 0; y < h; ++y) {
-						DeIndexTexture4Optimal((u16 *)(out + outPitch * y), texptr + (bufw * y) / 2, w, clutAlphaLinearColor_);
-					}
+					DeIndexTextureLevel<u16>(out, outPitch, texptr, bufw, w, h, 4, swizzled, [=](u16 *dest, const u8 *src, int length) {
+						DeIndexTexture4Optimal(dest, src, length, color);
+					});
 				} else {
-					for (int y = 0; y < h; ++y) {
-						DeIndexTexture4OptimalRev((u16 *)(out + outPitch * y), texptr + (bufw * y) / 2, w, clutAlphaLinearColor_);
-					}
+					DeIndexTextureLevel<u16>(out, outPitch, texptr, bufw, w, h, 4, swizzled, [=](u16 *dest, const u8 *src, int length) {
+						DeIndexTexture4OptimalRev(dest, src, length, color);
+					});
 				}
 			} else {
 				const u16 *clut = GetCurrentClut<u16>() + clutSharingOffset;
 				if (expandTo32bit && !reverseColors) {
 					// We simply expand the CLUT to 32-bit, then we deindex as usual. Probably the fastest way.
 					ConvertFormatToRGBA8888(clutformat, expandClut_, clut, 16);
-					for (int y = 0; y < h; ++y) {
-						DeIndexTexture4((u32 *)(out + outPitch * y), texptr + (bufw * y) / 2, w, expandClut_);
-					}
+					const u32 *clut32 = expandClut_;
+					DeIndexTextureLevel<u32>(out, outPitch, texptr, bufw, w, h, 4, swizzled, [=](u32 *dest, const u8 *src, int length) {
+						DeIndexTexture4(dest, src, length, clut32);
+					});
 				} else {
-					for (int y = 0; y < h; ++y) {
-						DeIndexTexture4((u16 *)(out + outPitch * y), texptr + (bufw * y) / 2, w, clut);
-					}
+					DeIndexTextureLevel<u16>(out, outPitch, texptr, bufw, w, h, 4, swizzled, [=](u16 *dest, const u8 *src, int length) {
+						DeIndexTexture4(dest, src, length, clut);
+					});
 				}
 			}
 		}
@@ -1250,9 +1293,9 @@ void TextureCacheCommon::DecodeTextureLevel(u8 *out, int outPitch, GETextureForm
 		case GE_CMODE_32BIT_ABGR8888:
 		{
 			const u32 *clut = GetCurrentClut<u32>() + clutSharingOffset;
-			for (int y = 0; y < h; ++y) {
-				DeIndexTexture4((u32 *)(out + outPitch * y), texptr + (bufw * y) / 2, w, clut);
-			}
+			DeIndexTextureLevel<u32>(out, outPitch, texptr, bufw, w, h, 4, swizzled, [=](u32 *dest, const u8 *src, int length) {
+				DeIndexTexture4(dest, src, length, clut);
+			});
 		}
 		break;
 
@@ -1357,19 +1400,10 @@ void TextureCacheCommon::DecodeTextureLevel(u8 *out, int outPitch, GETextureForm
 
 	case GE_TFMT_DXT1:
 	{
-		int minw = std::min(bufw, w);
 		u32 *dst = (u32 *)out;
 		int outPitch32 = outPitch / sizeof(u32);
-		DXT1Block *src = (DXT1Block*)texptr;
-
-		for (int y = 0; y < h; y += 4) {
-			u32 blockIndex = (y / 4) * (bufw / 4);
-			int blockHeight = std::min(h - y, 4);
-			for (int x = 0; x < minw; x += 4) {
-				DecodeDXT1Block(dst + outPitch32 * y + x, src + blockIndex, outPitch32, blockHeight, false);
-				blockIndex++;
-			}
-		}
+		const DXT1Block *src = (const DXT1Block *)texptr;
+		DecodeDXT1Level(dst, outPitch32, src, bufw, w, h, false);
 		w = (w + 3) & ~3;
 		if (reverseColors) {
 			ReverseColors(out, out, GE_TFMT_8888, outPitch32 * h, useBGRA);
@@ -1379,19 +1413,10 @@ void TextureCacheCommon::DecodeTextureLevel(u8 *out, int outPitch, GETextureForm
 
 	case GE_TFMT_DXT3:
 	{
-		int minw = std::min(bufw, w);
 		u32 *dst = (u32 *)out;
 		int outPitch32 = outPitch / sizeof(u32);
-		DXT3Block *src = (DXT3Block*)texptr;
-
-		for (int y = 0; y < h; y += 4) {
-			u32 blockIndex = (y / 4) * (bufw / 4);
-			int blockHeight = std::min(h - y, 4);
-			for (int x = 0; x < minw; x += 4) {
-				DecodeDXT3Block(dst + outPitch32 * y + x, src + blockIndex, outPitch32, blockHeight);
-				blockIndex++;
-			}
-		}
+		const DXT3Block *src = (const DXT3Block *)texptr;
+		DecodeDXT3Level(dst, outPitch32, src, bufw, w, h);
 		w = (w + 3) & ~3;
 		if (reverseColors) {
 			ReverseColors(out, out, GE_TFMT_8888, outPitch32 * h, useBGRA);
@@ -1401,19 +1426,10 @@ void TextureCacheCommon::DecodeTextureLevel(u8 *out, int outPitch, GETextureForm
 
 	case GE_TFMT_DXT5:
 	{
-		int minw = std::min(bufw, w);
 		u32 *dst = (u32 *)out;
 		int outPitch32 = outPitch / sizeof(u32);
-		DXT5Block *src = (DXT5Block*)texptr;
-
-		for (int y = 0; y < h; y += 4) {
-			u32 blockIndex = (y / 4) * (bufw / 4);
-			int blockHeight = std::min(h - y, 4);
-			for (int x = 0; x < minw; x += 4) {
-				DecodeDXT5Block(dst + outPitch32 * y + x, src + blockIndex, outPitch32, blockHeight);
-				blockIndex++;
-			}
-		}
+		const DXT5Block *src = (const DXT5Block *)texptr;
+		DecodeDXT5Level(dst, outPitch32, src, bufw, w, h);
 		w = (w + 3) & ~3;
 		if (reverseColors) {
 			ReverseColors(out, out, GE_TFMT_8888, outPitch32 * h, useBGRA);
@@ -1425,17 +1441,18 @@ void TextureCacheCommon::DecodeTextureLevel(u8 *out, int outPitch, GETextureForm
 		ERROR_LOG_REPORT(G3D, "Unknown Texture Format %d!!!", format);
 		break;
 	}
+
+	if (coreCollectDebugStats) {
+		gpuStats.msDecodingTextures += real_time_now() - start;
+	}
 }
 
 void TextureCacheCommon::ReadIndexedTex(u8 *out, int outPitch, int level, const u8 *texptr, int bytesPerIndex, int bufw, bool expandTo32Bit) {
 	int w = gstate.getTextureWidth(level);
 	int h = gstate.getTextureHeight(level);
-
-	if (gstate.isTextureSwizzled()) {
-		tmpTexBuf32_.resize(bufw * ((h + 7) & ~7));
-		UnswizzleFromMem(tmpTexBuf32_.data(), bufw * bytesPerIndex, texptr, bufw, h, bytesPerIndex);
-		texptr = (u8 *)tmpTexBuf32_.data();
-	}
+	// Swizzled indices are read directly from the blocks, so there's no temp unswizzle pass.
+	const bool swizzled = gstate.isTextureSwizzled();
+	const int bitsPerIndex = bytesPerIndex * 8;
 
 	int palFormat = gstate.getClutPaletteFormat();
 
@@ -1455,21 +1472,21 @@ void TextureCacheCommon::ReadIndexedTex(u8 *out, int outPitch, int level, const
 	{
 		switch (bytesPerIndex) {
 		case 1:
-			for (int y = 0; y < h; ++y) {
-				DeIndexTexture((u16 *)(out + outPitch * y), (const u8 *)texptr + bufw * y, w, clut16);
-			}
+			DeIndexTextureLevel<u16>(out, outPitch, texptr, bufw, w, h, bitsPerIndex, swizzled, [=](u16 *dest, const u8 *src, int length) {
+				DeIndexTexture(dest, src, length, clut16);
+			});
 			break;
 
 		case 2:
-			for (int y = 0; y < h; ++y) {
-				DeIndexTexture((u16 *)(out + outPitch * y), (const u16_le *)texptr + bufw * y, w, clut16);
-			}
+			DeIndexTextureLevel<u16>(out, outPitch, texptr, bufw, w, h, bitsPerIndex, swizzled, [=](u16 *dest, const u8 *src, int length) {
+				DeIndexTexture(dest, (const u16_le *)src, length, clut16);
+			});
 			break;
 
 		case 4:
-			for (int y = 0; y < h; ++y) {
-				DeIndexTexture((u16 *)(out + outPitch * y), (const u32_le *)texptr + bufw * y, w, clut16);
-			}
+			DeIndexTextureLevel<u16>(out, outPitch, texptr, bufw, w, h, bitsPerIndex, swizzled, [=](u16 *dest, const u8 *src, int length) {
+				DeIndexTexture(dest, (const u32_le *)src, length, clut16);
+			});
 			break;
 		}
 	}
@@ -1479,21 +1496,21 @@ void TextureCacheCommon::ReadIndexedTex(u8 *out, int outPitch, int level, const
 	{
 		switch (bytesPerIndex) {
 		case 1:
-			for (int y = 0; y < h; ++y) {
-				DeIndexTexture((u32 *)(out + outPitch * y), (const u8 *)texptr + bufw * y, w, clut32);
-			}
+			DeIndexTextureLevel<u32>(out, outPitch, texptr, bufw, w, h, bitsPerIndex, swizzled, [=](u32 *dest, const u8 *src, int length) {
+				DeIndexTexture(dest, src, length, clut32);
+			});
 			break;
 
 		case 2:
-			for (int y = 0; y < h; ++y) {
-				DeIndexTexture((u32 *)(out + outPitch * y), (const u16_le *)texptr + bufw * y, w, clut32);
-			}
+			DeIndexTextureLevel<u32>(out, outPitch, texptr, bufw, w, h, bitsPerIndex, swizzled, [=](u32 *dest, const u8 *src, int length) {
+				DeIndexTexture(dest, (const u16_le *)src, length, clut32);
+			});
 			break;
 
 		case 4:
-			for (int y = 0; y < h; ++y) {
-				DeIndexTexture((u32 *)(out + outPitch * y), (const u32_le *)texptr + bufw * y, w, clut32);
-			}
+			DeIndexTextureLevel<u32>(out, outPitch, texptr, bufw, w, h, bitsPerIndex, swizzled, [=](u32 *dest, const u8 *src, int length) {
+				DeIndexTexture(dest, (const u32_le *)src, length, clut32);
+			});
 			break;
 		}
 	}
@@ -1585,6 +1602,7 @@ void TextureCacheCommon::Clear(bool delete_them) {
 	}
 	fbTexInfo_.clear();
 	videos_.clear();
+	Scaler().ClearAsync();
 }
 
 void TextureCacheCommon::DeleteTexture(TexCache::iterator it) {
@@ -173,6 +173,7 @@ struct TexCacheEntry {
 };
 
 class FramebufferManagerCommon;
+class TextureScalerCommon;
 // Can't be unordered_map, we use lower_bound ... although for some reason that compiles on MSVC.
 // Would really like to replace this with DenseHashMap but can't as long as we need lower_bound.
 typedef std::map<u64, std::unique_ptr<TexCacheEntry>> TexCache;
@@ -223,6 +224,7 @@ class TextureCacheCommon {
 	void Decimate(bool forcePressure = false);
 
 	virtual void ApplyTextureFramebuffer(TexCacheEntry *entry, VirtualFramebuffer *framebuffer) = 0;
+	virtual TextureScalerCommon &Scaler() = 0;
 	void HandleTextureChange(TexCacheEntry *const entry, const char *reason, bool initialMatch, bool doDelete);
 	virtual void BuildTexture(TexCacheEntry *const entry) = 0;
 	virtual void UpdateCurrentClut(GEPaletteFormat clutFormat, u32 clutBase, bool clutIndexIsSimple) = 0;
@@ -243,6 +245,11 @@ class TextureCacheCommon {
 		return (const T *)clutBuf_;
 	}
 
+	// With async scaling, textures are used unscaled until the scaler thread has a result.
+	bool AsyncScaleReady(const TexCacheEntry &entry);
+	void QueueAsyncScale(const TexCacheEntry &entry, int level, const void *pixels, int pitch, u32 fmt, int w, int h);
+	void ScaleTexture(const TexCacheEntry &entry, int level, u32 *out, u32 *src, u32 &dstFmt, int &w, int &h, int scaleFactor);
+
 	u32 EstimateTexMemoryUsage(const TexCacheEntry *entry);
 	void GetSamplingParams(int &minFilt, int &magFilt, bool &sClamp, bool &tClamp, float &lodBias, int maxLevel, u32 addr, GETexLevelMode &mode);
 	void UpdateSamplingParams(TexCacheEntry &entry, SamplerCacheKey &key);  // Used by D3D11 and Vulkan.
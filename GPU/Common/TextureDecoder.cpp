@@ -29,6 +29,9 @@
 
 #ifdef _M_SSE
 #include <emmintrin.h>
+#if _M_SSE >= 0x301
+#include <tmmintrin.h>
+#endif
 #if _M_SSE >= 0x401
 #include <smmintrin.h>
 #endif
@@ -307,6 +310,142 @@ void DoUnswizzleTex16Basic(const u8 *texptr, u32 *ydestp, int bxc, int byc, u32
 	}
 }
 
+#if _M_SSE >= 0x301
+// Each 16 bytes of indices is 32 pixels.  Returns the number of pixels handled.
+static int DeIndexTexture4SimpleSSSE3(u16 *dest, const u8 *indexed, int length, const u16 *clut) {
+	const __m128i lowMask = _mm_set1_epi16(0x00FF);
+	const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+	// Split the palette into a table of low bytes and a table of high bytes.
+	const __m128i clut0 = _mm_loadu_si128((const __m128i *)clut);
+	const __m128i clut1 = _mm_loadu_si128((const __m128i *)clut + 1);
+	const __m128i lowTable = _mm_packus_epi16(_mm_and_si128(clut0, lowMask), _mm_and_si128(clut1, lowMask));
+	const __m128i highTable = _mm_packus_epi16(_mm_srli_epi16(clut0, 8), _mm_srli_epi16(clut1, 8));
+
+	int i = 0;
+	for (; i + 32 <= length; i += 32) {
+		const __m128i indices = _mm_loadu_si128((const __m128i *)(indexed + i / 2));
+		const __m128i lowNibbles = _mm_and_si128(indices, nibbleMask);
+		const __m128i highNibbles = _mm_and_si128(_mm_srli_epi16(indices, 4), nibbleMask);
+		// The low nibble is the first pixel of each pair.
+		const __m128i first = _mm_unpacklo_epi8(lowNibbles, highNibbles);
+		const __m128i second = _mm_unpackhi_epi8(lowNibbles, highNibbles);
+
+		__m128i lo = _mm_shuffle_epi8(lowTable, first);
+		__m128i hi = _mm_shuffle_epi8(highTable, first);
+		_mm_storeu_si128((__m128i *)(dest + i + 0), _mm_unpacklo_epi8(lo, hi));
+		_mm_storeu_si128((__m128i *)(dest + i + 8), _mm_unpackhi_epi8(lo, hi));
+		lo = _mm_shuffle_epi8(lowTable, second);
+		hi = _mm_shuffle_epi8(highTable, second);
+		_mm_storeu_si128((__m128i *)(dest + i + 16), _mm_unpacklo_epi8(lo, hi));
+		_mm_storeu_si128((__m128i *)(dest + i + 24), _mm_unpackhi_epi8(lo, hi));
+	}
+	return i;
+}
+
+static inline void DeIndexWrite16Pixels32SSSE3(u32 *dest, const __m128i &idx, const __m128i tables[4]) {
+	const __m128i b0 = _mm_shuffle_epi8(tables[0], idx);
+	const __m128i b1 = _mm_shuffle_epi8(tables[1], idx);
+	const __m128i b2 = _mm_shuffle_epi8(tables[2], idx);
+	const __m128i b3 = _mm_shuffle_epi8(tables[3], idx);
+	const __m128i b01lo = _mm_unpacklo_epi8(b0, b1);
+	const __m128i b01hi = _mm_unpackhi_epi8(b0, b1);
+	const __m128i b23lo = _mm_unpacklo_epi8(b2, b3);
+	const __m128i b23hi = _mm_unpackhi_epi8(b2, b3);
+	_mm_storeu_si128((__m128i *)(dest + 0), _mm_unpacklo_epi16(b01lo, b23lo));
+	_mm_storeu_si128((__m128i *)(dest + 4), _mm_unpackhi_epi16(b01lo, b23lo));
+	_mm_storeu_si128((__m128i *)(dest + 8), _mm_unpacklo_epi16(b01hi, b23hi));
+	_mm_storeu_si128((__m128i *)(dest + 12), _mm_unpackhi_epi16(b01hi, b23hi));
+}
+
+static int DeIndexTexture4SimpleSSSE3(u32 *dest, const u8 *indexed, int length, const u32 *clut) {
+	const __m128i byteMask = _mm_set1_epi32(0x000000FF);
+	const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+	// Split the palette into one table per byte of the color.
+	__m128i c[4];
+	for (int j = 0; j < 4; ++j) {
+		c[j] = _mm_loadu_si128((const __m128i *)clut + j);
+	}
+	__m128i tables[4];
+	for (int b = 0; b < 4; ++b) {
+		const __m128i w0 = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(c[0], b * 8), byteMask), _mm_and_si128(_mm_srli_epi32(c[1], b * 8), byteMask));
+		const __m128i w1 = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(c[2], b * 8), byteMask), _mm_and_si128(_mm_srli_epi32(c[3], b * 8), byteMask));
+		tables[b] = _mm_packus_epi16(w0, w1);
+	}
+
+	int i = 0;
+	for (; i + 32 <= length; i += 32) {
+		const __m128i indices = _mm_loadu_si128((const __m128i *)(indexed + i / 2));
+		const __m128i lowNibbles = _mm_and_si128(indices, nibbleMask);
+		const __m128i highNibbles = _mm_and_si128(_mm_srli_epi16(indices, 4), nibbleMask);
+		DeIndexWrite16Pixels32SSSE3(dest + i + 0, _mm_unpacklo_epi8(lowNibbles, highNibbles), tables);
+		DeIndexWrite16Pixels32SSSE3(dest + i + 16, _mm_unpackhi_epi8(lowNibbles, highNibbles), tables);
+	}
+	return i;
+}
+#endif
+
+template <typename ClutT>
+static inline void DeIndexTexture4SimpleBasic(ClutT *dest, const u8 *indexed, int length, const ClutT *clut) {
+	for (int i = 0; i < length; i += 2) {
+		u8 index = *indexed++;
+		dest[i + 0] = clut[(index >> 0) & 0xf];
+		dest[i + 1] = clut[(index >> 4) & 0xf];
+	}
+}
+
+template <typename ClutT>
+static inline void DeIndexTexture8SimpleBasic(ClutT *dest, const u8 *indexed, int length, const ClutT *clut) {
+	int i = 0;
+	for (; i + 4 <= length; i += 4) {
+		// Reading the indices as one word lets the compiler keep them in a register.
+		u32 indices;
+		memcpy(&indices, indexed + i, 4);
+		dest[i + 0] = clut[(indices >> 0) & 0xFF];
+		dest[i + 1] = clut[(indices >> 8) & 0xFF];
+		dest[i + 2] = clut[(indices >> 16) & 0xFF];
+		dest[i + 3] = clut[(indices >> 24) & 0xFF];
+	}
+	for (; i < length; ++i) {
+		dest[i] = clut[indexed[i]];
+	}
+}
+
+void DeIndexTexture4Simple(u16 *dest, const u8 *indexed, int length, const u16 *clut) {
+	int done = 0;
+#if _M_SSE >= 0x301
+	done = DeIndexTexture4SimpleSSSE3(dest, indexed, length, clut);
+#elif PPSSPP_ARCH(ARMV7) || PPSSPP_ARCH(ARM64)
+	if (cpu_info.bNEON) {
+		done = DeIndexTexture4SimpleNEON(dest, indexed, length, clut);
+	}
+#endif
+	if (done < length) {
+		DeIndexTexture4SimpleBasic(dest + done, indexed + done / 2, length - done, clut);
+	}
+}
+
+void DeIndexTexture4Simple(u32 *dest, const u8 *indexed, int length, const u32 *clut) {
+	int done = 0;
+#if _M_SSE >= 0x301
+	done = DeIndexTexture4SimpleSSSE3(dest, indexed, length, clut);
+#elif PPSSPP_ARCH(ARMV7) || PPSSPP_ARCH(ARM64)
+	if (cpu_info.bNEON) {
+		done = DeIndexTexture4SimpleNEON(dest, indexed, length, clut);
+	}
+#endif
+	if (done < length) {
+		DeIndexTexture4SimpleBasic(dest + done, indexed + done / 2, length - done, clut);
+	}
+}
+
+void DeIndexTexture8Simple(u16 *dest, const u8 *indexed, int length, const u16 *clut) {
+	DeIndexTexture8SimpleBasic(dest, indexed, length, clut);
+}
+
+void DeIndexTexture8Simple(u32 *dest, const u8 *indexed, int length, const u32 *clut) {
+	DeIndexTexture8SimpleBasic(dest, indexed, length, clut);
+}
+
 #if !PPSSPP_ARCH(ARM64) && !defined(_M_SSE)
 QuickTexHashFunc DoQuickTexHash = &QuickTexHashBasic;
 QuickTexHashFunc StableQuickTexHash = &QuickTexHashNonSSE;
@@ -339,6 +478,13 @@ class DXTDecoder {
 	inline void WriteColorsDXT3(u32 *dst, const DXT3Block *src, int pitch, int height);
 	inline void WriteColorsDXT5(u32 *dst, const DXT5Block *src, int pitch, int height);
 
+	void GetColors(u32 colors[4]) const {
+		memcpy(colors, colors_, sizeof(colors_));
+	}
+	void GetAlpha(u8 alpha[8]) const {
+		memcpy(alpha, alpha_, sizeof(alpha_));
+	}
+
 protected:
 	u32 colors_[4];
 	u8 alpha_[8];
@@ -352,7 +498,6 @@ static inline int mix_2_3(int c1, int c2) {
 	return (c1 + c1 + c2) / 3;
 }
 
-// This could probably be done faster by decoding two or four blocks at a time with SSE/NEON.
 void DXTDecoder::DecodeColors(const DXT1Block *src, bool ignore1bitAlpha) {
 	u16 c1 = src->color1;
 	u16 c2 = src->color2;
@@ -454,7 +599,7 @@ void DXTDecoder::WriteColorsDXT5(u32 *dst, const DXT5Block *src, int pitch, int
 	}
 }
 
-// This could probably be done faster by decoding two or four blocks at a time with SSE/NEON.
+// For whole textures, prefer DecodeDXT1Level() and friends, which have SIMD paths.
 void DecodeDXT1Block(u32 *dst, const DXT1Block *src, int pitch, int height, bool ignore1bitAlpha) {
 	DXTDecoder dxt;
 	dxt.DecodeColors(src, ignore1bitAlpha);
@@ -475,6 +620,213 @@ void DecodeDXT5Block(u32 *dst, const DXT5Block *src, int pitch, int height) {
 	dxt.WriteColorsDXT5(dst, src, pitch, height);
 }
 
+#ifdef _M_SSE
+static inline __m128i SelectSSE2(const __m128i &mask, const __m128i &a, const __m128i &b) {
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// Returns all four palette colors of the block, matching DXTDecoder::DecodeColors().
+static inline __m128i DecodeDXTColorsSSE2(const DXT1Block *src, bool ignore1bitAlpha) {
+	const u16 c1 = src->color1;
+	const u16 c2 = src->color2;
+	// Lanes are b, g, r, a for each endpoint, so that packing gives makecol() order.
+	const __m128i endpoints = _mm_setr_epi16(c1, c1, c1, 0, c2, c2, c2, 0);
+	// Red is shifted left, green and blue right.  The high half of a multiply shifts right.
+	const __m128i red = _mm_and_si128(_mm_mullo_epi16(endpoints, _mm_setr_epi16(0, 0, 8, 0, 0, 0, 8, 0)), _mm_setr_epi16(0, 0, 0xF8, 0, 0, 0, 0xF8, 0));
+	const __m128i greenBlue = _mm_and_si128(_mm_mulhi_epu16(endpoints, _mm_setr_epi16(256, 8192, 0, 0, 256, 8192, 0, 0)), _mm_setr_epi16(0xF8, 0xFC, 0, 0, 0xF8, 0xFC, 0, 0));
+	const int alpha = ignore1bitAlpha ? 0 : 255;
+	const __m128i colors = _mm_or_si128(_mm_or_si128(red, greenBlue), _mm_setr_epi16(0, 0, 0, alpha, 0, 0, 0, alpha));
+	const __m128i swapped = _mm_shuffle_epi32(colors, _MM_SHUFFLE(1, 0, 3, 2));
+
+	__m128i mixed;
+	if (c1 > c2) {
+		// (c1 + c1 + c2) / 3, using 0xAAAB / 2^17 as an exact 1/3 for these small values.
+		const __m128i sum = _mm_add_epi16(_mm_add_epi16(colors, colors), swapped);
+		mixed = _mm_srli_epi16(_mm_mulhi_epu16(sum, _mm_set1_epi16((short)0xAAAB)), 1);
+	} else {
+		// Average for the third color, and the fourth is transparent black.
+		mixed = _mm_srli_epi16(_mm_add_epi16(colors, swapped), 1);
+		mixed = _mm_and_si128(mixed, _mm_setr_epi32(-1, -1, 0, 0));
+	}
+	return _mm_unpacklo_epi64(_mm_packus_epi16(colors, colors), _mm_packus_epi16(mixed, mixed));
+}
+
+// Picks a color for each pixel by its 2-bit index, and ORs in alphaRows (16 values) if given.
+static inline void WriteDXTColorsSSE2(u32 *dst, const __m128i &colors, const u8 lines[4], const u32 *alphaRows, int pitch, int height) {
+	const __m128i color0 = _mm_shuffle_epi32(colors, _MM_SHUFFLE(0, 0, 0, 0));
+	const __m128i color1 = _mm_shuffle_epi32(colors, _MM_SHUFFLE(1, 1, 1, 1));
+	const __m128i color2 = _mm_shuffle_epi32(colors, _MM_SHUFFLE(2, 2, 2, 2));
+	const __m128i color3 = _mm_shuffle_epi32(colors, _MM_SHUFFLE(3, 3, 3, 3));
+	const __m128i bit0 = _mm_setr_epi32(1 << 0, 1 << 2, 1 << 4, 1 << 6);
+	const __m128i bit1 = _mm_setr_epi32(2 << 0, 2 << 2, 2 << 4, 2 << 6);
+
+	for (int y = 0; y < height; y++) {
+		const __m128i line = _mm_set1_epi32(lines[y]);
+		const __m128i low = _mm_cmpeq_epi32(_mm_and_si128(line, bit0), bit0);
+		const __m128i high = _mm_cmpeq_epi32(_mm_and_si128(line, bit1), bit1);
+		__m128i result = SelectSSE2(high, SelectSSE2(low, color3, color2), SelectSSE2(low, color1, color0));
+		if (alphaRows) {
+			result = _mm_or_si128(result, _mm_loadu_si128((const __m128i *)(alphaRows + y * 4)));
+		}
+		_mm_storeu_si128((__m128i *)dst, result);
+		dst += pitch;
+	}
+}
+
+// Interpolates all 8 alpha values at once, matching DXTDecoder::DecodeAlphaDXT5().
+static inline void DecodeAlphaDXT5SSE2(u8 alpha[8], const DXT5Block *src) {
+	// Fixed 8.8 weights pre-divided by 7 (or 5), same as lerp8() / lerp6().
+	const __m128i a1 = _mm_set1_epi16(src->alpha1);
+	const __m128i a2 = _mm_set1_epi16(src->alpha2);
+	__m128i result;
+	if (src->alpha1 > src->alpha2) {
+		const __m128i weight1 = _mm_setr_epi16(256, 0, (6 << 8) / 7, (5 << 8) / 7, (4 << 8) / 7, (3 << 8) / 7, (2 << 8) / 7, (1 << 8) / 7);
+		const __m128i weight2 = _mm_setr_epi16(0, 256, (1 << 8) / 7, (2 << 8) / 7, (3 << 8) / 7, (4 << 8) / 7, (5 << 8) / 7, (6 << 8) / 7);
+		const __m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(a1, weight1), _mm_mullo_epi16(a2, weight2)), _mm_set1_epi16(255));
+		result = _mm_srli_epi16(sum, 8);
+	} else {
+		const __m128i weight1 = _mm_setr_epi16(256, 0, (4 << 8) / 5, (3 << 8) / 5, (2 << 8) / 5, (1 << 8) / 5, 0, 0);
+		const __m128i weight2 = _mm_setr_epi16(0, 256, (1 << 8) / 5, (2 << 8) / 5, (3 << 8) / 5, (4 << 8) / 5, 0, 0);
+		const __m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(a1, weight1), _mm_mullo_epi16(a2, weight2)), _mm_set1_epi16(255));
+		// The last two are always 0 and 255.
+		result = _mm_or_si128(_mm_srli_epi16(_mm_and_si128(sum, _mm_setr_epi16(-1, -1, -1, -1, -1, -1, 0, 0)), 8), _mm_setr_epi16(0, 0, 0, 0, 0, 0, 0, 255));
+	}
+	_mm_storel_epi64((__m128i *)alpha, _mm_packus_epi16(result, result));
+}
+
+// Spreads the 16 alpha nibbles of a DXT3 block into the top of each pixel.
+static inline void DXT3AlphaRowsSSE2(u32 alphaRows[16], const DXT3Block *src) {
+	const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i data = _mm_loadl_epi64((const __m128i *)src->alphaLines);
+	const __m128i lowNibbles = _mm_and_si128(data, nibbleMask);
+	const __m128i highNibbles = _mm_and_si128(_mm_srli_epi16(data, 4), nibbleMask);
+	// One byte per pixel, already shifted up to the top of the byte.
+	const __m128i alpha = _mm_slli_epi16(_mm_unpacklo_epi8(lowNibbles, highNibbles), 4);
+	const __m128i alpha16lo = _mm_unpacklo_epi8(zero, alpha);
+	const __m128i alpha16hi = _mm_unpackhi_epi8(zero, alpha);
+	_mm_storeu_si128((__m128i *)alphaRows + 0, _mm_unpacklo_epi16(zero, alpha16lo));
+	_mm_storeu_si128((__m128i *)alphaRows + 1, _mm_unpackhi_epi16(zero, alpha16lo));
+	_mm_storeu_si128((__m128i *)alphaRows + 2, _mm_unpacklo_epi16(zero, alpha16hi));
+	_mm_storeu_si128((__m128i *)alphaRows + 3, _mm_unpackhi_epi16(zero, alpha16hi));
+}
+#endif
+
+static inline void DXT3AlphaRows(u32 alphaRows[16], const DXT3Block *src) {
+	for (int y = 0; y < 4; y++) {
+		u32 alphadata = src->alphaLines[y];
+		for (int x = 0; x < 4; x++) {
+			alphaRows[y * 4 + x] = alphadata << 28;
+			alphadata >>= 4;
+		}
+	}
+}
+
+static inline void DXT5AlphaRows(u32 alphaRows[16], const u8 alpha[8], const DXT5Block *src) {
+	// 48 bits, 3 bit index per pixel, 12 bits per line.
+	u64 alphadata = ((u64)(u16)src->alphadata1 << 32) | (u32)src->alphadata2;
+	for (int i = 0; i < 16; i++) {
+		alphaRows[i] = alpha[alphadata & 7] << 24;
+		alphadata >>= 3;
+	}
+}
+
+// These decode a row of blocks at a time, writing minw pixels (rounded up to the block) of each line.
+static void DecodeDXT1Row(u32 *dst, const DXT1Block *src, int pitch, int minw, int height, bool ignore1bitAlpha) {
+	for (int x = 0; x < minw; x += 4) {
+#ifdef _M_SSE
+		WriteDXTColorsSSE2(dst + x, DecodeDXTColorsSSE2(src, ignore1bitAlpha), src->lines, nullptr, pitch, height);
+#elif PPSSPP_ARCH(ARMV7) || PPSSPP_ARCH(ARM64)
+		if (cpu_info.bNEON) {
+			DXTDecoder dxt;
+			u32 colors[4];
+			dxt.DecodeColors(src, ignore1bitAlpha);
+			dxt.GetColors(colors);
+			WriteDXTColorsNEON(dst + x, colors, src->lines, nullptr, pitch, height);
+		} else {
+			DecodeDXT1Block(dst + x, src, pitch, height, ignore1bitAlpha);
+		}
+#else
+		DecodeDXT1Block(dst + x, src, pitch, height, ignore1bitAlpha);
+#endif
+		src++;
+	}
+}
+
+static void DecodeDXT3Row(u32 *dst, const DXT3Block *src, int pitch, int minw, int height) {
+	u32 alphaRows[16];
+	for (int x = 0; x < minw; x += 4) {
+#ifdef _M_SSE
+		DXT3AlphaRowsSSE2(alphaRows, src);
+		WriteDXTColorsSSE2(dst + x, DecodeDXTColorsSSE2(&src->color, true), src->color.lines, alphaRows, pitch, height);
+#elif PPSSPP_ARCH(ARMV7) || PPSSPP_ARCH(ARM64)
+		if (cpu_info.bNEON) {
+			DXTDecoder dxt;
+			u32 colors[4];
+			dxt.DecodeColors(&src->color, true);
+			dxt.GetColors(colors);
+			DXT3AlphaRows(alphaRows, src);
+			WriteDXTColorsNEON(dst + x, colors, src->color.lines, alphaRows, pitch, height);
+		} else {
+			DecodeDXT3Block(dst + x, src, pitch, height);
+		}
+#else
+		DecodeDXT3Block(dst + x, src, pitch, height);
+#endif
+		src++;
+	}
+}
+
+static void DecodeDXT5Row(u32 *dst, const DXT5Block *src, int pitch, int minw, int height) {
+	u32 alphaRows[16];
+	for (int x = 0; x < minw; x += 4) {
+#ifdef _M_SSE
+		u8 alpha[8];
+		DecodeAlphaDXT5SSE2(alpha, src);
+		DXT5AlphaRows(alphaRows, alpha, src);
+		WriteDXTColorsSSE2(dst + x, DecodeDXTColorsSSE2(&src->color, true), src->color.lines, alphaRows, pitch, height);
+#elif PPSSPP_ARCH(ARMV7) || PPSSPP_ARCH(ARM64)
+		if (cpu_info.bNEON) {
+			DXTDecoder dxt;
+			u32 colors[4];
+			u8 alpha[8];
+			dxt.DecodeColors(&src->color, true);
+			dxt.DecodeAlphaDXT5(src);
+			dxt.GetColors(colors);
+			dxt.GetAlpha(alpha);
+			DXT5AlphaRows(alphaRows, alpha, src);
+			WriteDXTColorsNEON(dst + x, colors, src->color.lines, alphaRows, pitch, height);
+		} else {
+			DecodeDXT5Block(dst + x, src, pitch, height);
+		}
+#else
+		DecodeDXT5Block(dst + x, src, pitch, height);
+#endif
+		src++;
+	}
+}
+
+void DecodeDXT1Level(u32 *dst, int pitch, const DXT1Block *src, int bufw, int w, int h, bool ignore1bitAlpha) {
+	const int minw = std::min(bufw, w);
+	for (int y = 0; y < h; y += 4) {
+		DecodeDXT1Row(dst + pitch * y, src + (y / 4) * (bufw / 4), pitch, minw, std::min(h - y, 4), ignore1bitAlpha);
+	}
+}
+
+void DecodeDXT3Level(u32 *dst, int pitch, const DXT3Block *src, int bufw, int w, int h) {
+	const int minw = std::min(bufw, w);
+	for (int y = 0; y < h; y += 4) {
+		DecodeDXT3Row(dst + pitch * y, src + (y / 4) * (bufw / 4), pitch, minw, std::min(h - y, 4));
+	}
+}
+
+void DecodeDXT5Level(u32 *dst, int pitch, const DXT5Block *src, int bufw, int w, int h) {
+	const int minw = std::min(bufw, w);
+	for (int y = 0; y < h; y += 4) {
+		DecodeDXT5Row(dst + pitch * y, src + (y / 4) * (bufw / 4), pitch, minw, std::min(h - y, 4));
+	}
+}
+
 #ifdef _M_SSE
 static inline u32 CombineSSEBitsToDWORD(const __m128i &v) {
 	__m128i temp;
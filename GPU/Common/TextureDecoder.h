@@ -23,6 +23,8 @@ enum CheckAlphaResult {
 	CHECKALPHA_ANY = 4,
 };
 
+#include <algorithm>
+
 #include "Common/Common.h"
 #include "Common/Swap.h"
 #include "Core/MemMap.h"
@@ -119,6 +121,12 @@ void DecodeDXT1Block(u32 *dst, const DXT1Block *src, int pitch, int height, bool
 void DecodeDXT3Block(u32 *dst, const DXT3Block *src, int pitch, int height);
 void DecodeDXT5Block(u32 *dst, const DXT5Block *src, int pitch, int height);
 
+// Decode a whole level a row of blocks at a time.  bufw is the width of src in pixels, and
+// each line gets min(bufw, w) pixels, rounded up to whole blocks.
+void DecodeDXT1Level(u32 *dst, int pitch, const DXT1Block *src, int bufw, int w, int h, bool ignore1bitAlpha);
+void DecodeDXT3Level(u32 *dst, int pitch, const DXT3Block *src, int bufw, int w, int h);
+void DecodeDXT5Level(u32 *dst, int pitch, const DXT5Block *src, int bufw, int w, int h);
+
 static const u8 textureBitsPerPixel[16] = {
 	16,  //GE_TFMT_5650,
 	16,  //GE_TFMT_5551,
@@ -140,6 +148,14 @@ static const u8 textureBitsPerPixel[16] = {
 
 u32 GetTextureBufw(int level, u32 texaddr, GETextureFormat format);
 
+// Fast paths for the common "simple" clut index (no shift, mask, or start pos.)
+// CLUT4 uses a 16-entry byte shuffle (pshufb / vtbl) when available.
+void DeIndexTexture4Simple(u16 *dest, const u8 *indexed, int length, const u16 *clut);
+void DeIndexTexture4Simple(u32 *dest, const u8 *indexed, int length, const u32 *clut);
+// CLUT8 has too many entries for a register table, so this is just an unrolled lookup.
+void DeIndexTexture8Simple(u16 *dest, const u8 *indexed, int length, const u16 *clut);
+void DeIndexTexture8Simple(u32 *dest, const u8 *indexed, int length, const u32 *clut);
+
 template <typename IndexT, typename ClutT>
 inline void DeIndexTexture(ClutT *dest, const IndexT *indexed, int length, const ClutT *clut) {
 	// Usually, there is no special offset, mask, or shift.
@@ -147,9 +163,7 @@ inline void DeIndexTexture(ClutT *dest, const IndexT *indexed, int length, const
 
 	if (nakedIndex) {
 		if (sizeof(IndexT) == 1) {
-			for (int i = 0; i < length; ++i) {
-				*dest++ = clut[*indexed++];
-			}
+			DeIndexTexture8Simple(dest, (const u8 *)indexed, length, clut);
 		} else {
 			for (int i = 0; i < length; ++i) {
 				*dest++ = clut[(*indexed++) & 0xFF];
@@ -174,11 +188,7 @@ inline void DeIndexTexture4(ClutT *dest, const u8 *indexed, int length, const Cl
 	const bool nakedIndex = gstate.isClutIndexSimple();
 
 	if (nakedIndex) {
-		for (int i = 0; i < length; i += 2) {
-			u8 index = *indexed++;
-			dest[i + 0] = clut[(index >> 0) & 0xf];
-			dest[i + 1] = clut[(index >> 4) & 0xf];
-		}
+		DeIndexTexture4Simple(dest, indexed, length, clut);
 	} else {
 		for (int i = 0; i < length; i += 2) {
 			u8 index = *indexed++;
@@ -231,3 +241,38 @@ inline void DeIndexTexture4Optimal(ClutT *dest, const u32 texaddr, int length, C
 	const u8 *indexed = (const u8 *) Memory::GetPointer(texaddr);
 	DeIndexTexture4Optimal(dest, indexed, length, color);
 }
+
+// De-indexes a whole level, reading swizzled indices directly rather than unswizzling into
+// a temporary buffer first.  deindex(dest, src, length) is called once per row when linear,
+// or once per 16-byte run of a block when swizzled.  bitsPerIndex is 4, 8, 16, or 32.
+template <typename ClutT, typename Func>
+inline void DeIndexTextureLevel(u8 *out, int outPitch, const u8 *texptr, int bufw, int w, int h, int bitsPerIndex, bool swizzled, Func deindex) {
+	const int rowBytes = (bufw * bitsPerIndex) / 8;
+	if (!swizzled) {
+		for (int y = 0; y < h; ++y) {
+			deindex((ClutT *)(out + outPitch * y), texptr + rowBytes * y, w);
+		}
+		return;
+	}
+
+	// See UnswizzleFromMem for the layout: blocks are 16 bytes wide and 8 rows tall.
+	const int bxc = rowBytes / 16;
+	const int byc = (h + 7) / 8;
+	const int pixelsPerRun = 128 / bitsPerIndex;
+	for (int by = 0; by < byc; ++by) {
+		const u8 *blockRow = texptr + by * bxc * 128;
+		const int rows = std::min(h - by * 8, 8);
+		for (int bx = 0; bx < bxc; ++bx) {
+			const int x = bx * pixelsPerRun;
+			if (x >= w) {
+				// The rest of the blocks are only padding out to bufw.
+				break;
+			}
+			const int length = std::min(w - x, pixelsPerRun);
+			const u8 *src = blockRow + bx * 128;
+			for (int n = 0; n < rows; ++n) {
+				deindex((ClutT *)(out + outPitch * (by * 8 + n)) + x, src + n * 16, length);
+			}
+		}
+	}
+}
@@ -165,6 +165,91 @@ void DoUnswizzleTex16NEON(const u8 *texptr, u32 *ydestp, int bxc, int byc, u32 p
 // NOTE: This is just a NEON version of xxhash.
 // GCC sucks at making things NEON and can't seem to handle it.
 
+static inline uint8x8x2_t SplitTableNEON(uint8x16_t bytes) {
+	uint8x8x2_t table;
+	table.val[0] = vget_low_u8(bytes);
+	table.val[1] = vget_high_u8(bytes);
+	return table;
+}
+
+static inline uint8x16_t LookupTableNEON(const uint8x8x2_t &table, uint8x16_t idx) {
+	return vcombine_u8(vtbl2_u8(table, vget_low_u8(idx)), vtbl2_u8(table, vget_high_u8(idx)));
+}
+
+int DeIndexTexture4SimpleNEON(u16 *dest, const u8 *indexed, int length, const u16 *clut) {
+	// Deinterleaving gives us a table of low bytes and a table of high bytes.
+	const uint8x16x2_t planes = vld2q_u8((const u8 *)clut);
+	const uint8x8x2_t lowTable = SplitTableNEON(planes.val[0]);
+	const uint8x8x2_t highTable = SplitTableNEON(planes.val[1]);
+	const uint8x16_t nibbleMask = vdupq_n_u8(0x0F);
+
+	int i = 0;
+	for (; i + 32 <= length; i += 32) {
+		const uint8x16_t indices = vld1q_u8(indexed + i / 2);
+		// The low nibble is the first pixel of each pair.
+		const uint8x16x2_t pixels = vzipq_u8(vandq_u8(indices, nibbleMask), vshrq_n_u8(indices, 4));
+		for (int j = 0; j < 2; ++j) {
+			uint8x16x2_t result;
+			result.val[0] = LookupTableNEON(lowTable, pixels.val[j]);
+			result.val[1] = LookupTableNEON(highTable, pixels.val[j]);
+			vst2q_u8((u8 *)(dest + i + j * 16), result);
+		}
+	}
+	return i;
+}
+
+int DeIndexTexture4SimpleNEON(u32 *dest, const u8 *indexed, int length, const u32 *clut) {
+	// One table per byte of the color.
+	const uint8x16x4_t planes = vld4q_u8((const u8 *)clut);
+	uint8x8x2_t tables[4];
+	for (int b = 0; b < 4; ++b) {
+		tables[b] = SplitTableNEON(planes.val[b]);
+	}
+	const uint8x16_t nibbleMask = vdupq_n_u8(0x0F);
+
+	int i = 0;
+	for (; i + 32 <= length; i += 32) {
+		const uint8x16_t indices = vld1q_u8(indexed + i / 2);
+		const uint8x16x2_t pixels = vzipq_u8(vandq_u8(indices, nibbleMask), vshrq_n_u8(indices, 4));
+		for (int j = 0; j < 2; ++j) {
+			uint8x16x4_t result;
+			for (int b = 0; b < 4; ++b) {
+				result.val[b] = LookupTableNEON(tables[b], pixels.val[j]);
+			}
+			vst4q_u8((u8 *)(dest + i + j * 16), result);
+		}
+	}
+	return i;
+}
+
+void WriteDXTColorsNEON(u32 *dst, const u32 colors[4], const u8 lines[4], const u32 *alphaRows, int pitch, int height) {
+	static const u8 byteOffsets[8] = { 0, 1, 2, 3, 0, 1, 2, 3 };
+	static const s8 indexShifts[8] = { 0, 0, 0, 0, -2, -2, -2, -2 };
+
+	uint8x8x2_t table;
+	table.val[0] = vld1_u8((const u8 *)colors);
+	table.val[1] = vld1_u8((const u8 *)colors + 8);
+	const uint8x8_t offsets = vld1_u8(byteOffsets);
+	const int8x8_t shifts = vld1_s8(indexShifts);
+	const uint8x8_t indexMask = vdup_n_u8(3);
+
+	for (int y = 0; y < height; y++) {
+		// Each byte of the result picks a byte out of the four colors: index * 4 + byte.
+		// The shifts already leave each byte with the index of its own pixel.
+		const uint8x8_t line = vdup_n_u8(lines[y]);
+		const uint8x8_t first = vand_u8(vshl_u8(line, shifts), indexMask);
+		const uint8x8_t second = vand_u8(vshl_u8(vshr_n_u8(line, 4), shifts), indexMask);
+		const uint8x8_t lo = vtbl2_u8(table, vadd_u8(vshl_n_u8(first, 2), offsets));
+		const uint8x8_t hi = vtbl2_u8(table, vadd_u8(vshl_n_u8(second, 2), offsets));
+		uint32x4_t result = vreinterpretq_u32_u8(vcombine_u8(lo, hi));
+		if (alphaRows) {
+			result = vorrq_u32(result, vld1q_u32(alphaRows + y * 4));
+		}
+		vst1q_u32(dst, result);
+		dst += pitch;
+	}
+}
+
 #if defined (__STDC_VERSION__) && __STDC_VERSION__ >= 199901L   // C99
 # include <stdint.h>
   typedef uint8_t  BYTE;
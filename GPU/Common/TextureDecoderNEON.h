@@ -21,6 +21,11 @@ u32 QuickTexHashNEON(const void *checkp, u32 size);
 void DoUnswizzleTex16NEON(const u8 *texptr, u32 *ydestp, int bxc, int byc, u32 pitch);
 u32 ReliableHash32NEON(const void *input, size_t len, u32 seed);
 
+// These return the number of pixels handled, always a multiple of 32.  The caller does the rest.
+int DeIndexTexture4SimpleNEON(u16 *dest, const u8 *indexed, int length, const u16 *clut);
+int DeIndexTexture4SimpleNEON(u32 *dest, const u8 *indexed, int length, const u32 *clut);
+void WriteDXTColorsNEON(u32 *dst, const u32 colors[4], const u8 lines[4], const u32 *alphaRows, int pitch, int height);
+
 CheckAlphaResult CheckAlphaRGBA8888NEON(const u32 *pixelData, int stride, int w, int h);
 CheckAlphaResult CheckAlphaABGR4444NEON(const u32 *pixelData, int stride, int w, int h);
 CheckAlphaResult CheckAlphaABGR1555NEON(const u32 *pixelData, int stride, int w, int h);
@@ -26,6 +26,7 @@
 #include <cstring>
 #include <cmath>
 
+#include "ppsspp_config.h"
 #include "GPU/Common/TextureScalerCommon.h"
 
 #include "Core/Config.h"
@@ -37,18 +38,32 @@
 #include "Common/CPUDetect.h"
 #include "ext/xbrz/xbrz.h"
 
+#if defined(_M_SSE)
+#include <emmintrin.h>
+#endif
 #if _M_SSE >= 0x401
 #include <smmintrin.h>
 #endif
+#if PPSSPP_ARCH(ARM_NEON)
+#if defined(_MSC_VER) && PPSSPP_ARCH(ARM64)
+#include <arm64_neon.h>
+#else
+#include <arm_neon.h>
+#endif
+#endif
 
 // Report the time and throughput for each larger scaling operation in the log
 //#define SCALING_MEASURE_TIME
 
 //#define DEBUG_SCALER_OUTPUT
 
-#ifdef SCALING_MEASURE_TIME
 #include "base/timeutil.h"
-#endif
+
+// How much time the async scaling thread may spend per frame, so it doesn't starve the emu thread.
+#define ASYNC_SCALE_BUDGET_PER_FRAME (1.0 / 240.0)
+// Finished results not used for this many frames are dropped.
+#define ASYNC_SCALE_KEEP_FRAMES 600
+#define ASYNC_SCALE_MAX_BYTES (128 * 1024 * 1024)
 
 /////////////////////////////////////// Helper Functions (mostly math for parallelization)
 
@@ -72,23 +87,116 @@ namespace {
 
 #define BLOCK_SIZE 32
 
+#if defined(_M_SSE)
+// SSE2 has no _mm_mullo_epi32.
+inline __m128i MulLo32SSE2(__m128i a, __m128i b) {
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+inline __m128i AbsDiffU8SSE2(__m128i a, __m128i b) {
+	return _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+}
+
+// Exactly x / 255 for x <= 255 * 255, which is all MIX_PIXELS can produce.
+inline __m128i Div255SSE2(__m128i x) {
+	return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(x, _mm_set1_epi16(1)), _mm_srli_epi16(x, 8)), 8);
+}
+
+// MIX_PIXELS on 4 pixels.  The factors are per channel in 16-bit lanes, lo for pixels 0-1 and hi for 2-3.
+inline __m128i MixPixelsSSE2(__m128i p0, __m128i p1, __m128i f0lo, __m128i f0hi, __m128i f1lo, __m128i f1hi) {
+	const __m128i zero = _mm_setzero_si128();
+	__m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(p0, zero), f0lo), _mm_mullo_epi16(_mm_unpacklo_epi8(p1, zero), f1lo));
+	__m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(p0, zero), f0hi), _mm_mullo_epi16(_mm_unpackhi_epi8(p1, zero), f1hi));
+	return _mm_packus_epi16(Div255SSE2(lo), Div255SSE2(hi));
+}
+#elif PPSSPP_ARCH(ARM_NEON)
+inline uint8x8_t Div255NEON(uint16x8_t x) {
+	return vshrn_n_u16(vaddq_u16(vaddq_u16(x, vdupq_n_u16(1)), vshrq_n_u16(x, 8)), 8);
+}
+
+inline uint32x4_t MixPixelsNEON(uint32x4_t p0, uint32x4_t p1, uint8x16_t f0, uint8x16_t f1) {
+	uint8x16_t b0 = vreinterpretq_u8_u32(p0);
+	uint8x16_t b1 = vreinterpretq_u8_u32(p1);
+	uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(b0), vget_low_u8(f0)), vget_low_u8(b1), vget_low_u8(f1));
+	uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(b0), vget_high_u8(f0)), vget_high_u8(b1), vget_high_u8(f1));
+	return vreinterpretq_u32_u8(vcombine_u8(Div255NEON(lo), Div255NEON(hi)));
+}
+#endif
+
+inline u32 convolve3x3Pixel(const u32 *data, const int kernel[3][3], int width, int height, int x, int y) {
+	int val = 0;
+	for (int yoff = -1; yoff <= 1; ++yoff) {
+		int yy = std::max(std::min(y + yoff, height - 1), 0);
+		for (int xoff = -1; xoff <= 1; ++xoff) {
+			int xx = std::max(std::min(x + xoff, width - 1), 0);
+			val += data[yy*width + xx] * kernel[yoff + 1][xoff + 1];
+		}
+	}
+	return abs(val);
+}
+
+// The SIMD row functions below only handle pixels with all their neighbors inside the image.
+// They start at x = 1 and return where they stopped, the caller does the rest.
+int convolve3x3Row(const u32 *data, u32 *out, const int kernel[3][3], int width, int y) {
+	int x = 1;
+#if defined(_M_SSE)
+	__m128i k[3][3];
+	for (int i = 0; i < 9; ++i) {
+		k[i / 3][i % 3] = _mm_set1_epi32(kernel[i / 3][i % 3]);
+	}
+	for (; x + 4 <= width - 1; x += 4) {
+		const u32 *p = data + y * width + x;
+		__m128i val = _mm_setzero_si128();
+		for (int yoff = -1; yoff <= 1; ++yoff) {
+			for (int xoff = -1; xoff <= 1; ++xoff) {
+				__m128i src = _mm_loadu_si128((const __m128i *)(p + yoff * width + xoff));
+				val = _mm_add_epi32(val, MulLo32SSE2(src, k[yoff + 1][xoff + 1]));
+			}
+		}
+		__m128i sign = _mm_srai_epi32(val, 31);
+		_mm_storeu_si128((__m128i *)(out + y * width + x), _mm_sub_epi32(_mm_xor_si128(val, sign), sign));
+	}
+#elif PPSSPP_ARCH(ARM_NEON)
+	for (; x + 4 <= width - 1; x += 4) {
+		const u32 *p = data + y * width + x;
+		int32x4_t val = vdupq_n_s32(0);
+		for (int yoff = -1; yoff <= 1; ++yoff) {
+			for (int xoff = -1; xoff <= 1; ++xoff) {
+				int32x4_t src = vreinterpretq_s32_u32(vld1q_u32(p + yoff * width + xoff));
+				val = vmlaq_n_s32(val, src, kernel[yoff + 1][xoff + 1]);
+			}
+		}
+		vst1q_u32(out + y * width + x, vreinterpretq_u32_s32(vabsq_s32(val)));
+	}
+#endif
+	return x;
+}
+
 // 3x3 convolution with Neumann boundary conditions, parallelizable
 // quite slow, could be sped up a lot
 // especially handling of separable kernels
-void convolve3x3(u32* data, u32* out, const int kernel[3][3], int width, int height, int l, int u) {
+void convolve3x3(bool simd, u32* data, u32* out, const int kernel[3][3], int width, int height, int l, int u) {
+	if (simd) {
+		for (int y = l; y < u; ++y) {
+			int x = 0;
+			if (y > 0 && y < height - 1 && width > 2) {
+				out[y*width] = convolve3x3Pixel(data, kernel, width, height, 0, y);
+				x = convolve3x3Row(data, out, kernel, width, y);
+			}
+			for (; x < width; ++x) {
+				out[y*width + x] = convolve3x3Pixel(data, kernel, width, height, x, y);
+			}
+		}
+		return;
+	}
+
 	for (int yb = 0; yb < (u - l) / BLOCK_SIZE + 1; ++yb) {
 		for (int xb = 0; xb < width / BLOCK_SIZE + 1; ++xb) {
 			for (int y = l + yb*BLOCK_SIZE; y < l + (yb + 1)*BLOCK_SIZE && y < u; ++y) {
 				for (int x = xb*BLOCK_SIZE; x < (xb + 1)*BLOCK_SIZE && x < width; ++x) {
-					int val = 0;
-					for (int yoff = -1; yoff <= 1; ++yoff) {
-						int yy = std::max(std::min(y + yoff, height - 1), 0);
-						for (int xoff = -1; xoff <= 1; ++xoff) {
-							int xx = std::max(std::min(x + xoff, width - 1), 0);
-							val += data[yy*width + xx] * kernel[yoff + 1][xoff + 1];
-						}
-					}
-					out[y*width + x] = abs(val);
+					out[y*width + x] = convolve3x3Pixel(data, kernel, width, height, x, y);
 				}
 			}
 		}
@@ -154,47 +262,175 @@ void deposterizeV(u32* data, u32* out, int w, int h, int l, int u) {
 	}
 }
 
+inline u32 distanceMaskPixel(const u32 *data, int width, int height, int x, int y) {
+	const u32 center = data[y*width + x];
+	u32 dist = 0;
+	for (int yoff = -1; yoff <= 1; ++yoff) {
+		int yy = y + yoff;
+		if (yy == height || yy == -1) {
+			dist += 1200; // assume distance at borders, usually makes for better result
+			continue;
+		}
+		for (int xoff = -1; xoff <= 1; ++xoff) {
+			if (yoff == 0 && xoff == 0) continue;
+			int xx = x + xoff;
+			if (xx == width || xx == -1) {
+				dist += 400; // assume distance at borders, usually makes for better result
+				continue;
+			}
+			dist += DISTANCE(data[yy*width + xx], center);
+		}
+	}
+	return dist;
+}
+
+int distanceMaskRow(const u32 *data, u32 *out, int width, int y) {
+	int x = 1;
+#if defined(_M_SSE)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_set1_epi16(1);
+	for (; x + 4 <= width - 1; x += 4) {
+		const u32 *p = data + y * width + x;
+		const __m128i center = _mm_loadu_si128((const __m128i *)p);
+		__m128i sumLo = zero;
+		__m128i sumHi = zero;
+		for (int yoff = -1; yoff <= 1; ++yoff) {
+			for (int xoff = -1; xoff <= 1; ++xoff) {
+				if (yoff == 0 && xoff == 0) continue;
+				__m128i diff = AbsDiffU8SSE2(_mm_loadu_si128((const __m128i *)(p + yoff * width + xoff)), center);
+				sumLo = _mm_add_epi16(sumLo, _mm_unpacklo_epi8(diff, zero));
+				sumHi = _mm_add_epi16(sumHi, _mm_unpackhi_epi8(diff, zero));
+			}
+		}
+		// Now add up the four channels of each pixel.
+		__m128 lo = _mm_castsi128_ps(_mm_madd_epi16(sumLo, ones));
+		__m128 hi = _mm_castsi128_ps(_mm_madd_epi16(sumHi, ones));
+		__m128i even = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+		__m128i odd = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+		_mm_storeu_si128((__m128i *)(out + y * width + x), _mm_add_epi32(even, odd));
+	}
+#elif PPSSPP_ARCH(ARM_NEON)
+	for (; x + 4 <= width - 1; x += 4) {
+		const u32 *p = data + y * width + x;
+		const uint8x16_t center = vreinterpretq_u8_u32(vld1q_u32(p));
+		uint16x8_t sumLo = vdupq_n_u16(0);
+		uint16x8_t sumHi = vdupq_n_u16(0);
+		for (int yoff = -1; yoff <= 1; ++yoff) {
+			for (int xoff = -1; xoff <= 1; ++xoff) {
+				if (yoff == 0 && xoff == 0) continue;
+				uint8x16_t diff = vabdq_u8(vreinterpretq_u8_u32(vld1q_u32(p + yoff * width + xoff)), center);
+				sumLo = vaddw_u8(sumLo, vget_low_u8(diff));
+				sumHi = vaddw_u8(sumHi, vget_high_u8(diff));
+			}
+		}
+		// Now add up the four channels of each pixel.
+		uint32x4_t lo = vpaddlq_u16(sumLo);
+		uint32x4_t hi = vpaddlq_u16(sumHi);
+		uint32x4_t dist = vcombine_u32(vpadd_u32(vget_low_u32(lo), vget_high_u32(lo)), vpadd_u32(vget_low_u32(hi), vget_high_u32(hi)));
+		vst1q_u32(out + y * width + x, dist);
+	}
+#endif
+	return x;
+}
+
 // generates a distance mask value for each pixel in data
 // higher values -> larger distance to the surrounding pixels
-void generateDistanceMask(u32* data, u32* out, int width, int height, int l, int u) {
+void generateDistanceMask(bool simd, u32* data, u32* out, int width, int height, int l, int u) {
+	if (simd) {
+		for (int y = l; y < u; ++y) {
+			int x = 0;
+			if (y > 0 && y < height - 1 && width > 2) {
+				out[y*width] = distanceMaskPixel(data, width, height, 0, y);
+				x = distanceMaskRow(data, out, width, y);
+			}
+			for (; x < width; ++x) {
+				out[y*width + x] = distanceMaskPixel(data, width, height, x, y);
+			}
+		}
+		return;
+	}
+
 	for (int yb = 0; yb < (u - l) / BLOCK_SIZE + 1; ++yb) {
 		for (int xb = 0; xb < width / BLOCK_SIZE + 1; ++xb) {
 			for (int y = l + yb*BLOCK_SIZE; y < l + (yb + 1)*BLOCK_SIZE && y < u; ++y) {
 				for (int x = xb*BLOCK_SIZE; x < (xb + 1)*BLOCK_SIZE && x < width; ++x) {
-					const u32 center = data[y*width + x];
-					u32 dist = 0;
-					for (int yoff = -1; yoff <= 1; ++yoff) {
-						int yy = y + yoff;
-						if (yy == height || yy == -1) {
-							dist += 1200; // assume distance at borders, usually makes for better result
-							continue;
-						}
-						for (int xoff = -1; xoff <= 1; ++xoff) {
-							if (yoff == 0 && xoff == 0) continue;
-							int xx = x + xoff;
-							if (xx == width || xx == -1) {
-								dist += 400; // assume distance at borders, usually makes for better result
-								continue;
-							}
-							dist += DISTANCE(data[yy*width + xx], center);
-						}
-					}
-					out[y*width + x] = dist;
+					out[y*width + x] = distanceMaskPixel(data, width, height, x, y);
 				}
 			}
 		}
 	}
 }
 
+inline u32 mixPixel(u32 data, u32 source, u32 mask, u32 maskmax) {
+	u8 mixFactors[2] = { 0, static_cast<u8>((std::min(mask, maskmax) * 255) / maskmax) };
+	mixFactors[0] = 255 - mixFactors[1];
+	u32 result = MIX_PIXELS(data, source, mixFactors);
+	if (A(source) == 0) result = result & 0x00FFFFFF; // xBRZ always does a better job with hard alpha
+	return result;
+}
+
+// Returns where it stopped, like the other row functions.
+int mixRow(u32 *data, const u32 *source, const u32 *mask, u32 maskmax, int width, int y) {
+	int x = 0;
+#if defined(_M_SSE)
+	// Below this, the float division gives exactly the same factor as the integer one.
+	if (maskmax >= 0x10000) {
+		return x;
+	}
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i signBit = _mm_set1_epi32(0x80000000);
+	const __m128i maskmaxVec = _mm_set1_epi32(maskmax);
+	const __m128i maskmaxSigned = _mm_xor_si128(maskmaxVec, signBit);
+	const __m128 maskmaxFloat = _mm_set1_ps((float)maskmax);
+	const __m128i alphaBits = _mm_set1_epi32(0xFF000000);
+	for (; x + 4 <= width; x += 4) {
+		const int pos = y * width + x;
+		__m128i m = _mm_loadu_si128((const __m128i *)(mask + pos));
+		// std::min() as unsigned, SSE2 only compares signed.
+		__m128i over = _mm_cmpgt_epi32(_mm_xor_si128(m, signBit), maskmaxSigned);
+		m = _mm_or_si128(_mm_andnot_si128(over, m), _mm_and_si128(over, maskmaxVec));
+		__m128i f1 = _mm_cvttps_epi32(_mm_div_ps(_mm_mul_ps(_mm_cvtepi32_ps(m), _mm_set1_ps(255.0f)), maskmaxFloat));
+		__m128i f0 = _mm_sub_epi32(_mm_set1_epi32(255), f1);
+		// Spread each pixel's factor to its four channels.
+		f0 = _mm_unpacklo_epi16(_mm_packs_epi32(f0, f0), _mm_packs_epi32(f0, f0));
+		f1 = _mm_unpacklo_epi16(_mm_packs_epi32(f1, f1), _mm_packs_epi32(f1, f1));
+
+		__m128i src = _mm_loadu_si128((const __m128i *)(source + pos));
+		__m128i dst = _mm_loadu_si128((const __m128i *)(data + pos));
+		__m128i result = MixPixelsSSE2(dst, src, _mm_unpacklo_epi32(f0, f0), _mm_unpackhi_epi32(f0, f0), _mm_unpacklo_epi32(f1, f1), _mm_unpackhi_epi32(f1, f1));
+		__m128i noAlpha = _mm_cmpeq_epi32(_mm_srli_epi32(src, 24), zero);
+		result = _mm_andnot_si128(_mm_and_si128(noAlpha, alphaBits), result);
+		_mm_storeu_si128((__m128i *)(data + pos), result);
+	}
+#elif PPSSPP_ARCH(ARM_NEON)
+	const uint32x4_t alphaBits = vdupq_n_u32(0xFF000000);
+	for (; x + 4 <= width; x += 4) {
+		const int pos = y * width + x;
+		// No exact vector division on ARMv7, so the factors are computed one at a time.
+		u8 factors[16];
+		for (int i = 0; i < 4; ++i) {
+			memset(factors + i * 4, (std::min(mask[pos + i], maskmax) * 255) / maskmax, 4);
+		}
+		uint8x16_t f1 = vld1q_u8(factors);
+		uint8x16_t f0 = vsubq_u8(vdupq_n_u8(255), f1);
+
+		uint32x4_t src = vld1q_u32(source + pos);
+		uint32x4_t result = MixPixelsNEON(vld1q_u32(data + pos), src, f0, f1);
+		uint32x4_t noAlpha = vceqq_u32(vshrq_n_u32(src, 24), vdupq_n_u32(0));
+		result = vbicq_u32(result, vandq_u32(noAlpha, alphaBits));
+		vst1q_u32(data + pos, result);
+	}
+#endif
+	return x;
+}
+
 // mix two images based on a mask
-void mix(u32* data, u32* source, u32* mask, u32 maskmax, int width, int l, int u) {
+void mix(bool simd, u32* data, u32* source, u32* mask, u32 maskmax, int width, int l, int u) {
 	for (int y = l; y < u; ++y) {
-		for (int x = 0; x < width; ++x) {
+		int x = simd ? mixRow(data, source, mask, maskmax, width, y) : 0;
+		for (; x < width; ++x) {
 			int pos = y*width + x;
-			u8 mixFactors[2] = { 0, static_cast<u8>((std::min(mask[pos], maskmax) * 255) / maskmax) };
-			mixFactors[0] = 255 - mixFactors[1];
-			data[pos] = MIX_PIXELS(data[pos], source[pos], mixFactors);
-			if (A(source[pos]) == 0) data[pos] = data[pos] & 0x00FFFFFF; // xBRZ always does a better job with hard alpha
+			data[pos] = mixPixel(data[pos], source[pos], mask[pos], maskmax);
 		}
 	}
 }
@@ -324,54 +560,85 @@ void scaleBicubicTSSE41(u32* data, u32* out, int w, int h, int l, int u) {
 		}
 	}
 }
-#endif
-
-void scaleBicubicBSpline(int factor, u32* data, u32* out, int w, int h, int l, int u) {
-#if _M_SSE >= 0x401
-	if (cpu_info.bSSE4_1) {
-		switch (factor) {
-		case 2: scaleBicubicTSSE41<2, 0>(data, out, w, h, l, u); break; // when I first tested this, 
-		case 3: scaleBicubicTSSE41<3, 0>(data, out, w, h, l, u); break; // it was even slower than I had expected
-		case 4: scaleBicubicTSSE41<4, 0>(data, out, w, h, l, u); break; // turns out I had not included
-		case 5: scaleBicubicTSSE41<5, 0>(data, out, w, h, l, u); break; // any of these break statements
-		default: ERROR_LOG(G3D, "Bicubic upsampling only implemented for factors 2 to 5");
-		}
-	} else {
-#endif
-		switch (factor) {
-		case 2: scaleBicubicT<2, 0>(data, out, w, h, l, u); break; // when I first tested this, 
-		case 3: scaleBicubicT<3, 0>(data, out, w, h, l, u); break; // it was even slower than I had expected
-		case 4: scaleBicubicT<4, 0>(data, out, w, h, l, u); break; // turns out I had not included
-		case 5: scaleBicubicT<5, 0>(data, out, w, h, l, u); break; // any of these break statements
-		default: ERROR_LOG(G3D, "Bicubic upsampling only implemented for factors 2 to 5");
+#elif PPSSPP_ARCH(ARM_NEON)
+template<int f, int T>
+void scaleBicubicTNEON(u32* data, u32* out, int w, int h, int l, int u) {
+	int outw = w*f;
+	for (int yb = 0; yb < (u - l)*f / BLOCK_SIZE + 1; ++yb) {
+		for (int xb = 0; xb < w*f / BLOCK_SIZE + 1; ++xb) {
+			for (int y = l*f + yb*BLOCK_SIZE; y < l*f + (yb + 1)*BLOCK_SIZE && y < u*f; ++y) {
+				for (int x = xb*BLOCK_SIZE; x < (xb + 1)*BLOCK_SIZE && x < w*f; ++x) {
+					float32x4_t result = vdupq_n_f32(0.0f);
+					int cx = x / f, cy = y / f;
+					// sample supporting pixels in original image
+					for (int sx = -2; sx <= 2; ++sx) {
+						for (int sy = -2; sy <= 2; ++sy) {
+							float weight = bicubicWeights[T][f - 2][x%f][y%f][sx + 2][sy + 2];
+							if (weight != 0.0f) {
+								// clamp pixel locations
+								int csy = std::max(std::min(sy + cy, h - 1), 0);
+								int csx = std::max(std::min(sx + cx, w - 1), 0);
+								// sample & add weighted components
+								uint8x8_t sample = vreinterpret_u8_u32(vdup_n_u32(data[csy*w + csx]));
+								uint32x4_t col = vmovl_u16(vget_low_u16(vmovl_u8(sample)));
+								result = vmlaq_n_f32(result, vcvtq_f32_u32(col), weight);
+							}
+						}
+					}
+					// generate and write result, rounding like the SSE4.1 version
+					float32x4_t scaled = vmulq_n_f32(result, bicubicInvSums[T][f - 2][x%f][y%f]);
+					int32x4_t pixel = vcvtq_s32_f32(vaddq_f32(scaled, vdupq_n_f32(0.5f)));
+					uint16x4_t pixel16 = vqmovun_s32(pixel);
+					uint8x8_t pixel8 = vqmovn_u16(vcombine_u16(pixel16, pixel16));
+					out[y*outw + x] = vget_lane_u32(vreinterpret_u32_u8(pixel8), 0);
+				}
+			}
 		}
-#if _M_SSE >= 0x401
 	}
-#endif
 }
+#endif
 
-void scaleBicubicMitchell(int factor, u32* data, u32* out, int w, int h, int l, int u) {
+// T: 0 = BSpline, 1 = Mitchell
+template<int T>
+void scaleBicubic(bool simd, int factor, u32* data, u32* out, int w, int h, int l, int u) {
 #if _M_SSE >= 0x401
-	if (cpu_info.bSSE4_1) {
+	if (cpu_info.bSSE4_1 && simd) {
 		switch (factor) {
-		case 2: scaleBicubicTSSE41<2, 1>(data, out, w, h, l, u); break;
-		case 3: scaleBicubicTSSE41<3, 1>(data, out, w, h, l, u); break;
-		case 4: scaleBicubicTSSE41<4, 1>(data, out, w, h, l, u); break;
-		case 5: scaleBicubicTSSE41<5, 1>(data, out, w, h, l, u); break;
+		case 2: scaleBicubicTSSE41<2, T>(data, out, w, h, l, u); break;
+		case 3: scaleBicubicTSSE41<3, T>(data, out, w, h, l, u); break;
+		case 4: scaleBicubicTSSE41<4, T>(data, out, w, h, l, u); break;
+		case 5: scaleBicubicTSSE41<5, T>(data, out, w, h, l, u); break;
 		default: ERROR_LOG(G3D, "Bicubic upsampling only implemented for factors 2 to 5");
 		}
-	} else {
-#endif
+		return;
+	}
+#elif PPSSPP_ARCH(ARM_NEON)
+	if (simd) {
 		switch (factor) {
-		case 2: scaleBicubicT<2, 1>(data, out, w, h, l, u); break;
-		case 3: scaleBicubicT<3, 1>(data, out, w, h, l, u); break;
-		case 4: scaleBicubicT<4, 1>(data, out, w, h, l, u); break;
-		case 5: scaleBicubicT<5, 1>(data, out, w, h, l, u); break;
+		case 2: scaleBicubicTNEON<2, T>(data, out, w, h, l, u); break;
+		case 3: scaleBicubicTNEON<3, T>(data, out, w, h, l, u); break;
+		case 4: scaleBicubicTNEON<4, T>(data, out, w, h, l, u); break;
+		case 5: scaleBicubicTNEON<5, T>(data, out, w, h, l, u); break;
 		default: ERROR_LOG(G3D, "Bicubic upsampling only implemented for factors 2 to 5");
 		}
-#if _M_SSE >= 0x401
+		return;
 	}
 #endif
+	switch (factor) {
+	case 2: scaleBicubicT<2, T>(data, out, w, h, l, u); break; // when I first tested this, 
+	case 3: scaleBicubicT<3, T>(data, out, w, h, l, u); break; // it was even slower than I had expected
+	case 4: scaleBicubicT<4, T>(data, out, w, h, l, u); break; // turns out I had not included
+	case 5: scaleBicubicT<5, T>(data, out, w, h, l, u); break; // any of these break statements
+	default: ERROR_LOG(G3D, "Bicubic upsampling only implemented for factors 2 to 5");
+	}
+}
+
+void scaleBicubicBSpline(bool simd, int factor, u32* data, u32* out, int w, int h, int l, int u) {
+	scaleBicubic<0>(simd, factor, data, out, w, h, l, u);
+}
+
+void scaleBicubicMitchell(bool simd, int factor, u32* data, u32* out, int w, int h, int l, int u) {
+	scaleBicubic<1>(simd, factor, data, out, w, h, l, u);
 }
 
 //////////////////////////////////////////////////////////////////// Bilinear scaling
@@ -382,67 +649,170 @@ const static u8 BILINEAR_FACTORS[4][3][2] = {
 		{ { 77, 178 }, { 26, 229 }, { 0, 0 } }, // x4
 		{ { 102, 153 }, { 51, 204 }, { 0, 255 } }, // x5
 };
+
+// The first half of the new pixels + center mix with the left/upper neighbor, the rest with the right/lower one.
+template<int f>
+inline const u8 *bilinearFactors(int i) {
+	return i < f / 2 + f % 2 ? BILINEAR_FACTORS[f - 2][i] : BILINEAR_FACTORS[f - 2][f - 1 - i];
+}
+
+template<int f>
+int bilinearHRow(const u32 *data, u32 *out, int w, int y) {
+	const u32 *row = data + y*w;
+	u32 *outRow = out + y*w*f;
+	int x = 1;
+#if defined(_M_SSE) || PPSSPP_ARCH(ARM_NEON)
+	for (; x + 4 <= w - 1; x += 4) {
+		u32 mixed[f][4];
+#if defined(_M_SSE)
+		const __m128i left = _mm_loadu_si128((const __m128i *)(row + x - 1));
+		const __m128i center = _mm_loadu_si128((const __m128i *)(row + x));
+		const __m128i right = _mm_loadu_si128((const __m128i *)(row + x + 1));
+		for (int i = 0; i < f; ++i) {
+			const u8 *factors = bilinearFactors<f>(i);
+			const __m128i f0 = _mm_set1_epi16(factors[0]);
+			const __m128i f1 = _mm_set1_epi16(factors[1]);
+			const __m128i side = i < f / 2 + f % 2 ? left : right;
+			_mm_storeu_si128((__m128i *)mixed[i], MixPixelsSSE2(side, center, f0, f0, f1, f1));
+		}
+#else
+		const uint32x4_t left = vld1q_u32(row + x - 1);
+		const uint32x4_t center = vld1q_u32(row + x);
+		const uint32x4_t right = vld1q_u32(row + x + 1);
+		for (int i = 0; i < f; ++i) {
+			const u8 *factors = bilinearFactors<f>(i);
+			const uint32x4_t side = i < f / 2 + f % 2 ? left : right;
+			vst1q_u32(mixed[i], MixPixelsNEON(side, center, vdupq_n_u8(factors[0]), vdupq_n_u8(factors[1])));
+		}
+#endif
+		for (int k = 0; k < 4; ++k) {
+			for (int i = 0; i < f; ++i) {
+				outRow[(x + k)*f + i] = mixed[i][k];
+			}
+		}
+	}
+#endif
+	return x;
+}
+
+template<int f>
+int bilinearVRow(const u32 *upper, const u32 *center, const u32 *lower, u32 *out, int outw) {
+	int x = 0;
+#if defined(_M_SSE)
+	for (; x + 4 <= outw; x += 4) {
+		const __m128i u = _mm_loadu_si128((const __m128i *)(upper + x));
+		const __m128i c = _mm_loadu_si128((const __m128i *)(center + x));
+		const __m128i l = _mm_loadu_si128((const __m128i *)(lower + x));
+		for (int i = 0; i < f; ++i) {
+			const u8 *factors = bilinearFactors<f>(i);
+			const __m128i f0 = _mm_set1_epi16(factors[0]);
+			const __m128i f1 = _mm_set1_epi16(factors[1]);
+			_mm_storeu_si128((__m128i *)(out + i*outw + x), MixPixelsSSE2(i < f / 2 + f % 2 ? u : l, c, f0, f0, f1, f1));
+		}
+	}
+#elif PPSSPP_ARCH(ARM_NEON)
+	for (; x + 4 <= outw; x += 4) {
+		const uint32x4_t u = vld1q_u32(upper + x);
+		const uint32x4_t c = vld1q_u32(center + x);
+		const uint32x4_t l = vld1q_u32(lower + x);
+		for (int i = 0; i < f; ++i) {
+			const u8 *factors = bilinearFactors<f>(i);
+			vst1q_u32(out + i*outw + x, MixPixelsNEON(i < f / 2 + f % 2 ? u : l, c, vdupq_n_u8(factors[0]), vdupq_n_u8(factors[1])));
+		}
+	}
+#endif
+	return x;
+}
+
+template<int f>
+inline void bilinearHPixel(const u32 *data, u32 *out, int w, int y, int x) {
+	int outw = w*f;
+	int inpos = y*w + x;
+	u32 left = data[inpos - (x == 0 ? 0 : 1)];
+	u32 center = data[inpos];
+	u32 right = data[inpos + (x == w - 1 ? 0 : 1)];
+	int i = 0;
+	for (; i < f / 2 + f % 2; ++i) { // first half of the new pixels + center, hope the compiler unrolls this
+		out[y*outw + x*f + i] = MIX_PIXELS(left, center, BILINEAR_FACTORS[f - 2][i]);
+	}
+	for (; i < f; ++i) { // second half of the new pixels, hope the compiler unrolls this
+		out[y*outw + x*f + i] = MIX_PIXELS(right, center, BILINEAR_FACTORS[f - 2][f - 1 - i]);
+	}
+}
+
 // integral bilinear upscaling by factor f, horizontal part
 template<int f>
-void bilinearHt(u32* data, u32* out, int w, int l, int u) {
+void bilinearHt(bool simd, u32* data, u32* out, int w, int l, int u) {
 	static_assert(f > 1 && f <= 5, "Bilinear scaling only implemented for factors 2 to 5");
-	int outw = w*f;
 	for (int y = l; y < u; ++y) {
-		for (int x = 0; x < w; ++x) {
-			int inpos = y*w + x;
-			u32 left = data[inpos - (x == 0 ? 0 : 1)];
-			u32 center = data[inpos];
-			u32 right = data[inpos + (x == w - 1 ? 0 : 1)];
-			int i = 0;
-			for (; i < f / 2 + f % 2; ++i) { // first half of the new pixels + center, hope the compiler unrolls this
-				out[y*outw + x*f + i] = MIX_PIXELS(left, center, BILINEAR_FACTORS[f - 2][i]);
-			}
-			for (; i < f; ++i) { // second half of the new pixels, hope the compiler unrolls this
-				out[y*outw + x*f + i] = MIX_PIXELS(right, center, BILINEAR_FACTORS[f - 2][f - 1 - i]);
-			}
+		int x = 0;
+		if (simd && w > 2) {
+			bilinearHPixel<f>(data, out, w, y, 0);
+			x = bilinearHRow<f>(data, out, w, y);
+		}
+		for (; x < w; ++x) {
+			bilinearHPixel<f>(data, out, w, y, x);
 		}
 	}
 }
-void bilinearH(int factor, u32* data, u32* out, int w, int l, int u) {
+void bilinearH(bool simd, int factor, u32* data, u32* out, int w, int l, int u) {
 	switch (factor) {
-	case 2: bilinearHt<2>(data, out, w, l, u); break;
-	case 3: bilinearHt<3>(data, out, w, l, u); break;
-	case 4: bilinearHt<4>(data, out, w, l, u); break;
-	case 5: bilinearHt<5>(data, out, w, l, u); break;
+	case 2: bilinearHt<2>(simd, data, out, w, l, u); break;
+	case 3: bilinearHt<3>(simd, data, out, w, l, u); break;
+	case 4: bilinearHt<4>(simd, data, out, w, l, u); break;
+	case 5: bilinearHt<5>(simd, data, out, w, l, u); break;
 	default: ERROR_LOG(G3D, "Bilinear upsampling only implemented for factors 2 to 5");
 	}
 }
+template<int f>
+inline void bilinearVPixel(const u32 *data, u32 *out, int outw, u32 uy, int y, u32 ly, int x) {
+	u32 upper = data[uy * outw + x];
+	u32 center = data[y * outw + x];
+	u32 lower = data[ly * outw + x];
+	int i = 0;
+	for (; i < f / 2 + f % 2; ++i) { // first half of the new pixels + center, hope the compiler unrolls this
+		out[(y*f + i)*outw + x] = MIX_PIXELS(upper, center, BILINEAR_FACTORS[f - 2][i]);
+	}
+	for (; i < f; ++i) { // second half of the new pixels, hope the compiler unrolls this
+		out[(y*f + i)*outw + x] = MIX_PIXELS(lower, center, BILINEAR_FACTORS[f - 2][f - 1 - i]);
+	}
+}
+
 // integral bilinear upscaling by factor f, vertical part
 // gl/gu == global lower and upper bound
 template<int f>
-void bilinearVt(u32* data, u32* out, int w, int gl, int gu, int l, int u) {
+void bilinearVt(bool simd, u32* data, u32* out, int w, int gl, int gu, int l, int u) {
 	static_assert(f>1 && f <= 5, "Bilinear scaling only implemented for 2x, 3x, 4x, and 5x");
 	int outw = w*f;
+	if (simd) {
+		// Whole rows at a time, the SIMD loads are contiguous anyway.
+		for (int y = l; y < u; ++y) {
+			u32 uy = y - (y == gl ? 0 : 1);
+			u32 ly = y + (y == gu - 1 ? 0 : 1);
+			int x = bilinearVRow<f>(data + uy * outw, data + y * outw, data + ly * outw, out + y*f*outw, outw);
+			for (; x < outw; ++x) {
+				bilinearVPixel<f>(data, out, outw, uy, y, ly, x);
+			}
+		}
+		return;
+	}
+
 	for (int xb = 0; xb < outw / BLOCK_SIZE + 1; ++xb) {
 		for (int y = l; y < u; ++y) {
 			u32 uy = y - (y == gl ? 0 : 1);
 			u32 ly = y + (y == gu - 1 ? 0 : 1);
 			for (int x = xb*BLOCK_SIZE; x < (xb + 1)*BLOCK_SIZE && x < outw; ++x) {
-				u32 upper = data[uy * outw + x];
-				u32 center = data[y * outw + x];
-				u32 lower = data[ly * outw + x];
-				int i = 0;
-				for (; i < f / 2 + f % 2; ++i) { // first half of the new pixels + center, hope the compiler unrolls this
-					out[(y*f + i)*outw + x] = MIX_PIXELS(upper, center, BILINEAR_FACTORS[f - 2][i]);
-				}
-				for (; i < f; ++i) { // second half of the new pixels, hope the compiler unrolls this
-					out[(y*f + i)*outw + x] = MIX_PIXELS(lower, center, BILINEAR_FACTORS[f - 2][f - 1 - i]);
-				}
+				bilinearVPixel<f>(data, out, outw, uy, y, ly, x);
 			}
 		}
 	}
 }
-void bilinearV(int factor, u32* data, u32* out, int w, int gl, int gu, int l, int u) {
+void bilinearV(bool simd, int factor, u32* data, u32* out, int w, int gl, int gu, int l, int u) {
 	switch (factor) {
-	case 2: bilinearVt<2>(data, out, w, gl, gu, l, u); break;
-	case 3: bilinearVt<3>(data, out, w, gl, gu, l, u); break;
-	case 4: bilinearVt<4>(data, out, w, gl, gu, l, u); break;
-	case 5: bilinearVt<5>(data, out, w, gl, gu, l, u); break;
+	case 2: bilinearVt<2>(simd, data, out, w, gl, gu, l, u); break;
+	case 3: bilinearVt<3>(simd, data, out, w, gl, gu, l, u); break;
+	case 4: bilinearVt<4>(simd, data, out, w, gl, gu, l, u); break;
+	case 5: bilinearVt<5>(simd, data, out, w, gl, gu, l, u); break;
 	default: ERROR_LOG(G3D, "Bilinear upsampling only implemented for factors 2 to 5");
 	}
 }
@@ -492,13 +862,31 @@ void dbgPGM(int w, int h, u32* pixels, const char* prefix = "dbg") { // 1 compon
 
 }
 
+static void RunLoop(bool parallel, const std::function<void(int, int)> &loop, int lower, int upper) {
+	if (parallel) {
+		GlobalThreadPool::Loop(loop, lower, upper);
+	} else {
+		loop(lower, upper);
+	}
+}
+
 /////////////////////////////////////// Texture Scaler
 
-TextureScalerCommon::TextureScalerCommon() {
+TextureScalerCommon::TextureScalerCommon(bool useSIMD) : useSIMD_(useSIMD) {
 	initBicubicWeights();
+	// The async thread is a worker of its own.  In the global pool, the emu thread would wait behind its jobs.
+	asyncBufs_.parallel = false;
 }
 
 TextureScalerCommon::~TextureScalerCommon() {
+	if (asyncThread_.joinable()) {
+		{
+			std::lock_guard<std::mutex> guard(asyncLock_);
+			asyncExit_ = true;
+		}
+		asyncCond_.notify_one();
+		asyncThread_.join();
+	}
 }
 
 bool TextureScalerCommon::IsEmptyOrFlat(u32* data, int pixels, int fmt) {
@@ -553,45 +941,50 @@ bool TextureScalerCommon::ScaleInto(u32 *outputBuf, u32 *src, u32 &dstFmt, int &
 	// convert texture to correct format for scaling
 	ConvertTo8888(dstFmt, src, inputBuf, width, height);
 
+	ScaleConverted(scaleBufs_, outputBuf, inputBuf, width, height, factor);
+
+	// update values accordingly
+	dstFmt = Get8888Format();
+	width *= factor;
+	height *= factor;
+
+#ifdef SCALING_MEASURE_TIME
+	if (width*height > 64 * 64 * factor*factor) {
+		double t = real_time_now() - t_start;
+		NOTICE_LOG(G3D, "TextureScaler: processed %9d pixels in %6.5lf seconds. (%9.2lf Mpixels/second)",
+			width*height, t, (width*height) / (t * 1000 * 1000));
+	}
+#endif
+
+	return true;
+}
+
+// Expects 8888 input.  Doesn't call any virtuals, so the async thread can use it.
+void TextureScalerCommon::ScaleConverted(ScaleBuffers &bufs, u32 *outputBuf, u32 *inputBuf, int width, int height, int factor) {
 	// deposterize
 	if (g_Config.bTexDeposterize) {
-		bufDeposter.resize(width*height);
-		DePosterize(inputBuf, bufDeposter.data(), width, height);
-		inputBuf = bufDeposter.data();
+		bufs.deposter.resize(width*height);
+		DePosterize(bufs, inputBuf, bufs.deposter.data(), width, height);
+		inputBuf = bufs.deposter.data();
 	}
 
 	// scale 
 	switch (g_Config.iTexScalingType) {
 	case XBRZ:
-		ScaleXBRZ(factor, inputBuf, outputBuf, width, height);
+		ScaleXBRZ(bufs, factor, inputBuf, outputBuf, width, height);
 		break;
 	case HYBRID:
-		ScaleHybrid(factor, inputBuf, outputBuf, width, height);
+		ScaleHybrid(bufs, factor, inputBuf, outputBuf, width, height);
 		break;
 	case BICUBIC:
-		ScaleBicubicMitchell(factor, inputBuf, outputBuf, width, height);
+		ScaleBicubicMitchell(bufs, factor, inputBuf, outputBuf, width, height);
 		break;
 	case HYBRID_BICUBIC:
-		ScaleHybrid(factor, inputBuf, outputBuf, width, height, true);
+		ScaleHybrid(bufs, factor, inputBuf, outputBuf, width, height, true);
 		break;
 	default:
 		ERROR_LOG(G3D, "Unknown scaling type: %d", g_Config.iTexScalingType);
 	}
-
-	// update values accordingly
-	dstFmt = Get8888Format();
-	width *= factor;
-	height *= factor;
-
-#ifdef SCALING_MEASURE_TIME
-	if (width*height > 64 * 64 * factor*factor) {
-		double t = real_time_now() - t_start;
-		NOTICE_LOG(G3D, "TextureScaler: processed %9d pixels in %6.5lf seconds. (%9.2lf Mpixels/second)",
-			width*height, t, (width*height) / (t * 1000 * 1000));
-	}
-#endif
-
-	return true;
 }
 
 bool TextureScalerCommon::Scale(u32* &data, u32 &dstFmt, int &width, int &height, int factor) {
@@ -612,27 +1005,168 @@ bool TextureScalerCommon::Scale(u32* &data, u32 &dstFmt, int &width, int &height
 	return false;
 }
 
-void TextureScalerCommon::ScaleXBRZ(int factor, u32* source, u32* dest, int width, int height) {
+void TextureScalerCommon::QueueAsync(const AsyncKey &key, const u32 *src, int srcPitch, u32 srcFmt, int width, int height, int factor) {
+	{
+		std::lock_guard<std::mutex> guard(asyncLock_);
+		if (asyncPending_.count(key) || asyncResults_.count(key)) {
+			return;
+		}
+	}
+
+	// Gather the rows (srcPitch is in bytes) so ConvertTo8888 sees a tight image.
+	const int rowBytes = width * BytesPerPixel(srcFmt);
+	std::vector<u32> packed((rowBytes * height + 3) / 4);
+	for (int y = 0; y < height; ++y) {
+		memcpy((u8 *)packed.data() + rowBytes * y, (const u8 *)src + srcPitch * y, rowBytes);
+	}
+
+	if (IsEmptyOrFlat(packed.data(), width * height, srcFmt)) {
+		// This is quick, so just do it now.
+		AsyncResult result;
+		result.fmt = srcFmt;
+		result.width = width;
+		result.height = height;
+		result.factor = factor;
+		result.data.resize(width * height * factor * factor);
+		ScaleAlways(result.data.data(), packed.data(), result.fmt, result.width, result.height, factor);
+
+		std::lock_guard<std::mutex> guard(asyncLock_);
+		result.lastFrame = asyncFrame_;
+		asyncResultBytes_ += result.data.size() * sizeof(u32);
+		asyncResults_[key] = std::move(result);
+		return;
+	}
+
+	// Convert here, since the virtuals aren't safe to call from the async thread.
+	AsyncJob job;
+	job.key = key;
+	job.fmt = Get8888Format();
+	job.width = width;
+	job.height = height;
+	job.factor = factor;
+	job.src.resize(width * height);
+	u32 *converted = job.src.data();
+	ConvertTo8888(srcFmt, packed.data(), converted, width, height);
+	if (converted != job.src.data()) {
+		memcpy(job.src.data(), converted, width * height * sizeof(u32));
+	}
+
+	std::lock_guard<std::mutex> guard(asyncLock_);
+	job.generation = asyncGeneration_;
+	asyncPending_.insert(key);
+	asyncJobs_.push_back(std::move(job));
+	if (!asyncThread_.joinable()) {
+		asyncThread_ = std::thread([this] { AsyncThreadFunc(); });
+	}
+	asyncCond_.notify_one();
+}
+
+bool TextureScalerCommon::IsAsyncReady(const AsyncKey &key) {
+	std::lock_guard<std::mutex> guard(asyncLock_);
+	return asyncResults_.count(key) != 0;
+}
+
+bool TextureScalerCommon::CopyAsyncResult(const AsyncKey &key, u32 *out, u32 &dstFmt, int &width, int &height, int factor) {
+	std::lock_guard<std::mutex> guard(asyncLock_);
+	auto it = asyncResults_.find(key);
+	if (it == asyncResults_.end()) {
+		return false;
+	}
+	AsyncResult &result = it->second;
+	if (result.factor != factor || result.width != width * factor || result.height != height * factor) {
+		return false;
+	}
+
+	memcpy(out, result.data.data(), result.data.size() * sizeof(u32));
+	result.lastFrame = asyncFrame_;
+	dstFmt = result.fmt;
+	width = result.width;
+	height = result.height;
+	return true;
+}
+
+void TextureScalerCommon::StartFrame() {
+	std::lock_guard<std::mutex> guard(asyncLock_);
+	asyncFrame_++;
+	asyncTimeThisFrame_ = 0.0;
+
+	for (auto it = asyncResults_.begin(); it != asyncResults_.end(); ) {
+		const bool tooOld = asyncFrame_ - it->second.lastFrame > ASYNC_SCALE_KEEP_FRAMES;
+		if (tooOld || asyncResultBytes_ > ASYNC_SCALE_MAX_BYTES) {
+			asyncResultBytes_ -= it->second.data.size() * sizeof(u32);
+			it = asyncResults_.erase(it);
+		} else {
+			++it;
+		}
+	}
+	asyncCond_.notify_one();
+}
+
+void TextureScalerCommon::ClearAsync() {
+	std::lock_guard<std::mutex> guard(asyncLock_);
+	// Anything in progress is dropped when it finishes, even if the same key was queued again since.
+	asyncGeneration_++;
+	asyncJobs_.clear();
+	asyncPending_.clear();
+	asyncResults_.clear();
+	asyncResultBytes_ = 0;
+}
+
+void TextureScalerCommon::AsyncThreadFunc() {
+	std::unique_lock<std::mutex> guard(asyncLock_);
+	while (!asyncExit_) {
+		if (asyncJobs_.empty() || asyncTimeThisFrame_ >= ASYNC_SCALE_BUDGET_PER_FRAME) {
+			asyncCond_.wait(guard);
+			continue;
+		}
+
+		AsyncJob job = std::move(asyncJobs_.front());
+		asyncJobs_.pop_front();
+		guard.unlock();
+
+		double start = real_time_now();
+		AsyncResult result;
+		result.fmt = job.fmt;
+		result.width = job.width;
+		result.height = job.height;
+		result.factor = job.factor;
+		result.data.resize(job.width * job.height * job.factor * job.factor);
+		ScaleConverted(asyncBufs_, result.data.data(), job.src.data(), job.width, job.height, job.factor);
+		result.width *= job.factor;
+		result.height *= job.factor;
+		double elapsed = real_time_now() - start;
+
+		guard.lock();
+		asyncTimeThisFrame_ += elapsed;
+		if (job.generation == asyncGeneration_ && asyncPending_.erase(job.key) != 0) {
+			result.lastFrame = asyncFrame_;
+			asyncResultBytes_ += result.data.size() * sizeof(u32);
+			asyncResults_[job.key] = std::move(result);
+		}
+	}
+}
+
+void TextureScalerCommon::ScaleXBRZ(ScaleBuffers &bufs, int factor, u32* source, u32* dest, int width, int height) {
 	xbrz::ScalerCfg cfg;
-	GlobalThreadPool::Loop(std::bind(&xbrz::scale, factor, source, dest, width, height, xbrz::ColorFormat::ARGB, cfg, std::placeholders::_1, std::placeholders::_2), 0, height);
+	RunLoop(bufs.parallel, std::bind(&xbrz::scale, factor, source, dest, width, height, xbrz::ColorFormat::ARGB, cfg, std::placeholders::_1, std::placeholders::_2), 0, height);
 }
 
-void TextureScalerCommon::ScaleBilinear(int factor, u32* source, u32* dest, int width, int height) {
-	bufTmp1.resize(width*height*factor);
-	u32 *tmpBuf = bufTmp1.data();
-	GlobalThreadPool::Loop(std::bind(&bilinearH, factor, source, tmpBuf, width, std::placeholders::_1, std::placeholders::_2), 0, height);
-	GlobalThreadPool::Loop(std::bind(&bilinearV, factor, tmpBuf, dest, width, 0, height, std::placeholders::_1, std::placeholders::_2), 0, height);
+void TextureScalerCommon::ScaleBilinear(ScaleBuffers &bufs, int factor, u32* source, u32* dest, int width, int height) {
+	bufs.tmp1.resize(width*height*factor);
+	u32 *tmpBuf = bufs.tmp1.data();
+	RunLoop(bufs.parallel, std::bind(&bilinearH, useSIMD_, factor, source, tmpBuf, width, std::placeholders::_1, std::placeholders::_2), 0, height);
+	RunLoop(bufs.parallel, std::bind(&bilinearV, useSIMD_, factor, tmpBuf, dest, width, 0, height, std::placeholders::_1, std::placeholders::_2), 0, height);
 }
 
-void TextureScalerCommon::ScaleBicubicBSpline(int factor, u32* source, u32* dest, int width, int height) {
-	GlobalThreadPool::Loop(std::bind(&scaleBicubicBSpline, factor, source, dest, width, height, std::placeholders::_1, std::placeholders::_2), 0, height);
+void TextureScalerCommon::ScaleBicubicBSpline(ScaleBuffers &bufs, int factor, u32* source, u32* dest, int width, int height) {
+	RunLoop(bufs.parallel, std::bind(&scaleBicubicBSpline, useSIMD_, factor, source, dest, width, height, std::placeholders::_1, std::placeholders::_2), 0, height);
 }
 
-void TextureScalerCommon::ScaleBicubicMitchell(int factor, u32* source, u32* dest, int width, int height) {
-	GlobalThreadPool::Loop(std::bind(&scaleBicubicMitchell, factor, source, dest, width, height, std::placeholders::_1, std::placeholders::_2), 0, height);
+void TextureScalerCommon::ScaleBicubicMitchell(ScaleBuffers &bufs, int factor, u32* source, u32* dest, int width, int height) {
+	RunLoop(bufs.parallel, std::bind(&scaleBicubicMitchell, useSIMD_, factor, source, dest, width, height, std::placeholders::_1, std::placeholders::_2), 0, height);
 }
 
-void TextureScalerCommon::ScaleHybrid(int factor, u32* source, u32* dest, int width, int height, bool bicubic) {
+void TextureScalerCommon::ScaleHybrid(ScaleBuffers &bufs, int factor, u32* source, u32* dest, int width, int height, bool bicubic) {
 	// Basic algorithm:
 	// 1) determine a feature mask C based on a sobel-ish filter + splatting, and upscale that mask bilinearly
 	// 2) generate 2 scaled images: A - using Bilinear filtering, B - using xBRZ
@@ -642,30 +1176,30 @@ void TextureScalerCommon::ScaleHybrid(int factor, u32* source, u32* dest, int wi
 			{ 1, 1, 1 }, { 1, 1, 1 }, { 1, 1, 1 }
 	};
 
-	bufTmp1.resize(width*height);
-	bufTmp2.resize(width*height*factor*factor);
-	bufTmp3.resize(width*height*factor*factor);
-	GlobalThreadPool::Loop(std::bind(&generateDistanceMask, source, bufTmp1.data(), width, height, std::placeholders::_1, std::placeholders::_2), 0, height);
-	GlobalThreadPool::Loop(std::bind(&convolve3x3, bufTmp1.data(), bufTmp2.data(), KERNEL_SPLAT, width, height, std::placeholders::_1, std::placeholders::_2), 0, height);
-	ScaleBilinear(factor, bufTmp2.data(), bufTmp3.data(), width, height);
-	// mask C is now in bufTmp3
+	bufs.tmp1.resize(width*height);
+	bufs.tmp2.resize(width*height*factor*factor);
+	bufs.tmp3.resize(width*height*factor*factor);
+	RunLoop(bufs.parallel, std::bind(&generateDistanceMask, useSIMD_, source, bufs.tmp1.data(), width, height, std::placeholders::_1, std::placeholders::_2), 0, height);
+	RunLoop(bufs.parallel, std::bind(&convolve3x3, useSIMD_, bufs.tmp1.data(), bufs.tmp2.data(), KERNEL_SPLAT, width, height, std::placeholders::_1, std::placeholders::_2), 0, height);
+	ScaleBilinear(bufs, factor, bufs.tmp2.data(), bufs.tmp3.data(), width, height);
+	// mask C is now in bufs.tmp3
 
-	ScaleXBRZ(factor, source, bufTmp2.data(), width, height);
-	// xBRZ upscaled source is in bufTmp2
+	ScaleXBRZ(bufs, factor, source, bufs.tmp2.data(), width, height);
+	// xBRZ upscaled source is in bufs.tmp2
 
-	if (bicubic) ScaleBicubicBSpline(factor, source, dest, width, height);
-	else ScaleBilinear(factor, source, dest, width, height);
+	if (bicubic) ScaleBicubicBSpline(bufs, factor, source, dest, width, height);
+	else ScaleBilinear(bufs, factor, source, dest, width, height);
 	// Upscaled source is in dest
 
 	// Now we can mix it all together
 	// The factor 8192 was found through practical testing on a variety of textures
-	GlobalThreadPool::Loop(std::bind(&mix, dest, bufTmp2.data(), bufTmp3.data(), 8192, width*factor, std::placeholders::_1, std::placeholders::_2), 0, height*factor);
+	RunLoop(bufs.parallel, std::bind(&mix, useSIMD_, dest, bufs.tmp2.data(), bufs.tmp3.data(), 8192, width*factor, std::placeholders::_1, std::placeholders::_2), 0, height*factor);
 }
 
-void TextureScalerCommon::DePosterize(u32* source, u32* dest, int width, int height) {
-	bufTmp3.resize(width*height);
-	GlobalThreadPool::Loop(std::bind(&deposterizeH, source, bufTmp3.data(), width, std::placeholders::_1, std::placeholders::_2), 0, height);
-	GlobalThreadPool::Loop(std::bind(&deposterizeV, bufTmp3.data(), dest, width, height, std::placeholders::_1, std::placeholders::_2), 0, height);
-	GlobalThreadPool::Loop(std::bind(&deposterizeH, dest, bufTmp3.data(), width, std::placeholders::_1, std::placeholders::_2), 0, height);
-	GlobalThreadPool::Loop(std::bind(&deposterizeV, bufTmp3.data(), dest, width, height, std::placeholders::_1, std::placeholders::_2), 0, height);
+void TextureScalerCommon::DePosterize(ScaleBuffers &bufs, u32* source, u32* dest, int width, int height) {
+	bufs.tmp3.resize(width*height);
+	RunLoop(bufs.parallel, std::bind(&deposterizeH, source, bufs.tmp3.data(), width, std::placeholders::_1, std::placeholders::_2), 0, height);
+	RunLoop(bufs.parallel, std::bind(&deposterizeV, bufs.tmp3.data(), dest, width, height, std::placeholders::_1, std::placeholders::_2), 0, height);
+	RunLoop(bufs.parallel, std::bind(&deposterizeH, dest, bufs.tmp3.data(), width, std::placeholders::_1, std::placeholders::_2), 0, height);
+	RunLoop(bufs.parallel, std::bind(&deposterizeV, bufs.tmp3.data(), dest, width, height, std::placeholders::_1, std::placeholders::_2), 0, height);
 }
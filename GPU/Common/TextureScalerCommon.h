@@ -20,17 +20,46 @@
 #include "Common/CommonTypes.h"
 #include "Common/MemoryUtil.h"
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 class TextureScalerCommon {
 public:
-	TextureScalerCommon();
+	// Identifies a texture by its content.  Each field has its own bits, so different textures can't share a key.
+	struct AsyncKey {
+		u64 hash;
+		u32 dim;
+		u32 format;
+
+		bool operator ==(const AsyncKey &other) const {
+			return hash == other.hash && dim == other.dim && format == other.format;
+		}
+	};
+
+	// The filter kernels use SSE2/NEON where possible.  Tests turn this off to compare against the plain versions.
+	// Everything matches exactly, except bicubic which may round differently by 1 per channel.
+	explicit TextureScalerCommon(bool useSIMD = true);
 	~TextureScalerCommon();
 
 	void ScaleAlways(u32 *out, u32 *src, u32 &dstFmt, int &width, int &height, int factor);
 	bool Scale(u32 *&data, u32 &dstfmt, int &width, int &height, int factor);
 	bool ScaleInto(u32 *out, u32 *src, u32 &dstfmt, int &width, int &height, int factor);
 
+	// Async scaling: the caller keeps using the unscaled texture while a background thread scales it.
+	// Results are kept by content key, so identical textures at different addresses are only scaled once.
+	void QueueAsync(const AsyncKey &key, const u32 *src, int srcPitch, u32 srcFmt, int width, int height, int factor);
+	bool IsAsyncReady(const AsyncKey &key);
+	// Same contract as ScaleAlways.  Returns false if there's no finished result for this key and factor.
+	bool CopyAsyncResult(const AsyncKey &key, u32 *out, u32 &dstFmt, int &width, int &height, int factor);
+	// Resets the per-frame time budget of the async thread and drops stale results.
+	void StartFrame();
+	void ClearAsync();
+
 	enum { XBRZ = 0, HYBRID = 1, BICUBIC = 2, HYBRID_BICUBIC = 3 };
 
 protected:
@@ -38,18 +67,69 @@ class TextureScalerCommon {
 	virtual int BytesPerPixel(u32 format) = 0;
 	virtual u32 Get8888Format() = 0;
 
-	void ScaleXBRZ(int factor, u32* source, u32* dest, int width, int height);
-	void ScaleBilinear(int factor, u32* source, u32* dest, int width, int height);
-	void ScaleBicubicBSpline(int factor, u32* source, u32* dest, int width, int height);
-	void ScaleBicubicMitchell(int factor, u32* source, u32* dest, int width, int height);
-	void ScaleHybrid(int factor, u32* source, u32* dest, int width, int height, bool bicubic = false);
+	// Scratch space for the filters.  The async thread has its own, so it never waits on the emu thread.
+	struct ScaleBuffers {
+		SimpleBuf<u32> deposter, tmp1, tmp2, tmp3;
+		// Whether to split the work over the global thread pool.
+		bool parallel = true;
+	};
+
+	void ScaleConverted(ScaleBuffers &bufs, u32 *outputBuf, u32 *inputBuf, int width, int height, int factor);
+	void ScaleXBRZ(ScaleBuffers &bufs, int factor, u32* source, u32* dest, int width, int height);
+	void ScaleBilinear(ScaleBuffers &bufs, int factor, u32* source, u32* dest, int width, int height);
+	void ScaleBicubicBSpline(ScaleBuffers &bufs, int factor, u32* source, u32* dest, int width, int height);
+	void ScaleBicubicMitchell(ScaleBuffers &bufs, int factor, u32* source, u32* dest, int width, int height);
+	void ScaleHybrid(ScaleBuffers &bufs, int factor, u32* source, u32* dest, int width, int height, bool bicubic = false);
 
-	void DePosterize(u32* source, u32* dest, int width, int height);
+	void DePosterize(ScaleBuffers &bufs, u32* source, u32* dest, int width, int height);
 
 	bool IsEmptyOrFlat(u32* data, int pixels, int fmt);
 
+	void AsyncThreadFunc();
+
+	struct AsyncKeyHash {
+		size_t operator()(const AsyncKey &key) const {
+			return (size_t)(key.hash ^ (((u64)key.dim << 32 | key.format) * 0x9E3779B97F4A7C15ULL));
+		}
+	};
+
+	struct AsyncJob {
+		AsyncKey key;
+		// Results from before the last ClearAsync() are dropped.
+		u32 generation;
+		std::vector<u32> src;
+		u32 fmt;
+		int width;
+		int height;
+		int factor;
+	};
+	struct AsyncResult {
+		std::vector<u32> data;
+		u32 fmt;
+		int width;
+		int height;
+		int factor;
+		int lastFrame;
+	};
+
 	// depending on the factor and texture sizes, these can get pretty large 
 	// maximum is (100 MB total for a 512 by 512 texture with scaling factor 5 and hybrid scaling)
 	// of course, scaling factor 5 is totally silly anyway
-	SimpleBuf<u32> bufInput, bufDeposter, bufOutput, bufTmp1, bufTmp2, bufTmp3;
+	SimpleBuf<u32> bufInput, bufOutput;
+	ScaleBuffers scaleBufs_;
+	const bool useSIMD_;
+	// Only used by the async thread.
+	ScaleBuffers asyncBufs_;
+
+	std::thread asyncThread_;
+	std::mutex asyncLock_;
+	std::condition_variable asyncCond_;
+	std::deque<AsyncJob> asyncJobs_;
+	std::unordered_set<AsyncKey, AsyncKeyHash> asyncPending_;
+	std::unordered_map<AsyncKey, AsyncResult, AsyncKeyHash> asyncResults_;
+	size_t asyncResultBytes_ = 0;
+	double asyncTimeThisFrame_ = 0.0;
+	int asyncFrame_ = 0;
+	u32 asyncGeneration_ = 0;
+	bool asyncExit_ = false;
 };
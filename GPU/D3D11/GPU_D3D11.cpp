@@ -35,11 +35,14 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include <set>
+#include <thread>
 
 #include "Common/ChunkFile.h"
+#include "Common/FileUtil.h"
 #include "Common/GraphicsContext.h"
 #include "base/NativeApp.h"
 #include "base/logging.h"
+#include "base/timeutil.h"
 #include "profiler/profiler.h"
 #include "i18n/i18n.h"
 #include "Core/Debugger/Breakpoints.h"
@@ -48,6 +51,7 @@
 #include "Core/Config.h"
 #include "Core/Reporting.h"
 #include "Core/System.h"
+#include "Core/ELF/ParamSFO.h"
 
 #include "GPU/GPUState.h"
 #include "GPU/ge_constants.h"
@@ -110,9 +114,60 @@ GPU_D3D11::GPU_D3D11(GraphicsContext *gfxCtx, Draw::DrawContext *draw)
 	// Some of our defaults are different from hw defaults, let's assert them.
 	// We restore each frame anyway, but here is convenient for tests.
 	textureCache_->NotifyConfigChanged();
+
+	// Load shader cache.
+	std::string discID = g_paramSFO.GetDiscID();
+	if (discID.size()) {
+		File::CreateFullPath(GetSysDirectory(DIRECTORY_APP_CACHE));
+		shaderCachePath_ = GetSysDirectory(DIRECTORY_APP_CACHE) + "/" + discID + ".d3d11shadercache";
+		shaderCacheLoaded_ = false;
+
+		std::thread th([&] {
+			LoadCache(shaderCachePath_);
+			shaderCacheLoaded_ = true;
+		});
+		th.detach();
+	} else {
+		shaderCacheLoaded_ = true;
+	}
+}
+
+bool GPU_D3D11::IsReady() {
+	return shaderCacheLoaded_;
+}
+
+void GPU_D3D11::CancelReady() {
+	// The compile is one parallel loop, so there's nothing to cut short.
+}
+
+void GPU_D3D11::LoadCache(std::string filename) {
+	PSP_SetLoading("Loading shader cache...");
+	FILE *f = File::OpenCFile(filename, "rb");
+	if (!f)
+		return;
+	bool result = shaderManagerD3D11_->LoadCache(f);
+	fclose(f);
+	if (!result) {
+		WARN_LOG(G3D, "Bad D3D11 shader cache");
+		File::Delete(filename);
+	}
+}
+
+void GPU_D3D11::SaveCache(std::string filename) {
+	if (filename.empty() || !shaderManagerD3D11_->IsCacheDirty())
+		return;
+	FILE *f = File::OpenCFile(filename, "wb");
+	if (!f)
+		return;
+	shaderManagerD3D11_->SaveCache(f);
+	fclose(f);
 }
 
 GPU_D3D11::~GPU_D3D11() {
+	while (!IsReady()) {
+		sleep_ms(10);
+	}
+	SaveCache(shaderCachePath_);
 	delete depalShaderCache_;
 	framebufferManagerD3D11_->DestroyAllFBOs();
 	delete framebufferManagerD3D11_;
@@ -198,6 +253,10 @@ void GPU_D3D11::BuildReportingInfo() {
 }
 
 void GPU_D3D11::DeviceLost() {
+	while (!IsReady()) {
+		sleep_ms(10);
+	}
+	SaveCache(shaderCachePath_);
 	// Simply drop all caches and textures.
 	// FBOs appear to survive? Or no?
 	shaderManagerD3D11_->ClearShaders();
@@ -303,7 +362,7 @@ void GPU_D3D11::ExecuteOp(u32 op, u32 diff) {
 	if ((cmdFlags & FLAG_EXECUTE) || (diff && (cmdFlags & FLAG_EXECUTEONCHANGE))) {
 		(this->*info.func)(op, diff);
 	} else if (diff) {
-		uint64_t dirty = info.flags >> 8;
+		uint64_t dirty = ShaderDirtyForWrite(cmd, diff, info.flags >> 8);
 		if (dirty)
 			gstate_c.Dirty(dirty);
 	}
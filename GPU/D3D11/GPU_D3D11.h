@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <list>
 #include <deque>
 #include <d3d11.h>
@@ -36,6 +37,9 @@ class GPU_D3D11 : public GPUCommon {
 	GPU_D3D11(GraphicsContext *gfxCtx, Draw::DrawContext *draw);
 	~GPU_D3D11();
 
+	bool IsReady() override;
+	void CancelReady() override;
+
 	void CheckGPUFeatures() override;
 	void PreExecuteOp(u32 op, u32 diff) override;
 	void ExecuteOp(u32 op, u32 diff) override;
@@ -69,6 +73,9 @@ class GPU_D3D11 : public GPUCommon {
 	void CheckFlushOp(int cmd, u32 diff);
 	void BuildReportingInfo();
 
+	void LoadCache(std::string filename);
+	void SaveCache(std::string filename);
+
 	void InitClear() override;
 	void BeginFrame() override;
 	void CopyDisplayToOutput(bool reallyDirty) override;
@@ -81,4 +88,7 @@ class GPU_D3D11 : public GPUCommon {
 	DepalShaderCacheD3D11 *depalShaderCache_;
 	DrawEngineD3D11 drawEngine_;
 	ShaderManagerD3D11 *shaderManagerD3D11_;
+
+	std::string shaderCachePath_;
+	std::atomic<bool> shaderCacheLoaded_{};
 };
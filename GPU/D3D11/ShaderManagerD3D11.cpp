@@ -21,6 +21,7 @@
 #include <d3dcompiler.h>
 
 #include <map>
+#include <memory>
 
 #include "base/logging.h"
 #include "math/lin/matrix4x4.h"
@@ -29,6 +30,7 @@
 #include "thin3d/thin3d.h"
 #include "util/text/utf8.h"
 #include "Common/Common.h"
+#include "Common/ThreadPools.h"
 #include "Core/Config.h"
 #include "Core/Reporting.h"
 #include "GPU/Math3D.h"
@@ -39,6 +41,8 @@
 #include "GPU/D3D11/VertexShaderGeneratorD3D11.h"
 #include "GPU/D3D11/D3D11Util.h"
 
+static const size_t CODE_BUFFER_SIZE = 16384;
+
 D3D11FragmentShader::D3D11FragmentShader(ID3D11Device *device, D3D_FEATURE_LEVEL featureLevel, FShaderID id, const char *code, bool useHWTransform)
 	: device_(device), id_(id), failed_(false), useHWTransform_(useHWTransform), module_(0) {
 	source_ = code;
@@ -91,7 +95,7 @@ std::string D3D11VertexShader::GetShaderString(DebugShaderStringType type) const
 
 ShaderManagerD3D11::ShaderManagerD3D11(Draw::DrawContext *draw, ID3D11Device *device, ID3D11DeviceContext *context, D3D_FEATURE_LEVEL featureLevel)
 	: ShaderManagerCommon(draw), device_(device), context_(context), featureLevel_(featureLevel), lastVShader_(nullptr), lastFShader_(nullptr) {
-	codeBuffer_ = new char[16384];
+	codeBuffer_ = new char[CODE_BUFFER_SIZE];
 	memset(&ub_base, 0, sizeof(ub_base));
 	memset(&ub_lights, 0, sizeof(ub_lights));
 	memset(&ub_bones, 0, sizeof(ub_bones));
@@ -125,6 +129,8 @@ void ShaderManagerD3D11::Clear() {
 	}
 	fsCache_.clear();
 	vsCache_.clear();
+	fsLookaside_.Clear();
+	vsLookaside_.Clear();
 	lastFSID_.set_invalid();
 	lastVSID_.set_invalid();
 	gstate_c.Dirty(DIRTY_VERTEXSHADER_STATE | DIRTY_FRAGMENTSHADER_STATE);
@@ -204,27 +210,35 @@ void ShaderManagerD3D11::GetShaders(int prim, u32 vertType, D3D11VertexShader **
 		return;
 	}
 
-	VSCache::iterator vsIter = vsCache_.find(VSID);
-	D3D11VertexShader *vs;
-	if (vsIter == vsCache_.end()) {
-		// Vertex shader not in cache. Let's compile it.
-		GenerateVertexShaderD3D11(VSID, codeBuffer_, featureLevel_ <= D3D_FEATURE_LEVEL_9_3 ? HLSL_D3D11_LEVEL9 : HLSL_D3D11);
-		vs = new D3D11VertexShader(device_, featureLevel_, VSID, codeBuffer_, vertType, useHWTransform);
-		vsCache_[VSID] = vs;
-	} else {
-		vs = vsIter->second;
+	D3D11VertexShader *vs = vsLookaside_.Get(VSID);
+	if (!vs) {
+		VSCache::iterator vsIter = vsCache_.find(VSID);
+		if (vsIter == vsCache_.end()) {
+			// Vertex shader not in cache. Let's compile it.
+			GenerateVertexShaderD3D11(VSID, codeBuffer_, featureLevel_ <= D3D_FEATURE_LEVEL_9_3 ? HLSL_D3D11_LEVEL9 : HLSL_D3D11);
+			vs = new D3D11VertexShader(device_, featureLevel_, VSID, codeBuffer_, vertType, useHWTransform);
+			vsCache_[VSID] = vs;
+			history_.Add(VSID);
+		} else {
+			vs = vsIter->second;
+		}
+		vsLookaside_.Add(VSID, vs);
 	}
 	lastVSID_ = VSID;
 
-	FSCache::iterator fsIter = fsCache_.find(FSID);
-	D3D11FragmentShader *fs;
-	if (fsIter == fsCache_.end()) {
-		// Fragment shader not in cache. Let's compile it.
-		GenerateFragmentShaderD3D11(FSID, codeBuffer_, featureLevel_ <= D3D_FEATURE_LEVEL_9_3 ? HLSL_D3D11_LEVEL9 : HLSL_D3D11);
-		fs = new D3D11FragmentShader(device_, featureLevel_, FSID, codeBuffer_, useHWTransform);
-		fsCache_[FSID] = fs;
-	} else {
-		fs = fsIter->second;
+	D3D11FragmentShader *fs = fsLookaside_.Get(FSID);
+	if (!fs) {
+		FSCache::iterator fsIter = fsCache_.find(FSID);
+		if (fsIter == fsCache_.end()) {
+			// Fragment shader not in cache. Let's compile it.
+			GenerateFragmentShaderD3D11(FSID, codeBuffer_, featureLevel_ <= D3D_FEATURE_LEVEL_9_3 ? HLSL_D3D11_LEVEL9 : HLSL_D3D11);
+			fs = new D3D11FragmentShader(device_, featureLevel_, FSID, codeBuffer_, useHWTransform);
+			fsCache_[FSID] = fs;
+			history_.Add(FSID);
+		} else {
+			fs = fsIter->second;
+		}
+		fsLookaside_.Add(FSID, fs);
 	}
 
 	lastFSID_ = FSID;
@@ -287,3 +301,58 @@ std::string ShaderManagerD3D11::DebugGetShaderString(std::string id, DebugShader
 		return "N/A";
 	}
 }
+
+bool ShaderManagerD3D11::LoadCache(FILE *f) {
+	if (!history_.Load(f))
+		return false;
+
+	// Generating HLSL and compiling it is all CPU work, and the device is free threaded, so this
+	// spreads out well.  The maps are only touched afterwards, on this thread.
+	const ShaderLanguage lang = featureLevel_ <= D3D_FEATURE_LEVEL_9_3 ? HLSL_D3D11_LEVEL9 : HLSL_D3D11;
+	const std::vector<VShaderID> &vsids = history_.VertexShaders();
+	const std::vector<FShaderID> &fsids = history_.FragmentShaders();
+	std::vector<D3D11VertexShader *> vshaders(vsids.size());
+	std::vector<D3D11FragmentShader *> fshaders(fsids.size());
+	const int total = (int)(vsids.size() + fsids.size());
+	GlobalThreadPool::Loop([&](int lower, int upper) {
+		std::unique_ptr<char[]> buffer(new char[CODE_BUFFER_SIZE]);
+		for (int i = lower; i < upper; ++i) {
+			if (i < (int)vsids.size()) {
+				const VShaderID &id = vsids[i];
+				GenerateVertexShaderD3D11(id, buffer.get(), lang);
+				vshaders[i] = new D3D11VertexShader(device_, featureLevel_, id, buffer.get(), 0, id.Bit(VS_BIT_USE_HW_TRANSFORM));
+			} else {
+				const FShaderID &id = fsids[i - vsids.size()];
+				GenerateFragmentShaderD3D11(id, buffer.get(), lang);
+				fshaders[i - vsids.size()] = new D3D11FragmentShader(device_, featureLevel_, id, buffer.get(), false);
+			}
+		}
+	}, 0, total);
+
+	int failed = 0;
+	for (size_t i = 0; i < vsids.size(); ++i) {
+		if (vshaders[i]->Failed() || vsCache_.find(vsids[i]) != vsCache_.end()) {
+			failed += vshaders[i]->Failed() ? 1 : 0;
+			delete vshaders[i];
+		} else {
+			vsCache_[vsids[i]] = vshaders[i];
+		}
+	}
+	for (size_t i = 0; i < fsids.size(); ++i) {
+		if (fshaders[i]->Failed() || fsCache_.find(fsids[i]) != fsCache_.end()) {
+			failed += fshaders[i]->Failed() ? 1 : 0;
+			delete fshaders[i];
+		} else {
+			fsCache_[fsids[i]] = fshaders[i];
+		}
+	}
+
+	NOTICE_LOG(G3D, "Precompiled %d vertex and %d fragment shaders (%d failed)", (int)vsids.size(), (int)fsids.size(), failed);
+	return true;
+}
+
+void ShaderManagerD3D11::SaveCache(FILE *f) {
+	if (!history_.Save(f)) {
+		ERROR_LOG(G3D, "Failed to write the D3D11 shader cache");
+	}
+}
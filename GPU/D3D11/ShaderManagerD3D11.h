@@ -94,6 +94,11 @@ class ShaderManagerD3D11 : public ShaderManagerCommon {
 	std::vector<std::string> DebugGetShaderIDs(DebugShaderType type);
 	std::string DebugGetShaderString(std::string id, DebugShaderType type, DebugShaderStringType stringType);
 
+	// Compiles every shader in the history, spread over the thread pool.
+	bool LoadCache(FILE *f);
+	void SaveCache(FILE *f);
+	bool IsCacheDirty() const { return history_.IsDirty(); }
+
 	uint64_t UpdateUniforms();
 	void BindUniforms();
 
@@ -116,6 +121,11 @@ class ShaderManagerD3D11 : public ShaderManagerCommon {
 	typedef std::map<VShaderID, D3D11VertexShader *> VSCache;
 	VSCache vsCache_;
 
+	ShaderLookaside<FShaderID, D3D11FragmentShader> fsLookaside_;
+	ShaderLookaside<VShaderID, D3D11VertexShader> vsLookaside_;
+
+	ShaderIDHistory history_;
+
 	char *codeBuffer_;
 
 	// Uniform block scratchpad. These (the relevant ones) are copied to the current pushbuffer at draw time.
@@ -190,6 +190,7 @@ void TextureCacheD3D11::StartFrame() {
 		// INFO_LOG(G3D, "Scaled %i texels", texelsScaledThisFrame_);
 	}
 	texelsScaledThisFrame_ = 0;
+	scaler.StartFrame();
 	if (clearCacheNextFrame_) {
 		Clear(true);
 		clearCacheNextFrame_ = false;
@@ -509,7 +510,7 @@ void TextureCacheD3D11::BuildTexture(TexCacheEntry *const entry) {
 	}
 
 	if (scaleFactor != 1) {
-		if (texelsScaledThisFrame_ >= TEXCACHE_MAX_TEXELS_SCALED) {
+		if (texelsScaledThisFrame_ >= TEXCACHE_MAX_TEXELS_SCALED || !AsyncScaleReady(*entry)) {
 			entry->status |= TexCacheEntry::STATUS_TO_SCALE;
 			scaleFactor = 1;
 		} else {
@@ -722,9 +723,11 @@ void TextureCacheD3D11::LoadTextureLevel(TexCacheEntry &entry, ReplacedTexture &
 			entry.SetAlphaStatus(TexCacheEntry::STATUS_ALPHA_UNKNOWN);
 		}
 
-		if (scaleFactor > 1) {
+		if (scaleFactor == 1) {
+			QueueAsyncScale(entry, level, pixelData, decPitch, (u32)dstFmt, w, h);
+		} else {
 			u32 scaleFmt = (u32)dstFmt;
-			scaler.ScaleAlways((u32 *)mapData, pixelData, scaleFmt, w, h, scaleFactor);
+			ScaleTexture(entry, level, (u32 *)mapData, pixelData, scaleFmt, w, h, scaleFactor);
 			pixelData = (u32 *)mapData;
 
 			// We always end up at 8888.  Other parts assume this.
@@ -75,6 +75,7 @@ class TextureCacheD3D11 : public TextureCacheCommon {
 	void UpdateCurrentClut(GEPaletteFormat clutFormat, u32 clutBase, bool clutIndexIsSimple) override;
 
 	void ApplyTextureFramebuffer(TexCacheEntry *entry, VirtualFramebuffer *framebuffer) override;
+	TextureScalerCommon &Scaler() override { return scaler; }
 	void BuildTexture(TexCacheEntry *const entry) override;
 
 	ID3D11Device *device_;
@@ -16,11 +16,19 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include <algorithm>
+#include <condition_variable>
 #include <cstring>
+#include <deque>
 #include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <snappy-c.h>
+#include "base/timeutil.h"
 #include "profiler/profiler.h"
+#include "thread/threadutil.h"
 #include "Common/Common.h"
 #include "Common/Log.h"
 #include "Core/Core.h"
@@ -40,9 +48,87 @@
 
 namespace GPURecord {
 
+// Holds the commands and pushbuf data of a dump.  Older versions are read in full, while version 4
+// dumps are read a chunk at a time, with a thread reading ahead.
+class ReplayData {
+public:
+	~ReplayData();
+
+	bool Load(const std::string &filename);
+
+	int FrameCount() const {
+		return (int)frameStarts_.size();
+	}
+	void GetFrameCommands(int frame, u32 *start, u32 *end) const;
+	bool GetCommand(u32 index, Command *cmd);
+	// The result is valid until the next call, or null if out of range or unreadable.
+	const u8 *GetPushbuf(u32 ptr, u32 sz);
+	u32 PushbufSize() const {
+		return pushbufSize_;
+	}
+
+private:
+	typedef std::shared_ptr<std::vector<u8>> ChunkData;
+
+	enum {
+		// Decompressed chunks to keep around.
+		CACHE_BYTES = 64 * 1024 * 1024,
+		READ_AHEAD_CHUNKS = 2,
+	};
+
+	struct CacheEntry {
+		ChunkData data;
+		int lastUsed = 0;
+		bool loading = false;
+	};
+
+	bool LoadFull(u32 fp, int version);
+	bool LoadIndex(u32 fp, const std::string &filename);
+	const ChunkInfo *GetChunkInfo(u32 key) const;
+	bool ReadChunk(u32 fp, u32 key, std::vector<u8> &out);
+	ChunkData GetChunk(u32 key);
+	void StoreChunk(u32 key, const ChunkData &data);
+	void QueueReadAhead(u32 key);
+	void ReadAheadFunc();
+
+	static u32 ChunkKey(ChunkType type, u32 index) {
+		return (index << 1) | (u32)type;
+	}
+
+	bool streaming_ = false;
+	std::vector<Command> commands_;
+	std::vector<u8> pushbuf_;
+	std::vector<u32> frameStarts_;
+	u32 commandCount_ = 0;
+	u32 pushbufSize_ = 0;
+
+	std::vector<ChunkInfo> commandChunks_;
+	std::vector<ChunkInfo> pushbufChunks_;
+	u32 fp_ = 0;
+	u32 readAheadFp_ = 0;
+
+	std::mutex lock_;
+	std::condition_variable cond_;
+	std::map<u32, CacheEntry> cache_;
+	size_t cacheBytes_ = 0;
+	int generation_ = 0;
+	std::deque<u32> readAheadQueue_;
+	std::thread readAheadThread_;
+	bool readAheadExit_ = false;
+
+	// Kept alive while in use, even if evicted.
+	ChunkData currentCommands_;
+	u32 currentCommandChunk_ = 0xFFFFFFFF;
+	ChunkData currentPushbuf_;
+	u32 currentPushbufChunk_ = 0xFFFFFFFF;
+	std::vector<u8> straddle_;
+};
+
 static std::string lastExecFilename;
-static std::vector<Command> lastExecCommands;
-static std::vector<u8> lastExecPushbuf;
+static std::unique_ptr<ReplayData> lastExecData;
+static int replayFrame = 0;
+static int benchmarkReplays = 0;
+static std::vector<ReplayFrameStats> benchmarkFrames;
 
 // This class maps pushbuffer (dump data) sections to PSP memory.
 // Dumps can be larger than available PSP memory, because they include generated data too.
@@ -52,7 +138,7 @@ static std::vector<u8> lastExecPushbuf;
 // Slabs are managed with LRU, extra buffers are round-robin.
 class BufMapping {
 public:
-	BufMapping(const std::vector<u8> &pushbuf) : pushbuf_(pushbuf) {
+	BufMapping(ReplayData &data) : data_(data) {
 	}
 
 	// Returns a pointer to contiguous memory for this access, or else 0 (failure).
@@ -113,7 +199,7 @@ class BufMapping {
 
 		bool Alloc();
 		void Free();
-		bool Setup(u32 bufpos, const std::vector<u8> &pushbuf_);
+		bool Setup(u32 bufpos, ReplayData &data);
 	};
 
 	// An adhoc mapping of the pushbuffer (either larger than a slab or straddling slabs.)
@@ -132,7 +218,7 @@ class BufMapping {
 			return psp_pointer_;
 		}
 
-		bool Alloc(u32 bufpos, u32 sz, const std::vector<u8> &pushbuf_);
+		bool Alloc(u32 bufpos, u32 sz, ReplayData &data);
 		void Free();
 	};
 
@@ -140,7 +226,7 @@ class BufMapping {
 	u32 extraOffset_ = 0;
 	ExtraInfo extra_[EXTRA_COUNT]{};
 
-	const std::vector<u8> &pushbuf_;
+	ReplayData &data_;
 };
 
 u32 BufMapping::Map(u32 bufpos, u32 sz, const std::function<void()> &flush) {
@@ -174,7 +260,7 @@ u32 BufMapping::MapSlab(u32 bufpos, const std::function<void()> &flush) {
 	flush();
 
 	// Okay, we need to allocate.
-	if (!slabs_[best].Setup(slab_pos, pushbuf_)) {
+	if (!slabs_[best].Setup(slab_pos, data_)) {
 		return 0;
 	}
 	return slabs_[best].Ptr(bufpos);
@@ -194,12 +280,12 @@ u32 BufMapping::MapExtra(u32 bufpos, u32 sz, const std::function<void()> &flush)
 	int i = extraOffset_;
 	extraOffset_ = (extraOffset_ + 1) % EXTRA_COUNT;
 
-	if (!extra_[i].Alloc(bufpos, sz, pushbuf_)) {
+	if (!extra_[i].Alloc(bufpos, sz, data_)) {
 		// Let's try to power on - hopefully none of these are still in use.
 		for (int i = 0; i < EXTRA_COUNT; ++i) {
 			extra_[i].Free();
 		}
-		if (!extra_[i].Alloc(bufpos, sz, pushbuf_)) {
+		if (!extra_[i].Alloc(bufpos, sz, data_)) {
 			return 0;
 		}
 	}
@@ -224,10 +310,15 @@ void BufMapping::SlabInfo::Free() {
 	}
 }
 
-bool BufMapping::ExtraInfo::Alloc(u32 bufpos, u32 sz, const std::vector<u8> &pushbuf_) {
+bool BufMapping::ExtraInfo::Alloc(u32 bufpos, u32 sz, ReplayData &data) {
 	// Make sure we've freed any previous allocation first.
 	Free();
 
+	const u8 *src = data.GetPushbuf(bufpos, sz);
+	if (!src) {
+		return false;
+	}
+
 	u32 allocSize = sz;
 	psp_pointer_ = userMemory.Alloc(allocSize, false, "Straddle extra");
 	if (psp_pointer_ == -1) {
@@ -239,7 +330,7 @@ bool BufMapping::ExtraInfo::Alloc(u32 bufpos, u32 sz, const std::vector<u8> &pus
 
 	buf_pointer_ = bufpos;
 	size_ = sz;
-	Memory::MemcpyUnchecked(psp_pointer_, pushbuf_.data() + bufpos, sz);
+	Memory::MemcpyUnchecked(psp_pointer_, src, sz);
 	return true;
 }
 
@@ -251,7 +342,13 @@ void BufMapping::ExtraInfo::Free() {
 	}
 }
 
-bool BufMapping::SlabInfo::Setup(u32 bufpos, const std::vector<u8> &pushbuf_) {
+bool BufMapping::SlabInfo::Setup(u32 bufpos, ReplayData &data) {
+	u32 sz = std::min((u32)SLAB_SIZE, data.PushbufSize() - bufpos);
+	const u8 *src = data.GetPushbuf(bufpos, sz);
+	if (!src) {
+		return false;
+	}
+
 	// If it already has RAM, we're simply taking it over.  Slabs come only in one size.
 	if (psp_pointer_ == 0) {
 		if (!Alloc()) {
@@ -260,8 +357,7 @@ bool BufMapping::SlabInfo::Setup(u32 bufpos, const std::vector<u8> &pushbuf_) {
 	}
 
 	buf_pointer_ = bufpos;
-	u32 sz = std::min((u32)SLAB_SIZE, (u32)pushbuf_.size() - bufpos);
-	Memory::MemcpyUnchecked(psp_pointer_, pushbuf_.data() + bufpos, sz);
+	Memory::MemcpyUnchecked(psp_pointer_, src, sz);
 
 	slabGeneration_++;
 	last_used_ = slabGeneration_;
@@ -272,14 +368,15 @@ int BufMapping::slabGeneration_ = 0;
 
 class DumpExecute {
 public:
-	DumpExecute(const std::vector<u8> &pushbuf, const std::vector<Command> &commands)
-		: pushbuf_(pushbuf), commands_(commands), mapping_(pushbuf) {
+	DumpExecute(ReplayData &data)
+		: data_(data), mapping_(data) {
 	}
 	~DumpExecute();
 
-	bool Run();
+	bool Run(u32 start, u32 end, ReplayFrameStats *stats = nullptr);
 
 private:
+	const u8 *GetData(u32 ptr, u32 sz, const char *what);
 	void SyncStall();
 	bool SubmitCmds(const void *p, u32 sz);
 	void SubmitListEnd();
@@ -305,11 +402,18 @@ class DumpExecute {
 	std::vector<u32> execListQueue;
 	u16 lastBufw_[8]{};
 
-	const std::vector<u8> &pushbuf_;
-	const std::vector<Command> &commands_;
+	ReplayData &data_;
 	BufMapping mapping_;
 };
 
+const u8 *DumpExecute::GetData(u32 ptr, u32 sz, const char *what) {
+	const u8 *p = data_.GetPushbuf(ptr, sz);
+	if (!p) {
+		ERROR_LOG(SYSTEM, "Unable to read %s from GE dump", what);
+	}
+	return p;
+}
+
 void DumpExecute::SyncStall() {
 	gpu->UpdateStall(execListID, execListPos);
 	s64 listTicks = gpu->GetListTicks(execListID);
@@ -409,12 +513,20 @@ void DumpExecute::SubmitListEnd() {
 }
 
 void DumpExecute::Init(u32 ptr, u32 sz) {
-	gstate.Restore((u32_le *)(pushbuf_.data() + ptr));
+	const u8 *data = GetData(ptr, sz, "state");
+	if (!data) {
+		return;
+	}
+
+	gstate.Restore((u32_le *)data);
 	gpu->ReapplyGfxState();
 }
 
 void DumpExecute::Registers(u32 ptr, u32 sz) {
-	SubmitCmds(pushbuf_.data() + ptr, sz);
+	const u8 *data = GetData(ptr, sz, "registers");
+	if (data) {
+		SubmitCmds(data, sz);
+	}
 }
 
 void DumpExecute::Vertices(u32 ptr, u32 sz) {
@@ -472,23 +584,28 @@ void DumpExecute::Memset(u32 ptr, u32 sz) {
 		u32 sz;
 	};
 
-	const MemsetCommand *data = (const MemsetCommand *)(pushbuf_.data() + ptr);
+	const MemsetCommand *data = (const MemsetCommand *)GetData(ptr, sizeof(MemsetCommand), "memset");
 
-	if (Memory::IsVRAMAddress(data->dest)) {
+	if (data && Memory::IsVRAMAddress(data->dest)) {
 		SyncStall();
 		gpu->PerformMemorySet(data->dest, (u8)data->value, data->sz);
 	}
 }
 
 void DumpExecute::MemcpyDest(u32 ptr, u32 sz) {
-	execMemcpyDest = *(const u32 *)(pushbuf_.data() + ptr);
+	const u8 *data = GetData(ptr, sizeof(u32), "memcpy dest");
+	execMemcpyDest = data ? *(const u32_le *)data : 0;
 }
 
 void DumpExecute::Memcpy(u32 ptr, u32 sz) {
 	PROFILE_THIS_SCOPE("ReplayMemcpy");
 	if (Memory::IsVRAMAddress(execMemcpyDest)) {
 		SyncStall();
-		Memory::MemcpyUnchecked(execMemcpyDest, pushbuf_.data() + ptr, sz);
+		const u8 *data = GetData(ptr, sz, "memcpy");
+		if (!data) {
+			return;
+		}
+		Memory::MemcpyUnchecked(execMemcpyDest, data, sz);
 		gpu->PerformMemoryUpload(execMemcpyDest, sz);
 	}
 }
@@ -515,7 +632,11 @@ void DumpExecute::Framebuf(int level, u32 ptr, u32 sz) {
 		u32 pad;
 	};
 
-	FramebufData *framebuf = (FramebufData *)(pushbuf_.data() + ptr);
+	const u8 *data = GetData(ptr, sz, "framebuffer");
+	if (!data || sz < sizeof(FramebufData)) {
+		return;
+	}
+	const FramebufData *framebuf = (const FramebufData *)data;
 
 	u32 bufwCmd = GE_CMD_TEXBUFWIDTH0 + level;
 	u32 addrCmd = GE_CMD_TEXADDR0 + level;
@@ -530,7 +651,7 @@ void DumpExecute::Framebuf(int level, u32 ptr, u32 sz) {
 	// Could potentially always skip if !isTarget, but playing it safe for offset texture behavior.
 	if (Memory::IsValidRange(framebuf->addr, pspSize) && (!isTarget || !g_Config.bSoftwareRendering)) {
 		// Intentionally don't trigger an upload here.
-		Memory::MemcpyUnchecked(framebuf->addr, pushbuf_.data() + ptr + headerSize, pspSize);
+		Memory::MemcpyUnchecked(framebuf->addr, data + headerSize, pspSize);
 	}
 }
 
@@ -540,7 +661,10 @@ void DumpExecute::Display(u32 ptr, u32 sz) {
 		int linesize, pixelFormat;
 	};
 
-	DisplayBufData *disp = (DisplayBufData *)(pushbuf_.data() + ptr);
+	const DisplayBufData *disp = (const DisplayBufData *)GetData(ptr, sizeof(DisplayBufData), "display");
+	if (!disp) {
+		return;
+	}
 
 	// Sync up drawing.
 	SyncStall();
@@ -559,8 +683,15 @@ DumpExecute::~DumpExecute() {
 	mapping_.Reset();
 }
 
-bool DumpExecute::Run() {
-	for (const Command &cmd : commands_) {
+bool DumpExecute::Run(u32 start, u32 end, ReplayFrameStats *stats) {
+	for (u32 i = start; i < end; ++i) {
+		Command cmd;
+		if (!data_.GetCommand(i, &cmd)) {
+			ERROR_LOG(SYSTEM, "Unable to read GE dump command %d", i);
+			return false;
+		}
+
+		double cmdStart = stats ? real_time_now() : 0.0;
 		switch (cmd.type) {
 		case CommandType::INIT:
 			Init(cmd.ptr, cmd.sz);
@@ -628,9 +759,18 @@ bool DumpExecute::Run() {
 			ERROR_LOG(SYSTEM, "Unsupported GE dump command: %d", (int)cmd.type);
 			return false;
 		}
+
+		if (stats) {
+			stats->commandSeconds[(u8)cmd.type] += real_time_now() - cmdStart;
+			stats->commandCounts[(u8)cmd.type]++;
+		}
 	}
 
+	double syncStart = stats ? real_time_now() : 0.0;
 	SubmitListEnd();
+	if (stats) {
+		stats->syncSeconds = real_time_now() - syncStart;
+	}
 	return true;
 }
 
@@ -653,10 +793,341 @@ static bool ReadCompressed(u32 fp, void *dest, size_t sz) {
 	return real_size == sz;
 }
 
+static bool SeekTo(u32 fp, u64 offset) {
+	pspFileSystem.SeekFile(fp, 0, FILEMOVE_BEGIN);
+	// Seeks are 32-bit, and dumps may be larger.
+	u64 pos = 0;
+	while (pos < offset) {
+		s32 step = (s32)std::min(offset - pos, (u64)0x7FFFFFFF);
+		u64 next = pspFileSystem.SeekFile(fp, step, FILEMOVE_CURRENT);
+		if (next != pos + step) {
+			return false;
+		}
+		pos = next;
+	}
+	return true;
+}
+
+ReplayData::~ReplayData() {
+	if (readAheadThread_.joinable()) {
+		{
+			std::lock_guard<std::mutex> guard(lock_);
+			readAheadExit_ = true;
+		}
+		cond_.notify_all();
+		readAheadThread_.join();
+	}
+	if (readAheadFp_) {
+		pspFileSystem.CloseFile(readAheadFp_);
+	}
+	if (fp_) {
+		pspFileSystem.CloseFile(fp_);
+	}
+}
+
+bool ReplayData::Load(const std::string &filename) {
+	u32 fp = pspFileSystem.OpenFile(filename, FILEACCESS_READ);
+	u8 header[8]{};
+	int version = 0;
+	pspFileSystem.ReadFile(fp, header, sizeof(header));
+	pspFileSystem.ReadFile(fp, (u8 *)&version, sizeof(version));
+
+	if (memcmp(header, HEADER, sizeof(header)) != 0 || version > VERSION || version < MIN_VERSION) {
+		ERROR_LOG(SYSTEM, "Invalid GE dump or unsupported version");
+		pspFileSystem.CloseFile(fp);
+		return false;
+	}
+
+	if (version < 4) {
+		bool success = LoadFull(fp, version);
+		pspFileSystem.CloseFile(fp);
+		return success;
+	}
+
+	fp_ = fp;
+	if (!LoadIndex(fp, filename)) {
+		return false;
+	}
+
+	// The read ahead thread has its own handle, so it doesn't disturb our position.
+	readAheadFp_ = pspFileSystem.OpenFile(filename, FILEACCESS_READ);
+	streaming_ = true;
+	readAheadThread_ = std::thread(&ReplayData::ReadAheadFunc, this);
+	return true;
+}
+
+bool ReplayData::LoadFull(u32 fp, int version) {
+	u32 sz = 0;
+	pspFileSystem.ReadFile(fp, (u8 *)&sz, sizeof(sz));
+	u32 bufsz = 0;
+	pspFileSystem.ReadFile(fp, (u8 *)&bufsz, sizeof(bufsz));
+
+	commands_.resize(sz);
+	pushbuf_.resize(bufsz);
+
+	bool truncated = false;
+	truncated = truncated || !ReadCompressed(fp, commands_.data(), sizeof(Command) * sz);
+	truncated = truncated || !ReadCompressed(fp, pushbuf_.data(), bufsz);
+
+	if (truncated) {
+		ERROR_LOG(SYSTEM, "Truncated GE dump");
+		return false;
+	}
+
+	commandCount_ = sz;
+	pushbufSize_ = bufsz;
+	frameStarts_.push_back(0);
+	return true;
+}
+
+bool ReplayData::LoadIndex(u32 fp, const std::string &filename) {
+	const u64 fileSize = pspFileSystem.GetFileInfo(filename).size;
+	IndexFooter footer{};
+	if (fileSize < sizeof(footer) || !SeekTo(fp, fileSize - sizeof(footer)) || pspFileSystem.ReadFile(fp, (u8 *)&footer, sizeof(footer)) != sizeof(footer)) {
+		ERROR_LOG(SYSTEM, "Truncated GE dump");
+		return false;
+	}
+	if (memcmp(footer.magic, INDEX_MAGIC, sizeof(footer.magic)) != 0) {
+		// Probably the recording never finished.
+		ERROR_LOG(SYSTEM, "GE dump has no index, truncated?");
+		return false;
+	}
+
+	std::vector<ChunkInfo> chunks(footer.chunkCount);
+	frameStarts_.resize(footer.frameCount);
+	const size_t chunksSize = chunks.size() * sizeof(ChunkInfo);
+	const size_t framesSize = frameStarts_.size() * sizeof(u32);
+	if (!SeekTo(fp, footer.indexOffset) || pspFileSystem.ReadFile(fp, (u8 *)chunks.data(), chunksSize) != chunksSize || pspFileSystem.ReadFile(fp, (u8 *)frameStarts_.data(), framesSize) != framesSize) {
+		ERROR_LOG(SYSTEM, "Truncated GE dump index");
+		return false;
+	}
+
+	for (const ChunkInfo &chunk : chunks) {
+		if (chunk.type == ChunkType::COMMANDS) {
+			commandChunks_.push_back(chunk);
+		} else if (chunk.type == ChunkType::PUSHBUF) {
+			pushbufChunks_.push_back(chunk);
+		}
+	}
+
+	commandCount_ = footer.commandCount;
+	pushbufSize_ = footer.pushbufSize;
+	if (commandChunks_.size() != (commandCount_ + COMMANDS_PER_CHUNK - 1) / COMMANDS_PER_CHUNK || pushbufChunks_.size() != (pushbufSize_ + PUSHBUF_CHUNK_SIZE - 1) / PUSHBUF_CHUNK_SIZE) {
+		ERROR_LOG(SYSTEM, "Invalid GE dump index");
+		return false;
+	}
+	if (frameStarts_.empty()) {
+		frameStarts_.push_back(0);
+	}
+	return true;
+}
+
+void ReplayData::GetFrameCommands(int frame, u32 *start, u32 *end) const {
+	*start = std::min(frameStarts_[frame], commandCount_);
+	*end = frame + 1 < (int)frameStarts_.size() ? std::min(frameStarts_[frame + 1], commandCount_) : commandCount_;
+}
+
+const ChunkInfo *ReplayData::GetChunkInfo(u32 key) const {
+	const std::vector<ChunkInfo> &chunks = (key & 1) ? pushbufChunks_ : commandChunks_;
+	u32 index = key >> 1;
+	return index < chunks.size() ? &chunks[index] : nullptr;
+}
+
+bool ReplayData::ReadChunk(u32 fp, u32 key, std::vector<u8> &out) {
+	const ChunkInfo *info = GetChunkInfo(key);
+	if (!info || !SeekTo(fp, info->offset)) {
+		return false;
+	}
+
+	out.resize(info->rawSize);
+	if (info->compression == ChunkCompression::NONE) {
+		return pspFileSystem.ReadFile(fp, out.data(), info->rawSize) == info->rawSize;
+	}
+
+	std::vector<u8> compressed(info->compressedSize);
+	if (pspFileSystem.ReadFile(fp, compressed.data(), info->compressedSize) != info->compressedSize) {
+		return false;
+	}
+	size_t real_size = info->rawSize;
+	if (snappy_uncompress((const char *)compressed.data(), compressed.size(), (char *)out.data(), &real_size) != SNAPPY_OK) {
+		return false;
+	}
+	return real_size == info->rawSize;
+}
+
+ReplayData::ChunkData ReplayData::GetChunk(u32 key) {
+	std::unique_lock<std::mutex> guard(lock_);
+	while (true) {
+		auto it = cache_.find(key);
+		if (it == cache_.end()) {
+			break;
+		}
+		if (it->second.data) {
+			it->second.lastUsed = ++generation_;
+			return it->second.data;
+		}
+		// The read ahead thread is already on it.
+		cond_.wait(guard);
+	}
+
+	cache_[key].loading = true;
+	guard.unlock();
+
+	ChunkData data = std::make_shared<std::vector<u8>>();
+	if (!ReadChunk(fp_, key, *data)) {
+		ERROR_LOG(SYSTEM, "Unable to read GE dump chunk");
+		data.reset();
+	}
+
+	guard.lock();
+	StoreChunk(key, data);
+	return data;
+}
+
+// Call with lock_ held.
+void ReplayData::StoreChunk(u32 key, const ChunkData &data) {
+	if (!data) {
+		cache_.erase(key);
+		cond_.notify_all();
+		return;
+	}
+
+	CacheEntry &entry = cache_[key];
+	entry.data = data;
+	entry.loading = false;
+	entry.lastUsed = ++generation_;
+	cacheBytes_ += data->size();
+	cond_.notify_all();
+
+	// Anything currently in use stays alive through currentCommands_ or currentPushbuf_.
+	while (cacheBytes_ > CACHE_BYTES) {
+		auto oldest = cache_.end();
+		for (auto it = cache_.begin(); it != cache_.end(); ++it) {
+			if (it->second.data && it->first != key && (oldest == cache_.end() || it->second.lastUsed < oldest->second.lastUsed)) {
+				oldest = it;
+			}
+		}
+		if (oldest == cache_.end()) {
+			break;
+		}
+		cacheBytes_ -= oldest->second.data->size();
+		cache_.erase(oldest);
+	}
+}
+
+void ReplayData::QueueReadAhead(u32 key) {
+	if (!GetChunkInfo(key)) {
+		return;
+	}
+	std::lock_guard<std::mutex> guard(lock_);
+	if (cache_.find(key) == cache_.end() && std::find(readAheadQueue_.begin(), readAheadQueue_.end(), key) == readAheadQueue_.end()) {
+		readAheadQueue_.push_back(key);
+		cond_.notify_all();
+	}
+}
+
+void ReplayData::ReadAheadFunc() {
+	setCurrentThreadName("GEDumpReadAhead");
+
+	std::unique_lock<std::mutex> guard(lock_);
+	while (!readAheadExit_) {
+		if (readAheadQueue_.empty()) {
+			cond_.wait(guard);
+			continue;
+		}
+
+		u32 key = readAheadQueue_.front();
+		readAheadQueue_.pop_front();
+		if (cache_.find(key) != cache_.end()) {
+			continue;
+		}
+		cache_[key].loading = true;
+		guard.unlock();
+
+		ChunkData data = std::make_shared<std::vector<u8>>();
+		if (!ReadChunk(readAheadFp_, key, *data)) {
+			data.reset();
+		}
+
+		guard.lock();
+		StoreChunk(key, data);
+	}
+}
+
+bool ReplayData::GetCommand(u32 index, Command *cmd) {
+	if (!streaming_) {
+		if (index >= commands_.size()) {
+			return false;
+		}
+		*cmd = commands_[index];
+		return true;
+	}
+
+	if (index >= commandCount_) {
+		return false;
+	}
+	u32 chunk = index / COMMANDS_PER_CHUNK;
+	if (chunk != currentCommandChunk_) {
+		currentCommands_ = GetChunk(ChunkKey(ChunkType::COMMANDS, chunk));
+		currentCommandChunk_ = currentCommands_ ? chunk : 0xFFFFFFFF;
+		QueueReadAhead(ChunkKey(ChunkType::COMMANDS, chunk + 1));
+	}
+
+	size_t offset = (index % COMMANDS_PER_CHUNK) * sizeof(Command);
+	if (!currentCommands_ || offset + sizeof(Command) > currentCommands_->size()) {
+		return false;
+	}
+	memcpy(cmd, currentCommands_->data() + offset, sizeof(Command));
+	return true;
+}
+
+const u8 *ReplayData::GetPushbuf(u32 ptr, u32 sz) {
+	if (ptr > pushbufSize_ || sz > pushbufSize_ - ptr) {
+		return nullptr;
+	}
+	if (!streaming_) {
+		return pushbuf_.data() + ptr;
+	}
+
+	const u32 first = ptr / PUSHBUF_CHUNK_SIZE;
+	const u32 last = sz == 0 ? first : (ptr + sz - 1) / PUSHBUF_CHUNK_SIZE;
+	if (first != currentPushbufChunk_) {
+		currentPushbuf_ = GetChunk(ChunkKey(ChunkType::PUSHBUF, first));
+		currentPushbufChunk_ = currentPushbuf_ ? first : 0xFFFFFFFF;
+		// Data is mostly written in the order it's used.
+		for (u32 i = 1; i <= READ_AHEAD_CHUNKS; ++i) {
+			QueueReadAhead(ChunkKey(ChunkType::PUSHBUF, last + i));
+		}
+	}
+	if (!currentPushbuf_) {
+		return nullptr;
+	}
+
+	const u32 offset = ptr - first * PUSHBUF_CHUNK_SIZE;
+	if (first == last) {
+		return currentPushbuf_->data() + offset;
+	}
+
+	// Straddles chunks, so put it together.
+	straddle_.resize(sz);
+	u32 copied = std::min(sz, (u32)currentPushbuf_->size() - offset);
+	memcpy(straddle_.data(), currentPushbuf_->data() + offset, copied);
+	for (u32 chunk = first + 1; chunk <= last; ++chunk) {
+		ChunkData data = GetChunk(ChunkKey(ChunkType::PUSHBUF, chunk));
+		if (!data) {
+			return nullptr;
+		}
+		u32 part = std::min(sz - copied, (u32)data->size());
+		memcpy(straddle_.data() + copied, data->data(), part);
+		copied += part;
+	}
+	return straddle_.data();
+}
+
 static void ReplayStop() {
 	lastExecFilename.clear();
-	lastExecCommands.clear();
-	lastExecPushbuf.clear();
+	lastExecData.reset();
+	replayFrame = 0;
 }
 
 bool RunMountedReplay(const std::string &filename) {
@@ -665,42 +1136,88 @@ bool RunMountedReplay(const std::string &filename) {
 	Core_ListenStopRequest(&ReplayStop);
 	if (lastExecFilename != filename) {
 		PROFILE_THIS_SCOPE("ReplayLoad");
-		u32 fp = pspFileSystem.OpenFile(filename, FILEACCESS_READ);
-		u8 header[8]{};
-		int version = 0;
-		pspFileSystem.ReadFile(fp, header, sizeof(header));
-		pspFileSystem.ReadFile(fp, (u8 *)&version, sizeof(version));
-
-		if (memcmp(header, HEADER, sizeof(header)) != 0 || version > VERSION || version < MIN_VERSION) {
-			ERROR_LOG(SYSTEM, "Invalid GE dump or unsupported version");
-			pspFileSystem.CloseFile(fp);
+		lastExecData.reset(new ReplayData());
+		if (!lastExecData->Load(filename)) {
+			lastExecData.reset();
 			return false;
 		}
 
-		u32 sz = 0;
-		pspFileSystem.ReadFile(fp, (u8 *)&sz, sizeof(sz));
-		u32 bufsz = 0;
-		pspFileSystem.ReadFile(fp, (u8 *)&bufsz, sizeof(bufsz));
-
-		lastExecCommands.resize(sz);
-		lastExecPushbuf.resize(bufsz);
+		lastExecFilename = filename;
+	}
 
-		bool truncated = false;
-		truncated = truncated || !ReadCompressed(fp, lastExecCommands.data(), sizeof(Command) * sz);
-		truncated = truncated || !ReadCompressed(fp, lastExecPushbuf.data(), bufsz);
+	// One frame each time, and then start over.
+	const int frame = replayFrame % lastExecData->FrameCount();
+	replayFrame = frame + 1;
+	u32 start, end;
+	lastExecData->GetFrameCommands(frame, &start, &end);
 
-		pspFileSystem.CloseFile(fp);
+	if (benchmarkReplays == 0) {
+		DumpExecute executor(*lastExecData);
+		return executor.Run(start, end);
+	}
 
-		if (truncated) {
-			ERROR_LOG(SYSTEM, "Truncated GE dump");
-			return false;
-		}
+	ReplayFrameStats stats{};
+	stats.frame = frame;
+	gpuStats.ResetFrame();
+	double startTime = real_time_now();
+	bool success;
+	{
+		DumpExecute executor(*lastExecData);
+		success = executor.Run(start, end, &stats);
+	}
+	stats.seconds = real_time_now() - startTime;
+	stats.gpu = gpuStats;
+	benchmarkFrames.push_back(stats);
 
-		lastExecFilename = filename;
+	if ((int)benchmarkFrames.size() >= benchmarkReplays) {
+		Core_Stop();
 	}
+	return success;
+}
 
-	DumpExecute executor(lastExecPushbuf, lastExecCommands);
-	return executor.Run();
+void SeekReplay(int frame) {
+	replayFrame = std::max(frame, 0);
+}
+
+int ReplayFrameCount() {
+	return lastExecData ? lastExecData->FrameCount() : 0;
+}
+
+void StartReplayBenchmark(int replays) {
+	benchmarkReplays = replays;
+	benchmarkFrames.clear();
+	benchmarkFrames.reserve(replays);
+}
+
+std::vector<ReplayFrameStats> FinishReplayBenchmark() {
+	std::vector<ReplayFrameStats> frames;
+	frames.swap(benchmarkFrames);
+	benchmarkReplays = 0;
+	return frames;
+}
+
+const char *CommandTypeName(CommandType type) {
+	switch (type) {
+	case CommandType::INIT: return "INIT";
+	case CommandType::REGISTERS: return "REGISTERS";
+	case CommandType::VERTICES: return "VERTICES";
+	case CommandType::INDICES: return "INDICES";
+	case CommandType::CLUT: return "CLUT";
+	case CommandType::TRANSFERSRC: return "TRANSFERSRC";
+	case CommandType::MEMSET: return "MEMSET";
+	case CommandType::MEMCPYDEST: return "MEMCPYDEST";
+	case CommandType::MEMCPYDATA: return "MEMCPYDATA";
+	case CommandType::DISPLAY: return "DISPLAY";
+	default:
+		break;
+	}
+	if (type >= CommandType::TEXTURE0 && type <= CommandType::TEXTURE7) {
+		return "TEXTURE";
+	}
+	if (type >= CommandType::FRAMEBUF0 && type <= CommandType::FRAMEBUF7) {
+		return "FRAMEBUF";
+	}
+	return nullptr;
 }
 
 };
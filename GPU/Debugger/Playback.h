@@ -18,9 +18,35 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include "GPU/GPU.h"
+#include "GPU/Debugger/RecordFormat.h"
 
 namespace GPURecord {
 
+// Each call replays the next frame of the dump, starting over after the last.
 bool RunMountedReplay(const std::string &filename);
+// Makes the next replay start at this frame.
+void SeekReplay(int frame);
+// Zero until the dump is loaded.
+int ReplayFrameCount();
+
+// Collected for each replay while benchmarking.
+struct ReplayFrameStats {
+	int frame;
+	// Wall time of the replay, excluding loading the dump.
+	double seconds;
+	// Time waiting for the GE to finish the list at the end.
+	double syncSeconds;
+	// By CommandType.  GE work is counted against whichever command had to wait for it.
+	double commandSeconds[256];
+	int commandCounts[256];
+	GPUStatistics gpu;
+};
+
+// Replays this many frames of the mounted dump, then stops the core.
+void StartReplayBenchmark(int replays);
+std::vector<ReplayFrameStats> FinishReplayBenchmark();
+const char *CommandTypeName(CommandType type);
 
 };
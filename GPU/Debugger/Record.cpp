@@ -40,28 +40,94 @@
 
 namespace GPURecord {
 
+enum {
+	// Pushbuf data older than this is written out, and no longer deduplicated against.
+	PUSHBUF_WINDOW = 16 * PUSHBUF_CHUNK_SIZE,
+};
+
 static bool active = false;
 static bool nextFrame = false;
+static int framesToRecord = 1;
+static int framesLeft = 0;
 static int flipLastAction = -1;
 static std::function<void(const std::string &)> writeCallback;
 
+// Everything before pushbufBase and commandBase has already been written to recordFile.
 static std::vector<u8> pushbuf;
+static u32 pushbufBase = 0;
 static std::vector<Command> commands;
+static u32 commandBase = 0;
 static std::vector<u32> lastRegisters;
 static std::vector<u32> lastTextures;
 static std::set<u32> lastRenderTargets;
 
+static FILE *recordFile = nullptr;
+static std::string recordFilename;
+static u64 recordOffset = 0;
+static std::vector<ChunkInfo> chunks;
+static std::vector<u32> frameStarts;
+
+static u32 PushbufPos() {
+	return pushbufBase + (u32)pushbuf.size();
+}
+
+static void WriteChunk(ChunkType type, const void *p, size_t sz) {
+	size_t compressed_size = snappy_max_compressed_length(sz);
+	std::vector<u8> compressed(compressed_size);
+	snappy_compress((const char *)p, sz, (char *)compressed.data(), &compressed_size);
+
+	ChunkInfo info{};
+	info.type = type;
+	info.rawSize = (u32)sz;
+	info.offset = recordOffset;
+	if (compressed_size < sz) {
+		info.compression = ChunkCompression::SNAPPY;
+		info.compressedSize = (u32)compressed_size;
+		fwrite(compressed.data(), compressed_size, 1, recordFile);
+	} else {
+		info.compression = ChunkCompression::NONE;
+		info.compressedSize = (u32)sz;
+		fwrite(p, sz, 1, recordFile);
+	}
+	recordOffset += info.compressedSize;
+	chunks.push_back(info);
+}
+
+// Writes out complete chunks, or everything if final.
+static void FlushChunks(bool final) {
+	while (commands.size() >= COMMANDS_PER_CHUNK || (final && !commands.empty())) {
+		size_t count = std::min(commands.size(), (size_t)COMMANDS_PER_CHUNK);
+		WriteChunk(ChunkType::COMMANDS, commands.data(), count * sizeof(Command));
+		commands.erase(commands.begin(), commands.begin() + count);
+		commandBase += (u32)count;
+	}
+
+	const size_t keep = final ? 0 : PUSHBUF_WINDOW;
+	while (pushbuf.size() >= keep + PUSHBUF_CHUNK_SIZE || (final && !pushbuf.empty())) {
+		size_t sz = std::min(pushbuf.size(), (size_t)PUSHBUF_CHUNK_SIZE);
+		WriteChunk(ChunkType::PUSHBUF, pushbuf.data(), sz);
+		pushbuf.erase(pushbuf.begin(), pushbuf.begin() + sz);
+		pushbufBase += (u32)sz;
+
+		lastTextures.erase(std::remove_if(lastTextures.begin(), lastTextures.end(), [](u32 ptr) {
+			return ptr < pushbufBase;
+		}), lastTextures.end());
+	}
+}
+
 static void FlushRegisters() {
 	if (!lastRegisters.empty()) {
 		Command last{CommandType::REGISTERS};
-		last.ptr = (u32)pushbuf.size();
+		last.ptr = PushbufPos();
 		last.sz = (u32)(lastRegisters.size() * sizeof(u32));
-		pushbuf.resize(pushbuf.size() + last.sz);
-		memcpy(pushbuf.data() + last.ptr, lastRegisters.data(), last.sz);
+		pushbuf.insert(pushbuf.end(), (const u8 *)lastRegisters.data(), (const u8 *)lastRegisters.data() + last.sz);
 		lastRegisters.clear();
 
 		commands.push_back(last);
 	}
+
+	// A good time to write out anything complete, since no one is pointing into pushbuf.
+	FlushChunks(false);
 }
 
 static std::string GenRecordingFilename() {
@@ -80,55 +146,67 @@ static std::string GenRecordingFilename() {
 	return StringFromFormat("%s_%04d.ppdmp", prefix.c_str(), 9999);
 }
 
-static void BeginRecording() {
-	active = true;
-	nextFrame = false;
-	lastTextures.clear();
-	lastRenderTargets.clear();
-	flipLastAction = gpuStats.numFlips;
+// Each frame starts with the full state, so playback can begin at any of them.
+static void BeginFrame() {
+	FlushRegisters();
+	frameStarts.push_back(commandBase + (u32)commands.size());
 
-	u32 ptr = (u32)pushbuf.size();
+	u32 ptr = PushbufPos();
 	u32 sz = 512 * 4;
 	pushbuf.resize(pushbuf.size() + sz);
-	gstate.Save((u32_le *)(pushbuf.data() + ptr));
+	gstate.Save((u32_le *)(pushbuf.data() + ptr - pushbufBase));
 
 	commands.push_back({CommandType::INIT, sz, ptr});
 }
 
-static void WriteCompressed(FILE *fp, const void *p, size_t sz) {
-	size_t compressed_size = snappy_max_compressed_length(sz);
-	u8 *compressed = new u8[compressed_size];
-	snappy_compress((const char *)p, sz, (char *)compressed, &compressed_size);
+static void BeginRecording() {
+	nextFrame = false;
+	recordFilename = GenRecordingFilename();
+	NOTICE_LOG(G3D, "Recording filename: %s", recordFilename.c_str());
+
+	recordFile = File::OpenCFile(recordFilename, "wb");
+	if (!recordFile) {
+		ERROR_LOG(G3D, "Unable to create %s", recordFilename.c_str());
+		return;
+	}
+	fwrite(HEADER, 8, 1, recordFile);
+	fwrite(&VERSION, sizeof(VERSION), 1, recordFile);
+	recordOffset = 8 + sizeof(VERSION);
 
-	u32 write_size = (u32)compressed_size;
-	fwrite(&write_size, sizeof(write_size), 1, fp);
-	fwrite(compressed, compressed_size, 1, fp);
+	active = true;
+	framesLeft = framesToRecord;
+	pushbufBase = 0;
+	commandBase = 0;
+	chunks.clear();
+	frameStarts.clear();
+	lastTextures.clear();
+	lastRenderTargets.clear();
+	flipLastAction = gpuStats.numFlips;
 
-	delete [] compressed;
+	BeginFrame();
 }
 
 static std::string WriteRecording() {
 	FlushRegisters();
-
-	const std::string filename = GenRecordingFilename();
-
-	NOTICE_LOG(G3D, "Recording filename: %s", filename.c_str());
-
-	FILE *fp = File::OpenCFile(filename, "wb");
-	fwrite(HEADER, 8, 1, fp);
-	fwrite(&VERSION, sizeof(VERSION), 1, fp);
-
-	u32 sz = (u32)commands.size();
-	fwrite(&sz, sizeof(sz), 1, fp);
-	u32 bufsz = (u32)pushbuf.size();
-	fwrite(&bufsz, sizeof(bufsz), 1, fp);
-
-	WriteCompressed(fp, commands.data(), commands.size() * sizeof(Command));
-	WriteCompressed(fp, pushbuf.data(), bufsz);
-
-	fclose(fp);
-
-	return filename;
+	FlushChunks(true);
+
+	IndexFooter footer{};
+	footer.commandCount = commandBase;
+	footer.pushbufSize = pushbufBase;
+	footer.chunkCount = (u32)chunks.size();
+	footer.frameCount = (u32)frameStarts.size();
+	footer.indexOffset = recordOffset;
+	memcpy(footer.magic, INDEX_MAGIC, sizeof(footer.magic));
+
+	fwrite(chunks.data(), sizeof(ChunkInfo), chunks.size(), recordFile);
+	fwrite(frameStarts.data(), sizeof(u32), frameStarts.size(), recordFile);
+	fwrite(&footer, sizeof(footer), 1, recordFile);
+	fclose(recordFile);
+	recordFile = nullptr;
+
+	chunks.clear();
+	frameStarts.clear();
+	return recordFilename;
 }
 
 static void GetVertDataSizes(int vcount, const void *indices, u32 &vbytes, u32 &ibytes) {
@@ -196,9 +274,9 @@ static Command EmitCommandWithRAM(CommandType t, const void *p, u32 sz) {
 		}
 
 		if (prev) {
-			cmd.ptr = (u32)(prev - pushbuf.data());
+			cmd.ptr = pushbufBase + (u32)(prev - pushbuf.data());
 		} else {
-			cmd.ptr = (u32)pushbuf.size();
+			cmd.ptr = PushbufPos();
 			int pad = 0;
 			if (cmd.ptr & 0xF) {
 				pad = 0x10 - (cmd.ptr & 0xF);
@@ -206,9 +284,9 @@ static Command EmitCommandWithRAM(CommandType t, const void *p, u32 sz) {
 			}
 			pushbuf.resize(pushbuf.size() + sz + pad);
 			if (pad) {
-				memset(pushbuf.data() + cmd.ptr - pad, 0, pad);
+				memset(pushbuf.data() + cmd.ptr - pushbufBase - pad, 0, pad);
 			}
-			memcpy(pushbuf.data() + cmd.ptr, p, sz);
+			memcpy(pushbuf.data() + cmd.ptr - pushbufBase, p, sz);
 		}
 	}
 
@@ -257,11 +335,11 @@ static void EmitTextureData(int level, u32 texaddr) {
 
 		// Dumps are huge - let's try to find this already emitted.
 		for (u32 prevptr : lastTextures) {
-			if (pushbuf.size() < prevptr + bytes) {
+			if (PushbufPos() < prevptr + bytes) {
 				continue;
 			}
 
-			if (memcmp(pushbuf.data() + prevptr, p, bytes) == 0) {
+			if (memcmp(pushbuf.data() + prevptr - pushbufBase, p, bytes) == 0) {
 				commands.push_back({type, bytes, prevptr});
 				// Okay, that was easy.  Bail out.
 				return;
@@ -370,9 +448,10 @@ bool IsActivePending() {
 	return nextFrame || active;
 }
 
-bool Activate() {
-	if (!nextFrame) {
+bool Activate(int frames) {
+	if (!nextFrame && !active) {
 		nextFrame = true;
+		framesToRecord = std::max(frames, 1);
 		flipLastAction = gpuStats.numFlips;
 		return true;
 	}
@@ -388,6 +467,7 @@ static void FinishRecording() {
 	std::string filename = WriteRecording();
 	commands.clear();
 	pushbuf.clear();
+	lastTextures.clear();
 
 	NOTICE_LOG(SYSTEM, "Recording finished");
 	active = false;
@@ -457,9 +537,9 @@ void NotifyMemcpy(u32 dest, u32 src, u32 sz) {
 	}
 	if (Memory::IsVRAMAddress(dest)) {
 		FlushRegisters();
-		Command cmd{CommandType::MEMCPYDEST, sizeof(dest), (u32)pushbuf.size()};
-		pushbuf.resize(pushbuf.size() + sizeof(dest));
-		memcpy(pushbuf.data() + cmd.ptr, &dest, sizeof(dest));
+		Command cmd{CommandType::MEMCPYDEST, sizeof(dest), PushbufPos()};
+		pushbuf.insert(pushbuf.end(), (const u8 *)&dest, (const u8 *)&dest + sizeof(dest));
+		commands.push_back(cmd);
 
 		sz = Memory::ValidSize(dest, sz);
 		if (sz != 0) {
@@ -483,9 +563,9 @@ void NotifyMemset(u32 dest, int v, u32 sz) {
 		MemsetCommand data{dest, v, sz};
 
 		FlushRegisters();
-		Command cmd{CommandType::MEMSET, sizeof(data), (u32)pushbuf.size()};
-		pushbuf.resize(pushbuf.size() + sizeof(data));
-		memcpy(pushbuf.data() + cmd.ptr, &data, sizeof(data));
+		Command cmd{CommandType::MEMSET, sizeof(data), PushbufPos()};
+		pushbuf.insert(pushbuf.end(), (const u8 *)&data, (const u8 *)&data + sizeof(data));
+		commands.push_back(cmd);
 	}
 }
 
@@ -517,16 +597,20 @@ void NotifyDisplay(u32 framebuf, int stride, int fmt) {
 	DisplayBufData disp{ { framebuf }, stride, fmt };
 
 	FlushRegisters();
-	u32 ptr = (u32)pushbuf.size();
+	u32 ptr = PushbufPos();
 	u32 sz = (u32)sizeof(disp);
-	pushbuf.resize(pushbuf.size() + sz);
-	memcpy(pushbuf.data() + ptr, &disp, sz);
+	pushbuf.insert(pushbuf.end(), (const u8 *)&disp, (const u8 *)&disp + sz);
 
 	commands.push_back({ CommandType::DISPLAY, sz, ptr });
 
 	if (writePending) {
-		NOTICE_LOG(SYSTEM, "Recording complete on display");
-		FinishRecording();
+		if (--framesLeft > 0) {
+			flipLastAction = gpuStats.numFlips;
+			BeginFrame();
+		} else {
+			NOTICE_LOG(SYSTEM, "Recording complete on display");
+			FinishRecording();
+		}
 	}
 }
 
@@ -545,13 +629,13 @@ void NotifyFrame() {
 		__DisplayGetFramebuf(&disp.topaddr, &disp.linesize, &disp.pixelFormat, 0);
 
 		FlushRegisters();
-		u32 ptr = (u32)pushbuf.size();
+		u32 ptr = PushbufPos();
 		u32 sz = (u32)sizeof(disp);
-		pushbuf.resize(pushbuf.size() + sz);
-		memcpy(pushbuf.data() + ptr, &disp, sz);
+		pushbuf.insert(pushbuf.end(), (const u8 *)&disp, (const u8 *)&disp + sz);
 
 		commands.push_back({ CommandType::DISPLAY, sz, ptr });
 
+		// Without display actions there's no telling where frames end, so stop here.
 		FinishRecording();
 	}
 	if (nextFrame && (gstate_c.skipDrawReason & SKIPDRAW_SKIPFRAME) == 0 && noDisplayAction) {
@@ -25,7 +25,8 @@ namespace GPURecord {
 
 bool IsActive();
 bool IsActivePending();
-bool Activate();
+// Records this many frames into one dump.
+bool Activate(int frames = 1);
 // Call only if Activate() returns true.
 void SetCallback(const std::function<void(const std::string &)> callback);
 
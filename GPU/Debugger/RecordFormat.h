@@ -18,6 +18,7 @@
 #pragma once
 
 #include "Common/CommonTypes.h"
+#include "Common/Swap.h"
 
 namespace GPURecord {
 
@@ -25,7 +26,8 @@ static const char *HEADER = "PPSSPPGE";
 // Version 1: Uncompressed
 // Version 2: Uses snappy
 // Version 3: Adds FRAMEBUF0-FRAMEBUF9
-static const int VERSION = 3;
+// Version 4: Chunked and indexed by frame, see IndexFooter
+static const int VERSION = 4;
 static const int MIN_VERSION = 2;
 
 enum class CommandType : u8 {
@@ -69,4 +71,45 @@ struct Command {
 
 #pragma pack(pop)
 
+// Since version 4, the commands and pushbuf are stored in independently compressed chunks after the
+// header, and an index of them is at the end of the file.  This way neither recording nor playback
+// need the whole dump in memory, and playback can start at any frame.
+//
+// The index is ChunkInfo[chunkCount], in file order, then the first command of each frame as
+// u32[frameCount], then the IndexFooter.  Commands chunks hold COMMANDS_PER_CHUNK commands and pushbuf
+// chunks PUSHBUF_CHUNK_SIZE bytes, except the last of each.  Every frame begins with an INIT command.
+
+static const char *INDEX_MAGIC = "PPGEINDX";
+static const u32 PUSHBUF_CHUNK_SIZE = 1024 * 1024;
+static const u32 COMMANDS_PER_CHUNK = 32768;
+
+enum class ChunkType : u8 {
+	COMMANDS = 0,
+	PUSHBUF = 1,
+};
+
+enum class ChunkCompression : u8 {
+	NONE = 0,
+	SNAPPY = 1,
+};
+
+struct ChunkInfo {
+	ChunkType type;
+	ChunkCompression compression;
+	u16_le pad;
+	u32_le rawSize;
+	u32_le compressedSize;
+	u32_le pad2;
+	u64_le offset;
+};
+
+struct IndexFooter {
+	u32_le commandCount;
+	u32_le pushbufSize;
+	u32_le chunkCount;
+	u32_le frameCount;
+	u64_le indexOffset;
+	char magic[8];
+};
+
 };
@@ -524,6 +524,8 @@ void ShaderManagerDX9::Clear() {
 	}
 	fsCache_.clear();
 	vsCache_.clear();
+	fsLookaside_.Clear();
+	vsLookaside_.Clear();
 	DirtyShader();
 }
 
@@ -580,47 +582,53 @@ VSShader *ShaderManagerDX9::ApplyShader(int prim, u32 vertType) {
 		return lastVShader_;	// Already all set.
 	}
 
-	VSCache::iterator vsIter = vsCache_.find(VSID);
-	VSShader *vs;
-	if (vsIter == vsCache_.end())	{
-		// Vertex shader not in cache. Let's compile it.
-		GenerateVertexShaderHLSL(VSID, codeBuffer_);
-		vs = new VSShader(device_, VSID, codeBuffer_, useHWTransform);
+	VSShader *vs = vsLookaside_.Get(VSID);
+	if (!vs) {
+		VSCache::iterator vsIter = vsCache_.find(VSID);
+		if (vsIter == vsCache_.end())	{
+			// Vertex shader not in cache. Let's compile it.
+			GenerateVertexShaderHLSL(VSID, codeBuffer_);
+			vs = new VSShader(device_, VSID, codeBuffer_, useHWTransform);
 
-		if (vs->Failed()) {
-			auto gr = GetI18NCategory("Graphics");
-			ERROR_LOG(G3D, "Shader compilation failed, falling back to software transform");
-			if (!g_Config.bHideSlowWarnings) {
-				host->NotifyUserMessage(gr->T("hardware transform error - falling back to software"), 2.5f, 0xFF3030FF);
-			}
-			delete vs;
+			if (vs->Failed()) {
+				auto gr = GetI18NCategory("Graphics");
+				ERROR_LOG(G3D, "Shader compilation failed, falling back to software transform");
+				if (!g_Config.bHideSlowWarnings) {
+					host->NotifyUserMessage(gr->T("hardware transform error - falling back to software"), 2.5f, 0xFF3030FF);
+				}
+				delete vs;
 
-			ComputeVertexShaderID(&VSID, vertType, false);
+				ComputeVertexShaderID(&VSID, vertType, false);
 
-			// TODO: Look for existing shader with the appropriate ID, use that instead of generating a new one - however, need to make sure
-			// that that shader ID is not used when computing the linked shader ID below, because then IDs won't match
-			// next time and we'll do this over and over...
+				// TODO: Look for existing shader with the appropriate ID, use that instead of generating a new one - however, need to make sure
+				// that that shader ID is not used when computing the linked shader ID below, because then IDs won't match
+				// next time and we'll do this over and over...
 
-			// Can still work with software transform.
-			GenerateVertexShaderHLSL(VSID, codeBuffer_);
-			vs = new VSShader(device_, VSID, codeBuffer_, false);
-		}
+				// Can still work with software transform.
+				GenerateVertexShaderHLSL(VSID, codeBuffer_);
+				vs = new VSShader(device_, VSID, codeBuffer_, false);
+			}
 
-		vsCache_[VSID] = vs;
-	} else {
-		vs = vsIter->second;
+			vsCache_[VSID] = vs;
+		} else {
+			vs = vsIter->second;
+		}
+		vsLookaside_.Add(VSID, vs);
 	}
 	lastVSID_ = VSID;
 
-	FSCache::iterator fsIter = fsCache_.find(FSID);
-	PSShader *fs;
-	if (fsIter == fsCache_.end())	{
-		// Fragment shader not in cache. Let's compile it.
-		GenerateFragmentShaderHLSL(FSID, codeBuffer_);
-		fs = new PSShader(device_, FSID, codeBuffer_);
-		fsCache_[FSID] = fs;
-	} else {
-		fs = fsIter->second;
+	PSShader *fs = fsLookaside_.Get(FSID);
+	if (!fs) {
+		FSCache::iterator fsIter = fsCache_.find(FSID);
+		if (fsIter == fsCache_.end())	{
+			// Fragment shader not in cache. Let's compile it.
+			GenerateFragmentShaderHLSL(FSID, codeBuffer_);
+			fs = new PSShader(device_, FSID, codeBuffer_);
+			fsCache_[FSID] = fs;
+		} else {
+			fs = fsIter->second;
+		}
+		fsLookaside_.Add(FSID, fs);
 	}
 
 	lastFSID_ = FSID;
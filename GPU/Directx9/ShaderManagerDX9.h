@@ -127,6 +127,9 @@ class ShaderManagerDX9 : public ShaderManagerCommon {
 
 	typedef std::map<VShaderID, VSShader *> VSCache;
 	VSCache vsCache_;
+
+	ShaderLookaside<FShaderID, PSShader> fsLookaside_;
+	ShaderLookaside<VShaderID, VSShader> vsLookaside_;
 };
 
 };
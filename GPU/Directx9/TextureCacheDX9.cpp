@@ -226,6 +226,7 @@ void TextureCacheDX9::StartFrame() {
 		// INFO_LOG(G3D, "Scaled %i texels", texelsScaledThisFrame_);
 	}
 	texelsScaledThisFrame_ = 0;
+	scaler.StartFrame();
 	if (clearCacheNextFrame_) {
 		Clear(true);
 		clearCacheNextFrame_ = false;
@@ -552,7 +553,7 @@ void TextureCacheDX9::BuildTexture(TexCacheEntry *const entry) {
 	}
 
 	if (scaleFactor != 1) {
-		if (texelsScaledThisFrame_ >= TEXCACHE_MAX_TEXELS_SCALED) {
+		if (texelsScaledThisFrame_ >= TEXCACHE_MAX_TEXELS_SCALED || !AsyncScaleReady(*entry)) {
 			entry->status |= TexCacheEntry::STATUS_TO_SCALE;
 			scaleFactor = 1;
 		} else {
@@ -735,8 +736,10 @@ void TextureCacheDX9::LoadTextureLevel(TexCacheEntry &entry, ReplacedTexture &re
 			entry.SetAlphaStatus(TexCacheEntry::STATUS_ALPHA_UNKNOWN);
 		}
 
-		if (scaleFactor > 1) {
-			scaler.ScaleAlways((u32 *)rect.pBits, pixelData, dstFmt, w, h, scaleFactor);
+		if (scaleFactor == 1) {
+			QueueAsyncScale(entry, level, pixelData, decPitch, dstFmt, w, h);
+		} else {
+			ScaleTexture(entry, level, (u32 *)rect.pBits, pixelData, dstFmt, w, h, scaleFactor);
 			pixelData = (u32 *)rect.pBits;
 
 			// We always end up at 8888.  Other parts assume this.
@@ -447,7 +447,7 @@ void GPU_GLES::ExecuteOp(u32 op, u32 diff) {
 	if ((cmdFlags & FLAG_EXECUTE) || (diff && (cmdFlags & FLAG_EXECUTEONCHANGE))) {
 		(this->*info.func)(op, diff);
 	} else if (diff) {
-		uint64_t dirty = info.flags >> 8;
+		uint64_t dirty = ShaderDirtyForWrite(cmd, diff, info.flags >> 8);
 		if (dirty)
 			gstate_c.Dirty(dirty);
 	}
@@ -22,6 +22,7 @@
 #include <cmath>
 #include <cstdio>
 #include <map>
+#include <memory>
 
 #include "math/dataconv.h"
 #include "base/logging.h"
@@ -36,6 +37,7 @@
 #include "thin3d/GLRenderManager.h"
 
 #include "Common/FileUtil.h"
+#include "Common/ThreadPools.h"
 #include "Core/Config.h"
 #include "Core/Host.h"
 #include "Core/Reporting.h"
@@ -50,6 +52,8 @@
 
 using namespace Lin;
 
+static const size_t CODE_BUFFER_SIZE = 16384;
+
 Shader::Shader(GLRenderManager *render, const char *code, const std::string &desc, uint32_t glShaderType, bool useHWTransform, uint32_t attrMask, uint64_t uniformMask)
 	  : render_(render), failed_(false), useHWTransform_(useHWTransform), attrMask_(attrMask), uniformMask_(uniformMask) {
 	PROFILE_THIS_SCOPE("shadercomp");
@@ -576,7 +580,7 @@ void LinkedShader::UpdateUniforms(u32 vertType, const ShaderID &vsid) {
 ShaderManagerGLES::ShaderManagerGLES(Draw::DrawContext *draw)
 		: ShaderManagerCommon(draw), lastShader_(nullptr), shaderSwitchDirtyUniforms_(0), diskCacheDirty_(false), fsCache_(16), vsCache_(16) {
 	render_ = (GLRenderManager *)draw->GetNativeObject(Draw::NativeObject::RENDER_MANAGER);
-	codeBuffer_ = new char[16384];
+	codeBuffer_ = new char[CODE_BUFFER_SIZE];
 	lastFSID_.set_invalid();
 	lastVSID_.set_invalid();
 }
@@ -599,6 +603,8 @@ void ShaderManagerGLES::Clear() {
 	linkedShaderCache_.clear();
 	fsCache_.Clear();
 	vsCache_.Clear();
+	fsLookaside_.Clear();
+	vsLookaside_.Clear();
 	DirtyShader();
 }
 
@@ -673,30 +679,34 @@ Shader *ShaderManagerGLES::ApplyVertexShader(int prim, u32 vertType, VShaderID *
 	}
 	lastVSID_ = *VSID;
 
-	Shader *vs = vsCache_.Get(*VSID);
-	if (!vs)	{
-		// Vertex shader not in cache. Let's compile it.
-		vs = CompileVertexShader(*VSID);
-		if (vs->Failed()) {
-			auto gr = GetI18NCategory("Graphics");
-			ERROR_LOG(G3D, "Shader compilation failed, falling back to software transform");
-			if (!g_Config.bHideSlowWarnings) {
-				host->NotifyUserMessage(gr->T("hardware transform error - falling back to software"), 2.5f, 0xFF3030FF);
-			}
-			delete vs;
+	Shader *vs = vsLookaside_.Get(*VSID);
+	if (!vs) {
+		vs = vsCache_.Get(*VSID);
+		if (!vs)	{
+			// Vertex shader not in cache. Let's compile it.
+			vs = CompileVertexShader(*VSID);
+			if (vs->Failed()) {
+				auto gr = GetI18NCategory("Graphics");
+				ERROR_LOG(G3D, "Shader compilation failed, falling back to software transform");
+				if (!g_Config.bHideSlowWarnings) {
+					host->NotifyUserMessage(gr->T("hardware transform error - falling back to software"), 2.5f, 0xFF3030FF);
+				}
+				delete vs;
 
-			// TODO: Look for existing shader with the appropriate ID, use that instead of generating a new one - however, need to make sure
-			// that that shader ID is not used when computing the linked shader ID below, because then IDs won't match
-			// next time and we'll do this over and over...
+				// TODO: Look for existing shader with the appropriate ID, use that instead of generating a new one - however, need to make sure
+				// that that shader ID is not used when computing the linked shader ID below, because then IDs won't match
+				// next time and we'll do this over and over...
 
-			// Can still work with software transform.
-			VShaderID vsidTemp;
-			ComputeVertexShaderID(&vsidTemp, vertType, false);
-			vs = CompileVertexShader(vsidTemp);
-		}
+				// Can still work with software transform.
+				VShaderID vsidTemp;
+				ComputeVertexShaderID(&vsidTemp, vertType, false);
+				vs = CompileVertexShader(vsidTemp);
+			}
 
-		vsCache_.Insert(*VSID, vs);
-		diskCacheDirty_ = true;
+			vsCache_.Insert(*VSID, vs);
+			diskCacheDirty_ = true;
+		}
+		vsLookaside_.Add(*VSID, vs);
 	}
 	return vs;
 }
@@ -717,12 +727,16 @@ LinkedShader *ShaderManagerGLES::ApplyFragmentShader(VShaderID VSID, Shader *vs,
 
 	lastFSID_ = FSID;
 
-	Shader *fs = fsCache_.Get(FSID);
-	if (!fs)	{
-		// Fragment shader not in cache. Let's compile it.
-		fs = CompileFragmentShader(FSID);
-		fsCache_.Insert(FSID, fs);
-		diskCacheDirty_ = true;
+	Shader *fs = fsLookaside_.Get(FSID);
+	if (!fs) {
+		fs = fsCache_.Get(FSID);
+		if (!fs) {
+			// Fragment shader not in cache. Let's compile it.
+			fs = CompileFragmentShader(FSID);
+			fsCache_.Insert(FSID, fs);
+			diskCacheDirty_ = true;
+		}
+		fsLookaside_.Add(FSID, fs);
 	}
 
 	// Okay, we have both shaders. Let's see if there's a linked one.
@@ -899,6 +913,31 @@ void ShaderManagerGLES::Load(const std::string &filename) {
 		diskCachePending_.link.push_back(std::make_pair(vsid, fsid));
 	}
 
+	// Generating the GLSL is the CPU heavy part, so it's all done up front on the thread pool.
+	// That leaves ContinuePrecompile() with only handing the source over to the render thread.
+	auto &pending = diskCachePending_;
+	pending.vertCode.resize(pending.vert.size());
+	pending.fragCode.resize(pending.frag.size());
+	const int numVert = (int)pending.vert.size();
+	GlobalThreadPool::Loop([&](int lower, int upper) {
+		std::unique_ptr<char[]> buffer(new char[CODE_BUFFER_SIZE]);
+		for (int i = lower; i < upper; ++i) {
+			if (i < numVert) {
+				const VShaderID &id = pending.vert[i];
+				// ContinuePrecompile() bails on these.
+				if (id.Bit(VS_BIT_IS_THROUGH) && id.Bit(VS_BIT_USE_HW_TRANSFORM))
+					continue;
+				GeneratedShader &gen = pending.vertCode[i];
+				GenerateVertexShader(id, buffer.get(), &gen.attrMask, &gen.uniformMask);
+				gen.code = buffer.get();
+			} else {
+				GeneratedShader &gen = pending.fragCode[i - numVert];
+				if (GenerateFragmentShader(pending.frag[i - numVert], buffer.get(), &gen.uniformMask))
+					gen.code = buffer.get();
+			}
+		}
+	}, 0, numVert + (int)pending.frag.size());
+
 	// Actual compilation happens in ContinuePrecompile(), called by GPU_GLES's IsReady.
 	NOTICE_LOG(G3D, "Precompiling the shader cache from '%s'", filename.c_str());
 	diskCacheDirty_ = false;
@@ -931,7 +970,8 @@ bool ShaderManagerGLES::ContinuePrecompile(float sliceTime) {
 				return false;
 			}
 
-			Shader *vs = CompileVertexShader(id);
+			const GeneratedShader &gen = pending.vertCode[i];
+			Shader *vs = new Shader(render_, gen.code.c_str(), VertexShaderDesc(id), GL_VERTEX_SHADER, id.Bit(VS_BIT_USE_HW_TRANSFORM), gen.attrMask, gen.uniformMask);
 			if (vs->Failed()) {
 				// Give up on using the cache, just bail. We can't safely create the fallback shaders here
 				// without trying to deduce the vertType from the VSID.
@@ -954,7 +994,11 @@ bool ShaderManagerGLES::ContinuePrecompile(float sliceTime) {
 
 		const FShaderID &id = pending.frag[i];
 		if (!fsCache_.Get(id)) {
-			fsCache_.Insert(id, CompileFragmentShader(id));
+			const GeneratedShader &gen = pending.fragCode[i];
+			Shader *fs = nullptr;
+			if (!gen.code.empty())
+				fs = new Shader(render_, gen.code.c_str(), FragmentShaderDesc(id), GL_FRAGMENT_SHADER, false, 0, gen.uniformMask);
+			fsCache_.Insert(id, fs);
 		} else {
 			WARN_LOG(G3D, "Duplicate fragment shader found in GL shader cache, ignoring");
 		}
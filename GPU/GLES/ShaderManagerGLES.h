@@ -213,11 +213,23 @@ class ShaderManagerGLES : public ShaderManagerCommon {
 	typedef DenseHashMap<VShaderID, Shader *, nullptr> VSCache;
 	VSCache vsCache_;
 
+	ShaderLookaside<FShaderID, Shader> fsLookaside_;
+	ShaderLookaside<VShaderID, Shader> vsLookaside_;
+
+	// Source for a shader from the disk cache, generated ahead of time by Load().
+	struct GeneratedShader {
+		std::string code;
+		uint32_t attrMask = 0;
+		uint64_t uniformMask = 0;
+	};
+
 	bool diskCacheDirty_;
 	struct {
 		std::vector<VShaderID> vert;
 		std::vector<FShaderID> frag;
 		std::vector<std::pair<VShaderID, FShaderID>> link;
+		std::vector<GeneratedShader> vertCode;
+		std::vector<GeneratedShader> fragCode;
 
 		size_t vertPos = 0;
 		size_t fragPos = 0;
@@ -228,6 +240,8 @@ class ShaderManagerGLES : public ShaderManagerCommon {
 			vert.clear();
 			frag.clear();
 			link.clear();
+			vertCode.clear();
+			fragCode.clear();
 			vertPos = 0;
 			fragPos = 0;
 			linkPos = 0;
@@ -231,6 +231,7 @@ void TextureCacheGLES::StartFrame() {
 		// INFO_LOG(G3D, "Scaled %i texels", texelsScaledThisFrame_);
 	}
 	texelsScaledThisFrame_ = 0;
+	scaler.StartFrame();
 	if (clearCacheNextFrame_) {
 		Clear(true);
 		clearCacheNextFrame_ = false;
@@ -625,7 +626,7 @@ void TextureCacheGLES::BuildTexture(TexCacheEntry *const entry) {
 	}
 
 	if (scaleFactor != 1) {
-		if (texelsScaledThisFrame_ >= TEXCACHE_MAX_TEXELS_SCALED) {
+		if (texelsScaledThisFrame_ >= TEXCACHE_MAX_TEXELS_SCALED || !AsyncScaleReady(*entry)) {
 			entry->status |= TexCacheEntry::STATUS_TO_SCALE;
 			scaleFactor = 1;
 		} else {
@@ -783,10 +784,12 @@ void TextureCacheGLES::LoadTextureLevel(TexCacheEntry &entry, ReplacedTexture &r
 			entry.SetAlphaStatus(TexCacheEntry::STATUS_ALPHA_UNKNOWN);
 		}
 
-		if (scaleFactor > 1) {
+		if (scaleFactor == 1) {
+			QueueAsyncScale(entry, level, pixelData, decPitch, (u32)dstFmt, w, h);
+		} else {
 			uint8_t *rearrange = (uint8_t *)AllocateAlignedMemory(w * scaleFactor * h * scaleFactor * 4, 16);
 			u32 dFmt = (u32)dstFmt;
-			scaler.ScaleAlways((u32 *)rearrange, (u32 *)pixelData, dFmt, w, h, scaleFactor);
+			ScaleTexture(entry, level, (u32 *)rearrange, (u32 *)pixelData, dFmt, w, h, scaleFactor);
 			dstFmt = (Draw::DataFormat)dFmt;
 			FreeAlignedMemory(pixelData);
 			pixelData = rearrange;
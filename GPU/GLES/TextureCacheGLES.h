@@ -82,6 +82,7 @@ class TextureCacheGLES : public TextureCacheCommon {
 	TexCacheEntry::TexStatus CheckAlpha(const uint8_t *pixelData, Draw::DataFormat dstFmt, int stride, int w, int h);
 	void UpdateCurrentClut(GEPaletteFormat clutFormat, u32 clutBase, bool clutIndexIsSimple) override;
 	void ApplyTextureFramebuffer(TexCacheEntry *entry, VirtualFramebuffer *framebuffer) override;
+	TextureScalerCommon &Scaler() override { return scaler; }
 
 	void BuildTexture(TexCacheEntry *const entry) override;
 
@@ -71,6 +71,8 @@ struct GPUStatistics {
 		numUploads = 0;
 		numClears = 0;
 		msProcessingDisplayLists = 0;
+		msDecodingTextures = 0;
+		msDecodingVertices = 0;
 		vertexGPUCycles = 0;
 		otherGPUCycles = 0;
 		memset(gpuCommandsAtCallLevel, 0, sizeof(gpuCommandsAtCallLevel));
@@ -92,6 +94,9 @@ struct GPUStatistics {
 	int numUploads;
 	int numClears;
 	double msProcessingDisplayLists;
+	// Only collected along with msProcessingDisplayLists.
+	double msDecodingTextures;
+	double msDecodingVertices;
 	int vertexGPUCycles;
 	int otherGPUCycles;
 	int gpuCommandsAtCallLevel[4];
@@ -1,13 +1,16 @@
 #include <algorithm>
+#include <cstring>
 #include <type_traits>
 #include <mutex>
 
 #include "base/timeutil.h"
 #include "profiler/profiler.h"
+#include "thread/threadutil.h"
 
 #include "Common/ColorConv.h"
 #include "Common/GraphicsContext.h"
 #include "Core/Reporting.h"
+#include "ext/xxhash.h"
 #include "GPU/GeDisasm.h"
 #include "GPU/GPU.h"
 #include "GPU/GPUCommon.h"
@@ -27,6 +30,7 @@
 #include "Core/MemMapHelpers.h"
 #include "GPU/Common/DrawEngineCommon.h"
 #include "GPU/Common/FramebufferCommon.h"
+#include "GPU/Common/ShaderId.h"
 #include "GPU/Common/SplineCommon.h"
 #include "GPU/Common/TextureCacheCommon.h"
 #include "GPU/Debugger/Debugger.h"
@@ -358,6 +362,7 @@ size_t commonCommandTableSize = ARRAY_SIZE(commonCommandTable);
 
 // TODO: Make class member?
 GPUCommon::CommandInfo GPUCommon::cmdInfo_[256];
+GPUCommon::ShaderIDDeps GPUCommon::shaderIDDeps_[256];
 
 void GPUCommon::Flush() {
 	drawEngineCommon_->DispatchFlush();
@@ -379,6 +384,7 @@ GPUCommon::GPUCommon(GraphicsContext *gfxCtx, Draw::DrawContext *draw) :
 
 	Reinitialize();
 	SetupColorConv();
+	useDisplayListCache_ = g_Config.bDisplayListCache;
 	gstate.Reset();
 	gstate_c.Reset();
 	gpuStats.Reset();
@@ -396,6 +402,8 @@ GPUCommon::GPUCommon(GraphicsContext *gfxCtx, Draw::DrawContext *draw) :
 		}
 		cmdInfo_[cmd].flags |= (uint64_t)commonCommandTable[i].flags | (commonCommandTable[i].dirty << 8);
 		cmdInfo_[cmd].func = commonCommandTable[i].func;
+		shaderIDDeps_[cmd].vs = VertexShaderIDDependencyMask(cmd);
+		shaderIDDeps_[cmd].fs = FragmentShaderIDDependencyMask(cmd);
 		if ((cmdInfo_[cmd].flags & (FLAG_EXECUTE | FLAG_EXECUTEONCHANGE)) && !cmdInfo_[cmd].func) {
 			// Can't have FLAG_EXECUTE commands without a function pointer to execute.
 			Crash();
@@ -413,6 +421,8 @@ GPUCommon::GPUCommon(GraphicsContext *gfxCtx, Draw::DrawContext *draw) :
 }
 
 GPUCommon::~GPUCommon() {
+	// By now, the emu thread should have synced with it.
+	StopGeThread();
 }
 
 void GPUCommon::UpdateCmdInfo() {
@@ -431,9 +441,13 @@ void GPUCommon::UpdateCmdInfo() {
 		cmdInfo_[GE_CMD_JUMP].func = &GPUCommon::Execute_Jump;
 		cmdInfo_[GE_CMD_CALL].func = &GPUCommon::Execute_Call;
 	}
+
+	// Decoded segments have the old flags baked in.
+	ClearDisplayListCache();
 }
 
 void GPUCommon::BeginHostFrame() {
+	SyncThread();
 	UpdateVsyncInterval(resized_);
 	ReapplyGfxState();
 
@@ -446,6 +460,7 @@ void GPUCommon::EndHostFrame() {
 }
 
 void GPUCommon::Reinitialize() {
+	SyncThread();
 	memset(dls, 0, sizeof(dls));
 	for (int i = 0; i < DisplayListMaxCount; ++i) {
 		dls[i].state = PSP_GE_DL_STATE_NONE;
@@ -459,6 +474,7 @@ void GPUCommon::Reinitialize() {
 	busyTicks = 0;
 	timeSpentStepping_ = 0.0;
 	interruptsEnabled_ = true;
+	ClearDisplayListCache();
 }
 
 void GPUCommon::UpdateVsyncInterval(bool force) {
@@ -530,6 +546,7 @@ void GPUCommon::PopDLQueue() {
 }
 
 bool GPUCommon::BusyDrawing() {
+	SyncThread();
 	u32 state = DrawSync(1);
 	if (state == PSP_GE_LIST_DRAWING || state == PSP_GE_LIST_STALLING) {
 		if (currentList && currentList->state != PSP_GE_DL_STATE_PAUSED) {
@@ -548,6 +565,7 @@ void GPUCommon::DumpNextFrame() {
 }
 
 u32 GPUCommon::DrawSync(int mode) {
+	SyncThread();
 	if (mode < 0 || mode > 1)
 		return SCE_KERNEL_ERROR_INVALID_MODE;
 
@@ -596,6 +614,7 @@ void GPUCommon::CheckDrawSync() {
 }
 
 int GPUCommon::ListSync(int listid, int mode) {
+	SyncThread();
 	if (listid < 0 || listid >= DisplayListMaxCount)
 		return SCE_KERNEL_ERROR_INVALID_ID;
 
@@ -640,6 +659,7 @@ int GPUCommon::ListSync(int listid, int mode) {
 }
 
 int GPUCommon::GetStack(int index, u32 stackPtr) {
+	SyncThread();
 	if (!currentList) {
 		// Seems like it doesn't return an error code?
 		return 0;
@@ -665,6 +685,7 @@ int GPUCommon::GetStack(int index, u32 stackPtr) {
 }
 
 u32 GPUCommon::EnqueueList(u32 listpc, u32 stall, int subIntrBase, PSPPointer<PspGeListArgs> args, bool head) {
+	SyncThread();
 	// TODO Check the stack values in missing arg and ajust the stack depth
 
 	// Check alignment
@@ -774,6 +795,7 @@ u32 GPUCommon::EnqueueList(u32 listpc, u32 stall, int subIntrBase, PSPPointer<Ps
 }
 
 u32 GPUCommon::DequeueList(int listid) {
+	SyncThread();
 	if (listid < 0 || listid >= DisplayListMaxCount || dls[listid].state == PSP_GE_DL_STATE_NONE)
 		return SCE_KERNEL_ERROR_INVALID_ID;
 
@@ -797,6 +819,7 @@ u32 GPUCommon::DequeueList(int listid) {
 }
 
 u32 GPUCommon::UpdateStall(int listid, u32 newstall) {
+	SyncThread();
 	if (listid < 0 || listid >= DisplayListMaxCount || dls[listid].state == PSP_GE_DL_STATE_NONE)
 		return SCE_KERNEL_ERROR_INVALID_ID;
 	auto &dl = dls[listid];
@@ -811,6 +834,7 @@ u32 GPUCommon::UpdateStall(int listid, u32 newstall) {
 }
 
 u32 GPUCommon::Continue() {
+	SyncThread();
 	if (!currentList)
 		return 0;
 
@@ -851,6 +875,7 @@ u32 GPUCommon::Continue() {
 }
 
 u32 GPUCommon::Break(int mode) {
+	SyncThread();
 	if (mode < 0 || mode > 1)
 		return SCE_KERNEL_ERROR_INVALID_MODE;
 
@@ -947,6 +972,7 @@ bool GPUCommon::InterpretList(DisplayList &list) {
 		gstate.Save(list.context);
 	}
 	list.started = true;
+	dlCacheRun_++;
 
 	gstate_c.offsetAddr = list.offsetAddr;
 
@@ -1002,7 +1028,13 @@ bool GPUCommon::InterpretList(DisplayList &list) {
 	if (coreCollectDebugStats) {
 		time_update();
 		double total = time_now_d() - start - timeSpentStepping_;
-		hleSetSteppingTime(timeSpentStepping_);
+		if (std::this_thread::get_id() == geThread_.get_id()) {
+			// HLE's stepping time belongs to the emu thread, FlushThreadEvents() passes it on.
+			std::lock_guard<std::mutex> guard(geThreadEventLock_);
+			geThreadSteppingTime_ += timeSpentStepping_;
+		} else {
+			hleSetSteppingTime(timeSpentStepping_);
+		}
 		timeSpentStepping_ = 0.0;
 		gpuStats.msProcessingDisplayLists += total;
 	}
@@ -1010,47 +1042,283 @@ bool GPUCommon::InterpretList(DisplayList &list) {
 }
 
 // Maybe should write this in ASM...
+enum {
+	// Shorter stretches aren't worth the lookup.
+	DLCACHE_MIN_WORDS = 16,
+	DLCACHE_MAX_WORDS = 4096,
+	DLCACHE_MAX_SEGMENTS = 4096,
+	// Lists that are rewritten every frame are left to the plain loop for a while.
+	DLCACHE_MAX_MISMATCHES = 4,
+	DLCACHE_RETRY_FRAMES = 120,
+	DLCACHE_PRUNE_FRAMES = 60,
+};
+
 void GPUCommon::FastRunLoop(DisplayList &list) {
 	PROFILE_THIS_SCOPE("gpuloop");
 	const CommandInfo *cmdInfo = cmdInfo_;
 	int dc = downcount;
-	for (; dc > 0; --dc) {
-		// We know that display list PCs have the upper nibble == 0 - no need to mask the pointer
-		const u32 op = *(const u32 *)(Memory::base + list.pc);
-		const u32 cmd = op >> 24;
-		const CommandInfo &info = cmdInfo[cmd];
-		const u32 diff = op ^ gstate.cmdmem[cmd];
-		if (diff == 0) {
-			if (info.flags & FLAG_EXECUTE) {
-				downcount = dc;
-				(this->*info.func)(op, diff);
+	while (dc > 0) {
+		const DLCacheSegment *segment = useDisplayListCache_ ? LookupDisplayListSegment(list.pc, dc) : nullptr;
+		if (segment) {
+			ReplayDisplayListSegment(*segment, list, dc);
+			continue;
+		}
+
+		// Nothing cached, run commands one by one until the next place a segment could start.
+		for (; dc > 0; --dc) {
+			// We know that display list PCs have the upper nibble == 0 - no need to mask the pointer
+			const u32 op = *(const u32 *)(Memory::base + list.pc);
+			const u32 cmd = op >> 24;
+			const CommandInfo &info = cmdInfo[cmd];
+			const u32 diff = op ^ gstate.cmdmem[cmd];
+			bool executed = false;
+			if (diff == 0) {
+				if (info.flags & FLAG_EXECUTE) {
+					downcount = dc;
+					(this->*info.func)(op, diff);
+					executed = true;
+				}
+			} else {
+				uint64_t flags = info.flags;
+				if (flags & FLAG_FLUSHBEFOREONCHANGE) {
+					if (drawEngineCommon_->GetNumDrawCalls()) {
+						drawEngineCommon_->DispatchFlush();
+					}
+				}
+				gstate.cmdmem[cmd] = op;
+				if (flags & (FLAG_EXECUTE | FLAG_EXECUTEONCHANGE)) {
+					downcount = dc;
+					(this->*info.func)(op, diff);
+					executed = true;
+				} else {
+					uint64_t dirty = ShaderDirtyForWrite(cmd, diff, flags >> 8);
+					if (dirty)
+						gstate_c.Dirty(dirty);
+				}
+			}
+			if (executed) {
+				const bool moved = downcount != dc;
 				dc = downcount;
+				if (moved || (info.flags & (FLAG_READS_PC | FLAG_WRITES_PC))) {
+					list.pc += 4;
+					--dc;
+					break;
+				}
 			}
+			list.pc += 4;
+		}
+	}
+	downcount = 0;
+}
+
+const GPUCommon::DLCacheSegment *GPUCommon::LookupDisplayListSegment(u32 pc, int dc) {
+	auto it = dlCache_.find(pc);
+	if (it == dlCache_.end()) {
+		// Only decode lists we've run before, one-off lists aren't worth it.
+		u32 &seen = dlCacheSeen_[(pc >> 2) % ARRAY_SIZE(dlCacheSeen_)];
+		if (seen != pc || dlCache_.size() >= DLCACHE_MAX_SEGMENTS) {
+			seen = pc;
+			return nullptr;
+		}
+		it = dlCache_.emplace(pc, DLCacheSegment()).first;
+	}
+
+	DLCacheSegment &seg = it->second;
+	seg.lastFrame = dlCacheFrame_;
+	if (seg.retryFrame > dlCacheFrame_) {
+		return nullptr;
+	}
+
+	if (seg.numWords != 0) {
+		if ((u32)dc < seg.numWords) {
+			return nullptr;
+		}
+		if (seg.checkedRun == dlCacheRun_ || XXH64(Memory::base + pc, seg.numWords * sizeof(u32), 0) == seg.hash) {
+			seg.checkedRun = dlCacheRun_;
+			return &seg;
+		}
+		if (++seg.mismatches >= DLCACHE_MAX_MISMATCHES) {
+			seg.mismatches = 0;
+			seg.retryFrame = dlCacheFrame_ + DLCACHE_RETRY_FRAMES;
+			seg.numWords = 0;
+			seg.steps.clear();
+			return nullptr;
+		}
+	}
+
+	DecodeDisplayListSegment(pc, dc, seg);
+	if (seg.numWords < DLCACHE_MIN_WORDS) {
+		seg.retryFrame = dlCacheFrame_ + DLCACHE_RETRY_FRAMES;
+		seg.numWords = 0;
+		seg.steps.clear();
+		return nullptr;
+	}
+	return &seg;
+}
+
+void GPUCommon::DecodeDisplayListSegment(u32 pc, int maxWords, DLCacheSegment &seg) {
+	seg.numWords = 0;
+	seg.steps.clear();
+
+	maxWords = std::min(maxWords, (int)DLCACHE_MAX_WORDS);
+	maxWords = Memory::ValidSize(pc, maxWords * 4) / 4;
+	const u32 *src = (const u32 *)(Memory::base + pc);
+
+	// Index of each register's write in the current run of state writes, so repeats collapse into one.
+	s16 runSlot[256];
+	memset(runSlot, -1, sizeof(runSlot));
+	size_t runStart = 0;
+	int runWords = 0;
+	auto endRun = [&]() {
+		if (runWords == 0)
+			return;
+		seg.steps.back().words = runWords;
+		for (size_t i = runStart; i < seg.steps.size(); ++i) {
+			runSlot[seg.steps[i].op >> 24] = -1;
+		}
+		runWords = 0;
+	};
+
+	for (int i = 0; i < maxWords; ++i) {
+		const u32 op = src[i];
+		const u32 cmd = op >> 24;
+		const uint64_t flags = cmdInfo_[cmd].flags;
+		seg.numWords++;
+
+		if (flags & (FLAG_EXECUTE | FLAG_EXECUTEONCHANGE)) {
+			endRun();
+			seg.steps.push_back({ op, 1, 1, 0, 0 });
+			// Jumps, calls, and friends end the segment, wherever they go gets its own.
+			if (flags & (FLAG_READS_PC | FLAG_WRITES_PC))
+				break;
+			continue;
+		}
+
+		// Only the last value matters: nothing can observe the ones before it.
+		if (runSlot[cmd] >= 0) {
+			seg.steps[runSlot[cmd]].op = op;
 		} else {
-			uint64_t flags = info.flags;
-			if (flags & FLAG_FLUSHBEFOREONCHANGE) {
-				if (drawEngineCommon_->GetNumDrawCalls()) {
+			if (runWords == 0)
+				runStart = seg.steps.size();
+			runSlot[cmd] = (s16)seg.steps.size();
+			seg.steps.push_back({ op, 0, 0, (u8)((flags & FLAG_FLUSHBEFOREONCHANGE) ? 1 : 0), flags >> 8 });
+		}
+		runWords++;
+	}
+	endRun();
+	seg.hash = XXH64(src, seg.numWords * sizeof(u32), 0);
+	seg.checkedRun = dlCacheRun_;
+}
+
+void GPUCommon::ReplayDisplayListSegment(const DLCacheSegment &seg, DisplayList &list, int &dc) {
+	const u32 epoch = dlCacheEpoch_;
+	u32 pc = list.pc;
+	// Dirty flags for a run of state writes are applied together, before anything can look at them.
+	u64 dirty = 0;
+	for (const DLCacheStep &step : seg.steps) {
+		const u32 op = step.op;
+		const u32 cmd = op >> 24;
+		const u32 diff = op ^ gstate.cmdmem[cmd];
+		if (!step.exec) {
+			if (diff != 0) {
+				if (step.flush && drawEngineCommon_->GetNumDrawCalls()) {
 					drawEngineCommon_->DispatchFlush();
 				}
+				gstate.cmdmem[cmd] = op;
+				dirty |= ShaderDirtyForWrite(cmd, diff, step.dirty);
 			}
-			gstate.cmdmem[cmd] = op;
-			if (flags & (FLAG_EXECUTE | FLAG_EXECUTEONCHANGE)) {
-				downcount = dc;
-				(this->*info.func)(op, diff);
-				dc = downcount;
-			} else {
-				uint64_t dirty = flags >> 8;
-				if (dirty)
+			if (step.words != 0) {
+				if (dirty != 0) {
 					gstate_c.Dirty(dirty);
+					dirty = 0;
+				}
+				pc += step.words * 4;
+				dc -= step.words;
 			}
+			continue;
 		}
-		list.pc += 4;
+
+		const CommandInfo &info = cmdInfo_[cmd];
+		bool execute = (info.flags & FLAG_EXECUTE) != 0;
+		if (diff != 0) {
+			if ((info.flags & FLAG_FLUSHBEFOREONCHANGE) && drawEngineCommon_->GetNumDrawCalls()) {
+				drawEngineCommon_->DispatchFlush();
+			}
+			gstate.cmdmem[cmd] = op;
+			execute = true;
+		}
+		if (execute) {
+			list.pc = pc;
+			downcount = dc;
+			(this->*info.func)(op, diff);
+			// Prims merge the ones after them, and any command may touch list memory or the stall.
+			if (list.pc != pc || downcount != dc || dlCacheEpoch_ != epoch) {
+				dc = downcount - 1;
+				list.pc += 4;
+				return;
+			}
+		}
+		pc += 4;
+		--dc;
 	}
-	downcount = 0;
+	list.pc = pc;
+}
+
+void GPUCommon::ClearDisplayListCache() {
+	dlCache_.clear();
+	memset(dlCacheSeen_, 0, sizeof(dlCacheSeen_));
+	dlCacheEpoch_++;
+}
+
+void GPUCommon::InvalidateDisplayListCache(u32 addr, int size) {
+	// Segments are only hashed once per run, so the overwritten ones have to go.  The epoch stops
+	// one that's running if its list changed underneath it.
+	if (size <= 0)
+		return;
+	// Lists the GPU rewrites have to be seen twice again before they're worth decoding.
+	// Small writes like block transfers only need to look at their own slots.
+	const u32 slots = ARRAY_SIZE(dlCacheSeen_);
+	if ((u32)size / 4 < slots) {
+		for (u32 pc = addr & ~3; pc < addr + size; pc += 4) {
+			u32 &seen = dlCacheSeen_[(pc >> 2) % slots];
+			if (seen == pc)
+				seen = 0;
+		}
+	} else {
+		for (u32 &seen : dlCacheSeen_) {
+			if (seen >= addr && seen < addr + size)
+				seen = 0;
+		}
+	}
+	if (dlCache_.empty())
+		return;
+	bool overlapped = false;
+	auto it = dlCache_.lower_bound(addr >= DLCACHE_MAX_WORDS * 4 ? addr - DLCACHE_MAX_WORDS * 4 : 0);
+	while (it != dlCache_.end() && it->first < addr + size) {
+		if (it->first >= addr || it->first + it->second.numWords * 4 > addr) {
+			it = dlCache_.erase(it);
+			overlapped = true;
+		} else {
+			++it;
+		}
+	}
+	if (overlapped)
+		dlCacheEpoch_++;
 }
 
 void GPUCommon::BeginFrame() {
+	SyncThread();
 	immCount_ = 0;
+	dlCacheFrame_++;
+	if ((dlCacheFrame_ % DLCACHE_PRUNE_FRAMES) == 0) {
+		for (auto it = dlCache_.begin(); it != dlCache_.end(); ) {
+			if (it->second.lastFrame + DLCACHE_RETRY_FRAMES < dlCacheFrame_) {
+				it = dlCache_.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
 	if (dumpNextFrame_) {
 		NOTICE_LOG(G3D, "DUMPING THIS FRAME");
 		dumpThisFrame_ = true;
@@ -1113,6 +1381,7 @@ void GPUCommon::UpdatePC(u32 currentPC, u32 newPC) {
 }
 
 void GPUCommon::ReapplyGfxState() {
+	SyncThread();
 	// The commands are embedded in the command memory so we can just reexecute the words. Convenient.
 	// To be safe we pass 0xFFFFFFFF as the diff.
 
@@ -1155,6 +1424,8 @@ int GPUCommon::GetNextListIndex() {
 void GPUCommon::ProcessDLQueue() {
 	startingTicks = CoreTiming::GetTicks();
 	cyclesExecuted = 0;
+	// The GE thread can't look at the CPU, so memchecks report where the lists were kicked from.
+	kickPC_ = currentMIPS->pc;
 
 	// Seems to be correct behaviour to process the list anyway?
 	if (startingTicks < busyTicks) {
@@ -1162,6 +1433,25 @@ void GPUCommon::ProcessDLQueue() {
 		//return;
 	}
 
+	// The debugger and recorder want to see each command as it runs, so they keep everything on this thread.
+	const bool useThread = g_Config.bGeThread && !GPUDebug::IsActive() && !GPURecord::IsActive() && !dumpNextFrame_ && !dumpThisFrame_;
+	if (!useThread) {
+		StopGeThread();
+		RunDLQueue();
+		return;
+	}
+
+	if (!geThread_.joinable()) {
+		geThreadExit_ = false;
+		geThread_ = std::thread(&GPUCommon::GeThreadFunc, this);
+	}
+	geThreadPending_ = true;
+	std::lock_guard<std::mutex> guard(geThreadLock_);
+	geThreadWork_ = true;
+	geThreadCond_.notify_all();
+}
+
+void GPUCommon::RunDLQueue() {
 	for (int listIndex = GetNextListIndex(); listIndex != -1; listIndex = GetNextListIndex()) {
 		DisplayList &l = dls[listIndex];
 		DEBUG_LOG(G3D, "Starting DL execution at %08x - stall = %08x", l.pc, l.stall);
@@ -1180,10 +1470,105 @@ void GPUCommon::ProcessDLQueue() {
 
 	drawCompleteTicks = startingTicks + cyclesExecuted;
 	busyTicks = std::max(busyTicks, drawCompleteTicks);
-	__GeTriggerSync(GPU_SYNC_DRAW, 1, drawCompleteTicks);
+	TriggerSync(GPU_SYNC_DRAW, 1, drawCompleteTicks);
 	// Since the event is in CoreTiming, we're in sync.  Just set 0 now.
 }
 
+void GPUCommon::GeThreadFunc() {
+	setCurrentThreadName("GE");
+
+	std::unique_lock<std::mutex> guard(geThreadLock_);
+	while (!geThreadExit_) {
+		if (!geThreadWork_) {
+			geThreadCond_.wait(guard);
+			continue;
+		}
+
+		guard.unlock();
+		RunDLQueue();
+		guard.lock();
+		geThreadWork_ = false;
+		geThreadCond_.notify_all();
+	}
+}
+
+void GPUCommon::SyncThread() {
+	if (!geThreadPending_ || std::this_thread::get_id() == geThread_.get_id())
+		return;
+
+	{
+		std::unique_lock<std::mutex> guard(geThreadLock_);
+		geThreadCond_.wait(guard, [&] { return !geThreadWork_; });
+	}
+	geThreadPending_ = false;
+	FlushThreadEvents();
+}
+
+void GPUCommon::FlushThreadEvents() {
+	std::vector<GeThreadEvent> events;
+	double steppingTime;
+	{
+		std::lock_guard<std::mutex> guard(geThreadEventLock_);
+		events.swap(geThreadEvents_);
+		steppingTime = geThreadSteppingTime_;
+		geThreadSteppingTime_ = 0.0;
+	}
+
+	if (steppingTime != 0.0)
+		hleSetSteppingTime(steppingTime);
+
+	// Now that we're back on the emu thread, let sceGe know what happened, in order.
+	for (const GeThreadEvent &ev : events) {
+		if (ev.interrupt) {
+			__GeTriggerInterrupt(ev.listid, ev.pc, ev.atTicks);
+		} else {
+			__GeTriggerSync(ev.type, ev.listid, ev.atTicks);
+		}
+	}
+}
+
+void GPUCommon::StopGeThread() {
+	if (!geThread_.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> guard(geThreadLock_);
+		geThreadExit_ = true;
+		geThreadCond_.notify_all();
+	}
+	geThread_.join();
+}
+
+void GPUCommon::QueueThreadEvent(const GeThreadEvent &ev) {
+	bool first;
+	{
+		std::lock_guard<std::mutex> guard(geThreadEventLock_);
+		first = geThreadEvents_.empty();
+		geThreadEvents_.push_back(ev);
+	}
+	// CoreTiming calls FlushThreadEvents() at its next advance, so these are scheduled while the
+	// CPU keeps running rather than waiting for something to sync with us.
+	if (first)
+		__GeNotifyThreadEvents();
+}
+
+bool GPUCommon::TriggerInterrupt(int listid, u32 pc, u64 atTicks) {
+	if (std::this_thread::get_id() == geThread_.get_id()) {
+		QueueThreadEvent({ true, GPU_SYNC_DRAW, listid, pc, atTicks });
+		// Same as __GeTriggerInterrupt(), which always queues it.
+		return true;
+	}
+	return __GeTriggerInterrupt(listid, pc, atTicks);
+}
+
+void GPUCommon::TriggerSync(GPUSyncType type, int id, u64 atTicks) {
+	if (std::this_thread::get_id() == geThread_.get_id()) {
+		QueueThreadEvent({ false, type, id, 0, atTicks });
+		return;
+	}
+	__GeTriggerSync(type, id, atTicks);
+}
+
 void GPUCommon::PreExecuteOp(u32 op, u32 diff) {
 	// Nothing to do
 }
@@ -1415,7 +1800,7 @@ void GPUCommon::Execute_End(u32 op, u32 diff) {
 			}
 			// TODO: Technically, jump/call/ret should generate an interrupt, but before the pc change maybe?
 			if (currentList->interruptsEnabled && trigger) {
-				if (__GeTriggerInterrupt(currentList->id, currentList->pc, startingTicks + cyclesExecuted)) {
+				if (TriggerInterrupt(currentList->id, currentList->pc, startingTicks + cyclesExecuted)) {
 					currentList->pendingInterrupt = true;
 					UpdateState(GPUSTATE_INTERRUPT);
 				}
@@ -1427,7 +1812,7 @@ void GPUCommon::Execute_End(u32 op, u32 diff) {
 		case PSP_GE_SIGNAL_HANDLER_PAUSE:
 			currentList->state = PSP_GE_DL_STATE_PAUSED;
 			if (currentList->interruptsEnabled) {
-				if (__GeTriggerInterrupt(currentList->id, currentList->pc, startingTicks + cyclesExecuted)) {
+				if (TriggerInterrupt(currentList->id, currentList->pc, startingTicks + cyclesExecuted)) {
 					currentList->pendingInterrupt = true;
 					UpdateState(GPUSTATE_INTERRUPT);
 				}
@@ -1442,13 +1827,13 @@ void GPUCommon::Execute_End(u32 op, u32 diff) {
 		default:
 			currentList->subIntrToken = prev & 0xFFFF;
 			UpdateState(GPUSTATE_DONE);
-			if (currentList->interruptsEnabled && __GeTriggerInterrupt(currentList->id, currentList->pc, startingTicks + cyclesExecuted)) {
+			if (currentList->interruptsEnabled && TriggerInterrupt(currentList->id, currentList->pc, startingTicks + cyclesExecuted)) {
 				currentList->pendingInterrupt = true;
 			} else {
 				currentList->state = PSP_GE_DL_STATE_COMPLETED;
 				currentList->waitTicks = startingTicks + cyclesExecuted;
 				busyTicks = std::max(busyTicks, currentList->waitTicks);
-				__GeTriggerSync(GPU_SYNC_LIST, currentList->id, currentList->waitTicks);
+				TriggerSync(GPU_SYNC_LIST, currentList->id, currentList->waitTicks);
 				if (currentList->started && currentList->context.IsValid()) {
 					gstate.Restore(currentList->context);
 					ReapplyGfxState();
@@ -1944,17 +2329,13 @@ void GPUCommon::Execute_WorldMtxNum(u32 op, u32 diff) {
 		fastLoad = false;
 	}
 
-	if (fastLoad) {
-		while ((src[i] >> 24) == GE_CMD_WORLDMATRIXDATA) {
-			const u32 newVal = src[i] << 8;
-			if (dst[i] != newVal) {
-				Flush();
-				dst[i] = newVal;
-				gstate_c.Dirty(DIRTY_WORLDMATRIX);
-			}
-			if (++i >= end) {
-				break;
-			}
+	if (fastLoad && end > 0) {
+		bool changed;
+		i = ScanMatrixData(dst, src, end, GE_CMD_WORLDMATRIXDATA, &changed);
+		if (changed) {
+			Flush();
+			LoadMatrixData(dst, src, i);
+			gstate_c.Dirty(DIRTY_WORLDMATRIX);
 		}
 	}
 
@@ -1991,17 +2372,13 @@ void GPUCommon::Execute_ViewMtxNum(u32 op, u32 diff) {
 		fastLoad = false;
 	}
 
-	if (fastLoad) {
-		while ((src[i] >> 24) == GE_CMD_VIEWMATRIXDATA) {
-			const u32 newVal = src[i] << 8;
-			if (dst[i] != newVal) {
-				Flush();
-				dst[i] = newVal;
-				gstate_c.Dirty(DIRTY_VIEWMATRIX);
-			}
-			if (++i >= end) {
-				break;
-			}
+	if (fastLoad && end > 0) {
+		bool changed;
+		i = ScanMatrixData(dst, src, end, GE_CMD_VIEWMATRIXDATA, &changed);
+		if (changed) {
+			Flush();
+			LoadMatrixData(dst, src, i);
+			gstate_c.Dirty(DIRTY_VIEWMATRIX);
 		}
 	}
 
@@ -2038,17 +2415,13 @@ void GPUCommon::Execute_ProjMtxNum(u32 op, u32 diff) {
 		fastLoad = false;
 	}
 
-	if (fastLoad) {
-		while ((src[i] >> 24) == GE_CMD_PROJMATRIXDATA) {
-			const u32 newVal = src[i] << 8;
-			if (dst[i] != newVal) {
-				Flush();
-				dst[i] = newVal;
-				gstate_c.Dirty(DIRTY_PROJMATRIX);
-			}
-			if (++i >= end) {
-				break;
-			}
+	if (fastLoad && end > 0) {
+		bool changed;
+		i = ScanMatrixData(dst, src, end, GE_CMD_PROJMATRIXDATA, &changed);
+		if (changed) {
+			Flush();
+			LoadMatrixData(dst, src, i);
+			gstate_c.Dirty(DIRTY_PROJMATRIX);
 		}
 	}
 
@@ -2086,17 +2459,13 @@ void GPUCommon::Execute_TgenMtxNum(u32 op, u32 diff) {
 		fastLoad = false;
 	}
 
-	if (fastLoad) {
-		while ((src[i] >> 24) == GE_CMD_TGENMATRIXDATA) {
-			const u32 newVal = src[i] << 8;
-			if (dst[i] != newVal) {
-				Flush();
-				dst[i] = newVal;
-				gstate_c.Dirty(DIRTY_TEXMATRIX);
-			}
-			if (++i >= end) {
-				break;
-			}
+	if (fastLoad && end > 0) {
+		bool changed;
+		i = ScanMatrixData(dst, src, end, GE_CMD_TGENMATRIXDATA, &changed);
+		if (changed) {
+			Flush();
+			LoadMatrixData(dst, src, i);
+			gstate_c.Dirty(DIRTY_TEXMATRIX);
 		}
 	}
 
@@ -2134,35 +2503,23 @@ void GPUCommon::Execute_BoneMtxNum(u32 op, u32 diff) {
 	}
 
 	if (fastLoad) {
-		// If we can't use software skinning, we have to flush and dirty.
-		if (!g_Config.bSoftwareSkinning) {
-			while ((src[i] >> 24) == GE_CMD_BONEMATRIXDATA) {
-				const u32 newVal = src[i] << 8;
-				if (dst[i] != newVal) {
-					Flush();
-					dst[i] = newVal;
-				}
-				if (++i >= end) {
-					break;
-				}
-			}
-
+		bool changed;
+		i = ScanMatrixData(dst, src, end, GE_CMD_BONEMATRIXDATA, &changed);
+		if (changed) {
+			u32 uniformsToDirty = 0;
 			const unsigned int numPlusCount = (op & 0x7F) + i;
 			for (unsigned int num = op & 0x7F; num < numPlusCount; num += 12) {
-				gstate_c.Dirty(DIRTY_BONEMATRIX0 << (num / 12));
-			}
-		} else {
-			while ((src[i] >> 24) == GE_CMD_BONEMATRIXDATA) {
-				dst[i] = src[i] << 8;
-				if (++i >= end) {
-					break;
-				}
+				uniformsToDirty |= DIRTY_BONEMATRIX0 << (num / 12);
 			}
 
-			const unsigned int numPlusCount = (op & 0x7F) + i;
-			for (unsigned int num = op & 0x7F; num < numPlusCount; num += 12) {
-				gstate_c.deferredVertTypeDirty |= DIRTY_BONEMATRIX0 << (num / 12);
+			// If we can't use software skinning, we have to flush and dirty.
+			if (!g_Config.bSoftwareSkinning) {
+				Flush();
+				gstate_c.Dirty(uniformsToDirty);
+			} else {
+				gstate_c.deferredVertTypeDirty |= uniformsToDirty;
 			}
+			LoadMatrixData(dst, src, i);
 		}
 	}
 
@@ -2325,6 +2682,14 @@ void GPUCommon::Execute_Unknown(u32 op, u32 diff) {
 
 void GPUCommon::FastLoadBoneMatrix(u32 target) {
 	const int num = gstate.boneMatrixNumber & 0x7F;
+	// Games often re-send the same bones every draw, in which case there's nothing to flush.
+	bool changed;
+	const u32_le *src = (const u32_le *)Memory::GetPointerUnchecked(target);
+	if (num + 12 <= 96 && ScanMatrixData((const u32 *)(gstate.boneMatrix + num), src, 12, GE_CMD_BONEMATRIXDATA, &changed) == 12 && !changed) {
+		gstate.boneMatrixNumber = (GE_CMD_BONEMATRIXNUMBER << 24) | ((num + 12) & 0x7F);
+		return;
+	}
+
 	const int mtxNum = num / 12;
 	uint32_t uniformsToDirty = DIRTY_BONEMATRIX0 << mtxNum;
 	if ((num - 12 * mtxNum) != 0) {
@@ -2383,10 +2748,14 @@ struct DisplayList_v2 {
 };
 
 void GPUCommon::DoState(PointerWrap &p) {
+	SyncThread();
 	auto s = p.Section("GPUCommon", 1, 4);
 	if (!s)
 		return;
 
+	if (p.mode == PointerWrap::MODE_READ)
+		ClearDisplayListCache();
+
 	p.Do<int>(dlQueue);
 	if (s >= 4) {
 		p.DoArray(dls, ARRAY_SIZE(dls));
@@ -2458,9 +2827,11 @@ void GPUCommon::DoState(PointerWrap &p) {
 }
 
 void GPUCommon::InterruptStart(int listid) {
+	SyncThread();
 	interruptRunning = true;
 }
 void GPUCommon::InterruptEnd(int listid) {
+	SyncThread();
 	interruptRunning = false;
 	isbreak = false;
 
@@ -2489,6 +2860,7 @@ void GPUCommon::InterruptEnd(int listid) {
 
 // TODO: Maybe cleaner to keep this in GE and trigger the clear directly?
 void GPUCommon::SyncEnd(GPUSyncType waitType, int listid, bool wokeThreads) {
+	SyncThread();
 	if (waitType == GPU_SYNC_DRAW && wokeThreads)
 	{
 		for (int i = 0; i < DisplayListMaxCount; ++i) {
@@ -2682,17 +3054,19 @@ void GPUCommon::DoBlockTransfer(u32 skipDrawReason) {
 
 		// Fixes Gran Turismo's funky text issue, since it overwrites the current texture.
 		textureCache_->Invalidate(dstBasePtr + (dstY * dstStride + dstX) * bpp, height * dstStride * bpp, GPU_INVALIDATE_HINT);
+		InvalidateDisplayListCache(dstBasePtr + (dstY * dstStride + dstX) * bpp, height * dstStride * bpp);
 		framebufferManager_->NotifyBlockTransferAfter(dstBasePtr, dstStride, dstX, dstY, srcBasePtr, srcStride, srcX, srcY, width, height, bpp, skipDrawReason);
 	}
 
-	CBreakPoints::ExecMemCheck(srcBasePtr + (srcY * srcStride + srcX) * bpp, false, height * srcStride * bpp, currentMIPS->pc);
-	CBreakPoints::ExecMemCheck(dstBasePtr + (dstY * dstStride + dstX) * bpp, true, height * dstStride * bpp, currentMIPS->pc);
+	CBreakPoints::ExecMemCheck(srcBasePtr + (srcY * srcStride + srcX) * bpp, false, height * srcStride * bpp, kickPC_);
+	CBreakPoints::ExecMemCheck(dstBasePtr + (dstY * dstStride + dstX) * bpp, true, height * dstStride * bpp, kickPC_);
 
 	// TODO: Correct timing appears to be 1.9, but erring a bit low since some of our other timing is inaccurate.
 	cyclesExecuted += ((height * width * bpp) * 16) / 10;
 }
 
 bool GPUCommon::PerformMemoryCopy(u32 dest, u32 src, int size) {
+	SyncThread();
 	// Track stray copies of a framebuffer in RAM. MotoGP does this.
 	if (framebufferManager_->MayIntersectFramebuffer(src) || framebufferManager_->MayIntersectFramebuffer(dest)) {
 		if (!framebufferManager_->NotifyFramebufferCopy(src, dest, size, false, gstate_c.skipDrawReason)) {
@@ -2712,6 +3086,7 @@ bool GPUCommon::PerformMemoryCopy(u32 dest, u32 src, int size) {
 }
 
 bool GPUCommon::PerformMemorySet(u32 dest, u8 v, int size) {
+	SyncThread();
 	// This may indicate a memset, usually to 0, of a framebuffer.
 	if (framebufferManager_->MayIntersectFramebuffer(dest)) {
 		Memory::Memset(dest, v, size);
@@ -2728,6 +3103,7 @@ bool GPUCommon::PerformMemorySet(u32 dest, u8 v, int size) {
 }
 
 bool GPUCommon::PerformMemoryDownload(u32 dest, int size) {
+	SyncThread();
 	// Cheat a bit to force a download of the framebuffer.
 	// VRAM + 0x00400000 is simply a VRAM mirror.
 	if (Memory::IsVRAMAddress(dest)) {
@@ -2737,6 +3113,7 @@ bool GPUCommon::PerformMemoryDownload(u32 dest, int size) {
 }
 
 bool GPUCommon::PerformMemoryUpload(u32 dest, int size) {
+	SyncThread();
 	// Cheat a bit to force an upload of the framebuffer.
 	// VRAM + 0x00400000 is simply a VRAM mirror.
 	if (Memory::IsVRAMAddress(dest)) {
@@ -2747,11 +3124,19 @@ bool GPUCommon::PerformMemoryUpload(u32 dest, int size) {
 }
 
 void GPUCommon::InvalidateCache(u32 addr, int size, GPUInvalidationType type) {
+	SyncThread();
 	if (size > 0)
 		textureCache_->Invalidate(addr, size, type);
 	else
 		textureCache_->InvalidateAll(type);
 
+	if (size <= 0 || type == GPU_INVALIDATE_ALL) {
+		dlCacheEpoch_++;
+		dlCacheRun_++;
+	} else {
+		InvalidateDisplayListCache(addr, size);
+	}
+
 	if (type != GPU_INVALIDATE_ALL && framebufferManager_->MayIntersectFramebuffer(addr)) {
 		// Vempire invalidates (with writeback) after drawing, but before blitting.
 		if (type == GPU_INVALIDATE_SAFE) {
@@ -2761,6 +3146,7 @@ void GPUCommon::InvalidateCache(u32 addr, int size, GPUInvalidationType type) {
 }
 
 void GPUCommon::NotifyVideoUpload(u32 addr, int size, int width, int format) {
+	SyncThread();
 	if (Memory::IsVRAMAddress(addr)) {
 		framebufferManager_->NotifyVideoUpload(addr, size, width, (GEBufferFormat)format);
 	}
@@ -2769,6 +3155,7 @@ void GPUCommon::NotifyVideoUpload(u32 addr, int size, int width, int format) {
 }
 
 bool GPUCommon::PerformStencilUpload(u32 dest, int size) {
+	SyncThread();
 	if (framebufferManager_->MayIntersectFramebuffer(dest)) {
 		framebufferManager_->NotifyStencilUpload(dest, size);
 		return true;
@@ -2834,6 +3221,7 @@ bool GPUCommon::DescribeCodePtr(const u8 *ptr, std::string &name) {
 }
 
 bool GPUCommon::FramebufferDirty() {
+	SyncThread();
 	VirtualFramebuffer *vfb = framebufferManager_->GetDisplayVFB();
 	if (vfb) {
 		bool dirty = vfb->dirtyAfterDisplay;
@@ -2844,6 +3232,7 @@ bool GPUCommon::FramebufferDirty() {
 }
 
 bool GPUCommon::FramebufferReallyDirty() {
+	SyncThread();
 	VirtualFramebuffer *vfb = framebufferManager_->GetDisplayVFB();
 	if (vfb) {
 		bool dirty = vfb->reallyDirtyAfterDisplay;
@@ -1,5 +1,12 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include "Common/Common.h"
 #include "Common/MemoryUtil.h"
 #include "GPU/GPUInterface.h"
@@ -84,6 +91,9 @@ class GPUCommon : public GPUInterface, public GPUDebugInterface {
 	void BeginHostFrame() override;
 	void EndHostFrame() override;
 
+	void SyncThread() override;
+	void FlushThreadEvents() override;
+
 	void InterruptStart(int listid) override;
 	void InterruptEnd(int listid) override;
 	void SyncEnd(GPUSyncType waitType, int listid, bool wokeThreads) override;
@@ -278,8 +288,43 @@ class GPUCommon : public GPUInterface, public GPUDebugInterface {
 	void BeginFrame() override;
 	void UpdateVsyncInterval(bool force);
 
+	void RunDLQueue();
+	void GeThreadFunc();
+	void StopGeThread();
+	// These go through to sceGe directly, or are handed to the emu thread when on the GE thread.
+	bool TriggerInterrupt(int listid, u32 pc, u64 atTicks);
+	void TriggerSync(GPUSyncType type, int id, u64 atTicks);
+
 	virtual void FastRunLoop(DisplayList &list);
 
+	// A straight-line stretch of a display list, pre-decoded so FastRunLoop can replay it without
+	// looking at each command's flags.  Runs of plain state writes are collapsed to one write per
+	// register, and anything that executes is kept as is.
+	struct DLCacheStep {
+		u32 op;
+		// For state writes, how many list words to skip after applying this (only set on the last write of a run.)
+		u16 words;
+		u8 exec;
+		u8 flush;
+		u64 dirty;
+	};
+	struct DLCacheSegment {
+		// Hash of the list words this was decoded from, checked against RAM once per list run.
+		u64 hash = 0;
+		u32 numWords = 0;
+		u32 checkedRun = 0;
+		std::vector<DLCacheStep> steps;
+		int lastFrame = 0;
+		int mismatches = 0;
+		int retryFrame = 0;
+	};
+	const DLCacheSegment *LookupDisplayListSegment(u32 pc, int dc);
+	void DecodeDisplayListSegment(u32 pc, int maxWords, DLCacheSegment &seg);
+	void ReplayDisplayListSegment(const DLCacheSegment &seg, DisplayList &list, int &dc);
+	void ClearDisplayListCache();
+	// Drops the segments whose list words overlap a range the GPU itself wrote, like a block transfer.
+	void InvalidateDisplayListCache(u32 addr, int size);
+
 	void SlowRunLoop(DisplayList &list);
 	void UpdatePC(u32 currentPC, u32 newPC);
 	void UpdateState(GPURunState state);
@@ -318,6 +363,23 @@ class GPUCommon : public GPUInterface, public GPUDebugInterface {
 
 	static CommandInfo cmdInfo_[256];
 
+	// The bits of each register that the vertex and fragment shader IDs are computed from.
+	struct ShaderIDDeps {
+		u32 vs;
+		u32 fs;
+	};
+
+	static ShaderIDDeps shaderIDDeps_[256];
+
+	// Drops the shader dirty flags of a state write that can't change the shader IDs.
+	static uint64_t ShaderDirtyForWrite(u8 cmd, u32 diff, uint64_t dirty) {
+		if ((diff & shaderIDDeps_[cmd].vs) == 0)
+			dirty &= ~(uint64_t)DIRTY_VERTEXSHADER_STATE;
+		if ((diff & shaderIDDeps_[cmd].fs) == 0)
+			dirty &= ~(uint64_t)DIRTY_FRAGMENTSHADER_STATE;
+		return dirty;
+	}
+
 	typedef std::list<int> DisplayListQueue;
 
 	int nextListID;
@@ -358,6 +420,42 @@ class GPUCommon : public GPUInterface, public GPUDebugInterface {
 	std::string reportingPrimaryInfo_;
 	std::string reportingFullInfo_;
 
+	// Keyed by the list address the segment starts at.
+	std::map<u32, DLCacheSegment> dlCache_;
+	// Bumped whenever list memory may have changed, so a replay in progress knows to stop.
+	u32 dlCacheEpoch_ = 0;
+	// Bumped for each InterpretList() and when all of memory may have changed.  Within a run only
+	// the GPU writes list memory, and it drops what it overwrites, so segments are hashed once per run.
+	u32 dlCacheRun_ = 0;
+	int dlCacheFrame_ = 0;
+	// Where segments last started, a new address only gets an entry the second time it's seen.
+	u32 dlCacheSeen_[1024]{};
+	bool useDisplayListCache_ = true;
+
+	// When enabled, ProcessDLQueue() hands lists to this thread and returns.  Everything that
+	// touches GPU state from outside must call SyncThread() first.
+	std::thread geThread_;
+	std::mutex geThreadLock_;
+	std::condition_variable geThreadCond_;
+	bool geThreadWork_ = false;
+	bool geThreadExit_ = false;
+	// Set from kicking the thread until SyncThread() has collected the results.
+	std::atomic<bool> geThreadPending_{ false };
+	struct GeThreadEvent {
+		bool interrupt;
+		GPUSyncType type;
+		int listid;
+		u32 pc;
+		u64 atTicks;
+	};
+	void QueueThreadEvent(const GeThreadEvent &ev);
+	// Filled by the GE thread as it runs, and emptied on the emu thread by FlushThreadEvents().
+	std::mutex geThreadEventLock_;
+	std::vector<GeThreadEvent> geThreadEvents_;
+	// Debugger stepping time from lists run on the GE thread, also guarded by geThreadEventLock_.
+	double geThreadSteppingTime_ = 0.0;
+	u32 kickPC_ = 0;
+
 private:
 	void FlushImm();
 	// Debug stats.
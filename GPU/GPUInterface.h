@@ -193,6 +193,11 @@ class GPUInterface {
 	virtual void InterruptEnd(int listid) = 0;
 	virtual void SyncEnd(GPUSyncType waitType, int listid, bool wokeThreads) = 0;
 
+	// Waits for display lists running on the GE thread, if any, to finish.
+	virtual void SyncThread() = 0;
+	// Passes interrupts and syncs the GE thread has raised so far on to sceGe, without waiting for it.
+	virtual void FlushThreadEvents() = 0;
+
 	virtual void PreExecuteOp(u32 op, u32 diff) = 0;
 	virtual void ExecuteOp(u32 op, u32 diff) = 0;
 	virtual bool InterpretList(DisplayList& list) = 0;
@@ -200,6 +200,58 @@ void GPUgstate::FastLoadBoneMatrix(u32 addr) {
 	gstate.boneMatrixNumber = (GE_CMD_BONEMATRIXNUMBER << 24) | (num & 0x7F);
 }
 
+int ScanMatrixData(const u32 *dst, const u32_le *src, int max, u8 cmd, bool *changed) {
+	int i = 0;
+	bool differs = false;
+#ifdef _M_SSE
+	const __m128i cmdv = _mm_set1_epi32(cmd);
+	__m128i diff = _mm_setzero_si128();
+	for (; i + 4 <= max; i += 4) {
+		const __m128i ops = _mm_loadu_si128((const __m128i *)(src + i));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_srli_epi32(ops, 24), cmdv)) != 0xFFFF)
+			break;
+		const __m128i prev = _mm_loadu_si128((const __m128i *)(dst + i));
+		diff = _mm_or_si128(diff, _mm_xor_si128(_mm_slli_epi32(ops, 8), prev));
+	}
+	differs = _mm_movemask_epi8(_mm_cmpeq_epi32(diff, _mm_setzero_si128())) != 0xFFFF;
+#elif PPSSPP_ARCH(ARM_NEON)
+	const uint32x4_t cmdv = vdupq_n_u32(cmd);
+	uint32x4_t diff = vdupq_n_u32(0);
+	for (; i + 4 <= max; i += 4) {
+		const uint32x4_t ops = vld1q_u32(src + i);
+		const uint32x4_t match = vceqq_u32(vshrq_n_u32(ops, 24), cmdv);
+		const uint32x2_t match2 = vand_u32(vget_low_u32(match), vget_high_u32(match));
+		if ((vget_lane_u32(match2, 0) & vget_lane_u32(match2, 1)) == 0)
+			break;
+		diff = vorrq_u32(diff, veorq_u32(vshlq_n_u32(ops, 8), vld1q_u32(dst + i)));
+	}
+	const uint32x2_t diff2 = vorr_u32(vget_low_u32(diff), vget_high_u32(diff));
+	differs = (vget_lane_u32(diff2, 0) | vget_lane_u32(diff2, 1)) != 0;
+#endif
+	for (; i < max && (src[i] >> 24) == cmd; ++i) {
+		differs = differs || dst[i] != (src[i] << 8);
+	}
+
+	*changed = differs;
+	return i;
+}
+
+void LoadMatrixData(u32 *dst, const u32_le *src, int count) {
+	int i = 0;
+#ifdef _M_SSE
+	for (; i + 4 <= count; i += 4) {
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_slli_epi32(_mm_loadu_si128((const __m128i *)(src + i)), 8));
+	}
+#elif PPSSPP_ARCH(ARM_NEON)
+	for (; i + 4 <= count; i += 4) {
+		vst1q_u32(dst + i, vshlq_n_u32(vld1q_u32(src + i), 8));
+	}
+#endif
+	for (; i < count; ++i) {
+		dst[i] = src[i] << 8;
+	}
+}
+
 void GPUgstate::Restore(u32_le *ptr) {
 	// Not sure what the first 10 values are, exactly, but these seem right.
 	gstate_c.vertexAddr = ptr[5];
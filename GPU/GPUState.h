@@ -447,6 +447,11 @@ struct GPUgstate {
 
 bool vertTypeIsSkinningEnabled(u32 vertType);
 
+// Matrix data commands are 24-bit floats in the low bits, stored shifted up.
+// Counts the run of cmd commands at src (up to max), and whether loading them would change dst.
+int ScanMatrixData(const u32 *dst, const u32_le *src, int max, u8 cmd, bool *changed);
+void LoadMatrixData(u32 *dst, const u32_le *src, int count);
+
 inline int vertTypeGetNumBoneWeights(u32 vertType) { return 1 + ((vertType & GE_VTYPE_WEIGHTCOUNT_MASK) >> GE_VTYPE_WEIGHTCOUNT_SHIFT); }
 inline int vertTypeGetWeightMask(u32 vertType) { return vertType & GE_VTYPE_WEIGHT_MASK; }
 
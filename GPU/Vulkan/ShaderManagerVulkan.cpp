@@ -190,6 +190,8 @@ void ShaderManagerVulkan::Clear() {
 	});
 	fsCache_.Clear();
 	vsCache_.Clear();
+	fsLookaside_.Clear();
+	vsLookaside_.Clear();
 	lastFSID_.set_invalid();
 	lastVSID_.set_invalid();
 	gstate_c.Dirty(DIRTY_VERTEXSHADER_STATE | DIRTY_FRAGMENTSHADER_STATE);
@@ -259,22 +261,30 @@ void ShaderManagerVulkan::GetShaders(int prim, u32 vertType, VulkanVertexShader
 		return;
 	}
 
-	VulkanVertexShader *vs = vsCache_.Get(VSID);
-	if (!vs)	{
-		// Vertex shader not in cache. Let's compile it.
-		GenerateVulkanGLSLVertexShader(VSID, codeBuffer_);
-		vs = new VulkanVertexShader(vulkan_, VSID, codeBuffer_, useHWTransform);
-		vsCache_.Insert(VSID, vs);
+	VulkanVertexShader *vs = vsLookaside_.Get(VSID);
+	if (!vs) {
+		vs = vsCache_.Get(VSID);
+		if (!vs) {
+			// Vertex shader not in cache. Let's compile it.
+			GenerateVulkanGLSLVertexShader(VSID, codeBuffer_);
+			vs = new VulkanVertexShader(vulkan_, VSID, codeBuffer_, useHWTransform);
+			vsCache_.Insert(VSID, vs);
+		}
+		vsLookaside_.Add(VSID, vs);
 	}
 	lastVSID_ = VSID;
 
-	VulkanFragmentShader *fs = fsCache_.Get(FSID);
+	VulkanFragmentShader *fs = fsLookaside_.Get(FSID);
 	if (!fs) {
-		uint32_t vendorID = vulkan_->GetPhysicalDeviceProperties().properties.vendorID;
-		// Fragment shader not in cache. Let's compile it.
-		GenerateVulkanGLSLFragmentShader(FSID, codeBuffer_, vendorID);
-		fs = new VulkanFragmentShader(vulkan_, FSID, codeBuffer_);
-		fsCache_.Insert(FSID, fs);
+		fs = fsCache_.Get(FSID);
+		if (!fs) {
+			uint32_t vendorID = vulkan_->GetPhysicalDeviceProperties().properties.vendorID;
+			// Fragment shader not in cache. Let's compile it.
+			GenerateVulkanGLSLFragmentShader(FSID, codeBuffer_, vendorID);
+			fs = new VulkanFragmentShader(vulkan_, FSID, codeBuffer_);
+			fsCache_.Insert(FSID, fs);
+		}
+		fsLookaside_.Add(FSID, fs);
 	}
 
 	lastFSID_ = FSID;
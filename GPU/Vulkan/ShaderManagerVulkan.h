@@ -138,6 +138,9 @@ class ShaderManagerVulkan : public ShaderManagerCommon {
 	typedef DenseHashMap<VShaderID, VulkanVertexShader *, nullptr> VSCache;
 	VSCache vsCache_;
 
+	ShaderLookaside<FShaderID, VulkanFragmentShader> fsLookaside_;
+	ShaderLookaside<VShaderID, VulkanVertexShader> vsLookaside_;
+
 	char *codeBuffer_;
 
 	uint64_t uboAlignment_;
@@ -718,6 +718,7 @@ void TextureCacheVulkan::StartFrame() {
 
 	timesInvalidatedAllThisFrame_ = 0;
 	texelsScaledThisFrame_ = 0;
+	scaler.StartFrame();
 
 	if (clearCacheNextFrame_) {
 		Clear(true);
@@ -1040,7 +1041,7 @@ void TextureCacheVulkan::BuildTexture(TexCacheEntry *const entry) {
 	}
 
 	if (scaleFactor != 1) {
-		if (texelsScaledThisFrame_ >= TEXCACHE_MAX_TEXELS_SCALED && !g_Config.bTexHardwareScaling) {
+		if ((texelsScaledThisFrame_ >= TEXCACHE_MAX_TEXELS_SCALED || !AsyncScaleReady(*entry)) && !g_Config.bTexHardwareScaling) {
 			entry->status |= TexCacheEntry::STATUS_TO_SCALE;
 			scaleFactor = 1;
 		} else {
@@ -1349,11 +1350,13 @@ void TextureCacheVulkan::LoadTextureLevel(TexCacheEntry &entry, uint8_t *writePt
 			entry.SetAlphaStatus(TexCacheEntry::STATUS_ALPHA_UNKNOWN);
 		}
 
-		if (scaleFactor > 1) {
+		if (scaleFactor == 1) {
+			QueueAsyncScale(entry, level, pixelData, decPitch, (u32)dstFmt, w, h);
+		} else {
 			u32 fmt = dstFmt;
 			// CPU scaling reads from the destination buffer so we want cached RAM.
 			uint8_t *rearrange = (uint8_t *)AllocateAlignedMemory(w * scaleFactor * h * scaleFactor * 4, 16);
-			scaler.ScaleAlways((u32 *)rearrange, pixelData, fmt, w, h, scaleFactor);
+			ScaleTexture(entry, level, (u32 *)rearrange, pixelData, fmt, w, h, scaleFactor);
 			pixelData = (u32 *)writePtr;
 			dstFmt = (VkFormat)fmt;
 
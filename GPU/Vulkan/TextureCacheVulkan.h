@@ -121,6 +121,7 @@ class TextureCacheVulkan : public TextureCacheCommon {
 	void UpdateCurrentClut(GEPaletteFormat clutFormat, u32 clutBase, bool clutIndexIsSimple) override;
 
 	void ApplyTextureFramebuffer(TexCacheEntry *entry, VirtualFramebuffer *framebuffer) override;
+	TextureScalerCommon &Scaler() override { return scaler; }
 	void BuildTexture(TexCacheEntry *const entry) override;
 
 	VulkanContext *vulkan_ = nullptr;
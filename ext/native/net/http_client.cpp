@@ -74,6 +74,18 @@ bool Connection::Resolve(const char *host, int port, DNSType type) {
 }
 
 bool Connection::Connect(int maxTries, double timeout, bool *cancelConnect) {
+	return ConnectWithCancel(maxTries, timeout, [cancelConnect] {
+		return cancelConnect && *cancelConnect;
+	});
+}
+
+bool Connection::Connect(int maxTries, double timeout, std::atomic<bool> *cancelConnect) {
+	return ConnectWithCancel(maxTries, timeout, [cancelConnect] {
+		return cancelConnect->load();
+	});
+}
+
+bool Connection::ConnectWithCancel(int maxTries, double timeout, const std::function<bool()> &cancelled) {
 	if (port_ <= 0) {
 		ELOG("Bad port");
 		return false;
@@ -120,7 +132,7 @@ bool Connection::Connect(int maxTries, double timeout, bool *cancelConnect) {
 			--timeoutHalfSeconds;
 
 			selectResult = select(maxfd, nullptr, &fds, nullptr, &tv);
-			if (cancelConnect && *cancelConnect) {
+			if (cancelled()) {
 				break;
 			}
 		}
@@ -139,7 +151,7 @@ bool Connection::Connect(int maxTries, double timeout, bool *cancelConnect) {
 			return true;
 		}
 
-		if (cancelConnect && *cancelConnect) {
+		if (cancelled()) {
 			break;
 		}
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <thread>
@@ -32,6 +33,8 @@ class Connection {
 	bool Resolve(const char *host, int port, DNSType type = DNSType::ANY);
 
 	bool Connect(int maxTries = 2, double timeout = 20.0f, bool *cancelConnect = nullptr);
+	// For when another thread does the cancelling.
+	bool Connect(int maxTries, double timeout, std::atomic<bool> *cancelConnect);
 	void Disconnect();
 
 	// Only to be used for bring-up and debugging.
@@ -46,6 +49,8 @@ class Connection {
 	addrinfo *resolved_;
 
 private:
+	bool ConnectWithCancel(int maxTries, double timeout, const std::function<bool()> &cancelled);
+
 	uintptr_t sock_;
 
 };
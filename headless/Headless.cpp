@@ -2,12 +2,17 @@
 // See headless.txt.
 // To build on non-windows systems, just run CMake in the SDL directory, it will build both a normal ppsspp and the headless version.
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <limits>
+#include <map>
+#include <memory>
 
 #include "file/zip_read.h"
+#include "json/json_writer.h"
 #include "profiler/profiler.h"
+#include "Common/CPUDetect.h"
 #include "Common/FileUtil.h"
 #include "Common/GraphicsContext.h"
 #include "Core/Config.h"
@@ -17,8 +22,12 @@
 #include "Core/System.h"
 #include "Core/HLE/sceUtility.h"
 #include "Core/Host.h"
+#include "Core/Loaders.h"
 #include "Core/SaveState.h"
+#include "Core/TextureReplacer.h"
+#include "Core/FileSystems/BlockDevices.h"
 #include "GPU/Common/FramebufferCommon.h"
+#include "GPU/Debugger/Playback.h"
 #include "Log.h"
 #include "LogManager.h"
 #include "base/NativeApp.h"
@@ -111,6 +120,14 @@ int printUsage(const char *progname, const char *reason)
 	fprintf(stderr, "  --ir                  use ir interpreter\n");
 	fprintf(stderr, "  -j                    use jit (default)\n");
 	fprintf(stderr, "  -c, --compare         compare with output in file.expected\n");
+	fprintf(stderr, "  --build-texture-pack=DIR  decode a texture replacement directory into textures.pack\n");
+	fprintf(stderr, "  --bench=N             replay a GE dump (.ppdmp) N times and report timings as JSON\n");
+	fprintf(stderr, "  --bench-json=FILE     write the benchmark report to FILE instead of stdout\n");
+	fprintf(stderr, "  --bench-frame=N       start the benchmark at frame N of a multi-frame dump\n");
+	fprintf(stderr, "  --no-dlcache          run display lists without the pre-decoded segment cache\n");
+	fprintf(stderr, "  --compress-iso=FILE   convert an ISO or CSO to a ZCSO image in FILE\n");
+	fprintf(stderr, "  --compress-codec=C    codec for --compress-iso: snappy (default) or deflate\n");
+	fprintf(stderr, "  --compress-dict       use a shared deflate dictionary for --compress-iso\n");
 	fprintf(stderr, "\nSee headless.txt for details.\n");
 
 	return 1;
@@ -208,6 +225,115 @@ bool RunAutoTest(HeadlessHost *headlessHost, CoreParameter &coreParameter, bool
 	return passed;
 }
 
+static void WriteReplayStats(json::JsonWriter &json, const GPURecord::ReplayFrameStats &frame) {
+	json.writeInt("frame", frame.frame);
+	json.writeFloat("ms", frame.seconds * 1000.0);
+	json.writeFloat("syncMs", frame.syncSeconds * 1000.0);
+	json.writeFloat("displayListMs", frame.gpu.msProcessingDisplayLists * 1000.0);
+	json.writeFloat("textureDecodeMs", frame.gpu.msDecodingTextures * 1000.0);
+	json.writeFloat("vertexDecodeMs", frame.gpu.msDecodingVertices * 1000.0);
+	json.writeInt("drawCalls", frame.gpu.numDrawCalls);
+	json.writeInt("cachedDrawCalls", frame.gpu.numCachedDrawCalls);
+	json.writeInt("flushes", frame.gpu.numFlushes);
+	json.writeInt("vertsSubmitted", frame.gpu.numVertsSubmitted);
+	json.writeInt("texturesDecoded", frame.gpu.numTexturesDecoded);
+	json.writeInt("textureSwitches", frame.gpu.numTextureSwitches);
+	json.writeInt("shaderSwitches", frame.gpu.numShaderSwitches);
+	json.writeInt("readbacks", frame.gpu.numReadbacks);
+	json.writeInt("uploads", frame.gpu.numUploads);
+
+	// The texture and framebuffer levels are combined.
+	std::map<std::string, std::pair<int, double>> commands;
+	for (int i = 0; i < 256; ++i) {
+		const char *name = GPURecord::CommandTypeName((GPURecord::CommandType)i);
+		if (name && frame.commandCounts[i] != 0) {
+			commands[name].first += frame.commandCounts[i];
+			commands[name].second += frame.commandSeconds[i];
+		}
+	}
+	json.pushDict("commands");
+	for (const auto &command : commands) {
+		json.pushDict(command.first);
+		json.writeInt("count", command.second.first);
+		json.writeFloat("ms", command.second.second * 1000.0);
+		json.pop();
+	}
+	json.pop();
+}
+
+static bool WriteReplayBenchmark(const char *filename, const std::string &dump, const std::string &backend, const std::vector<GPURecord::ReplayFrameStats> &frames) {
+	json::JsonWriter json(json::JsonWriter::PRETTY);
+	json.begin();
+	json.writeString("dump", dump);
+	json.writeString("backend", backend);
+	json.writeInt("replays", (int)frames.size());
+
+	// The first replay compiles shaders and decodes textures, so it's reported separately.
+	if (!frames.empty()) {
+		std::vector<double> times;
+		for (size_t i = frames.size() > 1 ? 1 : 0; i < frames.size(); ++i) {
+			times.push_back(frames[i].seconds * 1000.0);
+		}
+		std::sort(times.begin(), times.end());
+		double sum = 0.0;
+		for (double t : times) {
+			sum += t;
+		}
+
+		json.pushDict("summary");
+		json.writeFloat("firstMs", frames[0].seconds * 1000.0);
+		json.writeFloat("minMs", times.front());
+		json.writeFloat("medianMs", times[times.size() / 2]);
+		json.writeFloat("meanMs", sum / times.size());
+		json.writeFloat("maxMs", times.back());
+		json.pop();
+	}
+
+	json.pushArray("frames");
+	for (const auto &frame : frames) {
+		json.pushDict();
+		WriteReplayStats(json, frame);
+		json.pop();
+	}
+	json.pop();
+	json.end();
+
+	if (!filename) {
+		printf("%s", json.str().c_str());
+		return true;
+	}
+	FILE *f = File::OpenCFile(filename, "wb");
+	if (!f) {
+		fprintf(stderr, "Unable to write %s\n", filename);
+		return false;
+	}
+	std::string result = json.str();
+	bool success = fwrite(result.data(), 1, result.size(), f) == result.size();
+	fclose(f);
+	return success;
+}
+
+static bool CompressImage(const std::string &input, const std::string &output, ZCSOCodec codec, bool useDictionary) {
+	std::unique_ptr<FileLoader> fileLoader(ConstructFileLoader(input));
+	std::unique_ptr<BlockDevice> blockDevice(constructBlockDevice(fileLoader.get()));
+	if (!blockDevice) {
+		fprintf(stderr, "Unable to open %s\n", input.c_str());
+		return false;
+	}
+
+	// Headless doesn't load a config, and this is the only thing running.
+	g_Config.iNumWorkerThreads = cpu_info.num_cores;
+
+	std::string error;
+	double start = real_time_now();
+	if (!CompressBlockDevice(blockDevice.get(), output, codec, 0x4000, useDictionary, &error)) {
+		fprintf(stderr, "%s\n", error.c_str());
+		return false;
+	}
+	fprintf(stderr, "Compressed %s to %s in %.1f seconds.\n", input.c_str(), output.c_str(), real_time_now() - start);
+	return true;
+}
+
 int main(int argc, const char* argv[])
 {
 	PROFILE_INIT();
@@ -233,6 +359,15 @@ int main(int argc, const char* argv[])
 	const char *mountIso = 0;
 	const char *mountRoot = 0;
 	const char *screenshotFilename = 0;
+	const char *texturePackDir = 0;
+	const char *compressIsoFilename = 0;
+	ZCSOCodec compressCodec = ZCSOCodec::SNAPPY;
+	bool compressDict = false;
+	int benchReplays = 0;
+	int benchFrame = 0;
+	const char *benchJsonFilename = 0;
+	bool displayListCache = true;
+	std::string gpuName = "null";
 	float timeout = std::numeric_limits<float>::infinity();
 
 	for (int i = 1; i < argc; i++)
@@ -263,18 +398,18 @@ int main(int argc, const char* argv[])
 			verbose = true;
 		else if (!strncmp(argv[i], "--graphics=", strlen("--graphics=")) && strlen(argv[i]) > strlen("--graphics="))
 		{
-			const char *gpuName = argv[i] + strlen("--graphics=");
-			if (!strcasecmp(gpuName, "gles"))
+			gpuName = argv[i] + strlen("--graphics=");
+			if (!strcasecmp(gpuName.c_str(), "gles"))
 				gpuCore = GPUCORE_GLES;
-			else if (!strcasecmp(gpuName, "software"))
+			else if (!strcasecmp(gpuName.c_str(), "software"))
 				gpuCore = GPUCORE_SOFTWARE;
-			else if (!strcasecmp(gpuName, "directx9"))
+			else if (!strcasecmp(gpuName.c_str(), "directx9"))
 				gpuCore = GPUCORE_DIRECTX9;
-			else if (!strcasecmp(gpuName, "directx11"))
+			else if (!strcasecmp(gpuName.c_str(), "directx11"))
 				gpuCore = GPUCORE_DIRECTX11;
-			else if (!strcasecmp(gpuName, "vulkan"))
+			else if (!strcasecmp(gpuName.c_str(), "vulkan"))
 				gpuCore = GPUCORE_VULKAN;
-			else if (!strcasecmp(gpuName, "null"))
+			else if (!strcasecmp(gpuName.c_str(), "null"))
 				gpuCore = GPUCORE_NULL;
 			else
 				return printUsage(argv[0], "Unknown gpu backend specified after --graphics=. Allowed: software, directx9, directx11, vulkan, gles, null.");
@@ -283,8 +418,10 @@ int main(int argc, const char* argv[])
 		else if (!strcmp(argv[i], "--graphics")) {
 #if PPSSPP_API(ANY_GL)
 			gpuCore = GPUCORE_GLES;
+			gpuName = "gles";
 #else
 			gpuCore = GPUCORE_DIRECTX11;
+			gpuName = "directx11";
 #endif
 		} else if (!strncmp(argv[i], "--screenshot=", strlen("--screenshot=")) && strlen(argv[i]) > strlen("--screenshot="))
 			screenshotFilename = argv[i] + strlen("--screenshot=");
@@ -292,6 +429,30 @@ int main(int argc, const char* argv[])
 			timeout = strtod(argv[i] + strlen("--timeout="), NULL);
 		else if (!strcmp(argv[i], "--teamcity"))
 			teamCityMode = true;
+		else if (!strncmp(argv[i], "--build-texture-pack=", strlen("--build-texture-pack=")) && strlen(argv[i]) > strlen("--build-texture-pack="))
+			texturePackDir = argv[i] + strlen("--build-texture-pack=");
+		else if (!strncmp(argv[i], "--compress-iso=", strlen("--compress-iso=")) && strlen(argv[i]) > strlen("--compress-iso="))
+			compressIsoFilename = argv[i] + strlen("--compress-iso=");
+		else if (!strncmp(argv[i], "--compress-codec=", strlen("--compress-codec=")) && strlen(argv[i]) > strlen("--compress-codec="))
+		{
+			const char *codecName = argv[i] + strlen("--compress-codec=");
+			if (!strcasecmp(codecName, "snappy"))
+				compressCodec = ZCSOCodec::SNAPPY;
+			else if (!strcasecmp(codecName, "deflate"))
+				compressCodec = ZCSOCodec::DEFLATE;
+			else
+				return printUsage(argv[0], "Unknown codec specified after --compress-codec=. Allowed: snappy, deflate.");
+		}
+		else if (!strcmp(argv[i], "--compress-dict"))
+			compressDict = true;
+		else if (!strncmp(argv[i], "--bench=", strlen("--bench=")) && strlen(argv[i]) > strlen("--bench="))
+			benchReplays = atoi(argv[i] + strlen("--bench="));
+		else if (!strncmp(argv[i], "--bench-json=", strlen("--bench-json=")) && strlen(argv[i]) > strlen("--bench-json="))
+			benchJsonFilename = argv[i] + strlen("--bench-json=");
+		else if (!strncmp(argv[i], "--bench-frame=", strlen("--bench-frame=")) && strlen(argv[i]) > strlen("--bench-frame="))
+			benchFrame = atoi(argv[i] + strlen("--bench-frame="));
+		else if (!strcmp(argv[i], "--no-dlcache"))
+			displayListCache = false;
 		else if (!strncmp(argv[i], "--state=", strlen("--state=")) && strlen(argv[i]) > strlen("--state="))
 			stateToLoad = argv[i] + strlen("--state=");
 		else if (!strcmp(argv[i], "--help") || !strcmp(argv[i], "-h"))
@@ -300,6 +461,12 @@ int main(int argc, const char* argv[])
 			testFilenames.push_back(argv[i]);
 	}
 
+	if (texturePackDir) {
+		bool success = TextureReplacer::BuildPack(texturePackDir, true);
+		fprintf(stderr, "%s\n", success ? "Texture pack built." : "Failed to build texture pack.");
+		return success ? 0 : 1;
+	}
+
 	// TODO: Allow a filename here?
 	if (testFilenames.size() == 1 && testFilenames[0] == "@-")
 	{
@@ -313,11 +480,25 @@ int main(int argc, const char* argv[])
 
 	if (testFilenames.empty())
 		return printUsage(argv[0], argc <= 1 ? NULL : "No executables specified");
+	if (benchReplays > 0 && (testFilenames.size() != 1 || autoCompare))
+		return printUsage(argv[0], "--bench takes a single GE dump");
+	if (compressIsoFilename && testFilenames.size() != 1)
+		return printUsage(argv[0], "--compress-iso takes a single ISO or CSO");
+	if (compressDict && compressCodec != ZCSOCodec::DEFLATE)
+		return printUsage(argv[0], "--compress-dict requires --compress-codec=deflate");
 
 	HeadlessHost *headlessHost = getHost(gpuCore);
 	headlessHost->SetGraphicsCore(gpuCore);
 	host = headlessHost;
 
+	// Read errors are reported through the host, so this has to wait until there is one.
+	if (compressIsoFilename) {
+		bool success = CompressImage(testFilenames[0], compressIsoFilename, compressCodec, compressDict);
+		delete host;
+		host = nullptr;
+		return success ? 0 : 1;
+	}
+
 	std::string error_string;
 	GraphicsContext *graphicsContext = nullptr;
 	bool glWorking = host->InitGraphics(&error_string, &graphicsContext);
@@ -382,6 +563,9 @@ int main(int argc, const char* argv[])
 	g_Config.iAudioLatency = 1;
 	g_Config.bEnableWlan = true;
 	g_Config.sMACAddress = "12:34:56:78:9A:BC";
+	// Headless never draws the stats, this just collects them.
+	g_Config.bShowDebugStats = benchReplays > 0;
+	g_Config.bDisplayListCache = displayListCache;
 
 #ifdef _WIN32
 	g_Config.internalDataDirectory = "";
@@ -420,6 +604,21 @@ int main(int argc, const char* argv[])
 
 	std::vector<std::string> failedTests;
 	std::vector<std::string> passedTests;
+	bool benchFailed = false;
+	if (benchReplays > 0) {
+		coreParameter.fileToStart = testFilenames[0];
+		GPURecord::StartReplayBenchmark(benchReplays);
+		GPURecord::SeekReplay(benchFrame);
+		RunAutoTest(headlessHost, coreParameter, false, verbose, timeout);
+		std::vector<GPURecord::ReplayFrameStats> frames = GPURecord::FinishReplayBenchmark();
+		if (frames.empty()) {
+			fprintf(stderr, "Unable to replay %s\n", testFilenames[0].c_str());
+			benchFailed = true;
+		} else if (!WriteReplayBenchmark(benchJsonFilename, testFilenames[0], glWorking ? gpuName : "null", frames)) {
+			benchFailed = true;
+		}
+		testFilenames.clear();
+	}
 	for (size_t i = 0; i < testFilenames.size(); ++i)
 	{
 		coreParameter.fileToStart = testFilenames[i];
@@ -464,5 +663,5 @@ int main(int argc, const char* argv[])
 	moncleanup();
 #endif
 
-	return 0;
+	return benchFailed ? 1 : 0;
 }
@@ -0,0 +1,250 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "base/timeutil.h"
+#include "Core/MemMap.h"
+#include "GPU/GPUState.h"
+#include "GPU/ge_constants.h"
+#include "GPU/Null/NullGpu.h"
+
+static const u32 LIST_ADDR = 0x08800000;
+static const u32 ONE_OFF_ADDR = 0x08900000;
+static const int BENCH_ITERATIONS = 2000;
+
+// NullGPU runs commands one by one, this puts back the cached loop from GPUCommon.
+class DLCacheTestGPU : public NullGPU {
+public:
+	void SetCacheEnabled(bool enabled) {
+		useDisplayListCache_ = enabled;
+		ClearDisplayListCache();
+	}
+
+	// Replaces the block transfer with one that copies these words over the list at addr.
+	void SetTransfer(u32 addr, const std::vector<u32> &words) {
+		transferAddr_ = addr;
+		transferWords_ = words;
+		cmdInfo_[GE_CMD_TRANSFERSTART].func = static_cast<CmdFunc>(&DLCacheTestGPU::Execute_TestTransfer);
+	}
+	void RestoreTransfer() {
+		cmdInfo_[GE_CMD_TRANSFERSTART].func = &GPUCommon::Execute_BlockTransferStart;
+	}
+
+	bool IsDecoded(u32 pc) const {
+		auto it = dlCache_.find(pc);
+		return it != dlCache_.end() && it->second.numWords != 0;
+	}
+	size_t NumSegments() const {
+		return dlCache_.size();
+	}
+
+	void Run(u32 start, u32 end) {
+		DisplayList list;
+		memset(&list, 0, sizeof(list));
+		list.pc = start;
+		list.stall = end;
+		list.state = PSP_GE_DL_STATE_RUNNING;
+		InterpretList(list);
+		currentList = nullptr;
+	}
+
+protected:
+	void FastRunLoop(DisplayList &list) override {
+		GPUCommon::FastRunLoop(list);
+	}
+
+	void Execute_TestTransfer(u32 op, u32 diff) {
+		u32 *dst = (u32 *)Memory::GetPointer(transferAddr_);
+		memcpy(dst, transferWords_.data(), transferWords_.size() * sizeof(u32));
+		InvalidateDisplayListCache(transferAddr_, (int)(transferWords_.size() * sizeof(u32)));
+	}
+
+	u32 transferAddr_ = 0;
+	std::vector<u32> transferWords_;
+};
+
+// Plain state writes, none of these execute anything.
+static const u8 stateCmds[] = {
+	GE_CMD_FOGCOLOR, GE_CMD_TEXENVCOLOR, GE_CMD_AMBIENTCOLOR, GE_CMD_MATERIALDIFFUSE,
+	GE_CMD_MATERIALAMBIENT, GE_CMD_MATERIALSPECULAR, GE_CMD_TRANSFERSRC, GE_CMD_TRANSFERDST,
+};
+
+static void WriteStateRun(std::vector<u32> &words, int count, int seed) {
+	for (int i = 0; i < count; ++i) {
+		// Repeat registers within the run, like games setting the same state for each draw.
+		const u8 cmd = stateCmds[(i + seed) % ARRAY_SIZE(stateCmds)];
+		words.push_back((cmd << 24) | ((i * 0x10101 + seed) & 0xFFFFFF));
+	}
+}
+
+// What the registers should end up as, running the list word by word (and doing the transfer.)
+static void ReferenceRun(std::vector<u32> &words, u32 transferOffset, const std::vector<u32> &transfer, u32 *cmdmem) {
+	for (size_t i = 0; i < words.size(); ++i) {
+		cmdmem[words[i] >> 24] = words[i];
+		if ((words[i] >> 24) == GE_CMD_TRANSFERSTART) {
+			std::copy(transfer.begin(), transfer.end(), words.begin() + transferOffset);
+		}
+	}
+}
+
+static bool CheckRegisters(const u32 *expected, const char *what, int pass) {
+	for (int i = 0; i < 256; ++i) {
+		if (gstate.cmdmem[i] != expected[i]) {
+			printf("Display list cache: %s, pass %d: register %02x is %08x, expected %08x\n", what, pass, i, gstate.cmdmem[i], expected[i]);
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool TestTransferOverList(DLCacheTestGPU &gpu) {
+	// Two segments, split by a transfer that copies new values over the second one.
+	std::vector<u32> words;
+	WriteStateRun(words, 64, 0);
+	words.push_back(GE_CMD_TRANSFERSTART << 24);
+	const u32 secondOffset = (u32)words.size();
+	WriteStateRun(words, 64, 3);
+
+	bool success = true;
+	gpu.SetCacheEnabled(true);
+	for (int pass = 0; pass < 8 && success; ++pass) {
+		// The first passes let both segments be decoded, then the transfer starts changing the second.
+		std::vector<u32> transfer;
+		WriteStateRun(transfer, 64, pass < 3 ? 3 : pass * 7);
+		gpu.SetTransfer(LIST_ADDR + secondOffset * 4, transfer);
+		// And sometimes the CPU changes the first one, which nothing tells us about.
+		if (pass == 5)
+			words[10] ^= 0x123;
+
+		memcpy(Memory::GetPointer(LIST_ADDR), words.data(), words.size() * sizeof(u32));
+		u32 expected[256];
+		memcpy(expected, gstate.cmdmem, sizeof(expected));
+		ReferenceRun(words, secondOffset, transfer, expected);
+
+		gpu.Run(LIST_ADDR, LIST_ADDR + (u32)words.size() * 4);
+		success = CheckRegisters(expected, "transfer over list", pass);
+		if (success && pass >= 3 && gpu.IsDecoded(LIST_ADDR + secondOffset * 4)) {
+			printf("Display list cache: pass %d: segment under the transfer is still cached\n", pass);
+			success = false;
+		}
+		if (success && pass >= 2 && !gpu.IsDecoded(LIST_ADDR)) {
+			printf("Display list cache: pass %d: first segment was not cached\n", pass);
+			success = false;
+		}
+	}
+	gpu.RestoreTransfer();
+	return success;
+}
+
+static bool TestOneOffLists(DLCacheTestGPU &gpu) {
+	// Lists built at a new address each time shouldn't leave anything behind.
+	std::vector<u32> words;
+	WriteStateRun(words, 64, 1);
+	const u32 stride = ((u32)words.size() + 1) * 4;
+	gpu.SetCacheEnabled(true);
+	for (u32 i = 0; i < 64; ++i) {
+		const u32 addr = ONE_OFF_ADDR + i * stride;
+		memcpy(Memory::GetPointer(addr), words.data(), words.size() * sizeof(u32));
+		gpu.Run(addr, addr + (u32)words.size() * 4);
+	}
+	if (gpu.NumSegments() != 0) {
+		printf("Display list cache: %d entries for lists that ran once\n", (int)gpu.NumSegments());
+		return false;
+	}
+
+	// But the second time one runs, it's worth decoding.
+	gpu.Run(ONE_OFF_ADDR, ONE_OFF_ADDR + (u32)words.size() * 4);
+	if (gpu.NumSegments() != 1 || !gpu.IsDecoded(ONE_OFF_ADDR)) {
+		printf("Display list cache: list that ran twice was not cached\n");
+		return false;
+	}
+	return true;
+}
+
+static bool BenchmarkCache(DLCacheTestGPU &gpu) {
+	// A list shaped roughly like a frame: runs of state, with a transfer every so often.
+	std::vector<u32> words;
+	for (int i = 0; i < 32; ++i) {
+		WriteStateRun(words, 96, i & 3);
+		words.push_back(GE_CMD_TRANSFERSTART << 24);
+	}
+	memcpy(Memory::GetPointer(LIST_ADDR), words.data(), words.size() * sizeof(u32));
+	// A transfer that lands somewhere else.
+	gpu.SetTransfer(LIST_ADDR + (u32)words.size() * 4 + 0x1000, std::vector<u32>(16));
+	const u32 end = LIST_ADDR + (u32)words.size() * 4;
+
+	u32 results[2][256];
+	double times[2];
+	for (int cached = 0; cached < 2; ++cached) {
+		gpu.SetCacheEnabled(cached != 0);
+		memset(gstate.cmdmem, 0, sizeof(gstate.cmdmem));
+		double st = real_time_now();
+		for (int n = 0; n < BENCH_ITERATIONS; ++n) {
+			gpu.Run(LIST_ADDR, end);
+		}
+		times[cached] = real_time_now() - st;
+		memcpy(results[cached], gstate.cmdmem, sizeof(results[cached]));
+	}
+
+	const double mcommands = (double)words.size() * BENCH_ITERATIONS / 1000000.0;
+	printf("Display list cache: plain loop %0.1f Mcmd/s, cached %0.1f Mcmd/s\n", mcommands / times[0], mcommands / times[1]);
+	// The cached run left its registers in gstate.
+	if (!CheckRegisters(results[0], "benchmark", 0)) {
+		gpu.RestoreTransfer();
+		return false;
+	}
+
+	// The same list, but at a different address every time, so the cache never helps.
+	const u32 stride = ((u32)words.size() * 4 + 0xFF) & ~0xFF;
+	const int oneOffCount = std::min(BENCH_ITERATIONS, (int)((Memory::RAM_NORMAL_SIZE / 2) / stride));
+	for (int n = 0; n < oneOffCount; ++n) {
+		memcpy(Memory::GetPointer(ONE_OFF_ADDR + n * stride), words.data(), words.size() * sizeof(u32));
+	}
+	for (int cached = 0; cached < 2; ++cached) {
+		gpu.SetCacheEnabled(cached != 0);
+		double st = real_time_now();
+		for (int n = 0; n < oneOffCount; ++n) {
+			const u32 addr = ONE_OFF_ADDR + n * stride;
+			gpu.Run(addr, addr + (u32)words.size() * 4);
+		}
+		times[cached] = real_time_now() - st;
+	}
+	gpu.RestoreTransfer();
+
+	const double oneOffMcommands = (double)words.size() * oneOffCount / 1000000.0;
+	printf("Display list cache: one-off lists, plain loop %0.1f Mcmd/s, cached %0.1f Mcmd/s\n", oneOffMcommands / times[0], oneOffMcommands / times[1]);
+	return true;
+}
+
+bool TestDisplayListCache() {
+	Memory::g_MemorySize = Memory::RAM_NORMAL_SIZE;
+	Memory::Init();
+
+	bool success;
+	{
+		DLCacheTestGPU gpu;
+		success = TestTransferOverList(gpu) && TestOneOffLists(gpu) && BenchmarkCache(gpu);
+	}
+
+	Memory::Shutdown();
+	return success;
+}
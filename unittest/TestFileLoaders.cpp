@@ -0,0 +1,732 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "base/stringutil.h"
+#include "base/timeutil.h"
+#include "net/http_server.h"
+#include "net/resolve.h"
+#include "net/sinks.h"
+#include "thread/executor.h"
+#include "Common/FileUtil.h"
+#include "Core/Config.h"
+#include "Core/Loaders.h"
+#include "Core/FileLoaders/CachingFileLoader.h"
+#include "Core/FileLoaders/FilePrefetcher.h"
+#include "Core/FileLoaders/HTTPFileLoader.h"
+#include "Core/FileLoaders/LocalFileLoader.h"
+#include "Core/FileLoaders/RetryingFileLoader.h"
+#include "Core/FileLoaders/SharedCachingFileLoader.h"
+
+static u8 ContentAt(s64 pos) {
+	return (u8)((pos ^ (pos >> 8) ^ (pos >> 19)) * 31);
+}
+
+// Makes up its contents, so large files don't need the memory.
+class GeneratedFileLoader : public FileLoader {
+public:
+	// A patchPos makes it a slightly different file, with one byte changed.
+	GeneratedFileLoader(s64 size, const std::string &path = "generated.iso", s64 patchPos = -1)
+		: size_(size), path_(path), patchPos_(patchPos) {
+	}
+
+	bool Exists() override {
+		return true;
+	}
+	bool IsDirectory() override {
+		return false;
+	}
+	s64 FileSize() override {
+		return size_;
+	}
+	std::string Path() const override {
+		return path_;
+	}
+	size_t ReadAt(s64 absolutePos, size_t bytes, size_t count, void *data, Flags flags = Flags::NONE) override {
+		reads_++;
+		if (std::this_thread::get_id() != owner_)
+			otherThreadReads_++;
+		if (absolutePos >= size_)
+			return 0;
+		size_t total = (size_t)std::min((s64)(bytes * count), size_ - absolutePos);
+		u8 *p = (u8 *)data;
+		for (size_t i = 0; i < total; ++i)
+			p[i] = ContentAt(absolutePos + i);
+		if (patchPos_ >= absolutePos && patchPos_ < absolutePos + (s64)total)
+			p[patchPos_ - absolutePos] ^= 0xFF;
+		return total / bytes;
+	}
+
+	std::atomic<int> reads_{ 0 };
+	// Reads from threads other than the one that created it, like reading ahead.
+	std::atomic<int> otherThreadReads_{ 0 };
+
+private:
+	std::thread::id owner_ = std::this_thread::get_id();
+	s64 size_;
+	std::string path_;
+	s64 patchPos_;
+};
+
+static bool CheckRead(FileLoader *loader, s64 size, s64 pos, size_t bytes, u8 *buf) {
+	size_t expected = pos >= size ? 0 : (size_t)std::min((s64)bytes, size - pos);
+	size_t readSize = loader->ReadAt(pos, bytes, buf);
+	if (readSize != expected) {
+		printf("Caching file loader: read %d bytes at %lld, expected %d\n", (int)readSize, (long long)pos, (int)expected);
+		return false;
+	}
+	for (size_t i = 0; i < readSize; ++i) {
+		if (buf[i] != ContentAt(pos + i)) {
+			printf("Caching file loader: wrong data at %lld\n", (long long)(pos + i));
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool TestCachingRandomReads() {
+	const s64 size = 24 * 1024 * 1024 + 1234;
+	GeneratedFileLoader *backend = new GeneratedFileLoader(size);
+	CachingFileLoader loader(backend);
+	std::vector<u8> buf(256 * 1024);
+	std::mt19937 rng(1);
+
+	for (int i = 0; i < 2000; ++i) {
+		s64 pos = rng() % (size + 4096);
+		size_t bytes = 1 + rng() % buf.size();
+		if (!CheckRead(&loader, size, pos, bytes, buf.data()))
+			return false;
+	}
+
+	for (s64 pos = 0; pos < size; pos += buf.size()) {
+		if (!CheckRead(&loader, size, pos, buf.size(), buf.data()))
+			return false;
+	}
+
+	// Everything is cached by now, so this shouldn't touch the backend.
+	// The read ahead thread might still be finishing its last read, though.
+	int reads = backend->reads_;
+	for (s64 pos = 0; pos < size; pos += 2048) {
+		if (!CheckRead(&loader, size, pos, 2048, buf.data()))
+			return false;
+	}
+	if (backend->reads_ > reads + 1) {
+		printf("Caching file loader: %d reads of cached blocks went to the backend\n", backend->reads_ - reads);
+		return false;
+	}
+	return true;
+}
+
+static bool TestCachingEviction() {
+	// Larger than the cache, so blocks have to be evicted while other threads read.
+	const s64 size = 320 * 1024 * 1024;
+	CachingFileLoader loader(new GeneratedFileLoader(size));
+
+	std::atomic<bool> success(true);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 3; ++t) {
+		threads.push_back(std::thread([&, t] {
+			std::vector<u8> buf(64 * 1024);
+			std::mt19937 rng(t);
+			for (int i = 0; i < 4000 && success; ++i) {
+				// One thread streams through the file, the others read randomly.
+				s64 pos = t == 0 ? (s64)i * 96 * 1024 : rng() % size;
+				if (!CheckRead(&loader, size, pos % size, 1 + rng() % buf.size(), buf.data()))
+					success = false;
+			}
+		}));
+	}
+	for (auto &thread : threads)
+		thread.join();
+	return success;
+}
+
+// Waits until the backend has gone a while without being read from another thread.
+static int WaitForReadAhead(GeneratedFileLoader *backend) {
+	int reads = backend->otherThreadReads_;
+	for (int idle = 0; idle < 50; ++idle) {
+		sleep_ms(1);
+		if (backend->otherThreadReads_ != reads) {
+			reads = backend->otherThreadReads_;
+			idle = 0;
+		}
+	}
+	return reads;
+}
+
+static bool TestCachingReadAheadWhenFull() {
+	// Streaming past the size of the cache, reading ahead has to evict blocks like any other read.
+	const s64 size = 320 * 1024 * 1024;
+	const s64 full = 300 * 1024 * 1024;
+	GeneratedFileLoader *backend = new GeneratedFileLoader(size);
+	CachingFileLoader loader(backend);
+	std::vector<u8> buf(256 * 1024);
+	for (s64 pos = 0; pos < full; pos += buf.size()) {
+		if (!CheckRead(&loader, size, pos, buf.size(), buf.data()))
+			return false;
+	}
+
+	int aheadReads = WaitForReadAhead(backend);
+	if (!CheckRead(&loader, size, full, buf.size(), buf.data()))
+		return false;
+	if (WaitForReadAhead(backend) == aheadReads) {
+		printf("Caching file loader: stopped reading ahead once the cache was full\n");
+		return false;
+	}
+
+	// And what it read should be there for the next reads.
+	int demandReads = backend->reads_ - backend->otherThreadReads_;
+	for (s64 pos = full + buf.size(); pos < full + 4 * buf.size(); pos += buf.size()) {
+		if (!CheckRead(&loader, size, pos, buf.size(), buf.data()))
+			return false;
+	}
+	demandReads = backend->reads_ - backend->otherThreadReads_ - demandReads;
+	if (demandReads != 0) {
+		printf("Caching file loader: %d reads after reading ahead went to the backend\n", demandReads);
+		return false;
+	}
+	return true;
+}
+
+static void BenchmarkCachingReads() {
+	const s64 size = 64 * 1024 * 1024;
+	CachingFileLoader loader(new GeneratedFileLoader(size));
+	std::vector<u8> buf(1024 * 1024);
+	for (s64 pos = 0; pos < size; pos += buf.size())
+		loader.ReadAt(pos, buf.size(), buf.data());
+
+	const int count = 1000000;
+	std::mt19937 rng(2);
+	std::vector<s64> positions(count);
+	for (auto &pos : positions)
+		pos = (rng() % (size / 2048)) * 2048;
+
+	double start = real_time_now();
+	for (s64 pos : positions)
+		loader.ReadAt(pos, 2048, buf.data());
+	double elapsed = real_time_now() - start;
+	printf("Caching file loader: %.2f M random 2KB reads/s\n", count / elapsed / 1000000.0);
+}
+
+// Collects everything the prefetcher wants to read next, as a list of blocks.
+static std::vector<s64> PrefetchedBlocks(FilePrefetcher &prefetcher, std::vector<bool> &cached) {
+	std::vector<s64> blocks;
+	s64 first;
+	size_t count;
+	while (prefetcher.Next(16, &first, &count)) {
+		for (size_t i = 0; i < count; ++i) {
+			cached[first + i] = true;
+			blocks.push_back(first + i);
+		}
+	}
+	return blocks;
+}
+
+static bool TestPrefetcher() {
+	const s64 numBlocks = 1000;
+	std::vector<bool> cached(numBlocks);
+	auto isCached = [&](s64 block) {
+		return cached[block];
+	};
+
+	// A sequential stream should get a growing window.
+	FilePrefetcher sequential("", numBlocks, isCached);
+	size_t lastAhead = 0;
+	for (s64 block = 0; block < 6; ++block) {
+		sequential.NoteRead(block, block);
+		std::vector<s64> blocks = PrefetchedBlocks(sequential, cached);
+		s64 ahead = blocks.empty() ? block : blocks.back();
+		if (ahead - block < (s64)lastAhead || (!blocks.empty() && blocks.front() <= block)) {
+			printf("Prefetcher: sequential read of block %d read ahead to %d\n", (int)block, (int)ahead);
+			return false;
+		}
+		lastAhead = (size_t)(ahead - block);
+	}
+	if (lastAhead <= 8) {
+		printf("Prefetcher: sequential window only grew to %d blocks\n", (int)lastAhead);
+		return false;
+	}
+
+	// Strides get detected after two reads, and don't read the blocks in between.
+	FilePrefetcher strided("", numBlocks, isCached);
+	cached.assign(numBlocks, false);
+	strided.NoteRead(500, 500);
+	PrefetchedBlocks(strided, cached);
+	strided.NoteRead(510, 510);
+	strided.NoteRead(520, 520);
+	std::vector<s64> blocks = PrefetchedBlocks(strided, cached);
+	if (blocks.empty() || blocks.front() != 530 || std::find(blocks.begin(), blocks.end(), 525) != blocks.end()) {
+		printf("Prefetcher: strided reads prefetched %d blocks starting at %d\n", (int)blocks.size(), blocks.empty() ? -1 : (int)blocks.front());
+		return false;
+	}
+
+	// Opening a file reads its start, and reading it doesn't go past its end.
+	FilePrefetcher extents("", numBlocks, isCached);
+	cached.assign(numBlocks, false);
+	extents.NoteExtent(100, 102);
+	blocks = PrefetchedBlocks(extents, cached);
+	for (s64 block = 100; block <= 102; ++block) {
+		extents.NoteRead(block, block);
+		std::vector<s64> more = PrefetchedBlocks(extents, cached);
+		blocks.insert(blocks.end(), more.begin(), more.end());
+	}
+	if (blocks != std::vector<s64>{ 100, 101, 102 }) {
+		printf("Prefetcher: reading a file prefetched %d blocks\n", (int)blocks.size());
+		return false;
+	}
+
+	// What's read during one boot gets prefetched at the next.
+	const std::string traceFilename = "prefetcher_test.ppbt";
+	const std::vector<s64> bootReads = { 900, 17, 18, 400, 3 };
+	{
+		FilePrefetcher boot(traceFilename, numBlocks, isCached);
+		for (s64 block : bootReads)
+			boot.NoteRead(block, block);
+	}
+	{
+		FilePrefetcher nextBoot(traceFilename, numBlocks, isCached);
+		cached.assign(numBlocks, false);
+		blocks = PrefetchedBlocks(nextBoot, cached);
+	}
+	if (blocks != bootReads) {
+		remove(traceFilename.c_str());
+		printf("Prefetcher: replayed %d of %d blocks from the boot trace\n", (int)blocks.size(), (int)bootReads.size());
+		return false;
+	}
+
+	// A short session, like identifying the file, doesn't replace the trace.  It only adds to it.
+	for (int session = 0; session < 2; ++session) {
+		FilePrefetcher probe(traceFilename, numBlocks, isCached);
+		probe.NoteRead(18, 18);
+		probe.NoteRead(0, 0);
+	}
+	FilePrefetcher afterProbe(traceFilename, numBlocks, isCached);
+	cached.assign(numBlocks, false);
+	blocks = PrefetchedBlocks(afterProbe, cached);
+	remove(traceFilename.c_str());
+	std::vector<s64> expected = bootReads;
+	expected.push_back(0);
+	if (blocks != expected) {
+		printf("Prefetcher: replayed %d blocks after a short session, expected %d\n", (int)blocks.size(), (int)expected.size());
+		return false;
+	}
+	return true;
+}
+
+static bool TestLocalFileLoader() {
+	const std::string filename = "local_loader_test.bin";
+	const s64 size = 3 * 2048 + 100;
+	std::vector<u8> contents((size_t)size);
+	for (s64 pos = 0; pos < size; ++pos)
+		contents[(size_t)pos] = ContentAt(pos);
+	FILE *f = fopen(filename.c_str(), "wb");
+	if (!f || fwrite(contents.data(), 1, contents.size(), f) != contents.size()) {
+		printf("Local file loader: unable to write %s\n", filename.c_str());
+		if (f)
+			fclose(f);
+		return false;
+	}
+	fclose(f);
+
+	bool success = true;
+	{
+		LocalFileLoader loader(filename, true);
+		std::vector<u8> buf(8192);
+		for (s64 pos : { (s64)0, (s64)1000, (s64)2048, size - 10, size, size + 5 }) {
+			if (!CheckRead(&loader, size, pos, buf.size(), buf.data()))
+				success = false;
+		}
+
+		// Only mapped files can be read in place, and never past the end.
+		const u8 *ptr = loader.GetPointer(2048, 2048);
+		if (ptr && memcmp(ptr, &contents[2048], 2048) != 0) {
+			printf("Local file loader: wrong data in the mapping\n");
+			success = false;
+		}
+		if (loader.GetPointer(size - 10, 11) != nullptr || loader.GetPointer(-1, 1) != nullptr) {
+			printf("Local file loader: got a pointer outside the file\n");
+			success = false;
+		}
+	}
+	{
+		// Mapping is opt-in, since touching a mapped file that's gone away crashes.
+		LocalFileLoader loader(filename);
+		if (loader.GetPointer(0, 2048) != nullptr) {
+			printf("Local file loader: mapped without being asked to\n");
+			success = false;
+		}
+	}
+	remove(filename.c_str());
+	return success;
+}
+
+static bool TestSharedCache() {
+	const std::string oldCacheDirectory = g_Config.appCacheDirectory;
+	g_Config.appCacheDirectory = "shared_cache_test";
+	const std::string storePath = SharedCachingFileLoader::CacheDirectory() + "/blocks.ppsb";
+	const s64 size = 4 * 1024 * 1024;
+	std::vector<u8> buf(256 * 1024);
+
+	bool success = true;
+	u64 emptySize = 0, firstSize = 0, variantSize = 0;
+	{
+		SharedCachingFileLoader loader(new GeneratedFileLoader(size, "http://server/game.iso"));
+		loader.FileSize();
+		emptySize = File::GetFileSize(storePath);
+		for (s64 pos = 0; pos < size && success; pos += buf.size())
+			success = CheckRead(&loader, size, pos, buf.size(), buf.data());
+		firstSize = File::GetFileSize(storePath);
+	}
+
+	// Another dump of the same game only needs space for the blocks that are different.
+	{
+		SharedCachingFileLoader loader(new GeneratedFileLoader(size, "http://server/game-v2.iso", size / 2 + 5));
+		for (s64 pos = 0; pos < size; pos += buf.size())
+			loader.ReadAt(pos, buf.size(), buf.data());
+		variantSize = File::GetFileSize(storePath);
+	}
+	if (success && (firstSize <= emptySize || variantSize <= firstSize || (variantSize - firstSize) * 4 > firstSize - emptySize)) {
+		printf("Shared disk cache: store went from %lld to %lld to %lld bytes\n", (long long)emptySize, (long long)firstSize, (long long)variantSize);
+		success = false;
+	}
+
+	// Once the cache is warm, like for the next process, the backend isn't needed.
+	if (success) {
+		GeneratedFileLoader *backend = new GeneratedFileLoader(size, "http://server/game.iso");
+		SharedCachingFileLoader loader(backend);
+		std::mt19937 rng(3);
+		for (int i = 0; i < 200 && success; ++i)
+			success = CheckRead(&loader, size, rng() % size, 1 + rng() % buf.size(), buf.data());
+		if (backend->reads_ != 0) {
+			printf("Shared disk cache: %d reads went to the backend\n", (int)backend->reads_);
+			success = false;
+		}
+	}
+
+	File::DeleteDirRecursively(g_Config.appCacheDirectory);
+	g_Config.appCacheDirectory = oldCacheDirectory;
+	return success;
+}
+
+// Several PPSSPPs can share the store.  Each opens it separately, like these two do.
+static bool TestSharedBlockStore() {
+	const std::string dir = "shared_store_test";
+	const std::string storePath = dir + "/blocks.ppsb";
+	std::vector<std::vector<u8>> blocks(6);
+	std::vector<SharedBlockHash> hashes;
+	for (size_t i = 0; i < blocks.size(); ++i) {
+		blocks[i].resize(i == blocks.size() - 1 ? 1000 : 65536);
+		for (size_t j = 0; j < blocks[i].size(); ++j)
+			blocks[i][j] = ContentAt((s64)j) ^ (u8)(i + 1);
+		hashes.push_back(SharedBlockStore::HashBlock(blocks[i].data(), blocks[i].size()));
+	}
+
+	auto checkBlock = [&](SharedBlockStore &store, size_t i, bool expected, const char *what) {
+		std::vector<u8> buf(store.BlockSize());
+		const size_t size = store.ReadBlock(hashes[i], buf.data());
+		if (!expected) {
+			if (size == 0)
+				return true;
+			printf("Shared block store: %s: block %d is still there\n", what, (int)i);
+			return false;
+		}
+		if (size != blocks[i].size() || memcmp(buf.data(), blocks[i].data(), size) != 0) {
+			printf("Shared block store: %s: block %d read back %d bytes, wrong\n", what, (int)i, (int)size);
+			return false;
+		}
+		return true;
+	};
+
+	bool success = true;
+	{
+		SharedBlockStore first(dir);
+		SharedBlockStore second(dir);
+		if (!first.IsValid() || !second.IsValid()) {
+			printf("Shared block store: couldn't open it twice\n");
+			success = false;
+		}
+
+		// Each sees what the other added, and adding the same block again doesn't take more space.
+		for (size_t i = 0; i < blocks.size() && success; ++i) {
+			SharedBlockStore &writer = (i & 1) ? second : first;
+			SharedBlockStore &reader = (i & 1) ? first : second;
+			writer.AddBlock(hashes[i], blocks[i].data(), blocks[i].size());
+			success = checkBlock(reader, i, true, "other store") && checkBlock(writer, i, true, "same store");
+		}
+		const u64 size = File::GetFileSize(storePath);
+		second.AddBlock(hashes[0], blocks[0].data(), blocks[0].size());
+		first.AddBlock(hashes[1], blocks[1].data(), blocks[1].size());
+		if (success && File::GetFileSize(storePath) != size) {
+			printf("Shared block store: adding the same blocks again grew it from %lld to %lld bytes\n", (long long)size, (long long)File::GetFileSize(storePath));
+			success = false;
+		}
+	}
+
+	// Like a crash halfway through writing the last block.
+	const u64 fullSize = File::GetFileSize(storePath);
+	if (success && !File::IOFile(storePath, "rb+").Resize(fullSize - 500)) {
+		printf("Shared block store: couldn't truncate %s\n", storePath.c_str());
+		success = false;
+	}
+	if (success) {
+		const size_t last = blocks.size() - 1;
+		{
+			SharedBlockStore store(dir);
+			for (size_t i = 0; i < last && success; ++i)
+				success = checkBlock(store, i, true, "after truncating");
+			success = success && checkBlock(store, last, false, "after truncating");
+			store.AddBlock(hashes[last], blocks[last].data(), blocks[last].size());
+			success = success && checkBlock(store, last, true, "added again");
+		}
+		SharedBlockStore store(dir);
+		for (size_t i = 0; i <= last && success; ++i)
+			success = checkBlock(store, i, true, "reopened");
+	}
+
+	File::DeleteDirRecursively(dir);
+	return success;
+}
+
+#ifndef _WIN32
+static std::vector<u8> ForkTestBlock(int i) {
+	std::vector<u8> block(4096 + (i % 256) * 16);
+	for (size_t j = 0; j < block.size(); ++j)
+		block[j] = ContentAt((s64)j + i * 7);
+	memcpy(block.data(), &i, sizeof(i));
+	return block;
+}
+
+// Two processes creating the store and appending to it at once, each has to see every block.
+static bool TestSharedBlockStoreProcesses() {
+	const std::string dir = "shared_store_fork_test";
+	const int BLOCKS = 1024;
+
+	// Both open the store, then start appending together.
+	int start[2];
+	if (pipe(start) != 0) {
+		printf("Shared block store: pipe failed\n");
+		return false;
+	}
+	fflush(stdout);
+	const pid_t pid = fork();
+	if (pid < 0) {
+		printf("Shared block store: fork failed\n");
+		close(start[0]);
+		close(start[1]);
+		return false;
+	}
+	{
+		SharedBlockStore store(dir);
+		bool valid = store.IsValid();
+		char c = 0;
+		if (pid == 0) {
+			close(start[1]);
+			valid = read(start[0], &c, 1) == 1 && valid;
+			close(start[0]);
+		} else {
+			close(start[0]);
+			valid = write(start[1], &c, 1) == 1 && valid;
+			close(start[1]);
+		}
+		for (int i = pid == 0 ? 1 : 0; i < BLOCKS && valid; i += 2) {
+			const std::vector<u8> block = ForkTestBlock(i);
+			store.AddBlock(SharedBlockStore::HashBlock(block.data(), block.size()), block.data(), block.size());
+		}
+		if (pid == 0)
+			_exit(valid ? 0 : 1);
+		if (!valid)
+			printf("Shared block store: couldn't open it next to another process\n");
+	}
+
+	int status = 0;
+	bool success = waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+	if (!success)
+		printf("Shared block store: child process failed\n");
+
+	SharedBlockStore store(dir);
+	std::vector<u8> buf(store.BlockSize());
+	for (int i = 0; i < BLOCKS && success; ++i) {
+		const std::vector<u8> block = ForkTestBlock(i);
+		const size_t size = store.ReadBlock(SharedBlockStore::HashBlock(block.data(), block.size()), buf.data());
+		if (size != block.size() || memcmp(buf.data(), block.data(), size) != 0) {
+			printf("Shared block store: block %d from the %s process read back %d bytes, wrong\n", i, (i & 1) ? "child" : "parent", (int)size);
+			success = false;
+		}
+	}
+
+	File::DeleteDirRecursively(dir);
+	return success;
+}
+#endif
+
+// Serves a generated disc over the native http server, slowly, like a remote one would.
+class TestDiscServer {
+public:
+	TestDiscServer(s64 size) : size_(size) {
+		net::Init();
+		server_ = new http::Server(new threading::NewThreadExecutor());
+		server_->RegisterHandler("/disc.iso", std::bind(&TestDiscServer::HandleDisc, this, std::placeholders::_1));
+		if (server_->Listen(0)) {
+			thread_ = std::thread([this] {
+				while (!stop_)
+					server_->RunSlice(0.1);
+			});
+		}
+	}
+	~TestDiscServer() {
+		stop_ = true;
+		server_->Stop();
+		if (thread_.joinable())
+			thread_.join();
+		delete server_;
+		net::Shutdown();
+	}
+
+	std::string Url() {
+		return StringFromFormat("http://localhost:%d/disc.iso", server_->Port());
+	}
+
+	std::atomic<int> requests_{ 0 };
+	std::atomic<int> maxInFlight_{ 0 };
+	// Range requests to fail with a 503 before serving again.
+	std::atomic<int> failures_{ 0 };
+
+private:
+	void HandleDisc(const http::Request &request) {
+		std::string range;
+		s64 begin = 0, last = 0;
+		if (request.Method() == http::RequestHeader::HEAD) {
+			request.WriteHttpResponseHeader("1.0", 200, size_, "application/octet-stream", "Accept-Ranges: bytes\r\n");
+			return;
+		}
+		if (!request.GetHeader("range", &range) || sscanf(range.c_str(), "bytes=%lld-%lld", &begin, &last) != 2 || begin < 0 || begin > last || last >= size_) {
+			request.WriteHttpResponseHeader("1.0", 416, -1, "text/plain");
+			return;
+		}
+		requests_++;
+		if (failures_.fetch_sub(1) > 0) {
+			request.WriteHttpResponseHeader("1.0", 503, -1, "text/plain");
+			return;
+		}
+		failures_ = 0;
+
+		int inFlight = ++inFlight_;
+		int prevMax = maxInFlight_;
+		while (inFlight > prevMax && !maxInFlight_.compare_exchange_weak(prevMax, inFlight))
+			continue;
+		// Each connection gets limited bandwidth, like a slow link would.
+		std::vector<char> data((size_t)(last - begin + 1));
+		sleep_ms(LATENCY_MS + (int)(data.size() / BYTES_PER_MS));
+
+		for (size_t i = 0; i < data.size(); ++i)
+			data[i] = (char)ContentAt(begin + i);
+		std::string contentRange = StringFromFormat("Content-Range: bytes %lld-%lld/%lld\r\n", begin, last, size_);
+		request.WriteHttpResponseHeader("1.0", 206, data.size(), "application/octet-stream", contentRange.c_str());
+		request.Out()->Push(data.data(), data.size());
+		request.Out()->Flush();
+		--inFlight_;
+	}
+
+	enum {
+		LATENCY_MS = 10,
+		BYTES_PER_MS = 16 * 1024,
+	};
+
+	s64 size_;
+	http::Server *server_;
+	std::thread thread_;
+	std::atomic<bool> stop_{ false };
+	std::atomic<int> inFlight_{ 0 };
+};
+
+static bool TestHTTPFileLoader() {
+	const s64 size = 8 * 1024 * 1024 + 1000;
+	TestDiscServer server(size);
+	RetryingFileLoader loader(new HTTPFileLoader(server.Url()));
+	if (loader.FileSize() != size) {
+		printf("HTTP file loader: got a size of %lld, expected %lld\n", (long long)loader.FileSize(), (long long)size);
+		return false;
+	}
+
+	std::vector<u8> buf(1024 * 1024);
+	bool success = true;
+	for (s64 pos : { (s64)0, (s64)2048, (s64)12345, size - 10, size - 300 * 1024, size }) {
+		if (!CheckRead(&loader, size, pos, 2048, buf.data()) || !CheckRead(&loader, size, pos, buf.size(), buf.data()))
+			success = false;
+	}
+
+	// Large reads should be split up over several connections.
+	double start = real_time_now();
+	for (s64 pos = 0; pos < size && success; pos += buf.size())
+		success = CheckRead(&loader, size, pos, buf.size(), buf.data());
+	double elapsed = real_time_now() - start;
+	if (success && server.maxInFlight_ < 2) {
+		printf("HTTP file loader: never had more than one request in flight\n");
+		success = false;
+	}
+
+	// The retrying loader should get past a server that's briefly unavailable.
+	server.failures_ = 2;
+	int requestsBefore = server.requests_;
+	if (success && !CheckRead(&loader, size, 4 * 1024 * 1024, 4096, buf.data()))
+		success = false;
+	if (success && server.requests_ - requestsBefore != 3) {
+		printf("HTTP file loader: took %d requests to get past 2 failures\n", server.requests_ - requestsBefore);
+		success = false;
+	}
+
+	printf("HTTP file loader: %.1f ms to read %lld bytes, %d requests at once\n", elapsed * 1000.0, (long long)size, (int)server.maxInFlight_);
+	return success;
+}
+
+bool TestFileLoaders() {
+	if (!TestCachingRandomReads())
+		return false;
+	if (!TestCachingEviction())
+		return false;
+	if (!TestCachingReadAheadWhenFull())
+		return false;
+	if (!TestPrefetcher())
+		return false;
+	if (!TestLocalFileLoader())
+		return false;
+	if (!TestSharedBlockStore())
+		return false;
+#ifndef _WIN32
+	if (!TestSharedBlockStoreProcesses())
+		return false;
+#endif
+	if (!TestSharedCache())
+		return false;
+	if (!TestHTTPFileLoader())
+		return false;
+	BenchmarkCachingReads();
+	return true;
+}
@@ -0,0 +1,144 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "base/timeutil.h"
+#include "GPU/GPUState.h"
+
+static const int BENCH_ITERATIONS = 20000;
+
+struct MatrixRun {
+	u8 cmd;
+	int size;
+};
+
+// What a typical draw in a dump sends: world and view most of the time, sometimes the projection,
+// and a full set of bones for skinned models.
+static const MatrixRun runs[] = {
+	{ GE_CMD_WORLDMATRIXDATA, 12 },
+	{ GE_CMD_VIEWMATRIXDATA, 12 },
+	{ GE_CMD_PROJMATRIXDATA, 16 },
+	{ GE_CMD_WORLDMATRIXDATA, 12 },
+	{ GE_CMD_BONEMATRIXDATA, 96 },
+	{ GE_CMD_WORLDMATRIXDATA, 12 },
+	{ GE_CMD_TGENMATRIXDATA, 12 },
+	// Cut short by another command.
+	{ GE_CMD_BONEMATRIXDATA, 30 },
+};
+
+// The way the matrix commands used to be loaded, one at a time.
+static int ReferenceLoad(u32 *dst, const u32_le *src, int end, u8 cmd, bool *changed) {
+	int i = 0;
+	*changed = false;
+	while ((src[i] >> 24) == cmd) {
+		const u32 newVal = src[i] << 8;
+		if (dst[i] != newVal) {
+			*changed = true;
+			dst[i] = newVal;
+		}
+		if (++i >= end) {
+			break;
+		}
+	}
+	return i;
+}
+
+static int FastLoad(u32 *dst, const u32_le *src, int end, u8 cmd, bool *changed) {
+	int count = ScanMatrixData(dst, src, end, cmd, changed);
+	if (*changed) {
+		LoadMatrixData(dst, src, count);
+	}
+	return count;
+}
+
+bool TestGPUCommands() {
+	// Build a list with each run twice, the second time often redundant, like games tend to do.
+	std::vector<u32_le> list;
+	std::vector<size_t> starts;
+	for (int pass = 0; pass < 2; ++pass) {
+		for (size_t r = 0; r < ARRAY_SIZE(runs); ++r) {
+			const MatrixRun &run = runs[r];
+			const size_t firstStart = pass == 0 ? 0 : starts[r];
+			starts.push_back(list.size());
+			for (int i = 0; i < run.size; ++i) {
+				u32 value;
+				if (pass == 0) {
+					value = (u32)rand();
+				} else {
+					// Every other run is the same as last time, the rest differ in a single float.
+					value = list[firstStart + i];
+					if ((r & 1) && i == run.size / 2)
+						value ^= 1;
+				}
+				list.push_back((run.cmd << 24) | (value & 0xFFFFFF));
+			}
+			list.push_back(GE_CMD_NOP << 24);
+		}
+	}
+	const int maxSizes[] = { 12, 12, 16, 12, 96, 12, 12, 96 };
+
+	std::vector<u32> expected(96 * ARRAY_SIZE(runs));
+	std::vector<u32> actual(expected.size());
+	std::vector<int> expectedCounts(starts.size());
+	std::vector<int> actualCounts(starts.size());
+	std::vector<bool> expectedChanged(starts.size());
+	std::vector<bool> actualChanged(starts.size());
+
+	int commands = 0;
+	double st = real_time_now();
+	for (int n = 0; n < BENCH_ITERATIONS; ++n) {
+		for (size_t r = 0; r < starts.size(); ++r) {
+			const size_t which = r % ARRAY_SIZE(runs);
+			bool changed;
+			expectedCounts[r] = ReferenceLoad(&expected[which * 96], &list[starts[r]], maxSizes[which], runs[which].cmd, &changed);
+			expectedChanged[r] = changed;
+			commands += expectedCounts[r];
+		}
+	}
+	double refTime = real_time_now() - st;
+
+	st = real_time_now();
+	for (int n = 0; n < BENCH_ITERATIONS; ++n) {
+		for (size_t r = 0; r < starts.size(); ++r) {
+			const size_t which = r % ARRAY_SIZE(runs);
+			bool changed;
+			actualCounts[r] = FastLoad(&actual[which * 96], &list[starts[r]], maxSizes[which], runs[which].cmd, &changed);
+			actualChanged[r] = changed;
+		}
+	}
+	double fastTime = real_time_now() - st;
+
+	const double mcommands = commands / 1000000.0;
+	printf("Matrix data: per command %0.1f Mcmd/s, batched %0.1f Mcmd/s\n", mcommands / refTime, mcommands / fastTime);
+
+	for (size_t r = 0; r < starts.size(); ++r) {
+		if (expectedCounts[r] != actualCounts[r] || expectedChanged[r] != actualChanged[r]) {
+			printf("Matrix data: run %d loaded %d (changed %d), expected %d (changed %d)\n", (int)r, actualCounts[r], (int)actualChanged[r], expectedCounts[r], (int)expectedChanged[r]);
+			return false;
+		}
+	}
+	for (size_t i = 0; i < expected.size(); ++i) {
+		if (expected[i] != actual[i]) {
+			printf("Matrix data: mismatch at %d\n", (int)i);
+			return false;
+		}
+	}
+	return true;
+}
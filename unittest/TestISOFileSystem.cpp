@@ -0,0 +1,591 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include "zlib.h"
+
+#include "base/timeutil.h"
+#include "Common/Swap.h"
+#include "Core/Host.h"
+#include "Core/Loaders.h"
+#include "Core/FileLoaders/LocalFileLoader.h"
+#include "Core/FileSystems/BlockDevices.h"
+#include "Core/FileSystems/ISOFileSystem.h"
+
+static u8 IsoContentAt(u64 pos) {
+	return (u8)((pos * 7) ^ (pos >> 11));
+}
+
+class MemoryBlockDevice : public BlockDevice {
+public:
+	MemoryBlockDevice(std::vector<u8> &&data) : data_(std::move(data)) {
+	}
+
+	bool ReadBlock(int blockNumber, u8 *outPtr, bool uncached = false) override {
+		if ((u32)blockNumber >= GetNumBlocks())
+			return false;
+		reads_++;
+		memcpy(outPtr, &data_[(size_t)blockNumber * 2048], 2048);
+		return true;
+	}
+	u32 GetNumBlocks() override {
+		return (u32)(data_.size() / 2048);
+	}
+
+	int reads_ = 0;
+
+private:
+	std::vector<u8> data_;
+};
+
+// Lays out a minimal ISO9660 image: the volume descriptor, then all the directories, then file data.
+class IsoBuilder {
+public:
+	IsoBuilder() {
+		dirs_.push_back(Dir(""));
+	}
+
+	int AddDirectory(int parent, const std::string &name) {
+		dirs_.push_back(Dir(name, parent));
+		dirs_[parent].subdirs.push_back((int)dirs_.size() - 1);
+		return (int)dirs_.size() - 1;
+	}
+
+	void AddFile(int dir, const std::string &name, u32 size) {
+		files_.push_back(File(name, size));
+		dirs_[dir].files.push_back((int)files_.size() - 1);
+	}
+
+	u32 FileSector(int dir, size_t i) const {
+		return files_[dirs_[dir].files[i]].sector;
+	}
+
+	std::vector<u8> Build() {
+		u32 sector = 18;
+		for (Dir &dir : dirs_) {
+			dir.size = (u32)((DirData(dir).size() + 2047) & ~2047);
+			dir.sector = sector;
+			sector += dir.size / 2048;
+		}
+		for (File &file : files_) {
+			file.sector = file.size == 0 ? 0 : sector;
+			sector += (file.size + 2047) / 2048;
+		}
+
+		std::vector<u8> image((size_t)sector * 2048);
+		u8 *pvd = &image[16 * 2048];
+		pvd[0] = 1;
+		memcpy(pvd + 1, "CD001", 5);
+		pvd[6] = 1;
+		std::vector<u8> root;
+		WriteRecord(root, std::string(1, '\0'), dirs_[0].sector, dirs_[0].size, true);
+		memcpy(pvd + 156, root.data(), root.size());
+		image[17 * 2048] = 255;
+
+		for (Dir &dir : dirs_) {
+			std::vector<u8> data = DirData(dir);
+			memcpy(&image[(size_t)dir.sector * 2048], data.data(), data.size());
+		}
+		for (const File &file : files_) {
+			for (u64 pos = (u64)file.sector * 2048; pos < (u64)file.sector * 2048 + file.size; ++pos)
+				image[(size_t)pos] = IsoContentAt(pos);
+		}
+		return image;
+	}
+
+private:
+	struct Dir {
+		Dir(const std::string &n, int p = 0) : name(n), parent(p) {
+		}
+
+		std::string name;
+		int parent;
+		std::vector<int> subdirs;
+		std::vector<int> files;
+		u32 sector = 0;
+		u32 size = 0;
+	};
+	struct File {
+		File(const std::string &n, u32 s) : name(n), size(s) {
+		}
+
+		std::string name;
+		u32 size;
+		u32 sector = 0;
+	};
+
+	static void WriteRecord(std::vector<u8> &out, const std::string &name, u32 sector, u32 size, bool isDir) {
+		u8 recordSize = (u8)(33 + name.size());
+		if (recordSize & 1)
+			recordSize++;
+		// Records don't cross sectors, the rest of the sector stays zero.
+		if ((out.size() & 2047) + recordSize > 2048)
+			out.resize((out.size() + 2047) & ~2047);
+
+		size_t offset = out.size();
+		out.resize(offset + recordSize);
+		u8 *r = &out[offset];
+		r[0] = recordSize;
+		for (int i = 0; i < 4; ++i) {
+			r[2 + i] = (u8)(sector >> (i * 8));
+			r[9 - i] = (u8)(sector >> (i * 8));
+			r[10 + i] = (u8)(size >> (i * 8));
+			r[17 - i] = (u8)(size >> (i * 8));
+		}
+		r[25] = isDir ? 2 : 0;
+		r[28] = 1;
+		r[31] = 1;
+		r[32] = (u8)name.size();
+		memcpy(r + 33, name.data(), name.size());
+	}
+
+	std::vector<u8> DirData(const Dir &dir) const {
+		std::vector<u8> out;
+		const Dir &parent = dirs_[dir.parent];
+		WriteRecord(out, std::string(1, '\0'), dir.sector, dir.size, true);
+		WriteRecord(out, std::string(1, '\1'), parent.sector, parent.size, true);
+		for (int sub : dir.subdirs)
+			WriteRecord(out, dirs_[sub].name, dirs_[sub].sector, dirs_[sub].size, true);
+		for (int file : dir.files)
+			WriteRecord(out, files_[file].name, files_[file].sector, files_[file].size, false);
+		return out;
+	}
+
+	std::vector<Dir> dirs_;
+	std::vector<File> files_;
+};
+
+static bool CheckFile(ISOFileSystem &iso, const std::string &path, bool exists, s64 size = 0) {
+	PSPFileInfo info = iso.GetFileInfo(path);
+	if (info.exists != exists || (exists && info.size != size)) {
+		printf("ISO file system: %s: exists=%d size=%lld, expected exists=%d size=%lld\n", path.c_str(), info.exists, (long long)info.size, exists, (long long)size);
+		return false;
+	}
+	return true;
+}
+
+static bool TestISOPathLookups() {
+	IsoBuilder builder;
+	const int game = builder.AddDirectory(0, "PSP_GAME");
+	const int sysdir = builder.AddDirectory(game, "SYSDIR");
+	const int usrdir = builder.AddDirectory(game, "USRDIR");
+	builder.AddFile(game, "PARAM.SFO", 100);
+	builder.AddFile(sysdir, "EBOOT.BIN", 5000);
+	builder.AddFile(sysdir, "BOOT.BIN", 0);
+	// Only the first of two entries with the same name can be found.
+	builder.AddFile(sysdir, "DUP.BIN", 10);
+	builder.AddFile(sysdir, "DUP.BIN", 20);
+
+	const int numDataDirs = 8, numDataFiles = 300;
+	std::vector<int> dataDirs;
+	for (int d = 0; d < numDataDirs; ++d) {
+		dataDirs.push_back(builder.AddDirectory(usrdir, "DATA" + std::to_string(d)));
+		for (int f = 0; f < numDataFiles; ++f)
+			builder.AddFile(dataDirs.back(), "FILE" + std::to_string(f) + ".DAT", 1 + f);
+	}
+
+	SequentialHandleAllocator handles;
+	ISOFileSystem iso(&handles, new MemoryBlockDevice(builder.Build()));
+
+	bool success = CheckFile(iso, "/PSP_GAME/SYSDIR/EBOOT.BIN", true, 5000);
+	success = CheckFile(iso, "./PSP_GAME/SYSDIR/EBOOT.BIN", true, 5000) && success;
+	success = CheckFile(iso, "PSP_GAME/PARAM.SFO", true, 100) && success;
+	success = CheckFile(iso, "/PSP_GAME/SYSDIR/", true, 2048) && success;
+	success = CheckFile(iso, "/PSP_GAME/SYSDIR/DUP.BIN", true, 10) && success;
+	// Lookups were always case sensitive, and stay that way.
+	success = CheckFile(iso, "/psp_game/sysdir/eboot.bin", false) && success;
+	success = CheckFile(iso, "/PSP_GAME//SYSDIR", false) && success;
+	success = CheckFile(iso, "/PSP_GAME/SYSDIR/EBOOT.BIN/X", false) && success;
+	success = CheckFile(iso, "/PSP_GAME/SYSDIR/EBOOT", false) && success;
+	success = CheckFile(iso, "/PSP_GAME/SYSDIR/EBOOT.BIN2", false) && success;
+
+	// The second time around, the paths are all in the index.
+	for (int pass = 0; pass < 2 && success; ++pass) {
+		for (int d = 0; d < numDataDirs && success; ++d) {
+			for (int f = 0; f < numDataFiles && success; ++f) {
+				const std::string path = "/PSP_GAME/USRDIR/DATA" + std::to_string(d) + "/FILE" + std::to_string(f) + ".DAT";
+				PSPFileInfo info = iso.GetFileInfo(path);
+				if (!info.exists || info.size != 1 + f || info.startSector != builder.FileSector(dataDirs[d], f)) {
+					printf("ISO file system: %s: wrong info in pass %d\n", path.c_str(), pass);
+					success = false;
+				}
+			}
+		}
+	}
+
+	if (iso.GetDirListing("/PSP_GAME/USRDIR/DATA3").size() != numDataFiles) {
+		printf("ISO file system: wrong number of files listed\n");
+		success = false;
+	}
+
+	u32 handle = iso.OpenFile("/PSP_GAME/SYSDIR/EBOOT.BIN", FILEACCESS_READ);
+	std::vector<u8> buf(6000);
+	size_t readSize = iso.ReadFile(handle, buf.data(), buf.size());
+	const u64 start = (u64)iso.GetFileInfo("/PSP_GAME/SYSDIR/EBOOT.BIN").startSector * 2048;
+	for (size_t i = 0; i < readSize; ++i) {
+		if (buf[i] != IsoContentAt(start + i)) {
+			printf("ISO file system: wrong data at %d\n", (int)i);
+			success = false;
+			break;
+		}
+	}
+	if (readSize != 5000) {
+		printf("ISO file system: read %d bytes, expected 5000\n", (int)readSize);
+		success = false;
+	}
+	iso.CloseFile(handle);
+	return success;
+}
+
+// Booting only needs a few directories, however many files the disc has.
+static bool TestISOManyFiles() {
+	const int numDirs = 100, filesPerDir = 1000;
+	IsoBuilder builder;
+	const int game = builder.AddDirectory(0, "PSP_GAME");
+	const int sysdir = builder.AddDirectory(game, "SYSDIR");
+	builder.AddFile(game, "PARAM.SFO", 100);
+	builder.AddFile(sysdir, "EBOOT.BIN", 64 * 1024);
+	const int usrdir = builder.AddDirectory(game, "USRDIR");
+	for (int d = 0; d < numDirs; ++d) {
+		const int dir = builder.AddDirectory(usrdir, "DIR" + std::to_string(d));
+		for (int f = 0; f < filesPerDir; ++f)
+			builder.AddFile(dir, "FILE" + std::to_string(f) + ".DAT", 0);
+	}
+	std::vector<u8> image = builder.Build();
+
+	double start = real_time_now();
+	SequentialHandleAllocator handles;
+	MemoryBlockDevice *device = new MemoryBlockDevice(std::move(image));
+	ISOFileSystem iso(&handles, device);
+	// What loading a game reads before it runs the first instruction.
+	bool success = CheckFile(iso, "/PSP_GAME/PARAM.SFO", true, 100);
+	u32 handle = iso.OpenFile("/PSP_GAME/SYSDIR/EBOOT.BIN", FILEACCESS_READ);
+	std::vector<u8> eboot(64 * 1024);
+	if (iso.ReadFile(handle, eboot.data(), eboot.size()) != eboot.size()) {
+		printf("ISO file system: couldn't read the EBOOT\n");
+		success = false;
+	}
+	iso.CloseFile(handle);
+	double booted = real_time_now();
+	// The volume descriptor, three directories, and the EBOOT.  None of the data directories.
+	if (device->reads_ > 4 + (int)eboot.size() / 2048) {
+		printf("ISO file system: booting read %d blocks\n", device->reads_);
+		success = false;
+	}
+
+	for (int d = 0; d < numDirs && success; ++d) {
+		const std::string dir = "/PSP_GAME/USRDIR/DIR" + std::to_string(d) + "/";
+		for (int f = 0; f < filesPerDir && success; ++f)
+			success = CheckFile(iso, dir + "FILE" + std::to_string(f) + ".DAT", true, 0);
+	}
+	double walked = real_time_now();
+
+	printf("ISO file system: %d files, %.3f ms to boot, %.1f ms to find them all\n", numDirs * filesPerDir,
+		(booted - start) * 1000.0, (walked - booted) * 1000.0);
+	return success;
+}
+
+// Holds a whole image file, for reading compressed images back.
+class MemoryFileLoader : public FileLoader {
+public:
+	MemoryFileLoader(std::vector<u8> &&data) : data_(std::move(data)) {
+	}
+
+	bool Exists() override {
+		return true;
+	}
+	bool IsDirectory() override {
+		return false;
+	}
+	s64 FileSize() override {
+		return (s64)data_.size();
+	}
+	std::string Path() const override {
+		return "memory.cso";
+	}
+	size_t ReadAt(s64 absolutePos, size_t bytes, size_t count, void *data, Flags flags = Flags::NONE) override {
+		reads_++;
+		if (absolutePos >= (s64)data_.size())
+			return 0;
+		size_t total = std::min(bytes * count, data_.size() - (size_t)absolutePos);
+		memcpy(data, &data_[(size_t)absolutePos], total);
+		return total / bytes;
+	}
+
+	std::atomic<int> reads_{ 0 };
+
+private:
+	std::vector<u8> data_;
+};
+
+// Some frames that won't compress, so they get stored plain.
+static std::vector<u8> MakeCompressibleImage(u32 numBlocks, u32 noiseEvery, u32 frameSize) {
+	std::vector<u8> image((size_t)numBlocks * 2048);
+	u32 noise = 1;
+	for (size_t i = 0; i < image.size(); ++i) {
+		if ((i / frameSize) % noiseEvery == noiseEvery - 1) {
+			noise = noise * 1103515245 + 12345;
+			image[i] = (u8)(noise >> 16);
+		} else {
+			image[i] = IsoContentAt(i);
+		}
+	}
+	return image;
+}
+
+// Like the common CSO tools write them: raw deflate frames after a 32-bit index.
+static std::vector<u8> BuildCSO(const std::vector<u8> &image, u32 frameSize) {
+	const u32 numFrames = (u32)((image.size() + frameSize - 1) / frameSize);
+	std::vector<u8> cso(0x18 + (numFrames + 1) * 4);
+	memcpy(&cso[0], "CISO", 4);
+	*(u32_le *)&cso[0x04] = 0x18;
+	*(u64_le *)&cso[0x08] = (u64)image.size();
+	*(u32_le *)&cso[0x10] = frameSize;
+	cso[0x14] = 1;
+
+	std::vector<u8> out(compressBound(frameSize));
+	for (u32 frame = 0; frame <= numFrames; ++frame) {
+		u32 pos = (u32)cso.size();
+		if (frame == numFrames) {
+			*(u32_le *)&cso[0x18 + frame * 4] = pos;
+			break;
+		}
+
+		z_stream z{};
+		deflateInit2(&z, 9, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+		z.next_in = (Bytef *)&image[(size_t)frame * frameSize];
+		z.avail_in = frameSize;
+		z.next_out = out.data();
+		z.avail_out = (uInt)out.size();
+		deflate(&z, Z_FINISH);
+		const size_t outSize = z.total_out;
+		deflateEnd(&z);
+
+		if (outSize >= frameSize) {
+			*(u32_le *)&cso[0x18 + frame * 4] = pos | 0x80000000;
+			cso.insert(cso.end(), image.begin() + (size_t)frame * frameSize, image.begin() + (size_t)(frame + 1) * frameSize);
+		} else {
+			*(u32_le *)&cso[0x18 + frame * 4] = pos;
+			cso.insert(cso.end(), out.begin(), out.begin() + outSize);
+		}
+	}
+	return cso;
+}
+
+static bool CheckBlocks(const std::vector<u8> &image, const u8 *data, u32 minBlock, u32 count, const char *what) {
+	if (memcmp(data, &image[(size_t)minBlock * 2048], (size_t)count * 2048) != 0) {
+		printf("%s: wrong data reading %d blocks at %d\n", what, count, minBlock);
+		return false;
+	}
+	return true;
+}
+
+// Sequential reads go through the read-ahead thread and the frame cache, the rest mostly don't.
+static bool TestCSOReads() {
+	const u32 frameSize = 0x2000, blocksPerFrame = frameSize / 2048;
+	const u32 numBlocks = 4096, numFrames = numBlocks / blocksPerFrame;
+	const std::vector<u8> image = MakeCompressibleImage(numBlocks, 7, frameSize);
+	MemoryFileLoader *loader = new MemoryFileLoader(BuildCSO(image, frameSize));
+	std::unique_ptr<FileLoader> loaderOwner(loader);
+	CISOFileBlockDevice device(loader);
+	if (device.GetNumBlocks() != numBlocks) {
+		printf("CSO: %d blocks, expected %d\n", device.GetNumBlocks(), numBlocks);
+		return false;
+	}
+
+	bool success = true;
+	std::vector<u8> buf(64 * 2048);
+
+	// A couple of frames in order, and a pause like a game would take, gives read-ahead time to work.
+	// After that, the frames just ahead should all come from the cache, apart from the plain ones.
+	success = device.ReadBlocks(0, 2 * blocksPerFrame, buf.data()) && CheckBlocks(image, buf.data(), 0, 2 * blocksPerFrame, "CSO");
+	success = success && device.ReadBlocks(2 * blocksPerFrame, blocksPerFrame, buf.data()) && CheckBlocks(image, buf.data(), 2 * blocksPerFrame, blocksPerFrame, "CSO");
+	sleep_ms(50);
+	const int readsBefore = loader->reads_;
+	int plainAhead = 0;
+	for (u32 b = 3 * blocksPerFrame; b < (3 + 32) * blocksPerFrame && success; ++b) {
+		success = device.ReadBlock(b, buf.data()) && CheckBlocks(image, buf.data(), b, 1, "CSO read-ahead");
+		if ((b / blocksPerFrame) % 7 == 6)
+			plainAhead++;
+	}
+	if (success && loader->reads_ - readsBefore != plainAhead) {
+		printf("CSO: %d file reads after read-ahead, expected %d\n", loader->reads_ - readsBefore, plainAhead);
+		success = false;
+	}
+	loader->reads_ = 0;
+
+	double st = real_time_now();
+	for (u32 b = 0; b < numBlocks && success; ++b) {
+		success = device.ReadBlock(b, buf.data()) && CheckBlocks(image, buf.data(), b, 1, "CSO sequential");
+	}
+	const double seqTime = real_time_now() - st;
+	// Each compressed frame should be read once, with its other blocks coming from the cache.
+	const int plainFrames = numFrames / 7;
+	const int seqReads = loader->reads_;
+	if (success && seqReads >= 2 * (int)numFrames + plainFrames * (int)blocksPerFrame) {
+		printf("CSO: sequential reads took %d file reads\n", seqReads);
+		success = false;
+	}
+
+	// Reads that start and end in the middle of frames, while read-ahead may still be going.
+	u32 seed = 1;
+	for (int i = 0; i < 500 && success; ++i) {
+		seed = seed * 1103515245 + 12345;
+		const u32 count = 1 + (seed >> 16) % 64;
+		seed = seed * 1103515245 + 12345;
+		const u32 minBlock = (seed >> 8) % (numBlocks - count);
+		success = device.ReadBlocks(minBlock, count, buf.data()) && CheckBlocks(image, buf.data(), minBlock, count, "CSO ReadBlocks");
+		if (success && (i & 3) == 0) {
+			// And a repeated single block, which may come from the cache.
+			success = device.ReadBlock(minBlock, buf.data()) && CheckBlocks(image, buf.data(), minBlock, 1, "CSO repeated ReadBlock");
+		}
+	}
+
+	// Uncached reads skip the cache, and should still agree with it.
+	for (u32 b = 0; b < numBlocks && success; b += 13) {
+		success = device.ReadBlock(b, buf.data(), true) && CheckBlocks(image, buf.data(), b, 1, "CSO uncached");
+	}
+
+	printf("CSO: %d blocks read in order in %0.1f ms with %d file reads\n", numBlocks, seqTime * 1000.0, seqReads);
+	return success;
+}
+
+// Writes the image out with every codec, and reads it all back through the reader.
+static bool TestZCSORoundTrip() {
+	const u32 frameSize = 0x4000;
+	const u32 numBlocks = 1000;
+	const std::vector<u8> image = MakeCompressibleImage(numBlocks, 5, frameSize);
+	std::vector<u8> sourceData = image;
+	MemoryBlockDevice source(std::move(sourceData));
+	const std::string filename = "zcso_roundtrip_test.zcso";
+
+	struct Variant {
+		ZCSOCodec codec;
+		bool useDictionary;
+		const char *name;
+	};
+	static const Variant variants[] = {
+		{ ZCSOCodec::DEFLATE, false, "deflate" },
+		{ ZCSOCodec::DEFLATE, true, "deflate with dictionary" },
+		{ ZCSOCodec::SNAPPY, false, "snappy" },
+	};
+
+	bool success = true;
+	std::vector<u8> buf(64 * 2048);
+	for (const Variant &variant : variants) {
+		std::string error;
+		if (!CompressBlockDevice(&source, filename, variant.codec, frameSize, variant.useDictionary, &error)) {
+			printf("ZCSO %s: %s\n", variant.name, error.c_str());
+			success = false;
+			break;
+		}
+
+		LocalFileLoader loader(filename);
+		if (loader.FileSize() >= (s64)image.size()) {
+			printf("ZCSO %s: %lld bytes, didn't compress\n", variant.name, (long long)loader.FileSize());
+			success = false;
+		}
+		{
+			CISOFileBlockDevice device(&loader);
+			if (device.GetNumBlocks() != numBlocks) {
+				printf("ZCSO %s: %d blocks, expected %d\n", variant.name, device.GetNumBlocks(), numBlocks);
+				success = false;
+			}
+			// The last read runs past the end of the final frame, which is only partly used.
+			for (u32 b = 0; b < numBlocks && success; b += 64) {
+				const u32 count = std::min(64U, numBlocks - b);
+				success = device.ReadBlocks(b, count, buf.data()) && CheckBlocks(image, buf.data(), b, count, "ZCSO");
+			}
+			for (u32 b = 3; b < numBlocks && success; b += 17) {
+				success = device.ReadBlock(b, buf.data()) && CheckBlocks(image, buf.data(), b, 1, "ZCSO ReadBlock");
+			}
+		}
+		if (!success)
+			break;
+	}
+	remove(filename.c_str());
+	return success;
+}
+
+// Catches the read errors block devices report to the user.
+class ReadErrorHost : public Host {
+public:
+	bool InitGraphics(std::string *error_string, GraphicsContext **ctx) override {
+		return false;
+	}
+	void ShutdownGraphics() override {}
+	void InitSound() override {}
+	void ShutdownSound() override {}
+	void NotifyUserMessage(const std::string &message, float duration, u32 color, const char *id) override {
+		messages_++;
+	}
+
+	int messages_ = 0;
+};
+
+// Headers that would have us allocate or shift by nonsense should just fail to load.
+static bool TestCSOBadHeaders() {
+	const u32 frameSize = 0x2000;
+	const std::vector<u8> image = MakeCompressibleImage(64, 7, frameSize);
+	const std::vector<u8> cso = BuildCSO(image, frameSize);
+
+	ReadErrorHost errorHost;
+	Host *oldHost = host;
+	host = &errorHost;
+
+	bool success = true;
+	for (int which = 0; which < 3; ++which) {
+		std::vector<u8> bad = cso;
+		if (which == 0)
+			bad[0x15] = 40;
+		else if (which == 1)
+			bad[0x15] = 31;
+		else
+			*(u32_le *)&bad[0x10] = 0x80000000;
+
+		std::unique_ptr<FileLoader> loader(new MemoryFileLoader(std::move(bad)));
+		CISOFileBlockDevice device(loader.get());
+		if (device.GetNumBlocks() != 0) {
+			printf("CSO: bad header %d loaded with %d blocks\n", which, device.GetNumBlocks());
+			success = false;
+		}
+	}
+	if (errorHost.messages_ != 3) {
+		printf("CSO: %d read errors reported for 3 bad headers\n", errorHost.messages_);
+		success = false;
+	}
+	host = oldHost;
+	return success;
+}
+
+bool TestISOFileSystem() {
+	if (!TestISOPathLookups())
+		return false;
+	if (!TestCSOReads())
+		return false;
+	if (!TestZCSORoundTrip())
+		return false;
+	if (!TestCSOBadHeaders())
+		return false;
+	return TestISOManyFiles();
+}
@@ -0,0 +1,342 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "base/timeutil.h"
+#include "GPU/Common/IndexGenerator.h"
+
+static const int MAX_PRIM_VERTS = 300;
+static const int PRIMS_PER_DRAW = 8;
+static const int NUM_DRAWS = 2000;
+static const int BENCH_ITERATIONS = 200;
+
+// One index at a time, the way IndexGenerator has always done it.  Returns how many were written.
+static int ReferenceAddPrim(u16 *out, int start, int prim, int numVerts, bool clockwise) {
+	u16 *outInds = out;
+	const int v1 = clockwise ? 1 : 2;
+	const int v2 = clockwise ? 2 : 1;
+	switch (prim) {
+	case GE_PRIM_POINTS:
+		for (int i = 0; i < numVerts; i++)
+			*outInds++ = start + i;
+		break;
+	case GE_PRIM_LINES:
+		for (int i = 0; i < numVerts; i += 2) {
+			*outInds++ = start + i;
+			*outInds++ = start + i + 1;
+		}
+		break;
+	case GE_PRIM_LINE_STRIP:
+		for (int i = 0; i < numVerts - 1; i++) {
+			*outInds++ = start + i;
+			*outInds++ = start + i + 1;
+		}
+		break;
+	case GE_PRIM_TRIANGLES:
+		for (int i = 0; i < numVerts; i += 3) {
+			*outInds++ = start + i;
+			*outInds++ = start + i + v1;
+			*outInds++ = start + i + v2;
+		}
+		break;
+	case GE_PRIM_TRIANGLE_STRIP:
+	{
+		int wind = v1;
+		for (int i = 0; i < numVerts - 2; i++) {
+			*outInds++ = start + i;
+			*outInds++ = start + i + wind;
+			wind ^= 3;
+			*outInds++ = start + i + wind;
+		}
+		break;
+	}
+	case GE_PRIM_TRIANGLE_FAN:
+		for (int i = 0; i < numVerts - 2; i++) {
+			*outInds++ = start;
+			*outInds++ = start + i + v1;
+			*outInds++ = start + i + v2;
+		}
+		break;
+	case GE_PRIM_RECTANGLES:
+		for (int i = 0; i < (numVerts & ~1); i++)
+			*outInds++ = start + i;
+		break;
+	}
+	return (int)(outInds - out);
+}
+
+// What VertexCount() should add up to, which isn't always what was written for short prims.
+static int ReferenceCount(int prim, int count, bool indexed) {
+	switch (prim) {
+	case GE_PRIM_POINTS: return count;
+	case GE_PRIM_LINES: return indexed ? count & ~1 : count;
+	case GE_PRIM_LINE_STRIP: return (count - 1) * 2;
+	case GE_PRIM_TRIANGLES: return indexed ? (count / 3) * 3 : count;
+	case GE_PRIM_TRIANGLE_STRIP: return !indexed && count <= 2 ? 0 : (count - 2) * 3;
+	case GE_PRIM_TRIANGLE_FAN: return indexed && count <= 0 ? 0 : (count - 2) * 3;
+	case GE_PRIM_RECTANGLES: return count & ~1;
+	}
+	return 0;
+}
+
+template <class ITypeLE>
+static int ReferenceTranslatePrim(u16 *out, int offset, int prim, int numInds, const ITypeLE *inds, bool clockwise) {
+	u16 *outInds = out;
+	const int v1 = clockwise ? 1 : 2;
+	const int v2 = clockwise ? 2 : 1;
+	switch (prim) {
+	case GE_PRIM_POINTS:
+		for (int i = 0; i < numInds; i++)
+			*outInds++ = offset + inds[i];
+		break;
+	case GE_PRIM_LINES:
+	case GE_PRIM_RECTANGLES:
+		for (int i = 0; i < (numInds & ~1); i++)
+			*outInds++ = offset + inds[i];
+		break;
+	case GE_PRIM_LINE_STRIP:
+		for (int i = 0; i < numInds - 1; i++) {
+			*outInds++ = offset + inds[i];
+			*outInds++ = offset + inds[i + 1];
+		}
+		break;
+	case GE_PRIM_TRIANGLES:
+		if (sizeof(ITypeLE) == sizeof(u16) && (u16)offset == 0 && clockwise) {
+			// This one is just copied, partial triangle and all.
+			for (int i = 0; i < numInds; i++)
+				*outInds++ = inds[i];
+			break;
+		}
+		for (int i = 0; i < (numInds / 3) * 3; i += 3) {
+			*outInds++ = offset + inds[i];
+			*outInds++ = offset + inds[i + v1];
+			*outInds++ = offset + inds[i + v2];
+		}
+		break;
+	case GE_PRIM_TRIANGLE_STRIP:
+	{
+		int wind = v1;
+		for (int i = 0; i < numInds - 2; i++) {
+			*outInds++ = offset + inds[i];
+			*outInds++ = offset + inds[i + wind];
+			wind ^= 3;
+			*outInds++ = offset + inds[i + wind];
+		}
+		break;
+	}
+	case GE_PRIM_TRIANGLE_FAN:
+		for (int i = 0; i < numInds - 2; i++) {
+			*outInds++ = offset + inds[0];
+			*outInds++ = offset + inds[i + v1];
+			*outInds++ = offset + inds[i + v2];
+		}
+		break;
+	}
+	return (int)(outInds - out);
+}
+
+struct TestPrim {
+	int prim;
+	int count;
+	bool clockwise;
+	// Only used when translating.
+	int lowerBound;
+	std::vector<u32> inds;
+};
+
+typedef std::vector<TestPrim> TestDraw;
+
+static std::vector<TestDraw> RandomDraws(bool indexed) {
+	std::vector<TestDraw> draws(NUM_DRAWS);
+	for (TestDraw &draw : draws) {
+		draw.resize(1 + rand() % PRIMS_PER_DRAW);
+		for (TestPrim &p : draw) {
+			p.prim = rand() % 7;
+			// Mostly the small counts, where the vector loops and the tail meet.
+			p.count = (rand() & 1) ? rand() % 32 : rand() % MAX_PRIM_VERTS;
+			p.clockwise = (rand() & 3) != 0;
+			p.lowerBound = indexed ? rand() % 100 : 0;
+			if (indexed) {
+				p.inds.resize(p.count);
+				for (u32 &ind : p.inds) {
+					ind = p.lowerBound + rand() % 200;
+				}
+			}
+		}
+	}
+	return draws;
+}
+
+template <class ITypeLE>
+static std::vector<ITypeLE> IndexData(const TestPrim &p) {
+	return std::vector<ITypeLE>(p.inds.begin(), p.inds.end());
+}
+
+static bool CompareOutput(const char *name, int draw, const std::vector<u16> &expected, const std::vector<u16> &actual, int expectedCount, int actualCount) {
+	if (expectedCount != actualCount) {
+		printf("%s: draw %d has %d indices, expected %d\n", name, draw, actualCount, expectedCount);
+		return false;
+	}
+	for (size_t i = 0; i < expected.size(); ++i) {
+		if (expected[i] != actual[i]) {
+			printf("%s: draw %d mismatch at index %d: %04x, expected %04x\n", name, draw, (int)i, actual[i], expected[i]);
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool TestAddPrims() {
+	const std::vector<TestDraw> draws = RandomDraws(false);
+	const size_t bufSize = PRIMS_PER_DRAW * MAX_PRIM_VERTS * 3 + 16;
+	std::vector<u16> expected(bufSize);
+	std::vector<u16> actual(bufSize);
+
+	IndexGenerator gen;
+	for (size_t d = 0; d < draws.size(); ++d) {
+		// A random fill catches writes past the end.
+		const u16 fill = (u16)rand();
+		std::fill(expected.begin(), expected.end(), fill);
+		std::fill(actual.begin(), actual.end(), fill);
+
+		// Start near the top sometimes, indices wrap at 16 bits.
+		const int start = (d & 1) ? 0xFFFF - rand() % 256 : rand() % 256;
+		gen.Setup(actual.data());
+		gen.SetIndex(start);
+		int index = start;
+		int written = 0;
+		int vertexCount = 0;
+		for (const TestPrim &p : draws[d]) {
+			gen.AddPrim(p.prim, p.count, p.clockwise);
+			const int n = ReferenceAddPrim(expected.data() + written, index, p.prim, p.count, p.clockwise);
+			written += n;
+			vertexCount += ReferenceCount(p.prim, p.count, false);
+			index += p.prim == GE_PRIM_RECTANGLES ? p.count & ~1 : p.count;
+		}
+		if (!CompareOutput("AddPrim", (int)d, expected, actual, vertexCount, gen.VertexCount()))
+			return false;
+	}
+
+	// Every draw calls this at every flush, so count indices written per second.
+	double st = real_time_now();
+	int total = 0;
+	for (int i = 0; i < BENCH_ITERATIONS; ++i) {
+		for (const TestDraw &draw : draws) {
+			int index = 0;
+			for (const TestPrim &p : draw) {
+				total += ReferenceAddPrim(expected.data(), index, p.prim, p.count, p.clockwise);
+				index += p.count;
+			}
+		}
+	}
+	double refTime = real_time_now() - st;
+
+	st = real_time_now();
+	for (int i = 0; i < BENCH_ITERATIONS; ++i) {
+		for (const TestDraw &draw : draws) {
+			gen.Setup(actual.data());
+			for (const TestPrim &p : draw) {
+				gen.AddPrim(p.prim, p.count, p.clockwise);
+			}
+		}
+	}
+	double fastTime = real_time_now() - st;
+
+	const double minds = total / 1000000.0;
+	printf("AddPrim: reference %0.1f Mind/s, fast %0.1f Mind/s\n", minds / refTime, minds / fastTime);
+	return true;
+}
+
+template <class ITypeLE>
+static bool TestTranslatePrims(const char *name) {
+	const std::vector<TestDraw> draws = RandomDraws(true);
+	const size_t bufSize = PRIMS_PER_DRAW * MAX_PRIM_VERTS * 3 + 16;
+	std::vector<u16> expected(bufSize);
+	std::vector<u16> actual(bufSize);
+
+	std::vector<std::vector<std::vector<ITypeLE>>> data(draws.size());
+	for (size_t d = 0; d < draws.size(); ++d) {
+		for (const TestPrim &p : draws[d]) {
+			data[d].push_back(IndexData<ITypeLE>(p));
+		}
+	}
+
+	IndexGenerator gen;
+	for (size_t d = 0; d < draws.size(); ++d) {
+		const u16 fill = (u16)rand();
+		std::fill(expected.begin(), expected.end(), fill);
+		std::fill(actual.begin(), actual.end(), fill);
+
+		const int start = (d & 1) ? 0xFFFF - rand() % 256 : rand() % 256;
+		gen.Setup(actual.data());
+		gen.SetIndex(start);
+		int index = start;
+		int written = 0;
+		int vertexCount = 0;
+		for (size_t i = 0; i < draws[d].size(); ++i) {
+			const TestPrim &p = draws[d][i];
+			gen.TranslatePrim(p.prim, p.count, data[d][i].data(), p.lowerBound, p.clockwise);
+			gen.Advance(200);
+			written += ReferenceTranslatePrim(expected.data() + written, index - p.lowerBound, p.prim, p.count, data[d][i].data(), p.clockwise);
+			vertexCount += ReferenceCount(p.prim, p.count, true);
+			index += 200;
+		}
+		if (!CompareOutput(name, (int)d, expected, actual, vertexCount, gen.VertexCount()))
+			return false;
+	}
+
+	double st = real_time_now();
+	int total = 0;
+	for (int i = 0; i < BENCH_ITERATIONS; ++i) {
+		for (size_t d = 0; d < draws.size(); ++d) {
+			int index = 0;
+			for (size_t j = 0; j < draws[d].size(); ++j) {
+				const TestPrim &p = draws[d][j];
+				total += ReferenceTranslatePrim(expected.data(), index - p.lowerBound, p.prim, p.count, data[d][j].data(), p.clockwise);
+				index += 200;
+			}
+		}
+	}
+	double refTime = real_time_now() - st;
+
+	st = real_time_now();
+	for (int i = 0; i < BENCH_ITERATIONS; ++i) {
+		for (size_t d = 0; d < draws.size(); ++d) {
+			gen.Setup(actual.data());
+			for (size_t j = 0; j < draws[d].size(); ++j) {
+				const TestPrim &p = draws[d][j];
+				gen.TranslatePrim(p.prim, p.count, data[d][j].data(), p.lowerBound, p.clockwise);
+				gen.Advance(200);
+			}
+		}
+	}
+	double fastTime = real_time_now() - st;
+
+	const double minds = total / 1000000.0;
+	printf("%s: reference %0.1f Mind/s, fast %0.1f Mind/s\n", name, minds / refTime, minds / fastTime);
+	return true;
+}
+
+bool TestIndexGenerator() {
+	return TestAddPrims() &&
+		TestTranslatePrims<u8>("TranslatePrim u8") &&
+		TestTranslatePrims<u16_le>("TranslatePrim u16") &&
+		TestTranslatePrims<u32_le>("TranslatePrim u32");
+}
@@ -0,0 +1,125 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "thin3d/thin3d.h"
+#include "GPU/GPUState.h"
+#include "GPU/Common/ShaderId.h"
+
+static const int NUM_STATES = 500;
+
+static u32 RandomBits() {
+	return ((rand() & 0xFFF) << 12) | (rand() & 0xFFF);
+}
+
+static void RandomizeState() {
+	for (int cmd = 0; cmd < 256; ++cmd) {
+		gstate.cmdmem[cmd] = (cmd << 24) | RandomBits();
+	}
+	gstate.tgenMatrix[11] = (rand() & 1) ? 1.0f : 0.5f;
+	gstate_c.textureFullAlpha = (rand() & 1) != 0;
+	gstate_c.vertexFullAlpha = (rand() & 1) != 0;
+	gstate_c.allowShaderBlend = (rand() & 1) != 0;
+	gstate_c.bgraTexture = (rand() & 1) != 0;
+	gstate_c.needShaderTexClamp = (rand() & 1) != 0;
+}
+
+static bool TestShaderIDHistory() {
+	Draw::Bugs bugs;
+	ShaderIDHistory history;
+	for (int n = 0; n < 64; ++n) {
+		RandomizeState();
+		VShaderID vsid;
+		FShaderID fsid;
+		ComputeVertexShaderID(&vsid, gstate.vertType, (gstate.vertType & GE_VTYPE_THROUGH_MASK) == 0);
+		ComputeFragmentShaderID(&fsid, bugs);
+		history.Add(vsid);
+		history.Add(fsid);
+		// Shaders get created again after a device loss, that shouldn't grow the history.
+		history.Add(vsid);
+	}
+
+	FILE *f = tmpfile();
+	if (!f || !history.Save(f) || history.IsDirty()) {
+		printf("Shader ID history: failed to save\n");
+		return false;
+	}
+
+	rewind(f);
+	ShaderIDHistory loaded;
+	if (!loaded.Load(f) || loaded.VertexShaders() != history.VertexShaders() || loaded.FragmentShaders() != history.FragmentShaders()) {
+		printf("Shader ID history: loaded %d/%d shaders, expected %d/%d\n", (int)loaded.VertexShaders().size(), (int)loaded.FragmentShaders().size(),
+			(int)history.VertexShaders().size(), (int)history.FragmentShaders().size());
+		fclose(f);
+		return false;
+	}
+
+	// IDs from a GPU with other features can't be trusted.
+	rewind(f);
+	gstate_c.featureFlags ^= GPU_SUPPORTS_DUALSOURCE_BLEND;
+	bool loadedOther = loaded.Load(f);
+	gstate_c.featureFlags ^= GPU_SUPPORTS_DUALSOURCE_BLEND;
+	fclose(f);
+	if (loadedOther || !loaded.VertexShaders().empty()) {
+		printf("Shader ID history: loaded with different GPU features\n");
+		return false;
+	}
+	return true;
+}
+
+// Writes that don't change any bits in the dependency masks skip dirtying the shaders, so every bit
+// that the IDs are computed from has to be in the masks.
+bool TestShaderId() {
+	Draw::Bugs bugs;
+	for (int n = 0; n < NUM_STATES; ++n) {
+		RandomizeState();
+		const u32 vertType = gstate.vertType;
+		const bool useHWTransform = (vertType & GE_VTYPE_THROUGH_MASK) == 0;
+
+		VShaderID expectedVS;
+		FShaderID expectedFS;
+		ComputeVertexShaderID(&expectedVS, vertType, useHWTransform);
+		ComputeFragmentShaderID(&expectedFS, bugs);
+
+		for (int cmd = 0; cmd < 256; ++cmd) {
+			const u32 orig = gstate.cmdmem[cmd];
+
+			gstate.cmdmem[cmd] = orig ^ (~VertexShaderIDDependencyMask(cmd) & RandomBits());
+			VShaderID vsid;
+			ComputeVertexShaderID(&vsid, vertType, useHWTransform);
+			if (vsid != expectedVS) {
+				printf("Shader ID: %02x %06x -> %06x changed the vertex shader: %s, expected %s\n", cmd, orig & 0xFFFFFF, gstate.cmdmem[cmd] & 0xFFFFFF,
+					VertexShaderDesc(vsid).c_str(), VertexShaderDesc(expectedVS).c_str());
+				return false;
+			}
+
+			gstate.cmdmem[cmd] = orig ^ (~FragmentShaderIDDependencyMask(cmd) & RandomBits());
+			FShaderID fsid;
+			ComputeFragmentShaderID(&fsid, bugs);
+			if (fsid != expectedFS) {
+				printf("Shader ID: %02x %06x -> %06x changed the fragment shader: %s, expected %s\n", cmd, orig & 0xFFFFFF, gstate.cmdmem[cmd] & 0xFFFFFF,
+					FragmentShaderDesc(fsid).c_str(), FragmentShaderDesc(expectedFS).c_str());
+				return false;
+			}
+
+			gstate.cmdmem[cmd] = orig;
+		}
+	}
+	return TestShaderIDHistory();
+}
@@ -0,0 +1,237 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "ppsspp_config.h"
+#include "base/timeutil.h"
+#include "Common/CPUDetect.h"
+#include "GPU/GPUState.h"
+#include "GPU/Common/TextureDecoder.h"
+
+static const int TEX_W = 256;
+static const int TEX_H = 256;
+static const int BENCH_ITERATIONS = 200;
+
+// The straightforward way: unswizzle to a temp buffer, then look up one pixel at a time.
+template <typename ClutT>
+static void ReferenceDeIndex(ClutT *out, const u8 *texptr, int bitsPerIndex, bool swizzled, const ClutT *clut) {
+	const int rowBytes = TEX_W * bitsPerIndex / 8;
+	std::vector<u32> unswizzled(rowBytes * TEX_H / 4);
+	if (swizzled) {
+		DoUnswizzleTex16(texptr, unswizzled.data(), rowBytes / 16, TEX_H / 8, rowBytes);
+		texptr = (const u8 *)unswizzled.data();
+	}
+
+	for (int y = 0; y < TEX_H; ++y) {
+		const u8 *row = texptr + rowBytes * y;
+		for (int x = 0; x < TEX_W; ++x) {
+			u32 index;
+			switch (bitsPerIndex) {
+			case 4: index = (row[x / 2] >> ((x & 1) * 4)) & 0xF; break;
+			case 8: index = row[x]; break;
+			case 16: index = ((const u16_le *)row)[x] & 0xFF; break;
+			default: index = ((const u32_le *)row)[x] & 0xFF; break;
+			}
+			out[y * TEX_W + x] = clut[index];
+		}
+	}
+}
+
+template <typename ClutT>
+static void FastDeIndex(ClutT *out, const u8 *texptr, int bitsPerIndex, bool swizzled, const ClutT *clut) {
+	DeIndexTextureLevel<ClutT>((u8 *)out, TEX_W * sizeof(ClutT), texptr, TEX_W, TEX_W, TEX_H, bitsPerIndex, swizzled, [=](ClutT *dest, const u8 *src, int length) {
+		switch (bitsPerIndex) {
+		case 4: DeIndexTexture4(dest, src, length, clut); break;
+		case 8: DeIndexTexture(dest, src, length, clut); break;
+		case 16: DeIndexTexture(dest, (const u16_le *)src, length, clut); break;
+		default: DeIndexTexture(dest, (const u32_le *)src, length, clut); break;
+		}
+	});
+}
+
+template <typename ClutT>
+static bool TestDeIndexFormat(const char *name, int bitsPerIndex, bool swizzled) {
+	std::vector<u8> texture(TEX_W * TEX_H * bitsPerIndex / 8);
+	for (size_t i = 0; i < texture.size(); ++i) {
+		texture[i] = (u8)rand();
+	}
+	ClutT clut[256];
+	for (int i = 0; i < 256; ++i) {
+		clut[i] = (ClutT)(rand() * 0x10001);
+	}
+
+	std::vector<ClutT> expected(TEX_W * TEX_H);
+	std::vector<ClutT> actual(TEX_W * TEX_H);
+
+	double st = real_time_now();
+	for (int i = 0; i < BENCH_ITERATIONS; ++i) {
+		ReferenceDeIndex(expected.data(), texture.data(), bitsPerIndex, swizzled, clut);
+	}
+	double refTime = real_time_now() - st;
+
+	st = real_time_now();
+	for (int i = 0; i < BENCH_ITERATIONS; ++i) {
+		FastDeIndex(actual.data(), texture.data(), bitsPerIndex, swizzled, clut);
+	}
+	double fastTime = real_time_now() - st;
+
+	const double mpixels = (double)TEX_W * TEX_H * BENCH_ITERATIONS / 1000000.0;
+	printf("%s %s clut%d: reference %0.1f Mpx/s, fast %0.1f Mpx/s\n", name, swizzled ? "swizzled" : "linear", (int)sizeof(ClutT) * 8, mpixels / refTime, mpixels / fastTime);
+
+	for (size_t i = 0; i < expected.size(); ++i) {
+		if (expected[i] != actual[i]) {
+			printf("%s: mismatch at pixel %d,%d\n", name, (int)(i % TEX_W), (int)(i / TEX_W));
+			return false;
+		}
+	}
+	return true;
+}
+
+template <typename BlockT, typename BlockFunc, typename LevelFunc>
+static bool TestDXTFormat(const char *name, BlockFunc decodeBlock, LevelFunc decodeLevel) {
+	std::vector<BlockT> blocks((TEX_W / 4) * (TEX_H / 4));
+	u8 *raw = (u8 *)blocks.data();
+	for (size_t i = 0; i < blocks.size() * sizeof(BlockT); ++i) {
+		raw[i] = (u8)rand();
+	}
+
+	std::vector<u32> expected(TEX_W * TEX_H);
+	std::vector<u32> actual(TEX_W * TEX_H);
+
+	double st = real_time_now();
+	for (int i = 0; i < BENCH_ITERATIONS; ++i) {
+		for (int y = 0; y < TEX_H; y += 4) {
+			for (int x = 0; x < TEX_W; x += 4) {
+				decodeBlock(&expected[y * TEX_W + x], &blocks[(y / 4) * (TEX_W / 4) + x / 4]);
+			}
+		}
+	}
+	double refTime = real_time_now() - st;
+
+	st = real_time_now();
+	for (int i = 0; i < BENCH_ITERATIONS; ++i) {
+		decodeLevel(actual.data(), blocks.data());
+	}
+	double fastTime = real_time_now() - st;
+
+	const double mpixels = (double)TEX_W * TEX_H * BENCH_ITERATIONS / 1000000.0;
+	printf("%s: per block %0.1f Mpx/s, per level %0.1f Mpx/s\n", name, mpixels / refTime, mpixels / fastTime);
+
+	for (size_t i = 0; i < expected.size(); ++i) {
+		if (expected[i] != actual[i]) {
+			printf("%s: mismatch at pixel %d,%d\n", name, (int)(i % TEX_W), (int)(i / TEX_W));
+			return false;
+		}
+	}
+	return true;
+}
+
+#if PPSSPP_ARCH(ARMV7) || PPSSPP_ARCH(ARM64)
+// The level decoders only take this path with NEON, so check it directly against the plain block decoder.
+static bool TestDXTColorsNEON() {
+	if (!cpu_info.bNEON) {
+		return true;
+	}
+
+	for (int i = 0; i < 1000; ++i) {
+		DXT1Block block;
+		u8 *raw = (u8 *)&block;
+		for (size_t j = 0; j < sizeof(block); ++j) {
+			raw[j] = (u8)rand();
+		}
+		u32 alphaRows[16];
+		for (int j = 0; j < 16; ++j) {
+			alphaRows[j] = (u32)rand() << 24;
+		}
+
+		// A line of indices 0, 1, 2, 3 gives the four palette colors in order.
+		DXT1Block paletteBlock = block;
+		for (int j = 0; j < 4; ++j) {
+			paletteBlock.lines[j] = 0xE4;
+		}
+		u32 palette[16];
+		DecodeDXT1Block(palette, &paletteBlock, 4, 4, true);
+
+		u32 expected[16];
+		u32 actual[16];
+		DecodeDXT1Block(expected, &block, 4, 4, true);
+		WriteDXTColorsNEON(actual, palette, block.lines, nullptr, 4, 4);
+		for (int j = 0; j < 16; ++j) {
+			if (expected[j] != actual[j]) {
+				printf("DXT NEON: mismatch at pixel %d,%d of block %d\n", j % 4, j / 4, i);
+				return false;
+			}
+		}
+
+		WriteDXTColorsNEON(actual, palette, block.lines, alphaRows, 4, 4);
+		for (int j = 0; j < 16; ++j) {
+			if ((expected[j] | alphaRows[j]) != actual[j]) {
+				printf("DXT NEON: alpha mismatch at pixel %d,%d of block %d\n", j % 4, j / 4, i);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+#endif
+
+bool TestTextureDecoder() {
+	// The fast paths only apply with a simple clut index.
+	gstate.clutformat = 0xC500FF00;
+
+	static const struct {
+		const char *name;
+		int bitsPerIndex;
+	} formats[] = {
+		{ "CLUT4", 4 },
+		{ "CLUT8", 8 },
+		{ "CLUT16", 16 },
+		{ "CLUT32", 32 },
+	};
+
+	// The direct color formats are plain copies, so only the indexed and DXT formats are covered.
+	bool success = true;
+	for (const auto &format : formats) {
+		for (int swizzled = 0; swizzled < 2; ++swizzled) {
+			success = TestDeIndexFormat<u16>(format.name, format.bitsPerIndex, swizzled != 0) && success;
+			success = TestDeIndexFormat<u32>(format.name, format.bitsPerIndex, swizzled != 0) && success;
+		}
+	}
+
+#if PPSSPP_ARCH(ARMV7) || PPSSPP_ARCH(ARM64)
+	success = TestDXTColorsNEON() && success;
+#endif
+	success = TestDXTFormat<DXT1Block>("DXT1", [](u32 *dst, const DXT1Block *src) {
+		DecodeDXT1Block(dst, src, TEX_W, 4, false);
+	}, [](u32 *dst, const DXT1Block *src) {
+		DecodeDXT1Level(dst, TEX_W, src, TEX_W, TEX_W, TEX_H, false);
+	}) && success;
+	success = TestDXTFormat<DXT3Block>("DXT3", [](u32 *dst, const DXT3Block *src) {
+		DecodeDXT3Block(dst, src, TEX_W, 4);
+	}, [](u32 *dst, const DXT3Block *src) {
+		DecodeDXT3Level(dst, TEX_W, src, TEX_W, TEX_W, TEX_H);
+	}) && success;
+	success = TestDXTFormat<DXT5Block>("DXT5", [](u32 *dst, const DXT5Block *src) {
+		DecodeDXT5Block(dst, src, TEX_W, 4);
+	}, [](u32 *dst, const DXT5Block *src) {
+		DecodeDXT5Level(dst, TEX_W, src, TEX_W, TEX_W, TEX_H);
+	}) && success;
+	return success;
+}
@@ -0,0 +1,259 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include "ppsspp_config.h"
+
+#ifdef USING_QT_UI
+#include <QtGui/QImage>
+#else
+#include <libpng17/png.h>
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "Common/FileUtil.h"
+#include "Core/TextureReplacementPack.h"
+
+static const char *const PACK_DIR = "replacement_pack_test/";
+static const char *const PACK_FILE = "replacement_pack_test.pprp";
+static const char *const BROKEN_PACK_FILE = "replacement_pack_broken.pprp";
+
+static std::vector<u8> MakePixels(int w, int h, int seed, bool opaque) {
+	std::vector<u8> pixels(w * h * 4);
+	for (int y = 0; y < h; ++y) {
+		for (int x = 0; x < w; ++x) {
+			u8 *p = &pixels[(y * w + x) * 4];
+			p[0] = (u8)(x * 8 + seed);
+			p[1] = (u8)(y * 8);
+			// Flat areas so snappy has something to do.
+			p[2] = (u8)(seed * 16);
+			p[3] = opaque ? 0xFF : (u8)(x + y);
+		}
+	}
+	return pixels;
+}
+
+static bool WritePNG(const std::string &filename, const std::vector<u8> &pixels, int w, int h) {
+#ifdef USING_QT_UI
+	QImage image(pixels.data(), w, h, w * 4, QImage::Format_RGBA8888);
+	return image.save(filename.c_str(), "PNG");
+#else
+	png_image png = {};
+	png.version = PNG_IMAGE_VERSION;
+	png.format = PNG_FORMAT_RGBA;
+	png.width = w;
+	png.height = h;
+	FILE *fp = File::OpenCFile(filename, "wb");
+	if (!fp) {
+		return false;
+	}
+	bool success = png_image_write_to_stdio(&png, fp, 0, pixels.data(), w * 4, nullptr) != 0;
+	fclose(fp);
+	png_image_free(&png);
+	return success;
+#endif
+}
+
+static bool ReadBack(ReplacementPack &pack, u64 cachekey, u32 hash, u32 level, const std::vector<u8> &expected, int w, int h) {
+	const ReplacementPackEntry *entry = pack.Find(cachekey, hash, level, false);
+	if (!entry) {
+		printf("Pack entry %08x_%d missing\n", hash, level);
+		return false;
+	}
+	if ((int)entry->w != w || (int)entry->h != h) {
+		printf("Pack entry %08x_%d is %dx%d, expected %dx%d\n", hash, level, (int)entry->w, (int)entry->h, w, h);
+		return false;
+	}
+
+	// Leave a gap at the end of each row to check the pitch is respected.
+	const int rowPitch = w * 4 + 16;
+	std::vector<u8> out(rowPitch * h, 0xCC);
+	if (!pack.Read(entry, out.data(), rowPitch)) {
+		printf("Pack entry %08x_%d failed to read\n", hash, level);
+		return false;
+	}
+	for (int y = 0; y < h; ++y) {
+		if (memcmp(&out[rowPitch * y], &expected[w * 4 * y], w * 4) != 0 || out[rowPitch * y + w * 4] != 0xCC) {
+			printf("Pack entry %08x_%d differs at row %d\n", hash, level, y);
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool TestRoundTrip(bool compress, const std::vector<ReplacementPackSource> &sources, const std::vector<u8> &first, const std::vector<u8> &second) {
+	if (!ReplacementPack::Build(PACK_DIR, PACK_FILE, sources, compress)) {
+		printf("Failed to build pack (compress=%d)\n", (int)compress);
+		return false;
+	}
+
+	ReplacementPack pack;
+	if (!pack.Open(PACK_FILE)) {
+		printf("Failed to open pack (compress=%d)\n", (int)compress);
+		return false;
+	}
+
+	bool success = true;
+	// Once straight, once through the loader thread.
+	for (int pass = 0; pass < 2; ++pass) {
+		if (pass == 1) {
+			pack.Prefetch(pack.Find(0x1000, 0x11111111, 0, false));
+		}
+		success = success && ReadBack(pack, 0x1000, 0x11111111, 0, first, 32, 16);
+		success = success && ReadBack(pack, 0x1000, 0x11111111, 1, second, 16, 8);
+		// Shares the file with the first entry.
+		success = success && ReadBack(pack, 0x2000, 0x22222222, 0, first, 32, 16);
+	}
+
+	const ReplacementPackEntry *opaque = pack.Find(0x1000, 0x11111111, 1, false);
+	if (success && (!opaque || (opaque->flags & PACK_ENTRY_ALPHA_FULL) == 0)) {
+		printf("Opaque pack entry not marked as such\n");
+		success = false;
+	}
+	const ReplacementPackEntry *ignored = pack.Find(0x3000, 0x33333333, 0, true);
+	if (success && (!ignored || (ignored->flags & PACK_ENTRY_IGNORED) == 0)) {
+		printf("Ignored pack entry missing\n");
+		success = false;
+	}
+	if (success && pack.Find(0x1000, 0x11111111, 0, true) != nullptr) {
+		printf("Non-alias pack entry found as alias\n");
+		success = false;
+	}
+	if (success && (pack.Find(0x1000, 0x11111111, 2, false) || pack.Find(0x4000, 0x11111111, 0, false))) {
+		printf("Found a pack entry that was never added\n");
+		success = false;
+	}
+	// The missing file is just left out.
+	if (success && pack.Find(0x5000, 0x55555555, 0, false)) {
+		printf("Pack entry for a missing file was kept\n");
+		success = false;
+	}
+
+	pack.Close();
+	return success;
+}
+
+static bool OpensModified(const std::vector<u8> &data, size_t size, void (*modify)(std::vector<u8> &data)) {
+	std::vector<u8> broken(data.begin(), data.begin() + size);
+	if (modify) {
+		modify(broken);
+	}
+	FILE *fp = File::OpenCFile(BROKEN_PACK_FILE, "wb");
+	if (!fp) {
+		return true;
+	}
+	fwrite(broken.data(), 1, broken.size(), fp);
+	fclose(fp);
+
+	ReplacementPack pack;
+	bool opened = pack.Open(BROKEN_PACK_FILE);
+	pack.Close();
+	File::Delete(BROKEN_PACK_FILE);
+	return opened;
+}
+
+static ReplacementPackEntry *FirstEntry(std::vector<u8> &data) {
+	return (ReplacementPackEntry *)&data[sizeof(ReplacementPackHeader)];
+}
+
+static bool TestRejectsBrokenPacks() {
+	FILE *fp = File::OpenCFile(PACK_FILE, "rb");
+	if (!fp) {
+		printf("Unable to read back pack\n");
+		return false;
+	}
+	std::vector<u8> data((size_t)File::GetFileSize(fp));
+	bool success = fread(data.data(), 1, data.size(), fp) == data.size();
+	fclose(fp);
+	if (!success || !OpensModified(data, data.size(), nullptr)) {
+		printf("Unmodified pack did not open\n");
+		return false;
+	}
+
+	if (OpensModified(data, data.size() - 1, nullptr)) {
+		printf("Opened a pack with truncated data\n");
+		success = false;
+	}
+	if (OpensModified(data, sizeof(ReplacementPackHeader) + sizeof(ReplacementPackEntry), nullptr)) {
+		printf("Opened a pack with a truncated index\n");
+		success = false;
+	}
+	if (OpensModified(data, data.size(), [](std::vector<u8> &broken) {
+		FirstEntry(broken)->offset = broken.size() + 1;
+	})) {
+		printf("Opened a pack with an entry past the end\n");
+		success = false;
+	}
+	if (OpensModified(data, data.size(), [](std::vector<u8> &broken) {
+		// Offset + size wraps to a small number.
+		FirstEntry(broken)->offset = 0xFFFFFFFFFFFFFF00ULL;
+		FirstEntry(broken)->size = 0x200;
+	})) {
+		printf("Opened a pack with a wrapping entry\n");
+		success = false;
+	}
+	if (OpensModified(data, data.size(), [](std::vector<u8> &broken) {
+		FirstEntry(broken)->w = 0x10000;
+		FirstEntry(broken)->h = 0x10000;
+	})) {
+		printf("Opened a pack with a huge entry\n");
+		success = false;
+	}
+	if (OpensModified(data, data.size(), [](std::vector<u8> &broken) {
+		((ReplacementPackHeader *)broken.data())->entryCount = 0x10000000;
+	})) {
+		printf("Opened a pack with too many entries\n");
+		success = false;
+	}
+	if (OpensModified(data, data.size(), [](std::vector<u8> &broken) {
+		broken[0] = 'X';
+	})) {
+		printf("Opened a pack with a bad magic\n");
+		success = false;
+	}
+	return success;
+}
+
+bool TestTextureReplacementPack() {
+	File::CreateDir(PACK_DIR);
+
+	const std::vector<u8> first = MakePixels(32, 16, 1, false);
+	const std::vector<u8> second = MakePixels(16, 8, 2, true);
+	if (!WritePNG(std::string(PACK_DIR) + "first.png", first, 32, 16) || !WritePNG(std::string(PACK_DIR) + "second.png", second, 16, 8)) {
+		printf("Unable to write test PNGs\n");
+		return false;
+	}
+
+	std::vector<ReplacementPackSource> sources;
+	sources.push_back({ 0x1000, 0x11111111, 0, 0, "first.png" });
+	sources.push_back({ 0x1000, 0x11111111, 1, 0, "second.png" });
+	sources.push_back({ 0x2000, 0x22222222, 0, PACK_ENTRY_ALIAS, "first.png" });
+	sources.push_back({ 0x3000, 0x33333333, 0, PACK_ENTRY_ALIAS, "" });
+	sources.push_back({ 0x5000, 0x55555555, 0, 0, "missing.png" });
+
+	bool success = TestRoundTrip(false, sources, first, second);
+	success = TestRoundTrip(true, sources, first, second) && success;
+	success = TestRejectsBrokenPacks() && success;
+
+	File::Delete(PACK_FILE);
+	File::Delete(std::string(PACK_DIR) + "first.png");
+	File::Delete(std::string(PACK_DIR) + "second.png");
+	File::DeleteDir(PACK_DIR);
+	return success;
+}
@@ -0,0 +1,174 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/timeutil.h"
+#include "Core/Config.h"
+#include "GPU/Common/TextureScalerCommon.h"
+
+static const int TEX_W = 128;
+static const int TEX_H = 128;
+static const int BENCH_ITERATIONS = 4;
+
+class TestScaler : public TextureScalerCommon {
+public:
+	explicit TestScaler(bool useSIMD = true) : TextureScalerCommon(useSIMD) {
+	}
+
+	void Run(int filter, int factor, u32 *src, u32 *dest) {
+		switch (filter) {
+		case 0: ScaleBilinear(scaleBufs_, factor, src, dest, TEX_W, TEX_H); break;
+		case 1: ScaleBicubicBSpline(scaleBufs_, factor, src, dest, TEX_W, TEX_H); break;
+		case 2: ScaleBicubicMitchell(scaleBufs_, factor, src, dest, TEX_W, TEX_H); break;
+		case 3: ScaleHybrid(scaleBufs_, factor, src, dest, TEX_W, TEX_H, false); break;
+		default: ScaleHybrid(scaleBufs_, factor, src, dest, TEX_W, TEX_H, true); break;
+		}
+	}
+
+protected:
+	void ConvertTo8888(u32 format, u32 *source, u32 *&dest, int width, int height) override {
+		dest = source;
+	}
+	int BytesPerPixel(u32 format) override {
+		return 4;
+	}
+	u32 Get8888Format() override {
+		return 0;
+	}
+};
+
+static double TimeFilter(TestScaler &scaler, int filter, int factor, u32 *src, u32 *dest) {
+	double st = real_time_now();
+	for (int i = 0; i < BENCH_ITERATIONS; ++i) {
+		scaler.Run(filter, factor, src, dest);
+	}
+	return real_time_now() - st;
+}
+
+static bool WithinTolerance(u32 a, u32 b, int tolerance) {
+	for (int c = 0; c < 32; c += 8) {
+		if (abs((int)((a >> c) & 0xFF) - (int)((b >> c) & 0xFF)) > tolerance) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool TestAsyncScaling(const std::vector<u32> &src) {
+	const int oldType = g_Config.iTexScalingType;
+	const bool oldDeposterize = g_Config.bTexDeposterize;
+	g_Config.iTexScalingType = TextureScalerCommon::XBRZ;
+	g_Config.bTexDeposterize = false;
+
+	TestScaler scaler;
+	const int factor = 2;
+	std::vector<u32> expected(TEX_W * TEX_H * factor * factor);
+	std::vector<u32> actual(TEX_W * TEX_H * factor * factor);
+	u32 fmt = 0;
+	int w = TEX_W, h = TEX_H;
+	scaler.ScaleAlways(expected.data(), (u32 *)src.data(), fmt, w, h, factor);
+
+	TextureScalerCommon::AsyncKey key;
+	key.hash = 0x1234567890ABCDEFULL;
+	key.dim = 0x0707;
+	key.format = 3;
+	bool success = true;
+	for (int pass = 0; pass < 2 && success; ++pass) {
+		scaler.QueueAsync(key, src.data(), TEX_W * sizeof(u32), 0, TEX_W, TEX_H, factor);
+		// Each frame gives the async thread a little more time.
+		double start = real_time_now();
+		while (!scaler.IsAsyncReady(key) && real_time_now() - start < 10.0) {
+			scaler.StartFrame();
+			sleep_ms(1);
+		}
+
+		w = TEX_W;
+		h = TEX_H;
+		if (!scaler.CopyAsyncResult(key, actual.data(), fmt, w, h, factor)) {
+			printf("Async scaling: no result\n");
+			success = false;
+		} else if (w != TEX_W * factor || h != TEX_H * factor || expected != actual) {
+			printf("Async scaling: result differs from scaling right away\n");
+			success = false;
+		}
+
+		// Nothing is left after clearing, and queueing again starts over.
+		scaler.ClearAsync();
+		if (scaler.IsAsyncReady(key)) {
+			printf("Async scaling: result still there after clearing\n");
+			success = false;
+		}
+	}
+
+	g_Config.iTexScalingType = oldType;
+	g_Config.bTexDeposterize = oldDeposterize;
+	return success;
+}
+
+bool TestTextureScaler() {
+	// Blocky, like a typical PSP texture, with some noise so every filter path gets used.
+	std::vector<u32> src(TEX_W * TEX_H);
+	for (int y = 0; y < TEX_H; ++y) {
+		for (int x = 0; x < TEX_W; ++x) {
+			u32 block = ((x / 4) * 0x9E3779B1) ^ ((y / 4) * 0x85EBCA77);
+			src[y * TEX_W + x] = (rand() & 7) == 0 ? (u32)rand() * 0x10001 : block;
+		}
+	}
+
+	static const struct {
+		const char *name;
+		// See the TextureScalerCommon constructor, only bicubic may round differently.
+		int tolerance;
+	} filters[] = {
+		{ "Bilinear", 0 },
+		{ "Bicubic B-spline", 1 },
+		{ "Bicubic Mitchell", 1 },
+		{ "Hybrid", 0 },
+		{ "Hybrid + bicubic", 1 },
+	};
+
+	TestScaler plainScaler(false);
+	TestScaler simdScaler(true);
+	bool success = true;
+	for (int filter = 0; filter < (int)ARRAY_SIZE(filters); ++filter) {
+		for (int factor = 2; factor <= 5; ++factor) {
+			std::vector<u32> expected(TEX_W * TEX_H * factor * factor);
+			std::vector<u32> actual(TEX_W * TEX_H * factor * factor);
+
+			double refTime = TimeFilter(plainScaler, filter, factor, src.data(), expected.data());
+			double fastTime = TimeFilter(simdScaler, filter, factor, src.data(), actual.data());
+
+			const double mpixels = (double)TEX_W * TEX_H * factor * factor * BENCH_ITERATIONS / 1000000.0;
+			printf("%s %dx: plain %0.1f Mpx/s, simd %0.1f Mpx/s\n", filters[filter].name, factor, mpixels / refTime, mpixels / fastTime);
+
+			for (size_t i = 0; i < expected.size(); ++i) {
+				if (!WithinTolerance(expected[i], actual[i], filters[filter].tolerance)) {
+					printf("%s %dx: mismatch at pixel %d,%d (%08x vs %08x)\n", filters[filter].name, factor, (int)(i % (TEX_W * factor)), (int)(i / (TEX_W * factor)), expected[i], actual[i]);
+					success = false;
+					break;
+				}
+			}
+		}
+	}
+
+	success = TestAsyncScaling(src) && success;
+	return success;
+}
@@ -545,6 +545,15 @@ struct TestItem {
 bool TestArmEmitter();
 bool TestArm64Emitter();
 bool TestX64Emitter();
+bool TestTextureDecoder();
+bool TestTextureScaler();
+bool TestTextureReplacementPack();
+bool TestGPUCommands();
+bool TestDisplayListCache();
+bool TestShaderId();
+bool TestIndexGenerator();
+bool TestFileLoaders();
+bool TestISOFileSystem();
 
 TestItem availableTests[] = {
 #if defined(ARM64) || defined(_M_X64) || defined(_M_IX86)
@@ -568,6 +577,15 @@ TestItem availableTests[] = {
 	TEST_ITEM(QuickTexHash),
 	TEST_ITEM(CLZ),
 	TEST_ITEM(MemMap),
+	TEST_ITEM(TextureDecoder),
+	TEST_ITEM(TextureScaler),
+	TEST_ITEM(TextureReplacementPack),
+	TEST_ITEM(GPUCommands),
+	TEST_ITEM(DisplayListCache),
+	TEST_ITEM(ShaderId),
+	TEST_ITEM(IndexGenerator),
+	TEST_ITEM(FileLoaders),
+	TEST_ITEM(ISOFileSystem),
 };
 
 int main(int argc, const char *argv[]) {